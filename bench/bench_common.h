@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace diana::bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double seconds_since(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+inline double mb_per_sec(size_t bytes, double seconds) {
+    return seconds > 0.0 ? (static_cast<double>(bytes) / (1024.0 * 1024.0)) / seconds : 0.0;
+}
+
+// Reads an integer from argv[index], falling back to def.
+inline long arg_or(int argc, char** argv, int index, long def) {
+    if (index < argc) {
+        long v = std::strtol(argv[index], nullptr, 10);
+        if (v > 0) return v;
+    }
+    return def;
+}
+
+// Coloured, agent-like output: prose, SGR runs, a diff-ish prefix every few
+// lines. Deterministic so runs are comparable.
+inline std::string make_agent_output(size_t bytes) {
+    static const char* words[] = {
+        "terminal", "session", "render", "parse", "snapshot", "scrollback",
+        "cursor", "update", "buffer", "request", "agent", "output",
+    };
+    std::string out;
+    out.reserve(bytes + 256);
+    unsigned seed = 12345;
+    int line = 0;
+    while (out.size() < bytes) {
+        if (line % 5 == 0) out += "\x1b[32m+ \x1b[0m";
+        int len = 0;
+        while (len < 90) {
+            seed = seed * 1103515245u + 12345u;
+            const char* w = words[(seed >> 16) % (sizeof(words) / sizeof(words[0]))];
+            if ((seed >> 8) % 7 == 0) {
+                out += "\x1b[1;34m";
+                out += w;
+                out += "\x1b[0m ";
+            } else {
+                out += w;
+                out += ' ';
+            }
+            len += static_cast<int>(std::char_traits<char>::length(w)) + 1;
+        }
+        out += "\r\n";
+        ++line;
+    }
+    return out;
+}
+
+inline void print_row(const char* name, size_t bytes, double seconds) {
+    std::printf("%-28s %10.1f MB  %8.3f s  %10.1f MB/s\n",
+                name, static_cast<double>(bytes) / (1024.0 * 1024.0), seconds, mb_per_sec(bytes, seconds));
+}
+
+}
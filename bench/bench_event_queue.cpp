@@ -0,0 +1,143 @@
+// Session event queue under contention.
+//
+// N producer threads push SessionEvents as fast as they can while one
+// consumer takes them, the way PTY, parser and daemon threads feed the UI
+// thread. Compared:
+//   - the previous queue: std::deque behind a mutex, with a condition
+//     variable notified on every push, consumed one try_pop at a time;
+//   - EventQueue consumed with try_pop;
+//   - EventQueue consumed with drain() into a reused vector, as
+//     TerminalPanel::process_events does.
+// ExitEvents are used so no string is allocated and the queue is all that is
+// measured. Reported: events per second through the queue, best of repeats.
+//
+// usage: diana_bench_event_queue [thousand events per producer] [repeats]
+
+#include "bench_common.h"
+#include "core/event_queue.h"
+#include "core/session_events.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+using namespace diana;
+using namespace diana::bench;
+
+namespace {
+
+// The queue EventQueue replaced.
+template<typename T>
+class MutexEventQueue {
+public:
+    void push(T event) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(event));
+        cv_.notify_one();
+    }
+
+    std::optional<T> try_pop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return std::nullopt;
+        }
+        T event = std::move(queue_.front());
+        queue_.pop_front();
+        return event;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<T> queue_;
+};
+
+enum class Consumer { MutexTryPop, TryPop, Drain };
+
+// Returns events per second.
+template<typename Queue>
+double run(Queue& queue, Consumer consumer, int producers, long per_producer) {
+    std::atomic<int> ready{0};
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (long i = 0; i < per_producer; ++i) {
+                queue.push(ExitEvent{static_cast<uint32_t>(p), static_cast<int>(i)});
+            }
+        });
+    }
+    while (ready.load() < producers) {
+        std::this_thread::yield();
+    }
+
+    const long total = per_producer * producers;
+    long received = 0;
+    std::vector<SessionEvent> batch;
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    while (received < total) {
+        if (consumer == Consumer::Drain) {
+            if constexpr (std::is_same_v<Queue, EventQueue<SessionEvent>>) {
+                batch.clear();
+                received += static_cast<long>(queue.drain(batch));
+            }
+        } else if (queue.try_pop()) {
+            ++received;
+        }
+    }
+    double seconds = seconds_since(start);
+    for (auto& t : threads) {
+        t.join();
+    }
+    return seconds > 0.0 ? static_cast<double>(total) / seconds : 0.0;
+}
+
+double best_rate(long repeats, Consumer consumer, int producers, long per_producer) {
+    double best = 0.0;
+    for (long i = 0; i < repeats; ++i) {
+        double rate = 0.0;
+        if (consumer == Consumer::MutexTryPop) {
+            MutexEventQueue<SessionEvent> queue;
+            rate = run(queue, consumer, producers, per_producer);
+        } else {
+            EventQueue<SessionEvent> queue;
+            rate = run(queue, consumer, producers, per_producer);
+        }
+        best = std::max(best, rate);
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    long per_producer = arg_or(argc, argv, 1, 200) * 1000;
+    long repeats = arg_or(argc, argv, 2, 3);
+    unsigned cores = std::max(2u, std::thread::hardware_concurrency());
+
+    std::printf("SessionEvent queue, %ld events per producer, best of %ld, %u hardware threads\n",
+                per_producer, repeats, cores);
+    std::printf("%-10s %16s %16s %16s\n", "producers", "mutex try_pop", "try_pop", "drain");
+    for (int producers : {1, 2, 4, 8, 16}) {
+        if (static_cast<unsigned>(producers) > cores * 2) {
+            break;
+        }
+        std::printf("%-10d", producers);
+        for (Consumer consumer : {Consumer::MutexTryPop, Consumer::TryPop, Consumer::Drain}) {
+            std::printf(" %11.2f M/s", best_rate(repeats, consumer, producers, per_producer) / 1e6);
+        }
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,314 @@
+// PTY -> VTerminal throughput.
+//
+// Runs `cat` on a generated file inside a PTY and measures how long it takes
+// until every byte has been parsed by a VTerminal, for:
+//   - the previous path: a std::string per read pushed through the
+//     session EventQueue, copied again while filtering CPR requests and
+//     parsed on the consuming thread;
+//   - the ring path: the runner reads straight into the session's ByteRing
+//     and the session's parser thread consumes contiguous spans.
+// Parsing dominates both, so each path is also run with a consumer that only
+// drains the bytes, which isolates the transport. The paste row goes the other
+// way: the payload is written to a raw-mode child that saves it, and is
+// checked byte for byte. Finally it reports how long the exit of a
+// short-lived child takes to reach the exit callback and how often the IO
+// reactor wakes while sessions sit idle.
+//
+// usage: diana_bench_pty [megabytes] [repeats]
+
+#include "bench_common.h"
+#include "core/event_queue.h"
+#include "core/session_events.h"
+#include "process/process_runner.h"
+#include "terminal/terminal_session.h"
+#include "terminal/vterminal.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace diana;
+using namespace diana::bench;
+
+namespace {
+
+constexpr int ROWS = 50;
+constexpr int COLS = 200;
+
+// Same shape as the filter that used to run on the UI thread.
+std::string legacy_filter(const std::string& input, std::string& pending) {
+    std::string data = pending + input;
+    pending.clear();
+    std::string filtered;
+    filtered.reserve(data.size());
+    size_t i = 0;
+    while (i < data.size()) {
+        if (data[i] == '\x1b') {
+            if (i + 3 >= data.size()) {
+                pending = data.substr(i);
+                break;
+            }
+            if (data[i + 1] == '[' && data[i + 2] == '6' && data[i + 3] == 'n') {
+                i += 4;
+                continue;
+            }
+        }
+        filtered.push_back(data[i]);
+        i += 1;
+    }
+    return filtered;
+}
+
+ProcessConfig cat_config(const std::string& path) {
+    ProcessConfig config;
+    config.executable = "cat";
+    config.args = {path};
+    config.rows = ROWS;
+    config.cols = COLS;
+    return config;
+}
+
+double run_legacy(const std::string& path, bool parse) {
+    EventQueue<SessionEvent> queue;
+    VTerminal terminal(ROWS, COLS);
+    std::string pending;
+
+    ProcessRunner runner;
+    runner.set_output_callback([&queue](const std::string& data, bool is_stderr) {
+        queue.push(OutputEvent{1, data, is_stderr});
+    });
+    runner.set_exit_callback([&queue](int code) {
+        queue.push(ExitEvent{1, code});
+    });
+
+    auto start = Clock::now();
+    if (!runner.start(cat_config(path))) {
+        std::fprintf(stderr, "failed to start cat\n");
+        return 0.0;
+    }
+
+    bool done = false;
+    while (!done) {
+        SessionEvent event = queue.wait_pop();
+        if (auto* out = std::get_if<OutputEvent>(&event)) {
+            std::string filtered = legacy_filter(out->data, pending);
+            if (parse) {
+                terminal.write(filtered.data(), filtered.size());
+            }
+        } else if (std::holds_alternative<ExitEvent>(event)) {
+            done = true;
+        }
+    }
+    return seconds_since(start);
+}
+
+double run_ring(const std::string& path) {
+    TerminalSession session(1);
+    session.resize_terminal(ROWS, COLS);
+    session.set_foreground(true);
+
+    std::atomic<bool> exited{false};
+    ProcessRunner runner;
+    runner.set_output_ring(session.output_ring());
+    runner.set_exit_callback([&exited](int) { exited.store(true); });
+
+    auto start = Clock::now();
+    if (!runner.start(cat_config(path))) {
+        std::fprintf(stderr, "failed to start cat\n");
+        return 0.0;
+    }
+    while (!exited.load()) {
+        session.wait_until_parsed(std::chrono::milliseconds(5));
+    }
+    session.wait_until_parsed(std::chrono::seconds(30));
+    return seconds_since(start);
+}
+
+double run_ring_drain(const std::string& path) {
+    auto ring = std::make_shared<ByteRing>();
+    std::atomic<bool> exited{false};
+    ProcessRunner runner;
+    runner.set_output_ring(ring);
+    runner.set_exit_callback([&exited](int) { exited.store(true); });
+
+    auto start = Clock::now();
+    if (!runner.start(cat_config(path))) {
+        std::fprintf(stderr, "failed to start cat\n");
+        return 0.0;
+    }
+    size_t checksum = 0;
+    while (true) {
+        bool done = exited.load();
+        ConstByteSpan span = ring->read_span();
+        if (span.size > 0) {
+            checksum += static_cast<unsigned char>(span.data[0]);
+            ring->commit_read(span.size);
+            continue;
+        }
+        if (done) break;
+        std::this_thread::yield();
+    }
+    (void)checksum;
+    return seconds_since(start);
+}
+
+// write_stdin() of the whole payload until the child has stored all of it.
+double run_paste(const std::string& payload, bool* intact) {
+    std::string out_path = "/tmp/diana_bench_paste_" + std::to_string(getpid()) + ".txt";
+    std::atomic<bool> ready{false};
+    std::atomic<bool> exited{false};
+    ProcessRunner runner;
+    runner.set_output_callback([&ready](const std::string& data, bool) {
+        if (data.find('R') != std::string::npos) ready.store(true);
+    });
+    runner.set_exit_callback([&exited](int) { exited.store(true); });
+
+    ProcessConfig config;
+    config.executable = "/bin/sh";
+    config.args = {"-c", "stty raw -echo; printf R; head -c " + std::to_string(payload.size()) + " > " + out_path};
+    if (!runner.start(config)) {
+        std::fprintf(stderr, "failed to start sh\n");
+        return 0.0;
+    }
+    while (!ready.load()) {
+        std::this_thread::yield();
+    }
+
+    auto start = Clock::now();
+    if (!runner.write_stdin(payload)) {
+        std::fprintf(stderr, "paste rejected\n");
+    }
+    while (!exited.load()) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double elapsed = seconds_since(start);
+
+    std::ifstream in(out_path, std::ios::binary);
+    std::string received((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    *intact = received == payload;
+    unlink(out_path.c_str());
+    return elapsed;
+}
+
+// Spawn to exit callback for `true`, averaged.
+double run_exit_latency(long repeats) {
+    double total = 0.0;
+    for (long i = 0; i < repeats; ++i) {
+        std::atomic<bool> exited{false};
+        ProcessRunner runner;
+        runner.set_output_callback([](const std::string&, bool) {});
+        runner.set_exit_callback([&exited](int) { exited.store(true); });
+        ProcessConfig config;
+        config.executable = "true";
+        auto start = Clock::now();
+        if (!runner.start(config)) {
+            return 0.0;
+        }
+        while (!exited.load()) {
+            std::this_thread::yield();
+        }
+        total += seconds_since(start);
+    }
+    return total / static_cast<double>(repeats);
+}
+
+// start() until the child's first byte reaches the output callback, averaged.
+double run_first_output_latency(long repeats, const ProcessConfig& config) {
+    double total = 0.0;
+    for (long i = 0; i < repeats; ++i) {
+        std::atomic<bool> got_output{false};
+        std::atomic<bool> exited{false};
+        ProcessRunner runner;
+        runner.set_output_callback([&got_output](const std::string&, bool) { got_output.store(true); });
+        runner.set_exit_callback([&exited](int) { exited.store(true); });
+        auto start = Clock::now();
+        if (!runner.start(config)) {
+            return 0.0;
+        }
+        while (!got_output.load()) {
+            std::this_thread::yield();
+        }
+        total += seconds_since(start);
+        while (!exited.load()) {
+            std::this_thread::yield();
+        }
+    }
+    return total / static_cast<double>(repeats);
+}
+
+// Reactor wakeups while a handful of silent children run for a second.
+uint64_t idle_wakeups(int sessions) {
+    std::vector<std::unique_ptr<ProcessRunner>> runners;
+    for (int i = 0; i < sessions; ++i) {
+        auto runner = std::make_unique<ProcessRunner>();
+        runner->set_output_ring(std::make_shared<ByteRing>());
+        ProcessConfig config;
+        config.executable = "sleep";
+        config.args = {"2"};
+        runner->start(config);
+        runners.push_back(std::move(runner));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    uint64_t before = IoReactor::instance().wakeups();
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    return IoReactor::instance().wakeups() - before;
+}
+
+double best_of(long repeats, const std::function<double()>& fn) {
+    double best = 0.0;
+    for (long i = 0; i < repeats; ++i) {
+        double t = fn();
+        if (best == 0.0 || t < best) best = t;
+    }
+    return best;
+}
+
+}
+
+int main(int argc, char** argv) {
+    long megabytes = arg_or(argc, argv, 1, 64);
+    long repeats = arg_or(argc, argv, 2, 3);
+
+    std::string payload = make_agent_output(static_cast<size_t>(megabytes) * 1024 * 1024);
+    std::string path = "/tmp/diana_bench_pty_" + std::to_string(getpid()) + ".txt";
+    {
+        std::ofstream f(path, std::ios::binary);
+        f.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+
+    std::printf("PTY -> VTerminal, %dx%d, %zu bytes, best of %ld\n", COLS, ROWS, payload.size(), repeats);
+
+    print_row("transport: callback + queue", payload.size(), best_of(repeats, [&] { return run_legacy(path, false); }));
+    print_row("transport: ByteRing", payload.size(), best_of(repeats, [&] { return run_ring_drain(path); }));
+    print_row("parsed: callback + queue", payload.size(), best_of(repeats, [&] { return run_legacy(path, true); }));
+    print_row("parsed: ByteRing + parser", payload.size(), best_of(repeats, [&] { return run_ring(path); }));
+
+    bool intact = true;
+    std::string paste = payload.substr(0, std::min<size_t>(payload.size(), 8u * 1024 * 1024));
+    print_row("paste: write queue", paste.size(), best_of(repeats, [&] {
+        bool ok = false;
+        double t = run_paste(paste, &ok);
+        intact = intact && ok;
+        return t;
+    }));
+    std::printf("%-28s %10s\n", "paste arrived intact", intact ? "yes" : "NO");
+    ProcessConfig echo_config;
+    echo_config.executable = "echo";
+    echo_config.args = {"x"};
+    std::printf("%-28s %10.2f ms\n", "first output, plan per start", run_first_output_latency(50, echo_config) * 1000.0);
+    echo_config.plan = ExecPlan::build(echo_config.executable, echo_config.args);
+    std::printf("%-28s %10.2f ms\n", "first output, cached plan", run_first_output_latency(50, echo_config) * 1000.0);
+    std::printf("%-28s %10.2f ms\n", "exit detected after spawn", run_exit_latency(20) * 1000.0);
+    std::printf("%-28s %10llu\n", "idle wakeups, 16 sessions/s", static_cast<unsigned long long>(idle_wakeups(16)));
+
+    unlink(path.c_str());
+    return 0;
+}
@@ -0,0 +1,514 @@
+// Terminal emulation throughput over agent-like traces.
+//
+// Each trace is fed to a VTerminal in PTY-sized chunks. Every FRAME_BYTES the
+// screen is snapshotted and drawn into a headless ImGui frame with
+// TerminalLineRenderer, the way TerminalPanel draws it. Reported per trace:
+//   - parse MB/s (VTerminal::write only) and scrollback lines/s;
+//   - heap allocations per MB parsed (operator new plus ImGui's allocator;
+//     libvterm's own mallocs are not counted);
+//   - per frame: snapshot + draw time, allocations, and draw-list size.
+//
+// Built-in traces are synthetic but shaped like real output: an ink-style
+// TUI that keeps erasing and redrawing its prompt box, a full-screen TUI that
+// repaints in place on the alternate screen, codex-style diffs,
+// `cat` of source files, truecolor/256-colour SGR runs and CJK/emoji text.
+// Recordings made with the terminal's Rec menu can be added on the command
+// line to benchmark captured sessions.
+//
+// Afterwards the cat and cjk-emoji traces are encoded as bracketed pastes,
+// once per codepoint through libvterm (the old send_paste path) and once with
+// VTerminal::keyboard_paste.
+//
+// usage: diana_bench_terminal [megabytes per trace] [repeats] [recording.dianarec ...]
+
+#include "bench_common.h"
+#include "process/session_recorder.h"
+#include "terminal/terminal_line_renderer.h"
+#include "terminal/vterminal.h"
+
+#include <imgui.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace diana;
+using namespace diana::bench;
+
+namespace {
+
+std::atomic<uint64_t> g_allocations{0};
+std::atomic<uint64_t> g_allocated_bytes{0};
+
+struct AllocCount {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+
+    static AllocCount now() {
+        return {g_allocations.load(std::memory_order_relaxed), g_allocated_bytes.load(std::memory_order_relaxed)};
+    }
+    AllocCount since(const AllocCount& before) const { return {count - before.count, bytes - before.bytes}; }
+};
+
+void* counting_imgui_alloc(size_t size, void*) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size);
+}
+
+void counting_imgui_free(void* ptr, void*) {
+    std::free(ptr);
+}
+
+}
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace {
+
+constexpr int ROWS = 50;
+constexpr int COLS = 200;
+constexpr size_t READ_CHUNK = 4096;
+constexpr size_t FRAME_BYTES = 64 * 1024;
+
+struct Rng {
+    unsigned state = 12345;
+    unsigned next() {
+        state = state * 1103515245u + 12345u;
+        return state >> 8;
+    }
+    unsigned below(unsigned n) { return next() % n; }
+};
+
+const char* WORDS[] = {
+    "terminal", "session", "render", "parse", "snapshot", "scrollback",
+    "cursor", "update", "buffer", "request", "agent", "output", "const", "return",
+};
+constexpr unsigned WORD_COUNT = sizeof(WORDS) / sizeof(WORDS[0]);
+
+void append_words(std::string& out, Rng& rng, int columns) {
+    int len = 0;
+    while (len < columns) {
+        const char* w = WORDS[rng.below(WORD_COUNT)];
+        out += w;
+        out += ' ';
+        len += static_cast<int>(std::char_traits<char>::length(w)) + 1;
+    }
+}
+
+// Ink-style UI: a few lines of streamed answer, then the prompt box below it
+// is erased and drawn again, with a spinner line that updates in place.
+std::string make_tui_redraw(size_t bytes) {
+    std::string out;
+    Rng rng;
+    const std::string rule = [] {
+        std::string r;
+        for (int i = 0; i < COLS - 2; ++i) r += "\xE2\x94\x80";
+        return r;
+    }();
+    static const char* spinner[] = {"\xE2\xA0\x8B", "\xE2\xA0\x99", "\xE2\xA0\xB9", "\xE2\xA0\xB8"};
+    int step = 0;
+    while (out.size() < bytes) {
+        // Erase the previous spinner + box (6 lines) and continue the answer.
+        if (step > 0) out += "\r\x1b[6A\x1b[J";
+        for (int i = 0; i < 2; ++i) {
+            out += "\x1b[1m\xE2\x8F\xBA\x1b[22m ";
+            append_words(out, rng, 110);
+            out += "\r\n";
+        }
+        out += "\x1b[38;5;208m";
+        out += spinner[step % 4];
+        out += "\x1b[39m Thinking\xE2\x80\xA6 \x1b[2m(" + std::to_string(step / 10) + "s \xC2\xB7 esc to interrupt)\x1b[22m\r\n";
+        out += "\x1b[2m\xE2\x95\xAD" + rule + "\xE2\x95\xAE\x1b[22m\r\n";
+        out += "\x1b[2m\xE2\x94\x82\x1b[22m > ";
+        out += std::string(static_cast<size_t>(COLS - 5), ' ');
+        out += "\x1b[2m\xE2\x94\x82\x1b[22m\r\n";
+        out += "\x1b[2m\xE2\x95\xB0" + rule + "\xE2\x95\xAF\x1b[22m\r\n";
+        out += "  \x1b[2m? for shortcuts\x1b[22m\r\n";
+        out += "\x1b[7m context 42% \x1b[27m\r\n";
+        ++step;
+    }
+    return out;
+}
+
+// Full-screen TUI on the alternate screen (htop, a pager, a status board):
+// every row is rewritten in place with cursor addressing and nothing scrolls.
+std::string make_fullscreen_repaint(size_t bytes) {
+    std::string out = "\x1b[?1049h";
+    Rng rng;
+    while (out.size() < bytes) {
+        for (int row = 1; row <= ROWS; ++row) {
+            out += "\x1b[" + std::to_string(row) + ";1H";
+            if (row == 1) out += "\x1b[7m";
+            append_words(out, rng, COLS - 16);
+            out += "\x1b[K";
+            if (row == 1) out += "\x1b[27m";
+        }
+    }
+    return out;
+}
+
+std::string make_codex_diff(size_t bytes) {
+    std::string out;
+    Rng rng;
+    int file = 0;
+    while (out.size() < bytes) {
+        std::string name = "src/module_" + std::to_string(file++) + ".cpp";
+        out += "\x1b[1mdiff --git a/" + name + " b/" + name + "\x1b[0m\r\n";
+        out += "\x1b[1m--- a/" + name + "\x1b[0m\r\n\x1b[1m+++ b/" + name + "\x1b[0m\r\n";
+        for (int hunk = 0; hunk < 4; ++hunk) {
+            int line = static_cast<int>(rng.below(900)) + 1;
+            out += "\x1b[36m@@ -" + std::to_string(line) + ",12 +" + std::to_string(line) + ",13 @@\x1b[0m\r\n";
+            for (int i = 0; i < 13; ++i) {
+                unsigned kind = rng.below(6);
+                if (kind == 0) {
+                    out += "\x1b[31m-    ";
+                } else if (kind == 1) {
+                    out += "\x1b[32m+    ";
+                } else {
+                    out += "     ";
+                }
+                append_words(out, rng, 40 + static_cast<int>(rng.below(40)));
+                out += kind <= 1 ? "\x1b[0m\r\n" : "\r\n";
+            }
+        }
+    }
+    return out;
+}
+
+std::string make_cat(size_t bytes) {
+    std::string out;
+    Rng rng;
+    while (out.size() < bytes) {
+        int indent = static_cast<int>(rng.below(4)) * 4;
+        out.append(static_cast<size_t>(indent), ' ');
+        append_words(out, rng, 20 + static_cast<int>(rng.below(70)));
+        out += "\r\n";
+    }
+    return out;
+}
+
+std::string make_sgr_heavy(size_t bytes) {
+    std::string out;
+    Rng rng;
+    while (out.size() < bytes) {
+        for (int col = 0; col < 150;) {
+            const char* w = WORDS[rng.below(WORD_COUNT)];
+            switch (rng.below(4)) {
+                case 0:
+                    out += "\x1b[38;2;" + std::to_string(rng.below(256)) + ";" + std::to_string(rng.below(256)) + ";" +
+                           std::to_string(rng.below(256)) + "m";
+                    break;
+                case 1:
+                    out += "\x1b[38;5;" + std::to_string(rng.below(256)) + ";48;5;" + std::to_string(rng.below(256)) + "m";
+                    break;
+                case 2:
+                    out += "\x1b[1;3;4m";
+                    break;
+                default:
+                    out += "\x1b[9" + std::to_string(rng.below(8)) + "m";
+                    break;
+            }
+            out += w;
+            out += "\x1b[0m ";
+            col += static_cast<int>(std::char_traits<char>::length(w)) + 1;
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+std::string make_cjk_emoji(size_t bytes) {
+    static const char* pieces[] = {
+        "\xE7\xBB\x88\xE7\xAB\xAF\xE6\xB8\xB2\xE6\x9F\x93",          // 终端渲染
+        "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E\xE3\x81\xAE\xE3\x83\x86\xE3\x82\xAD\xE3\x82\xB9\xE3\x83\x88",  // 日本語のテキスト
+        "\xED\x95\x9C\xEA\xB5\xAD\xEC\x96\xB4",                      // 한국어
+        "\xF0\x9F\x9A\x80",                                          // rocket
+        "\xE2\x9C\xA8",                                              // sparkles
+        "\xF0\x9F\x91\x8D\xF0\x9F\x8F\xBD",                          // thumbs up + skin tone
+        "\xF0\x9F\x91\xA8\xE2\x80\x8D\xF0\x9F\x91\xA9\xE2\x80\x8D\xF0\x9F\x91\xA7",  // family ZWJ
+        "caf\x65\xCC\x81",                                           // combining accent
+        "ascii",
+    };
+    constexpr unsigned piece_count = sizeof(pieces) / sizeof(pieces[0]);
+    std::string out;
+    Rng rng;
+    while (out.size() < bytes) {
+        for (int i = 0; i < 24; ++i) {
+            out += pieces[rng.below(piece_count)];
+            out += ' ';
+        }
+        out += "\r\n";
+    }
+    return out;
+}
+
+struct Trace {
+    std::string name;
+    std::string data;
+};
+
+struct TraceResult {
+    double parse_seconds = 0.0;
+    uint64_t lines_pushed = 0;
+    AllocCount parse_allocs;
+    int frames = 0;
+    double frame_seconds = 0.0;
+    AllocCount frame_allocs;
+    uint64_t vertices = 0;
+    uint64_t indices = 0;
+    uint64_t draw_cmds = 0;
+};
+
+class HeadlessImGui {
+public:
+    HeadlessImGui() {
+        ImGui::SetAllocatorFunctions(counting_imgui_alloc, counting_imgui_free);
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+        io.DeltaTime = 1.0f / 60.0f;
+        io.IniFilename = nullptr;
+#if IMGUI_VERSION_NUM >= 19200
+        io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+#else
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+#endif
+    }
+
+    ~HeadlessImGui() { ImGui::DestroyContext(); }
+
+    // Draws the screen as TerminalPanel does and returns the draw data.
+    const ImDrawData* frame(const ScreenSnapshot& snapshot) {
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0, 0));
+        ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+        ImGui::Begin("Terminal", nullptr, ImGuiWindowFlags_NoDecoration);
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        float char_w = ImGui::CalcTextSize("W").x;
+        float line_height = ImGui::GetTextLineHeight();
+        TerminalLineStyle style;
+        style.default_bg = 0xFF211D1A;
+        for (int row = 0; row < snapshot.rows; ++row) {
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            renderer_.draw(draw_list, origin, char_w, line_height, snapshot.row(row), snapshot.cols, -1, -1, style);
+            ImGui::Dummy(ImVec2(static_cast<float>(snapshot.cols) * char_w, line_height));
+        }
+        ImGui::End();
+        ImGui::Render();
+        return ImGui::GetDrawData();
+    }
+
+private:
+    TerminalLineRenderer renderer_;
+};
+
+TraceResult run_trace(const Trace& trace, HeadlessImGui& imgui) {
+    TraceResult result;
+    VTerminal terminal(ROWS, COLS);
+    ScreenSnapshot snapshot;
+
+    size_t offset = 0;
+    size_t next_frame = FRAME_BYTES;
+    while (offset < trace.data.size()) {
+        size_t frame_end = std::min(trace.data.size(), next_frame);
+
+        AllocCount before = AllocCount::now();
+        auto start = Clock::now();
+        while (offset < frame_end) {
+            size_t n = std::min(READ_CHUNK, frame_end - offset);
+            terminal.write(trace.data.data() + offset, n);
+            offset += n;
+        }
+        result.parse_seconds += seconds_since(start);
+        AllocCount parsed = AllocCount::now().since(before);
+        result.parse_allocs.count += parsed.count;
+        result.parse_allocs.bytes += parsed.bytes;
+
+        before = AllocCount::now();
+        start = Clock::now();
+        terminal.snapshot_screen(snapshot);
+        const ImDrawData* draw_data = imgui.frame(snapshot);
+        result.frame_seconds += seconds_since(start);
+        AllocCount drawn = AllocCount::now().since(before);
+        result.frame_allocs.count += drawn.count;
+        result.frame_allocs.bytes += drawn.bytes;
+
+        result.vertices += static_cast<uint64_t>(draw_data->TotalVtxCount);
+        result.indices += static_cast<uint64_t>(draw_data->TotalIdxCount);
+        for (int i = 0; i < draw_data->CmdListsCount; ++i) {
+            result.draw_cmds += static_cast<uint64_t>(draw_data->CmdLists[i]->CmdBuffer.Size);
+        }
+        ++result.frames;
+        next_frame += FRAME_BYTES;
+    }
+
+    auto lock = terminal.lock_scrollback();
+    result.lines_pushed = terminal.scrollback_evicted() + terminal.scrollback_size();
+    return result;
+}
+
+std::string load_recording_output(const std::string& path) {
+    std::string error;
+    auto recording = Recording::load(path, &error);
+    if (!recording) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return {};
+    }
+    std::string data;
+    data.reserve(recording->output_bytes());
+    for (const auto& frame : recording->frames) {
+        if (frame.kind == RecordedFrameKind::Output) {
+            auto bytes = recording->data(frame);
+            data.append(bytes.data(), bytes.size());
+        }
+    }
+    return data;
+}
+
+uint32_t decode_utf8(const std::string& text, size_t& i) {
+    unsigned char c0 = static_cast<unsigned char>(text[i]);
+    size_t len = c0 < 0x80 ? 1 : (c0 >> 5) == 0x6 ? 2 : (c0 >> 4) == 0xE ? 3 : (c0 >> 3) == 0x1E ? 4 : 0;
+    if (len == 0 || i + len > text.size()) {
+        ++i;
+        return 0xFFFD;
+    }
+    uint32_t cp = len == 1 ? c0 : c0 & (0x7F >> len);
+    for (size_t k = 1; k < len; ++k) {
+        cp = (cp << 6) | (static_cast<unsigned char>(text[i + k]) & 0x3F);
+    }
+    i += len;
+    return cp;
+}
+
+// The paste path before keyboard_paste(), draining libvterm's 4 KB output
+// buffer before it can fill.
+std::string paste_per_codepoint(VTerminal& terminal, const std::string& text) {
+    std::string out;
+    terminal.keyboard_start_paste();
+    size_t i = 0;
+    int since_drain = 0;
+    while (i < text.size()) {
+        terminal.keyboard_unichar(decode_utf8(text, i));
+        if (++since_drain == 512) {
+            out += terminal.get_output();
+            since_drain = 0;
+        }
+    }
+    terminal.keyboard_end_paste();
+    out += terminal.get_output();
+    return out;
+}
+
+std::string paste_bulk(VTerminal& terminal, const std::string& text) {
+    std::string out;
+    terminal.keyboard_paste(text, out);
+    return out;
+}
+
+void run_paste(const Trace& trace, long repeats) {
+    const std::function<std::string(VTerminal&, const std::string&)> paths[] = {paste_per_codepoint, paste_bulk};
+    const char* names[] = {"per codepoint", "keyboard_paste"};
+    for (int p = 0; p < 2; ++p) {
+        double best = 0.0;
+        AllocCount allocs;
+        size_t out_size = 0;
+        for (long i = 0; i < repeats; ++i) {
+            VTerminal terminal(ROWS, COLS);
+            terminal.write("\x1b[?2004h", 8);
+            AllocCount before = AllocCount::now();
+            auto start = Clock::now();
+            std::string out = paths[p](terminal, trace.data);
+            double t = seconds_since(start);
+            if (i == 0 || t < best) {
+                best = t;
+                allocs = AllocCount::now().since(before);
+            }
+            out_size = out.size();
+        }
+        std::string name = "paste " + trace.name + ", " + names[p];
+        std::printf("%-34s %7.1f MB/s %9.0f allocs/MB  %zu bytes out\n", name.c_str(),
+                    mb_per_sec(trace.data.size(), best),
+                    static_cast<double>(allocs.count) / (static_cast<double>(trace.data.size()) / (1024.0 * 1024.0)),
+                    out_size);
+    }
+}
+
+void print_header() {
+    std::printf("%-18s %7s %9s %11s %10s %9s %9s %9s %9s %8s\n",
+                "trace", "MB", "parse", "lines/s", "allocs/MB", "frame", "allocs/f", "vtx/f", "idx/f", "cmds/f");
+}
+
+void print_result(const Trace& trace, const TraceResult& r) {
+    double mb = static_cast<double>(trace.data.size()) / (1024.0 * 1024.0);
+    double frames = r.frames > 0 ? static_cast<double>(r.frames) : 1.0;
+    std::printf("%-18s %7.1f %6.1f MB/s %11.0f %10.0f %6.3f ms %9.0f %9.0f %9.0f %8.0f\n",
+                trace.name.c_str(), mb, mb_per_sec(trace.data.size(), r.parse_seconds),
+                r.parse_seconds > 0.0 ? static_cast<double>(r.lines_pushed) / r.parse_seconds : 0.0,
+                static_cast<double>(r.parse_allocs.count) / mb,
+                r.frame_seconds * 1000.0 / frames,
+                static_cast<double>(r.frame_allocs.count) / frames,
+                static_cast<double>(r.vertices) / frames,
+                static_cast<double>(r.indices) / frames,
+                static_cast<double>(r.draw_cmds) / frames);
+}
+
+}
+
+int main(int argc, char** argv) {
+    long megabytes = arg_or(argc, argv, 1, 16);
+    long repeats = arg_or(argc, argv, 2, 3);
+    size_t bytes = static_cast<size_t>(megabytes) * 1024 * 1024;
+
+    std::vector<Trace> traces;
+    traces.push_back({"tui-redraw", make_tui_redraw(bytes)});
+    traces.push_back({"fullscreen", make_fullscreen_repaint(bytes)});
+    traces.push_back({"codex-diff", make_codex_diff(bytes)});
+    traces.push_back({"cat", make_cat(bytes)});
+    traces.push_back({"agent-output", make_agent_output(bytes)});
+    traces.push_back({"sgr-heavy", make_sgr_heavy(bytes)});
+    traces.push_back({"cjk-emoji", make_cjk_emoji(bytes)});
+    for (int i = 3; i < argc; ++i) {
+        std::string data = load_recording_output(argv[i]);
+        if (!data.empty()) {
+            traces.push_back({std::filesystem::path(argv[i]).stem().string(), std::move(data)});
+        }
+    }
+
+    std::printf("VTerminal + headless frame, %dx%d, %zu-byte reads, a frame every %zu KB, best of %ld\n",
+                COLS, ROWS, READ_CHUNK, FRAME_BYTES / 1024, repeats);
+    print_header();
+
+    HeadlessImGui imgui;
+    for (const auto& trace : traces) {
+        TraceResult best;
+        for (long i = 0; i < repeats; ++i) {
+            TraceResult r = run_trace(trace, imgui);
+            if (i == 0 || r.parse_seconds < best.parse_seconds) best = r;
+        }
+        print_result(trace, best);
+    }
+
+    std::printf("\n");
+    for (const auto& trace : traces) {
+        if (trace.name == "cat" || trace.name == "cjk-emoji") {
+            run_paste(trace, repeats);
+        }
+    }
+    return 0;
+}
@@ -56,6 +56,15 @@ void SessionConfigStore::save(const std::vector<SavedSessionConfig>& sessions) {
         s["name"] = session.name;
         s["app"] = app_kind_to_string(session.app);
         s["working_dir"] = session.working_dir;
+        if (!session.snapshot_file.empty()) {
+            s["snapshot"] = session.snapshot_file;
+        }
+        if (session.keep_warm) {
+            s["keep_warm"] = true;
+        }
+        if (session.daemon_key != 0) {
+            s["daemon_key"] = session.daemon_key;
+        }
         j.push_back(s);
     }
     
@@ -88,6 +97,15 @@ std::vector<SavedSessionConfig> SessionConfigStore::load() {
             if (item.contains("working_dir") && item["working_dir"].is_string()) {
                 config.working_dir = item["working_dir"].get<std::string>();
             }
+            if (item.contains("snapshot") && item["snapshot"].is_string()) {
+                config.snapshot_file = item["snapshot"].get<std::string>();
+            }
+            if (item.contains("keep_warm") && item["keep_warm"].is_boolean()) {
+                config.keep_warm = item["keep_warm"].get<bool>();
+            }
+            if (item.contains("daemon_key") && item["daemon_key"].is_number_unsigned()) {
+                config.daemon_key = item["daemon_key"].get<uint64_t>();
+            }
             result.push_back(config);
         }
     } catch (...) {
@@ -96,4 +114,9 @@ std::vector<SavedSessionConfig> SessionConfigStore::load() {
     return result;
 }
 
+std::string SessionConfigStore::snapshot_dir() const {
+    if (config_path_.empty()) return "";
+    return (std::filesystem::path(config_path_).parent_path() / "snapshots").string();
+}
+
 }
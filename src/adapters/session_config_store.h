@@ -10,6 +10,9 @@ struct SavedSessionConfig {
     std::string name;
     AppKind app = AppKind::ClaudeCode;
     std::string working_dir;
+    std::string snapshot_file;   // saved scrollback and screen, in snapshot_dir()
+    bool keep_warm = false;
+    uint64_t daemon_key = 0;     // see SessionConfig::daemon_key
 };
 
 class SessionConfigStore {
@@ -20,6 +23,10 @@ public:
     void save(const std::vector<SavedSessionConfig>& sessions);
     std::vector<SavedSessionConfig> load();
     
+    // Where saved terminals live, next to the config file. Empty when there
+    // is no config path.
+    std::string snapshot_dir() const;
+    
 private:
     std::string config_path_;
 };
@@ -1,6 +1,8 @@
 #include "app/app_shell.h"
 #include "app/dockspace.h"
 #include "ui/agent_token_panel.h"
+#include "core/profiler.h"
+#include <cstdio>
 #include <filesystem>
 
 namespace diana {
@@ -26,6 +28,8 @@ void AppShell::init() {
     marketplace_panel_ = std::make_unique<MarketplacePanel>();
     agent_config_panel_ = std::make_unique<AgentConfigPanel>();
     agent_token_panel_ = std::make_unique<AgentTokenPanel>();
+    diagnostics_panel_ = std::make_unique<DiagnosticsPanel>();
+    profiler_panel_ = std::make_unique<ProfilerPanel>();
     
     claude_code_panel_->set_profile_store(profile_store_.get());
     opencode_panel_->set_profile_store(opencode_profile_store_.get());
@@ -36,14 +40,27 @@ void AppShell::init() {
     agent_config_panel_->set_marketplace_panel(marketplace_panel_.get());
     marketplace_panel_->set_project_directory(std::filesystem::current_path().string());
     metrics_panel_->set_terminal_panel(terminal_panel_.get());
+    diagnostics_panel_->set_terminal_panel(terminal_panel_.get());
+    
+    if (std::string address = MetricsExporter::configured_address(); !address.empty()) {
+        metrics_exporter_ = std::make_unique<MetricsExporter>();
+        std::string error;
+        if (!metrics_exporter_->start(address, &error)) {
+            fprintf(stderr, "Metrics exporter disabled: %s\n", error.c_str());
+            metrics_exporter_.reset();
+        }
+    }
 }
 
 void AppShell::render() {
+    DIANA_PROFILE_SCOPE("frame");
     DockspacePanels panels{
         &show_terminal_,
         &show_agent_config_,
         &show_token_metrics_,
-        &show_agent_token_stats_
+        &show_agent_token_stats_,
+        &show_diagnostics_,
+        &show_profiler_
     };
     render_dockspace(first_frame_, panels);
     first_frame_ = false;
@@ -60,10 +77,50 @@ void AppShell::render() {
     if (show_agent_token_stats_) {
         agent_token_panel_->render();
     }
+    if (show_diagnostics_) {
+        diagnostics_panel_->render(&show_diagnostics_);
+    }
+    if (show_profiler_) {
+        profiler_panel_->render(&show_profiler_);
+    }
+    publish_session_metrics();
+}
+
+// The exporter serves what was published here, so a scrape never touches
+// the sessions the UI thread owns.
+void AppShell::publish_session_metrics() {
+    constexpr auto PUBLISH_INTERVAL = std::chrono::seconds(1);
+    auto now = std::chrono::steady_clock::now();
+    if (!metrics_exporter_ || now - last_metrics_publish_ < PUBLISH_INTERVAL) {
+        return;
+    }
+    last_metrics_publish_ = now;
+    
+    SessionController& controller = terminal_panel_->controller();
+    std::vector<SessionMetrics> sessions;
+    for (const auto& session : terminal_panel_->sessions()) {
+        IngestStats stats = session->ingest_stats();
+        SessionMetrics m;
+        m.id = session->id();
+        m.name = session->name();
+        m.app = session->config().app;
+        m.running = session->state() == SessionState::Running;
+        m.backlog_bytes = stats.pending_bytes;
+        m.pending_input_bytes = controller.pending_input(*session);
+        m.parsed_bytes = stats.bytes_parsed;
+        m.parse_lag_seconds = stats.parse_lag_ms / 1000.0;
+        if (auto usage = controller.resource_sampler().latest(session->id())) {
+            m.cpu_percent = usage->cpu_percent;
+            m.rss_bytes = usage->rss_bytes;
+        }
+        sessions.push_back(std::move(m));
+    }
+    metrics_exporter_->publish_sessions(sessions);
 }
 
 void AppShell::shutdown() {
     terminal_panel_->save_sessions();
+    terminal_panel_->save_snapshots();
 }
 
 }
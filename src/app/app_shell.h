@@ -7,10 +7,14 @@
 #include "ui/codex_panel.h"
 #include "ui/agent_config_panel.h"
 #include "ui/agent_token_panel.h"
+#include "ui/diagnostics_panel.h"
+#include "ui/profiler_panel.h"
 #include "marketplace/marketplace_panel.h"
 #include "adapters/claude_profile_store.h"
 #include "adapters/opencode_profile_store.h"
 #include "adapters/codex_profile_store.h"
+#include "metrics/metrics_exporter.h"
+#include <chrono>
 #include <memory>
 
 namespace diana {
@@ -29,16 +33,22 @@ public:
     MarketplacePanel& marketplace_panel() { return *marketplace_panel_; }
     AgentConfigPanel& agent_config_panel() { return *agent_config_panel_; }
     AgentTokenPanel& agent_token_panel() { return *agent_token_panel_; }
+    DiagnosticsPanel& diagnostics_panel() { return *diagnostics_panel_; }
+    ProfilerPanel& profiler_panel() { return *profiler_panel_; }
     ClaudeProfileStore& profile_store() { return *profile_store_; }
     OpenCodeProfileStore& opencode_profile_store() { return *opencode_profile_store_; }
     CodexProfileStore& codex_profile_store() { return *codex_profile_store_; }
 
 private:
+    void publish_session_metrics();
+    
     bool first_frame_ = true;
     bool show_terminal_ = true;
     bool show_agent_config_ = true;
     bool show_token_metrics_ = true;
     bool show_agent_token_stats_ = true;
+    bool show_diagnostics_ = false;
+    bool show_profiler_ = false;
     std::unique_ptr<TerminalPanel> terminal_panel_;
     std::unique_ptr<MetricsPanel> metrics_panel_;
     std::unique_ptr<ClaudeCodePanel> claude_code_panel_;
@@ -47,9 +57,13 @@ private:
     std::unique_ptr<MarketplacePanel> marketplace_panel_;
     std::unique_ptr<AgentConfigPanel> agent_config_panel_;
     std::unique_ptr<AgentTokenPanel> agent_token_panel_;
+    std::unique_ptr<DiagnosticsPanel> diagnostics_panel_;
+    std::unique_ptr<ProfilerPanel> profiler_panel_;
     std::unique_ptr<ClaudeProfileStore> profile_store_;
     std::unique_ptr<OpenCodeProfileStore> opencode_profile_store_;
     std::unique_ptr<CodexProfileStore> codex_profile_store_;
+    std::unique_ptr<MetricsExporter> metrics_exporter_;
+    std::chrono::steady_clock::time_point last_metrics_publish_{};
 };
 
 }
@@ -215,6 +215,12 @@ void render_dockspace(bool first_frame, const DockspacePanels& panels) {
             if (panels.show_agent_token_stats) {
                 ImGui::MenuItem("Agent Token Stats", "Ctrl+4", panels.show_agent_token_stats);
             }
+            if (panels.show_diagnostics) {
+                ImGui::MenuItem("Diagnostics", "Ctrl+5", panels.show_diagnostics);
+            }
+            if (panels.show_profiler) {
+                ImGui::MenuItem("Profiler", "Ctrl+6", panels.show_profiler);
+            }
             ImGui::Separator();
             if (ImGui::BeginMenu("Theme")) {
                 ThemeMode mode = get_theme_mode();
@@ -343,6 +349,12 @@ void render_dockspace(bool first_frame, const DockspacePanels& panels) {
         if (panels.show_agent_token_stats && ImGui::IsKeyPressed(ImGuiKey_4)) {
             *panels.show_agent_token_stats = !*panels.show_agent_token_stats;
         }
+        if (panels.show_diagnostics && ImGui::IsKeyPressed(ImGuiKey_5)) {
+            *panels.show_diagnostics = !*panels.show_diagnostics;
+        }
+        if (panels.show_profiler && ImGui::IsKeyPressed(ImGuiKey_6)) {
+            *panels.show_profiler = !*panels.show_profiler;
+        }
     }
     
     render_about_dialog();
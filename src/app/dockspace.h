@@ -7,6 +7,8 @@ struct DockspacePanels {
     bool* show_agent_config = nullptr;
     bool* show_token_metrics = nullptr;
     bool* show_agent_token_stats = nullptr;
+    bool* show_diagnostics = nullptr;
+    bool* show_profiler = nullptr;
 };
 
 void render_dockspace(bool first_frame, const DockspacePanels& panels);
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace diana {
+
+struct ByteSpan {
+    char* data = nullptr;
+    size_t size = 0;
+};
+
+struct ConstByteSpan {
+    const char* data = nullptr;
+    size_t size = 0;
+};
+
+// Single-producer/single-consumer byte ring. The producer reserves a
+// contiguous free region with write_span(), fills it (e.g. straight from
+// read(2)) and publishes it with commit_write(); the consumer walks readable
+// bytes with read_span()/commit_read(). Positions are monotonic byte counts,
+// so write_position() doubles as a stream offset.
+//
+// Backpressure uses two watermarks: a producer that finds the ring above the
+// high-water mark stops filling it and waits in wait_for_drain() until the
+// consumer brings it back down to the low-water mark. A producer that must not
+// block (an event loop) calls request_drain_wakeup() instead and is called
+// back through the writer wakeup.
+class ByteRing {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 1u << 20;
+
+    explicit ByteRing(size_t capacity = DEFAULT_CAPACITY) {
+        size_t rounded = 1;
+        while (rounded < capacity) rounded <<= 1;
+        buffer_ = std::make_unique<char[]>(rounded);
+        mask_ = rounded - 1;
+        high_water_ = rounded - rounded / 4;
+        low_water_ = rounded / 4;
+    }
+
+    ByteRing(const ByteRing&) = delete;
+    ByteRing& operator=(const ByteRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+    size_t size() const {
+        return static_cast<size_t>(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+    bool empty() const { return size() == 0; }
+    size_t free_space() const { return capacity() - size(); }
+
+    uint64_t write_position() const { return head_.load(std::memory_order_acquire); }
+    uint64_t read_position() const { return tail_.load(std::memory_order_acquire); }
+
+    // Producer side.
+    ByteSpan write_span() {
+        uint64_t head = head_.load(std::memory_order_relaxed);
+        uint64_t tail = tail_.load(std::memory_order_acquire);
+        size_t free = capacity() - static_cast<size_t>(head - tail);
+        size_t offset = static_cast<size_t>(head) & mask_;
+        return {buffer_.get() + offset, std::min(free, capacity() - offset)};
+    }
+
+    void commit_write(size_t n) {
+        if (n == 0) return;
+        head_.fetch_add(n, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        if (reader_wakeup_) {
+            reader_wakeup_();
+        }
+    }
+
+    bool wait_for_space(std::chrono::milliseconds timeout) {
+        std::unique_lock<std::mutex> lock(space_mutex_);
+        return space_cv_.wait_for(lock, timeout, [this] { return free_space() > 0; });
+    }
+
+    void set_watermarks(size_t high, size_t low) {
+        high_water_ = std::min(high, capacity());
+        low_water_ = std::min(low, high_water_);
+    }
+    size_t high_water() const { return high_water_; }
+    size_t low_water() const { return low_water_; }
+    bool above_high_water() const { return size() >= high_water_; }
+
+    // Waits until the consumer has drained the ring to the low-water mark.
+    bool wait_for_drain(std::chrono::milliseconds timeout) {
+        producer_stalls_.fetch_add(1, std::memory_order_relaxed);
+        std::unique_lock<std::mutex> lock(space_mutex_);
+        return space_cv_.wait_for(lock, timeout, [this] { return size() <= low_water_; });
+    }
+    uint64_t producer_stalls() const { return producer_stalls_.load(std::memory_order_relaxed); }
+
+    // Arms the writer wakeup to run once the consumer has drained the ring to
+    // the low-water mark. Returns false, without arming it, when the ring is
+    // already there.
+    bool request_drain_wakeup() {
+        producer_stalls_.fetch_add(1, std::memory_order_relaxed);
+        drain_wakeup_armed_.store(true, std::memory_order_seq_cst);
+        if (size() <= low_water_ && drain_wakeup_armed_.exchange(false, std::memory_order_seq_cst)) {
+            return false;
+        }
+        return true;
+    }
+
+    // Called from commit_read() on the consumer thread, at most once per
+    // request_drain_wakeup(). Same lifetime rule as the reader wakeup.
+    void set_writer_wakeup(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        writer_wakeup_ = std::move(fn);
+    }
+
+    // Consumer side. The span never wraps; call again after commit_read() to
+    // get the remainder.
+    ConstByteSpan read_span(size_t max_bytes = SIZE_MAX) const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        size_t available = static_cast<size_t>(head - tail);
+        size_t offset = static_cast<size_t>(tail) & mask_;
+        size_t len = std::min(std::min(available, capacity() - offset), max_bytes);
+        return {buffer_.get() + offset, len};
+    }
+
+    // Looks at unread bytes from a stream position in [read_position(),
+    // write_position()] without consuming them. Also stops at the wrap point.
+    ConstByteSpan peek_span(uint64_t position, size_t max_bytes = SIZE_MAX) const {
+        uint64_t tail = tail_.load(std::memory_order_relaxed);
+        uint64_t head = head_.load(std::memory_order_acquire);
+        if (position < tail || position >= head) return {};
+        size_t available = static_cast<size_t>(head - position);
+        size_t offset = static_cast<size_t>(position) & mask_;
+        size_t len = std::min(std::min(available, capacity() - offset), max_bytes);
+        return {buffer_.get() + offset, len};
+    }
+
+    void commit_read(size_t n) {
+        if (n == 0) return;
+        tail_.fetch_add(n, std::memory_order_seq_cst);
+        { std::lock_guard<std::mutex> lock(space_mutex_); }
+        space_cv_.notify_one();
+        if (drain_wakeup_armed_.load(std::memory_order_seq_cst) && size() <= low_water_ &&
+            drain_wakeup_armed_.exchange(false, std::memory_order_seq_cst)) {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            if (writer_wakeup_) {
+                writer_wakeup_();
+            }
+        }
+    }
+
+    // Called from commit_write() on the producer thread. Clear it before the
+    // consumer goes away; the ring itself may outlive both sides.
+    void set_reader_wakeup(std::function<void()> fn) {
+        std::lock_guard<std::mutex> lock(wake_mutex_);
+        reader_wakeup_ = std::move(fn);
+    }
+
+private:
+    std::unique_ptr<char[]> buffer_;
+    size_t mask_ = 0;
+
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) std::atomic<uint64_t> tail_{0};
+
+    std::mutex wake_mutex_;
+    std::function<void()> reader_wakeup_;
+    std::function<void()> writer_wakeup_;
+    std::atomic<bool> drain_wakeup_armed_{false};
+
+    std::mutex space_mutex_;
+    std::condition_variable space_cv_;
+    size_t high_water_ = 0;
+    size_t low_water_ = 0;
+    std::atomic<uint64_t> producer_stalls_{0};
+};
+
+}
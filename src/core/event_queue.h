@@ -1,58 +1,255 @@
 #pragma once
 
-#include <deque>
-#include <mutex>
+#include <array>
+#include <atomic>
 #include <condition_variable>
+#include <cstdint>
+#include <mutex>
 #include <optional>
+#include <vector>
 
 namespace diana {
 
+// Multi-producer, single-consumer queue. Any thread may push; everything
+// else belongs to one consumer thread (the UI thread for SessionController's
+// queue).
+//
+// push() is lock-free: it takes a node from a pool and CASes it onto a stack.
+// The consumer takes the whole stack with one exchange and reverses it, so
+// events from one producer come out in the order it pushed them, and hands
+// the nodes it has finished with back to the pool in one CAS per batch. The
+// pool grows a chunk at a time up to MAX_CHUNKS; past that, bursts fall back
+// to the heap.
 template<typename T>
 class EventQueue {
 public:
+    static constexpr size_t DEFAULT_CHUNK_SIZE = 256;
+    static constexpr size_t MAX_CHUNKS = 256;
+
+    explicit EventQueue(size_t chunk_size = DEFAULT_CHUNK_SIZE)
+        : chunk_size_(chunk_size) {
+        add_chunk();
+    }
+
+    ~EventQueue() {
+        clear();
+        for (size_t i = 0; i < chunk_count_; ++i) {
+            delete[] chunks_[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
     void push(T event) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push_back(std::move(event));
-        cv_.notify_one();
+        Node* node = acquire_node();
+        node->value.emplace(std::move(event));
+        node->next = incoming_.load(std::memory_order_relaxed);
+        while (!incoming_.compare_exchange_weak(node->next, node, std::memory_order_seq_cst,
+                                                std::memory_order_relaxed)) {
+        }
+        // Pairs with wait_pop: either it sees the node or we see the waiter.
+        if (waiters_.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(wait_mutex_);
+            wait_cv_.notify_one();
+        }
     }
 
     std::optional<T> try_pop() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        if (queue_.empty()) {
-            return std::nullopt;
+        if (!ready_) {
+            take_incoming();
+            if (!ready_) {
+                return std::nullopt;
+            }
         }
-        T event = std::move(queue_.front());
-        queue_.pop_front();
+        Node* node = ready_;
+        ready_ = node->next;
+        --ready_count_;
+        std::optional<T> event = std::move(node->value);
+        retire(node);
         return event;
     }
 
     T wait_pop() {
-        std::unique_lock<std::mutex> lock(mutex_);
-        cv_.wait(lock, [this] { return !queue_.empty(); });
-        T event = std::move(queue_.front());
-        queue_.pop_front();
-        return event;
+        for (;;) {
+            if (auto event = try_pop()) {
+                return std::move(*event);
+            }
+            std::unique_lock<std::mutex> lock(wait_mutex_);
+            waiters_.fetch_add(1, std::memory_order_seq_cst);
+            wait_cv_.wait(lock, [this] { return incoming_.load(std::memory_order_seq_cst) != nullptr; });
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Moves everything queued so far onto the end of out; returns how many.
+    size_t drain(std::vector<T>& out) {
+        take_incoming();
+        size_t count = ready_count_;
+        out.reserve(out.size() + count);
+        while (Node* node = ready_) {
+            ready_ = node->next;
+            out.push_back(std::move(*node->value));
+            retire(node);
+        }
+        ready_count_ = 0;
+        flush_retired();
+        return count;
     }
 
     bool empty() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.empty();
+        return !ready_ && !incoming_.load(std::memory_order_acquire);
     }
 
+    // Walks what producers pushed since the last pop; meant for tests and
+    // diagnostics rather than hot paths.
     size_t size() const {
-        std::lock_guard<std::mutex> lock(mutex_);
-        return queue_.size();
+        size_t count = ready_count_;
+        for (Node* node = incoming_.load(std::memory_order_acquire); node; node = node->next) {
+            ++count;
+        }
+        return count;
     }
 
     void clear() {
-        std::lock_guard<std::mutex> lock(mutex_);
-        queue_.clear();
+        take_incoming();
+        while (Node* node = ready_) {
+            ready_ = node->next;
+            retire(node);
+        }
+        ready_count_ = 0;
+        flush_retired();
     }
 
 private:
-    mutable std::mutex mutex_;
-    std::condition_variable cv_;
-    std::deque<T> queue_;
+    static constexpr uint32_t HEAP_NODE = UINT32_MAX;
+    static constexpr uint64_t INDEX_MASK = 0xffffffffull;
+
+    struct Node {
+        Node* next = nullptr;
+        std::optional<T> value;
+        uint32_t index = HEAP_NODE;
+        std::atomic<uint32_t> free_next{0};   // pool index + 1, 0 ends the list
+    };
+
+    // Appends what producers pushed since the last call to the ready list,
+    // oldest first, and returns the nodes popped so far to the pool.
+    void take_incoming() {
+        flush_retired();
+        Node* stack = incoming_.exchange(nullptr, std::memory_order_acquire);
+        if (!stack) {
+            return;
+        }
+        Node* reversed = nullptr;
+        Node* last = stack;
+        while (stack) {
+            Node* next = stack->next;
+            stack->next = reversed;
+            reversed = stack;
+            stack = next;
+            ++ready_count_;
+        }
+        if (ready_) {
+            ready_tail_->next = reversed;
+        } else {
+            ready_ = reversed;
+        }
+        ready_tail_ = last;
+    }
+
+    void retire(Node* node) {
+        node->value.reset();
+        if (node->index == HEAP_NODE) {
+            delete node;
+            return;
+        }
+        node->free_next.store(retired_ ? retired_->index + 1 : 0, std::memory_order_relaxed);
+        if (!retired_) {
+            retired_tail_ = node;
+        }
+        retired_ = node;
+    }
+
+    void flush_retired() {
+        if (retired_) {
+            release_chain(retired_, retired_tail_);
+            retired_ = nullptr;
+            retired_tail_ = nullptr;
+        }
+    }
+
+    Node* node_at(uint32_t index) const {
+        return chunks_[index / chunk_size_].load(std::memory_order_acquire) + index % chunk_size_;
+    }
+
+    // The free list head packs a pool index with a counter bumped on every
+    // change, so a pop that raced with pops and pushes of the same node fails
+    // its CAS instead of linking a node that is in use.
+    Node* acquire_node() {
+        for (;;) {
+            uint64_t head = free_head_.load(std::memory_order_acquire);
+            while (uint32_t slot = static_cast<uint32_t>(head & INDEX_MASK)) {
+                Node* node = node_at(slot - 1);
+                uint64_t next = node->free_next.load(std::memory_order_relaxed);
+                uint64_t desired = (((head >> 32) + 1) << 32) | next;
+                if (free_head_.compare_exchange_weak(head, desired, std::memory_order_acquire,
+                                                     std::memory_order_acquire)) {
+                    return node;
+                }
+            }
+            if (!add_chunk()) {
+                return new Node();
+            }
+        }
+    }
+
+    // Pushes first..last, already linked through free_next, onto the free list.
+    void release_chain(Node* first, Node* last) {
+        uint64_t head = free_head_.load(std::memory_order_relaxed);
+        uint64_t desired;
+        do {
+            last->free_next.store(static_cast<uint32_t>(head & INDEX_MASK), std::memory_order_relaxed);
+            desired = (((head >> 32) + 1) << 32) | (static_cast<uint64_t>(first->index) + 1);
+        } while (!free_head_.compare_exchange_weak(head, desired, std::memory_order_release,
+                                                   std::memory_order_relaxed));
+    }
+
+    // False once MAX_CHUNKS are in use. Producers that find the free list
+    // empty at the same time may each add a chunk; all of them get used.
+    bool add_chunk() {
+        std::lock_guard<std::mutex> lock(grow_mutex_);
+        if (chunk_count_ == MAX_CHUNKS) {
+            return false;
+        }
+        Node* chunk = new Node[chunk_size_];
+        size_t base = chunk_count_ * chunk_size_;
+        for (size_t i = 0; i < chunk_size_; ++i) {
+            chunk[i].index = static_cast<uint32_t>(base + i);
+            chunk[i].free_next.store(static_cast<uint32_t>(base + i + 2), std::memory_order_relaxed);
+        }
+        chunks_[chunk_count_].store(chunk, std::memory_order_release);
+        ++chunk_count_;
+        release_chain(&chunk[0], &chunk[chunk_size_ - 1]);
+        return true;
+    }
+
+    const size_t chunk_size_;
+    std::array<std::atomic<Node*>, MAX_CHUNKS> chunks_{};
+    size_t chunk_count_ = 0;   // guarded by grow_mutex_
+    std::mutex grow_mutex_;
+    std::atomic<uint64_t> free_head_{0};
+    std::atomic<Node*> incoming_{nullptr};
+
+    // Consumer side.
+    Node* ready_ = nullptr;
+    Node* ready_tail_ = nullptr;
+    size_t ready_count_ = 0;
+    Node* retired_ = nullptr;        // popped, not yet back in the pool
+    Node* retired_tail_ = nullptr;
+
+    std::atomic<int> waiters_{0};
+    std::mutex wait_mutex_;
+    std::condition_variable wait_cv_;
 };
 
 }
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Scoped timers for the hot paths. Building with DIANA_PROFILING=0 (CMake
+// option DIANA_ENABLE_PROFILING=OFF) removes every DIANA_PROFILE_SCOPE; with
+// it on, a scope costs two clock reads and a few stores into a buffer of the
+// calling thread, or one relaxed load while recording is switched off.
+#ifndef DIANA_PROFILING
+#define DIANA_PROFILING 1
+#endif
+
+#define DIANA_PROFILE_CONCAT_INNER(a, b) a##b
+#define DIANA_PROFILE_CONCAT(a, b) DIANA_PROFILE_CONCAT_INNER(a, b)
+
+#if DIANA_PROFILING
+// name must be a string literal: only the pointer is stored.
+#define DIANA_PROFILE_SCOPE(name) ::diana::ProfileScope DIANA_PROFILE_CONCAT(diana_profile_scope_, __LINE__)(name)
+#define DIANA_PROFILE_THREAD(name) ::diana::Profiler::instance().set_thread_name(name)
+#else
+#define DIANA_PROFILE_SCOPE(name) do {} while (0)
+#define DIANA_PROFILE_THREAD(name) do {} while (0)
+#endif
+
+namespace diana {
+
+struct ProfileEvent {
+    const char* name = nullptr;
+    uint64_t start_ns = 0;
+    uint64_t end_ns = 0;
+};
+
+struct ProfileThread {
+    uint32_t tid = 0;
+    std::string name;
+    std::vector<ProfileEvent> events;   // by end time, oldest first
+};
+
+// Each thread records into a ring of its own, so recording never contends;
+// snapshot() copies the rings and drops entries overwritten while copying.
+// A thread's ring goes back to a free list when the thread exits.
+class Profiler {
+public:
+    static constexpr size_t EVENTS_PER_THREAD = 8192;
+
+    static Profiler& instance() {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    static uint64_t now_ns() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void set_enabled(bool enabled) { enabled_.store(enabled, std::memory_order_relaxed); }
+
+    // Names the calling thread in snapshots and traces.
+    void set_thread_name(const char* name) {
+        ThreadState& state = thread_state();
+        state.name = name;
+        if (state.buffer) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            state.buffer->name = name;
+        }
+    }
+
+    void record(const char* name, uint64_t start_ns, uint64_t end_ns) {
+        ThreadState& state = thread_state();
+        if (!state.buffer) {
+            state.buffer = acquire(state.name);
+        }
+        Buffer& b = *state.buffer;
+        uint64_t index = b.written.load(std::memory_order_relaxed);
+        // Readers check claimed after copying to spot slots rewritten meanwhile.
+        b.claimed.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot& slot = b.slots[index % EVENTS_PER_THREAD];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start_ns.store(start_ns, std::memory_order_relaxed);
+        slot.end_ns.store(end_ns, std::memory_order_relaxed);
+        b.written.store(index + 1, std::memory_order_release);
+    }
+
+    // Events that ended at or after since_ns, per thread that has any.
+    std::vector<ProfileThread> snapshot(uint64_t since_ns = 0) const {
+        std::vector<ProfileThread> threads;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& buffer : buffers_) {
+            const Buffer& b = *buffer;
+            uint64_t end = b.written.load(std::memory_order_acquire);
+            uint64_t begin = end > EVENTS_PER_THREAD ? end - EVENTS_PER_THREAD : 0;
+            ProfileThread thread;
+            thread.tid = b.tid;
+            thread.name = b.name;
+            thread.events.reserve(static_cast<size_t>(end - begin));
+            for (uint64_t i = begin; i < end; ++i) {
+                const Slot& slot = b.slots[i % EVENTS_PER_THREAD];
+                ProfileEvent event;
+                event.name = slot.name.load(std::memory_order_relaxed);
+                event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+                event.end_ns = slot.end_ns.load(std::memory_order_relaxed);
+                thread.events.push_back(event);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t claimed = b.claimed.load(std::memory_order_relaxed);
+            uint64_t valid_from = claimed > EVENTS_PER_THREAD ? claimed - EVENTS_PER_THREAD : 0;
+            size_t skip = static_cast<size_t>(std::min(end, std::max(begin, valid_from)) - begin);
+            thread.events.erase(thread.events.begin(), thread.events.begin() + static_cast<std::ptrdiff_t>(skip));
+            auto first = std::find_if(thread.events.begin(), thread.events.end(),
+                                      [since_ns](const ProfileEvent& e) { return e.end_ns >= since_ns; });
+            thread.events.erase(thread.events.begin(), first);
+            if (!thread.events.empty()) {
+                threads.push_back(std::move(thread));
+            }
+        }
+        return threads;
+    }
+
+    // Trace Event Format, for chrome://tracing or ui.perfetto.dev.
+    static std::string chrome_trace_json(const std::vector<ProfileThread>& threads) {
+        uint64_t origin = UINT64_MAX;
+        for (const auto& thread : threads) {
+            for (const auto& event : thread.events) {
+                origin = std::min(origin, event.start_ns);
+            }
+        }
+        int pid = static_cast<int>(getpid());
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        char buffer[160];
+        for (const auto& thread : threads) {
+            snprintf(buffer, sizeof(buffer), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":",
+                     first ? "" : ",", pid, thread.tid);
+            out += buffer;
+            append_json_string(out, thread.name.empty() ? "thread " + std::to_string(thread.tid) : thread.name);
+            out += "}}";
+            first = false;
+            for (const auto& event : thread.events) {
+                out += ",{\"name\":";
+                append_json_string(out, event.name ? event.name : "?");
+                snprintf(buffer, sizeof(buffer), ",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                         pid, thread.tid, static_cast<double>(event.start_ns - origin) / 1e3,
+                         static_cast<double>(event.end_ns - event.start_ns) / 1e3);
+                out += buffer;
+            }
+        }
+        out += "]}\n";
+        return out;
+    }
+
+    bool write_chrome_trace(const std::string& path, std::string* error = nullptr) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            if (error) *error = "Cannot open " + path;
+            return false;
+        }
+        file << chrome_trace_json(snapshot());
+        if (!file) {
+            if (error) *error = "Cannot write " + path;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct Slot {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<uint64_t> start_ns{0};
+        std::atomic<uint64_t> end_ns{0};
+    };
+
+    struct Buffer {
+        std::array<Slot, EVENTS_PER_THREAD> slots;
+        std::atomic<uint64_t> written{0};
+        std::atomic<uint64_t> claimed{0};
+        uint32_t tid = 0;
+        std::string name;       // guarded by mutex_
+        bool in_use = false;    // guarded by mutex_
+    };
+
+    struct ThreadState {
+        Buffer* buffer = nullptr;
+        std::string name;
+        ~ThreadState() {
+            if (buffer) {
+                Profiler::instance().release(buffer);
+            }
+        }
+    };
+
+    Profiler() = default;
+
+    static ThreadState& thread_state() {
+        thread_local ThreadState state;
+        return state;
+    }
+
+    static void append_json_string(std::string& out, const std::string& value) {
+        out.push_back('"');
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                out.push_back('\\');
+                out.push_back(c);
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out.push_back(c);
+            }
+        }
+        out.push_back('"');
+    }
+
+    Buffer* acquire(const std::string& name) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& buffer : buffers_) {
+            if (!buffer->in_use) {
+                buffer->in_use = true;
+                buffer->tid = next_tid_++;
+                buffer->name = name;
+                buffer->written.store(0, std::memory_order_relaxed);
+                buffer->claimed.store(0, std::memory_order_relaxed);
+                return buffer.get();
+            }
+        }
+        buffers_.push_back(std::make_unique<Buffer>());
+        Buffer* buffer = buffers_.back().get();
+        buffer->in_use = true;
+        buffer->tid = next_tid_++;
+        buffer->name = name;
+        return buffer;
+    }
+
+    void release(Buffer* buffer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer->in_use = false;
+    }
+
+    std::atomic<bool> enabled_{true};
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+    uint32_t next_tid_ = 1;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name_(name), start_ns_(Profiler::instance().enabled() ? Profiler::now_ns() : 0) {}
+
+    ~ProfileScope() {
+        if (start_ns_ != 0) {
+            Profiler::instance().record(name_, start_ns_, Profiler::now_ns());
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name_;
+    uint64_t start_ns_;
+};
+
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace diana {
+
+// Decides when the render loop may sleep. Anything that changes what is on
+// screen either wakes the loop right away with request_redraw() (safe from
+// any thread) or asks for a frame by a deadline with request_redraw_in() (UI
+// thread only). Between those the loop blocks on OS events.
+class RedrawScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static RedrawScheduler& instance() {
+        static RedrawScheduler scheduler;
+        return scheduler;
+    }
+
+    // Installed once by the render loop before any worker thread starts, and
+    // cleared by it after they are joined; must be callable from any thread
+    // (glfwPostEmptyEvent is).
+    void set_waker(std::function<void()> waker) { waker_ = std::move(waker); }
+
+    void request_redraw() {
+        if (!pending_.exchange(true, std::memory_order_acq_rel)) {
+            wakeups_.fetch_add(1, std::memory_order_relaxed);
+            if (waker_) {
+                waker_();
+            }
+        }
+    }
+
+    void request_redraw_in(double seconds) {
+        auto when = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(std::max(0.0, seconds)));
+        if (!has_deadline_ || when < deadline_) {
+            deadline_ = when;
+            has_deadline_ = true;
+        }
+    }
+
+    bool redraw_pending() const { return pending_.load(std::memory_order_acquire); }
+
+    // How long the loop may block before the next frame is due.
+    double wait_timeout(double max_seconds) const {
+        if (pending_.load(std::memory_order_acquire)) {
+            return 0.0;
+        }
+        if (!has_deadline_) {
+            return max_seconds;
+        }
+        double remaining = std::chrono::duration<double>(deadline_ - Clock::now()).count();
+        return std::clamp(remaining, 0.0, max_seconds);
+    }
+
+    // Called at the start of every frame; requests made while the frame runs
+    // apply to the next wait.
+    void begin_frame() {
+        pending_.store(false, std::memory_order_release);
+        has_deadline_ = false;
+        frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void add_idle_time(double seconds) {
+        idle_us_.fetch_add(static_cast<uint64_t>(seconds * 1e6), std::memory_order_relaxed);
+    }
+
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+    double idle_seconds() const { return static_cast<double>(idle_us_.load(std::memory_order_relaxed)) / 1e6; }
+
+private:
+    RedrawScheduler() = default;
+
+    std::function<void()> waker_;
+    std::atomic<bool> pending_{false};
+    Clock::time_point deadline_{};
+    bool has_deadline_ = false;
+
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> wakeups_{0};
+    std::atomic<uint64_t> idle_us_{0};
+};
+
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "core/types.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace diana {
+
+// What one usage collector has done, for the metrics exporter.
+struct CollectorTelemetry {
+    std::atomic<uint64_t> files_watched{0};
+    std::atomic<uint64_t> entries_parsed{0};
+    std::atomic<uint64_t> input_tokens{0};
+    std::atomic<uint64_t> output_tokens{0};
+    std::atomic<uint64_t> polls{0};
+    std::atomic<int64_t> last_poll_unix_ms{0};
+    std::atomic<uint64_t> last_poll_us{0};
+
+    void record_entry(uint64_t input, uint64_t output) {
+        entries_parsed.fetch_add(1, std::memory_order_relaxed);
+        input_tokens.fetch_add(input, std::memory_order_relaxed);
+        output_tokens.fetch_add(output, std::memory_order_relaxed);
+    }
+
+    // Called after a pass over the watched files.
+    void record_poll(size_t files, std::chrono::steady_clock::duration took) {
+        files_watched.store(files, std::memory_order_relaxed);
+        last_poll_us.store(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(took).count()), std::memory_order_relaxed);
+        last_poll_unix_ms.store(std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+        polls.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+// Process-wide counters read by MetricsExporter. Hot paths bump them with
+// relaxed atomics, so a scrape never waits on a lock the UI, the parsers or
+// the collectors hold, and counting costs them next to nothing.
+class Telemetry {
+public:
+    static Telemetry& instance() {
+        static Telemetry telemetry;
+        return telemetry;
+    }
+
+    CollectorTelemetry& collector(AppKind app) { return collectors_[static_cast<size_t>(app)]; }
+    const CollectorTelemetry& collector(AppKind app) const { return collectors_[static_cast<size_t>(app)]; }
+
+    void add_pty_read(size_t bytes) { pty_read_bytes_.fetch_add(bytes, std::memory_order_relaxed); }
+    void add_pty_written(size_t bytes) { pty_written_bytes_.fetch_add(bytes, std::memory_order_relaxed); }
+    void add_parsed(size_t bytes) { parsed_bytes_.fetch_add(bytes, std::memory_order_relaxed); }
+
+    // UI thread: time spent building and submitting one frame.
+    void record_frame(double seconds) {
+        auto us = static_cast<uint64_t>(seconds * 1e6);
+        last_frame_us_.store(us, std::memory_order_relaxed);
+        frame_us_.fetch_add(us, std::memory_order_relaxed);
+        frames_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // UI thread: events taken from the session queue in one drain.
+    void record_events(size_t drained) {
+        event_queue_depth_.store(drained, std::memory_order_relaxed);
+        events_.fetch_add(drained, std::memory_order_relaxed);
+    }
+
+    uint64_t pty_read_bytes() const { return pty_read_bytes_.load(std::memory_order_relaxed); }
+    uint64_t pty_written_bytes() const { return pty_written_bytes_.load(std::memory_order_relaxed); }
+    uint64_t parsed_bytes() const { return parsed_bytes_.load(std::memory_order_relaxed); }
+    uint64_t frames() const { return frames_.load(std::memory_order_relaxed); }
+    double frame_seconds_total() const { return static_cast<double>(frame_us_.load(std::memory_order_relaxed)) / 1e6; }
+    double last_frame_seconds() const { return static_cast<double>(last_frame_us_.load(std::memory_order_relaxed)) / 1e6; }
+    uint64_t events() const { return events_.load(std::memory_order_relaxed); }
+    uint64_t event_queue_depth() const { return event_queue_depth_.load(std::memory_order_relaxed); }
+
+private:
+    Telemetry() = default;
+
+    std::array<CollectorTelemetry, 4> collectors_{};
+    std::atomic<uint64_t> pty_read_bytes_{0};
+    std::atomic<uint64_t> pty_written_bytes_{0};
+    std::atomic<uint64_t> parsed_bytes_{0};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> frame_us_{0};
+    std::atomic<uint64_t> last_frame_us_{0};
+    std::atomic<uint64_t> events_{0};
+    std::atomic<uint64_t> event_queue_depth_{0};
+};
+
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <cctype>
 #include <filesystem>
+#include <memory>
 #include <optional>
 #include <string>
 #include <vector>
@@ -16,6 +17,9 @@
 #include <GLFW/glfw3.h>
 
 #include "app/app_shell.h"
+#include "core/profiler.h"
+#include "core/redraw_scheduler.h"
+#include "core/telemetry.h"
 #include "ui/theme.h"
 
 static void glfw_error_callback(int error, const char* description) {
@@ -23,6 +27,13 @@ static void glfw_error_callback(int error, const char* description) {
 }
 
 static GLFWwindow* g_main_window = nullptr;
+
+// Longest the loop sleeps with nothing scheduled; keeps the system theme and
+// other cheap per-frame checks from going stale.
+static constexpr double MAX_IDLE_WAIT_SECONDS = 1.0;
+// ImGui settles hover/active state over a couple of frames after input.
+static constexpr int FRAMES_AFTER_INPUT = 3;
+
 namespace fs = std::filesystem;
 
 static bool is_font_file(const fs::path& path) {
@@ -180,6 +191,7 @@ extern "C" void diana_request_exit() {
 
 int main(int argc, char** argv) {
     (void)argc;
+    DIANA_PROFILE_THREAD("ui");
 
     glfwSetErrorCallback(glfw_error_callback);
     if (!glfwInit()) {
@@ -313,19 +325,59 @@ int main(int argc, char** argv) {
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init(glsl_version);
 
-    diana::AppShell app_shell;
-    app_shell.init();
+    auto& redraw = diana::RedrawScheduler::instance();
+    redraw.set_waker([] { glfwPostEmptyEvent(); });
+
+    // Owned here so it can be destroyed, joining its threads, while the
+    // waker is still valid.
+    auto app_shell = std::make_unique<diana::AppShell>();
+    app_shell->init();
 
+    int frames_after_input = FRAMES_AFTER_INPUT;
     while (!glfwWindowShouldClose(window)) {
-        glfwPollEvents();
-        
+        double timeout = frames_after_input > 0 ? 0.0 : redraw.wait_timeout(MAX_IDLE_WAIT_SECONDS);
+        if (timeout > 0.0) {
+            double wait_start = glfwGetTime();
+            glfwWaitEventsTimeout(timeout);
+            double waited = glfwGetTime() - wait_start;
+            redraw.add_idle_time(waited);
+            // Woken early by something other than request_redraw(): that
+            // is user input.
+            if (waited + 0.001 < timeout && !redraw.redraw_pending()) {
+                frames_after_input = FRAMES_AFTER_INPUT;
+            }
+        } else {
+            glfwPollEvents();
+            if (frames_after_input > 0) {
+                --frames_after_input;
+            }
+        }
+        // Nothing to draw while minimized. Leaving the pending flag set also
+        // stops output from posting further wakeups until we are restored.
+        if (glfwGetWindowAttrib(window, GLFW_ICONIFIED)) {
+            double wait_start = glfwGetTime();
+            glfwWaitEventsTimeout(MAX_IDLE_WAIT_SECONDS);
+            redraw.add_idle_time(glfwGetTime() - wait_start);
+            continue;
+        }
+        redraw.begin_frame();
+        double frame_start = glfwGetTime();
+
         diana::update_system_theme();
 
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
         ImGui::NewFrame();
 
-        app_shell.render();
+        app_shell->render();
+
+        if (ImGui::IsAnyItemActive() || io.MouseDown[0] || io.MouseDown[1]) {
+            redraw.request_redraw_in(0.0);
+        } else if (io.WantTextInput) {
+            redraw.request_redraw_in(io.ConfigInputTextCursorBlink ? 0.4 : MAX_IDLE_WAIT_SECONDS);
+        } else if (ImGui::IsAnyItemHovered()) {
+            redraw.request_redraw_in(ImGui::GetStyle().HoverDelayNormal);
+        }
 
         ImGui::Render();
         int display_w, display_h;
@@ -342,10 +394,14 @@ int main(int argc, char** argv) {
             glfwMakeContextCurrent(backup_current_context);
         }
 
+        // Before the swap, which may wait for vsync.
+        diana::Telemetry::instance().record_frame(glfwGetTime() - frame_start);
         glfwSwapBuffers(window);
     }
 
-    app_shell.shutdown();
+    app_shell->shutdown();
+    app_shell.reset();
+    redraw.set_waker(nullptr);
 
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
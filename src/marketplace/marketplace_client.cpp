@@ -1,4 +1,6 @@
 #include "marketplace_client.h"
+#include "core/profiler.h"
+#include "core/redraw_scheduler.h"
 #include <sstream>
 #include <thread>
 #include <algorithm>
@@ -33,6 +35,7 @@ std::string MarketplaceClient::url_encode(const std::string& value) {
 }
 
 std::string MarketplaceClient::http_get(const std::string& url, std::string& error_out) {
+    DIANA_PROFILE_SCOPE("marketplace.http_get");
     
 #ifdef __APPLE__
     CFURLRef cf_url = CFURLCreateWithBytes(
@@ -129,6 +132,7 @@ std::string MarketplaceClient::http_get(const std::string& url, std::string& err
 }
 
 McpSearchResult MarketplaceClient::search_servers(const std::string& query, int page, int page_size, std::string& error_out) {
+    DIANA_PROFILE_SCOPE("marketplace.search_servers");
     std::ostringstream url;
     url << "https://registry.smithery.ai/servers?page=" << page << "&pageSize=" << page_size;
     
@@ -151,6 +155,7 @@ McpSearchResult MarketplaceClient::search_servers(const std::string& query, int
 }
 
 McpServerEntry MarketplaceClient::get_server_detail(const std::string& qualified_name, std::string& error_out) {
+    DIANA_PROFILE_SCOPE("marketplace.get_server_detail");
     std::string url = "https://registry.smithery.ai/servers/" + url_encode(qualified_name);
     
     std::string response = http_get(url, error_out);
@@ -168,6 +173,7 @@ McpServerEntry MarketplaceClient::get_server_detail(const std::string& qualified
 }
 
 McpServerEntry MarketplaceClient::get_server_detail_by_id(const std::string& id, std::string& error_out) {
+    DIANA_PROFILE_SCOPE("marketplace.get_server_detail_by_id");
     std::string url = "https://registry.smithery.ai/servers/" + url_encode(id);
     
     std::string response = http_get(url, error_out);
@@ -185,6 +191,7 @@ McpServerEntry MarketplaceClient::get_server_detail_by_id(const std::string& id,
 }
 
 SkillSearchResult MarketplaceClient::search_skills(const std::string& query, int page, int page_size, std::string& error_out) {
+    DIANA_PROFILE_SCOPE("marketplace.search_skills");
     std::ostringstream url;
     url << "https://registry.smithery.ai/skills?page=" << page << "&pageSize=" << page_size;
     
@@ -210,9 +217,11 @@ void MarketplaceClient::search_servers_async(const std::string& query, int page,
     std::lock_guard<std::mutex> lock(tasks_mutex_);
     
     auto future = std::async(std::launch::async, [this, query, page, page_size, callback]() {
+        DIANA_PROFILE_THREAD("marketplace");
         std::string error;
         auto result = search_servers(query, page, page_size, error);
         callback(error.empty(), result, error);
+        RedrawScheduler::instance().request_redraw();
     });
     
     pending_tasks_.push_back({std::move(future), false});
@@ -222,9 +231,11 @@ void MarketplaceClient::get_server_detail_async(const std::string& qualified_nam
     std::lock_guard<std::mutex> lock(tasks_mutex_);
     
     auto future = std::async(std::launch::async, [this, qualified_name, callback]() {
+        DIANA_PROFILE_THREAD("marketplace");
         std::string error;
         auto result = get_server_detail(qualified_name, error);
         callback(error.empty(), result, error);
+        RedrawScheduler::instance().request_redraw();
     });
     
     pending_tasks_.push_back({std::move(future), false});
@@ -234,9 +245,11 @@ void MarketplaceClient::search_skills_async(const std::string& query, int page,
     std::lock_guard<std::mutex> lock(tasks_mutex_);
     
     auto future = std::async(std::launch::async, [this, query, page, page_size, callback]() {
+        DIANA_PROFILE_THREAD("marketplace");
         std::string error;
         auto result = search_skills(query, page, page_size, error);
         callback(error.empty(), result, error);
+        RedrawScheduler::instance().request_redraw();
     });
     
     pending_tasks_.push_back({std::move(future), false});
@@ -8,6 +8,7 @@
 #include <cstdio>
 #include <mutex>
 #include <algorithm>
+#include "core/redraw_scheduler.h"
 #include "terminal/vterminal.h"
 #include "ui/theme.h"
 #include <nfd.h>
@@ -232,6 +233,7 @@ void MarketplacePanel::render_content() {
         std::lock_guard<std::mutex> lock(install_mutex_);
         if (status_time_ > 0) {
             status_time_ -= ImGui::GetIO().DeltaTime;
+            RedrawScheduler::instance().request_redraw_in(status_time_);
         }
         status_message = status_message_;
         status_is_error = status_is_error_;
@@ -1508,6 +1510,7 @@ void MarketplacePanel::start_install_command(const std::string& cmd) {
             }
         }
         append_cli_log(data);
+        RedrawScheduler::instance().request_redraw();
     });
     install_process_.set_exit_callback([this](int exit_code) {
         std::string next_cmd;
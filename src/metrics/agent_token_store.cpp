@@ -1,4 +1,5 @@
 #include "metrics/agent_token_store.h"
+#include "core/profiler.h"
 #include <nlohmann/json.hpp>
 #include <fstream>
 #include <cstdlib>
@@ -145,6 +146,7 @@ void AgentTokenStore::do_initial_scan() {
 }
 
 void AgentTokenStore::poll() {
+    DIANA_PROFILE_SCOPE("agent_tokens.poll");
     if (claude_dir_.empty() && codex_dir_.empty() && opencode_dir_.empty()) {
         return;
     }
@@ -401,6 +403,7 @@ std::string AgentTokenStore::extract_session_id(const std::filesystem::path& pat
 }
 
 void AgentTokenStore::process_file(FileState& state) {
+    DIANA_PROFILE_SCOPE("agent_tokens.process_file");
     namespace fs = std::filesystem;
     
     if (!fs::exists(state.path)) return;
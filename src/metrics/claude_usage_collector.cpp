@@ -1,4 +1,6 @@
 #include "metrics/claude_usage_collector.h"
+#include "core/profiler.h"
+#include "core/telemetry.h"
 #include <nlohmann/json.hpp>
 #include <cstdlib>
 #include <cctype>
@@ -97,6 +99,7 @@ void ClaudeUsageCollector::do_initial_scan() {
 }
 
 void ClaudeUsageCollector::poll() {
+    DIANA_PROFILE_SCOPE("claude.poll");
     if (claude_dir_.empty()) {
         return;
     }
@@ -123,6 +126,7 @@ void ClaudeUsageCollector::poll() {
             process_file(file);
         }
         last_poll_ = now;
+        Telemetry::instance().collector(AppKind::ClaudeCode).record_poll(files_.size(), std::chrono::steady_clock::now() - now);
     }
 }
 
@@ -172,6 +176,7 @@ void ClaudeUsageCollector::scan_directories() {
 }
 
 void ClaudeUsageCollector::process_file(FileState& state) {
+    DIANA_PROFILE_SCOPE("claude.process_file");
     namespace fs = std::filesystem;
     
     if (!fs::exists(state.path)) return;
@@ -205,6 +210,7 @@ void ClaudeUsageCollector::process_file(FileState& state) {
                 store_->record_sample(sample);
             }
             ++entries_parsed_;
+            Telemetry::instance().collector(AppKind::ClaudeCode).record_entry(sample.input_tokens, sample.output_tokens);
             ++new_entries;
         }
     }
@@ -1,5 +1,7 @@
 
 #include "metrics/codex_usage_collector.h"
+#include "core/profiler.h"
+#include "core/telemetry.h"
 #include <cctype>
 #include <cstdlib>
 #include <ctime>
@@ -89,6 +91,7 @@ void CodexUsageCollector::do_initial_scan() {
 }
 
 void CodexUsageCollector::poll() {
+    DIANA_PROFILE_SCOPE("codex.poll");
     if (codex_dir_.empty()) {
         return;
     }
@@ -113,6 +116,7 @@ void CodexUsageCollector::poll() {
             process_file(file);
         }
         last_poll_ = now;
+        Telemetry::instance().collector(AppKind::Codex).record_poll(files_.size(), std::chrono::steady_clock::now() - now);
     }
 }
 
@@ -161,6 +165,7 @@ void CodexUsageCollector::scan_directories() {
 }
 
 void CodexUsageCollector::process_file(FileState& state) {
+    DIANA_PROFILE_SCOPE("codex.process_file");
     namespace fs = std::filesystem;
 
     if (!fs::exists(state.path)) return;
@@ -194,6 +199,7 @@ void CodexUsageCollector::process_file(FileState& state) {
                 store_->record_sample(sample);
             }
             ++entries_parsed_;
+            Telemetry::instance().collector(AppKind::Codex).record_entry(sample.input_tokens, sample.output_tokens);
         }
     }
 
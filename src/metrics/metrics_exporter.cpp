@@ -0,0 +1,417 @@
+#include "metrics/metrics_exporter.h"
+#include "core/redraw_scheduler.h"
+#include "core/telemetry.h"
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace diana {
+
+namespace {
+
+constexpr size_t MAX_REQUEST_BYTES = 8192;
+constexpr int CLIENT_TIMEOUT_SECONDS = 2;
+
+// Removes a socket left at path by an exporter that did not stop cleanly.
+// Anything that is not a socket, or a socket something still accepts on,
+// is left alone.
+bool remove_stale_socket(const std::string& path, const sockaddr_un& addr, std::string* error) {
+    struct stat st;
+    if (lstat(path.c_str(), &st) != 0) {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        if (error) *error = path + " exists and is not a socket";
+        return false;
+    }
+    int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool live = probe >= 0 && connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0;
+    if (probe >= 0) close(probe);
+    if (live) {
+        if (error) *error = "Something is already listening on " + path;
+        return false;
+    }
+    unlink(path.c_str());
+    return true;
+}
+
+const AppKind COLLECTED_APPS[] = {AppKind::ClaudeCode, AppKind::Codex, AppKind::OpenCode};
+
+const char* agent_label(AppKind app) {
+    switch (app) {
+        case AppKind::ClaudeCode: return "claude";
+        case AppKind::Codex:      return "codex";
+        case AppKind::OpenCode:   return "opencode";
+        case AppKind::Shell:      return "shell";
+    }
+    return "shell";
+}
+
+std::string escape_label(const std::string& value) {
+    std::string out;
+    out.reserve(value.size());
+    for (char c : value) {
+        if (c == '\\' || c == '"') {
+            out.push_back('\\');
+            out.push_back(c);
+        } else if (c == '\n') {
+            out += "\\n";
+        } else {
+            out.push_back(c);
+        }
+    }
+    return out;
+}
+
+void family(std::string& out, const char* name, const char* type, const char* help) {
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+}
+
+void sample(std::string& out, const char* name, const std::string& labels, uint64_t value) {
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), " %" PRIu64 "\n", value);
+    out += name;
+    out += labels;
+    out += buffer;
+}
+
+void sample(std::string& out, const char* name, const std::string& labels, double value) {
+    char buffer[48];
+    snprintf(buffer, sizeof(buffer), " %.9g\n", value);
+    out += name;
+    out += labels;
+    out += buffer;
+}
+
+std::string agent_labels(AppKind app) {
+    return std::string("{agent=\"") + agent_label(app) + "\"}";
+}
+
+void set_timeouts(int fd) {
+    timeval tv{};
+    tv.tv_sec = CLIENT_TIMEOUT_SECONDS;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+bool send_all(int fd, const std::string& data) {
+    size_t offset = 0;
+    while (offset < data.size()) {
+#ifdef MSG_NOSIGNAL
+        ssize_t n = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+#else
+        ssize_t n = send(fd, data.data() + offset, data.size() - offset, 0);
+#endif
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        offset += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string response(const char* status, const char* content_type, const std::string& body) {
+    std::string out = "HTTP/1.1 ";
+    out += status;
+    out += "\r\nContent-Type: ";
+    out += content_type;
+    out += "\r\nContent-Length: " + std::to_string(body.size());
+    out += "\r\nConnection: close\r\n\r\n";
+    out += body;
+    return out;
+}
+
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+std::string MetricsExporter::configured_address() {
+    const char* address = std::getenv("DIANA_METRICS_LISTEN");
+    return address ? address : "";
+}
+
+bool MetricsExporter::start(const std::string& address, std::string* error) {
+    if (running()) {
+        if (error) *error = "Already serving on " + address_;
+        return false;
+    }
+    std::string path;
+    if (address.rfind("unix:", 0) == 0) {
+        path = address.substr(5);
+    } else if (!address.empty() && address[0] == '/') {
+        path = address;
+    }
+
+    int fd = -1;
+    if (!path.empty()) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            if (error) *error = "Socket path is too long: " + path;
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        if (!remove_stale_socket(path, addr, error)) {
+            return false;
+        }
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        // Created owner-only, so no other user can connect before a chmod.
+        mode_t old_mask = umask(0077);
+        int rc = fd < 0 ? -1 : bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+        umask(old_mask);
+        if (rc != 0) {
+            if (error) *error = "Cannot bind " + path + ": " + std::strerror(errno);
+            if (fd >= 0) close(fd);
+            return false;
+        }
+    } else {
+        size_t colon = address.rfind(':');
+        std::string host = colon == std::string::npos ? "" : address.substr(0, colon);
+        char* end = nullptr;
+        long port = std::strtol(address.c_str() + (colon == std::string::npos ? 0 : colon + 1), &end, 10);
+        if (!end || *end != '\0' || port <= 0 || port > 65535) {
+            if (error) *error = "Expected 127.0.0.1:PORT or a socket path, got \"" + address + "\"";
+            return false;
+        }
+        if (!host.empty() && host != "127.0.0.1" && host != "localhost") {
+            if (error) *error = "Metrics are only served on 127.0.0.1 or a Unix socket";
+            return false;
+        }
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        if (fd >= 0) {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        }
+        if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            if (error) *error = "Cannot bind 127.0.0.1:" + std::to_string(port) + ": " + std::strerror(errno);
+            if (fd >= 0) close(fd);
+            return false;
+        }
+    }
+    if (::listen(fd, 8) != 0 || pipe(wake_fds_) != 0) {
+        if (error) *error = std::string("Cannot listen: ") + std::strerror(errno);
+        close(fd);
+        if (!path.empty()) unlink(path.c_str());
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(wake_fds_[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wake_fds_[1], F_SETFD, FD_CLOEXEC);
+
+    listen_fd_ = fd;
+    unix_path_ = path;
+    address_ = address;
+    thread_ = std::thread([this] { serve(); });
+    return true;
+}
+
+void MetricsExporter::stop() {
+    if (!thread_.joinable()) {
+        return;
+    }
+    char byte = 0;
+    ssize_t written = write(wake_fds_[1], &byte, 1);
+    (void)written;
+    thread_.join();
+    close(listen_fd_);
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+    listen_fd_ = -1;
+    wake_fds_[0] = wake_fds_[1] = -1;
+    if (!unix_path_.empty()) {
+        unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+}
+
+// Scrapes are answered one at a time; each takes well under a millisecond
+// and a stuck client is cut off after CLIENT_TIMEOUT_SECONDS.
+void MetricsExporter::serve() {
+    pollfd fds[2] = {{listen_fd_, POLLIN, 0}, {wake_fds_[0], POLLIN, 0}};
+    while (true) {
+        int rc = poll(fds, 2, -1);
+        if (rc < 0 && errno == EINTR) continue;
+        if (rc < 0 || (fds[1].revents & POLLIN)) {
+            return;
+        }
+        if (fds[0].revents & POLLIN) {
+            int client = accept(listen_fd_, nullptr, nullptr);
+            if (client >= 0) {
+                handle(client);
+                close(client);
+            }
+        }
+    }
+}
+
+void MetricsExporter::handle(int fd) {
+    set_timeouts(fd);
+    std::string request;
+    char buffer[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST_BYTES) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        request.append(buffer, static_cast<size_t>(n));
+    }
+    std::string line = request.substr(0, request.find("\r\n"));
+    if (line.rfind("GET ", 0) != 0) {
+        send_all(fd, response("405 Method Not Allowed", "text/plain", "Only GET is supported\n"));
+        return;
+    }
+    std::string target = line.substr(4, line.find(' ', 4) - 4);
+    if (target != "/metrics" && target != "/") {
+        send_all(fd, response("404 Not Found", "text/plain", "Metrics are at /metrics\n"));
+        return;
+    }
+    scrapes_.fetch_add(1, std::memory_order_relaxed);
+    send_all(fd, response("200 OK", "text/plain; version=0.0.4; charset=utf-8", render()));
+}
+
+void MetricsExporter::publish_sessions(const std::vector<SessionMetrics>& sessions) {
+    auto text = std::make_shared<std::string>();
+    std::string& out = *text;
+    std::vector<std::string> labels;
+    labels.reserve(sessions.size());
+    for (const auto& s : sessions) {
+        labels.push_back("{session=\"" + std::to_string(s.id) + "\",name=\"" + escape_label(s.name) +
+                         "\",agent=\"" + agent_label(s.app) + "\"}");
+    }
+
+    family(out, "diana_sessions", "gauge", "Open terminal sessions.");
+    sample(out, "diana_sessions", "", static_cast<uint64_t>(sessions.size()));
+    family(out, "diana_session_running", "gauge", "Whether the session's agent is running.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_running", labels[i], static_cast<uint64_t>(sessions[i].running ? 1 : 0));
+    }
+    family(out, "diana_session_backlog_bytes", "gauge", "PTY output waiting to be parsed.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_backlog_bytes", labels[i], sessions[i].backlog_bytes);
+    }
+    family(out, "diana_session_pending_input_bytes", "gauge", "Input queued for the PTY.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_pending_input_bytes", labels[i], sessions[i].pending_input_bytes);
+    }
+    family(out, "diana_session_parsed_bytes_total", "counter", "Output parsed by the session's terminal.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_parsed_bytes_total", labels[i], sessions[i].parsed_bytes);
+    }
+    family(out, "diana_session_parse_lag_seconds", "gauge", "Age of the oldest unparsed output.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_parse_lag_seconds", labels[i], sessions[i].parse_lag_seconds);
+    }
+    family(out, "diana_session_cpu_percent", "gauge", "CPU use of the session's process group.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_cpu_percent", labels[i], sessions[i].cpu_percent);
+    }
+    family(out, "diana_session_rss_bytes", "gauge", "Resident memory of the session's process group.");
+    for (size_t i = 0; i < sessions.size(); ++i) {
+        sample(out, "diana_session_rss_bytes", labels[i], sessions[i].rss_bytes);
+    }
+    std::atomic_store(&sessions_text_, std::shared_ptr<const std::string>(std::move(text)));
+}
+
+std::string MetricsExporter::render() const {
+    const Telemetry& t = Telemetry::instance();
+    const RedrawScheduler& redraw = RedrawScheduler::instance();
+    std::string out;
+    out.reserve(8192);
+
+    family(out, "diana_tokens_total", "counter", "Tokens found in agent usage logs.");
+    for (AppKind app : COLLECTED_APPS) {
+        const CollectorTelemetry& c = t.collector(app);
+        std::string agent = agent_label(app);
+        sample(out, "diana_tokens_total", "{agent=\"" + agent + "\",direction=\"input\"}",
+               c.input_tokens.load(std::memory_order_relaxed));
+        sample(out, "diana_tokens_total", "{agent=\"" + agent + "\",direction=\"output\"}",
+               c.output_tokens.load(std::memory_order_relaxed));
+    }
+    family(out, "diana_collector_entries_parsed_total", "counter", "Usage entries parsed from agent logs.");
+    for (AppKind app : COLLECTED_APPS) {
+        sample(out, "diana_collector_entries_parsed_total", agent_labels(app),
+               t.collector(app).entries_parsed.load(std::memory_order_relaxed));
+    }
+    family(out, "diana_collector_files_watched", "gauge", "Log files the collector reads.");
+    for (AppKind app : COLLECTED_APPS) {
+        sample(out, "diana_collector_files_watched", agent_labels(app),
+               t.collector(app).files_watched.load(std::memory_order_relaxed));
+    }
+    family(out, "diana_collector_polls_total", "counter", "Passes over the watched files.");
+    for (AppKind app : COLLECTED_APPS) {
+        sample(out, "diana_collector_polls_total", agent_labels(app),
+               t.collector(app).polls.load(std::memory_order_relaxed));
+    }
+    family(out, "diana_collector_last_poll_timestamp_seconds", "gauge",
+           "When the last pass finished; time() minus this is the collector lag.");
+    for (AppKind app : COLLECTED_APPS) {
+        sample(out, "diana_collector_last_poll_timestamp_seconds", agent_labels(app),
+               static_cast<double>(t.collector(app).last_poll_unix_ms.load(std::memory_order_relaxed)) / 1e3);
+    }
+    family(out, "diana_collector_poll_duration_seconds", "gauge", "How long the last pass took.");
+    for (AppKind app : COLLECTED_APPS) {
+        sample(out, "diana_collector_poll_duration_seconds", agent_labels(app),
+               static_cast<double>(t.collector(app).last_poll_us.load(std::memory_order_relaxed)) / 1e6);
+    }
+
+    family(out, "diana_pty_read_bytes_total", "counter", "Bytes read from agent PTYs.");
+    sample(out, "diana_pty_read_bytes_total", "", t.pty_read_bytes());
+    family(out, "diana_pty_written_bytes_total", "counter", "Bytes written to agent PTYs.");
+    sample(out, "diana_pty_written_bytes_total", "", t.pty_written_bytes());
+    family(out, "diana_terminal_parsed_bytes_total", "counter", "Bytes parsed by all terminals.");
+    sample(out, "diana_terminal_parsed_bytes_total", "", t.parsed_bytes());
+
+    family(out, "diana_frames_total", "counter", "Frames rendered.");
+    sample(out, "diana_frames_total", "", t.frames());
+    family(out, "diana_frame_seconds_total", "counter", "Time spent rendering frames, excluding vsync.");
+    sample(out, "diana_frame_seconds_total", "", t.frame_seconds_total());
+    family(out, "diana_frame_seconds", "gauge", "Render time of the last frame.");
+    sample(out, "diana_frame_seconds", "", t.last_frame_seconds());
+    family(out, "diana_ui_idle_seconds_total", "counter", "Time the render loop slept waiting for events.");
+    sample(out, "diana_ui_idle_seconds_total", "", redraw.idle_seconds());
+    family(out, "diana_ui_wakeups_total", "counter", "Redraws requested from outside the UI thread.");
+    sample(out, "diana_ui_wakeups_total", "", redraw.wakeups());
+
+    family(out, "diana_session_events_total", "counter", "Session events handled by the UI.");
+    sample(out, "diana_session_events_total", "", t.events());
+    family(out, "diana_session_event_queue_depth", "gauge", "Session events waiting at the last drain.");
+    sample(out, "diana_session_event_queue_depth", "", t.event_queue_depth());
+
+    if (auto sessions = std::atomic_load(&sessions_text_)) {
+        out += *sessions;
+    }
+
+    family(out, "diana_exporter_scrapes_total", "counter", "Scrapes served.");
+    sample(out, "diana_exporter_scrapes_total", "", scrapes());
+    return out;
+}
+
+}
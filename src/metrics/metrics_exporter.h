@@ -0,0 +1,72 @@
+#pragma once
+
+#include "core/types.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace diana {
+
+// One session as the exporter reports it; filled in by the UI thread.
+struct SessionMetrics {
+    uint32_t id = 0;
+    std::string name;
+    AppKind app = AppKind::Shell;
+    bool running = false;
+    uint64_t backlog_bytes = 0;        // output not parsed yet
+    uint64_t pending_input_bytes = 0;  // input not written to the PTY yet
+    uint64_t parsed_bytes = 0;
+    double parse_lag_seconds = 0.0;
+    double cpu_percent = 0.0;
+    uint64_t rss_bytes = 0;
+};
+
+// Serves Diana's metrics in the Prometheus text format over HTTP, on
+// 127.0.0.1 or a Unix socket, from a thread of its own. A scrape renders
+// the Telemetry counters and the last session snapshot the UI published, so
+// it never waits for the UI, the parsers or the collectors.
+//
+// Off unless DIANA_METRICS_LISTEN is set: "127.0.0.1:9464", ":9464", or a
+// socket path ("unix:/path" or an absolute path).
+class MetricsExporter {
+public:
+    MetricsExporter() = default;
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // DIANA_METRICS_LISTEN, or empty when the exporter should stay off.
+    static std::string configured_address();
+
+    // Only loopback addresses are accepted.
+    bool start(const std::string& address, std::string* error = nullptr);
+    void stop();
+    bool running() const { return thread_.joinable(); }
+    const std::string& address() const { return address_; }
+
+    // Replaces the per-session series later scrapes return.
+    void publish_sessions(const std::vector<SessionMetrics>& sessions);
+
+    // The body of a scrape.
+    std::string render() const;
+    uint64_t scrapes() const { return scrapes_.load(std::memory_order_relaxed); }
+
+private:
+    void serve();
+    void handle(int fd);
+
+    std::string address_;
+    std::string unix_path_;
+    int listen_fd_ = -1;
+    int wake_fds_[2] = {-1, -1};
+    std::thread thread_;
+    std::atomic<uint64_t> scrapes_{0};
+    // Read and replaced with std::atomic_load / std::atomic_store.
+    std::shared_ptr<const std::string> sessions_text_;
+};
+
+}
@@ -1,4 +1,6 @@
 #include "opencode_usage_collector.h"
+#include "core/profiler.h"
+#include "core/telemetry.h"
 
 #include <algorithm>
 #include <cctype>
@@ -180,6 +182,7 @@ void OpencodeUsageCollector::do_initial_scan() {
 }
 
 void OpencodeUsageCollector::poll() {
+    DIANA_PROFILE_SCOPE("opencode.poll");
     if (storage_dir_.empty()) return;
     
     if (!init_done_) return;
@@ -198,6 +201,7 @@ void OpencodeUsageCollector::poll() {
             process_file(path);
         }
         last_poll_ = now;
+        Telemetry::instance().collector(AppKind::OpenCode).record_poll(message_paths_.size(), std::chrono::steady_clock::now() - now);
     }
 }
 
@@ -282,6 +286,7 @@ void OpencodeUsageCollector::scan_messages() {
 }
 
 void OpencodeUsageCollector::process_file(const std::filesystem::path& path) {
+    DIANA_PROFILE_SCOPE("opencode.process_file");
     namespace fs = std::filesystem;
 
     if (!fs::exists(path)) return;
@@ -362,6 +367,7 @@ void OpencodeUsageCollector::process_file(const std::filesystem::path& path) {
             store_->record_sample(sample);
         }
         ++entries_parsed_;
+        Telemetry::instance().collector(AppKind::OpenCode).record_entry(sample.input_tokens, sample.output_tokens);
     }
 
     last_totals_[path.string()] = totals;
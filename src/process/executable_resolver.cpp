@@ -0,0 +1,375 @@
+#include "process/executable_resolver.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace diana {
+
+namespace {
+
+std::string trim_whitespace(std::string value) {
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+        value.erase(value.begin());
+    }
+    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+        value.pop_back();
+    }
+    return value;
+}
+
+void append_unique(std::vector<std::string>& items, const std::string& value) {
+    if (value.empty()) {
+        return;
+    }
+    if (std::find(items.begin(), items.end(), value) == items.end()) {
+        items.push_back(value);
+    }
+}
+
+void append_if_exists(std::vector<std::string>& items, const std::filesystem::path& path) {
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec) && !ec) {
+        append_unique(items, path.string());
+    }
+}
+
+std::string read_nvm_default_version(const std::string& home_dir) {
+    std::filesystem::path alias_file = std::filesystem::path(home_dir) / ".nvm/alias/default";
+    std::error_code ec;
+    if (!std::filesystem::exists(alias_file, ec) || ec) {
+        return {};
+    }
+    std::ifstream f(alias_file);
+    if (!f) return {};
+    std::string line;
+    std::getline(f, line);
+    return trim_whitespace(line);
+}
+
+std::string find_nvm_version_bin(const std::string& home_dir, const std::string& alias) {
+    if (alias.empty()) return {};
+    std::filesystem::path versions_dir = std::filesystem::path(home_dir) / ".nvm/versions/node";
+    std::error_code ec;
+    if (!std::filesystem::exists(versions_dir, ec) || ec) return {};
+    
+    std::filesystem::path exact = versions_dir / alias;
+    if (std::filesystem::exists(exact / "bin", ec) && !ec) {
+        return (exact / "bin").string();
+    }
+    
+    std::string version_prefix = alias;
+    if (!version_prefix.empty() && version_prefix[0] != 'v') {
+        version_prefix = "v" + version_prefix;
+    }
+    
+    std::string best_match;
+    for (const auto& entry : std::filesystem::directory_iterator(versions_dir, ec)) {
+        if (ec || !entry.is_directory()) continue;
+        std::string name = entry.path().filename().string();
+        if (name.rfind(version_prefix, 0) == 0) {
+            std::filesystem::path bin = entry.path() / "bin";
+            if (std::filesystem::exists(bin, ec) && !ec) {
+                if (best_match.empty() || name > best_match) {
+                    best_match = bin.string();
+                }
+            }
+        }
+    }
+    return best_match;
+}
+
+std::vector<std::string> split_path_list(const std::string& value) {
+    std::vector<std::string> result;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, ':')) {
+        item = trim_whitespace(item);
+        if (!item.empty()) {
+            result.push_back(item);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> build_search_paths() {
+    std::vector<std::string> paths;
+
+    const char* env_path = std::getenv("PATH");
+    if (env_path && *env_path) {
+        for (const auto& entry : split_path_list(env_path)) {
+            append_unique(paths, entry);
+        }
+    }
+
+    append_unique(paths, "/usr/local/bin");
+    append_unique(paths, "/opt/homebrew/bin");
+    append_unique(paths, "/usr/bin");
+    append_unique(paths, "/bin");
+    append_unique(paths, "/usr/sbin");
+    append_unique(paths, "/sbin");
+
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        std::string home_dir = home;
+        append_if_exists(paths, std::filesystem::path(home_dir) / ".local/bin");
+        append_if_exists(paths, std::filesystem::path(home_dir) / ".cargo/bin");
+        append_if_exists(paths, std::filesystem::path(home_dir) / ".npm-global/bin");
+        append_if_exists(paths, std::filesystem::path(home_dir) / ".volta/bin");
+        append_if_exists(paths, std::filesystem::path(home_dir) / ".asdf/shims");
+
+        std::string default_alias = read_nvm_default_version(home_dir);
+        std::string default_bin = find_nvm_version_bin(home_dir, default_alias);
+        if (!default_bin.empty()) {
+            append_unique(paths, default_bin);
+        }
+        
+        std::filesystem::path nvm_dir = std::filesystem::path(home_dir) / ".nvm/versions/node";
+        std::error_code ec;
+        if (std::filesystem::exists(nvm_dir, ec) && !ec) {
+            for (const auto& entry : std::filesystem::directory_iterator(nvm_dir, ec)) {
+                if (ec) {
+                    break;
+                }
+                if (!entry.is_directory()) {
+                    continue;
+                }
+                append_if_exists(paths, entry.path() / "bin");
+            }
+        }
+    }
+
+    return paths;
+}
+
+std::string resolve_from_shell(const std::string& executable) {
+    if (executable.find('/') != std::string::npos) {
+        return executable;
+    }
+    const char* shell = std::getenv("SHELL");
+    std::string shell_path = (shell && *shell) ? shell : "/bin/zsh";
+    std::string command = shell_path + " -lc \"command -v " + executable + " 2>/dev/null\"";
+
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) {
+        return {};
+    }
+
+    std::string output;
+    char buffer[256];
+    while (fgets(buffer, sizeof(buffer), pipe)) {
+        output += buffer;
+    }
+    pclose(pipe);
+
+    output = trim_whitespace(output);
+    if (output.empty()) {
+        return {};
+    }
+
+    std::filesystem::path resolved(output);
+    if (!resolved.is_absolute()) {
+        return {};
+    }
+
+    std::error_code ec;
+    if (!std::filesystem::exists(resolved, ec) || ec) {
+        return {};
+    }
+
+    return output;
+}
+
+// Files and directories whose change can alter a lookup: the search path
+// itself plus the roots it is derived from, whether they exist yet or not.
+std::vector<std::string> watched_paths(const std::vector<std::string>& search_paths) {
+    std::vector<std::string> paths = search_paths;
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        std::filesystem::path home_dir(home);
+        for (const char* rel : {".local/bin", ".cargo/bin", ".npm-global/bin", ".volta/bin", ".asdf/shims",
+                                ".nvm/versions/node", ".nvm/alias/default"}) {
+            append_unique(paths, (home_dir / rel).string());
+        }
+    }
+    return paths;
+}
+
+int64_t mtime_ns(const std::string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        return -1;
+    }
+#if defined(__APPLE__)
+    return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+    return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+ExecutableResolution lookup(const std::string& executable, const std::vector<std::string>& search_paths) {
+    auto start = std::chrono::steady_clock::now();
+    ExecutableResolution result;
+    result.path = executable;
+    if (executable.find('/') != std::string::npos) {
+        result.found = true;
+    } else {
+        for (const auto& dir : search_paths) {
+            std::filesystem::path candidate = std::filesystem::path(dir) / executable;
+            std::error_code ec;
+            if (std::filesystem::exists(candidate, ec) && !ec) {
+                result.path = candidate.string();
+                result.found = true;
+                break;
+            }
+        }
+        if (!result.found) {
+            std::string shell_resolved = resolve_from_shell(executable);
+            if (!shell_resolved.empty()) {
+                result.path = shell_resolved;
+                result.found = true;
+                result.via_shell = true;
+            }
+        }
+    }
+    result.resolve_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+}
+
+ExecutableResolver::ExecutableResolver(std::chrono::milliseconds stamp_check_interval)
+    : stamp_check_interval_(stamp_check_interval) {}
+
+ExecutableResolver::~ExecutableResolver() {
+    stopping_.store(true);
+}
+
+void ExecutableResolver::prewarm(const std::vector<std::string>& names) {
+    for (const auto& name : names) {
+        pool_.submit([this, name] {
+            if (!stopping_.load()) {
+                resolve(name);
+            }
+        });
+    }
+}
+
+ExecutableResolution ExecutableResolver::resolve(const std::string& name) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        refresh_locked(false);
+        auto it = entries_.find(name);
+        if (it != entries_.end()) {
+            return it->second;
+        }
+        if (!in_flight_.count(name)) {
+            break;
+        }
+        resolved_cv_.wait(lock);
+    }
+
+    in_flight_.insert(name);
+    uint64_t generation = generation_;
+    std::vector<std::string> search_paths = search_paths_;
+    lock.unlock();
+    ExecutableResolution result = lookup(name, search_paths);
+    lock.lock();
+    in_flight_.erase(name);
+    if (generation == generation_) {
+        store_locked(name, result);
+    }
+    resolved_cv_.notify_all();
+    return result;
+}
+
+std::optional<ExecutableResolution> ExecutableResolver::cached(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refresh_locked(false);
+    auto it = entries_.find(name);
+    if (it == entries_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void ExecutableResolver::invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    refresh_locked(true);
+}
+
+// Refreshes the cache when forced or when a watched path changed since it
+// was built, checking at most once per interval. Entries stay until their
+// new lookup replaces them.
+void ExecutableResolver::refresh_locked(bool force) {
+    auto now = std::chrono::steady_clock::now();
+    if (!built_) {
+        rebuild_locked();
+        last_check_ = now;
+        return;
+    }
+    if (!force) {
+        if (now - last_check_ < stamp_check_interval_) {
+            return;
+        }
+        last_check_ = now;
+        bool changed = std::any_of(stamps_.begin(), stamps_.end(),
+                                   [](const PathStamp& stamp) { return mtime_ns(stamp.path) != stamp.mtime_ns; });
+        if (!changed) {
+            return;
+        }
+    }
+    invalidations_.fetch_add(1, std::memory_order_relaxed);
+    rebuild_locked();
+    last_check_ = now;
+    for (const auto& [name, result] : entries_) {
+        pool_.submit([this, name = name, generation = generation_] {
+            if (!stopping_.load()) {
+                revalidate(name, generation);
+            }
+        });
+    }
+}
+
+void ExecutableResolver::rebuild_locked() {
+    ++generation_;
+    search_paths_ = build_search_paths();
+    stamps_.clear();
+    for (auto& path : watched_paths(search_paths_)) {
+        int64_t mtime = mtime_ns(path);
+        stamps_.push_back({std::move(path), mtime});
+    }
+    built_ = true;
+}
+
+// A result found through the shell is refreshed when its directory changes.
+void ExecutableResolver::store_locked(const std::string& name, const ExecutableResolution& result) {
+    entries_[name] = result;
+    if (result.via_shell) {
+        std::string dir = std::filesystem::path(result.path).parent_path().string();
+        stamps_.push_back({dir, mtime_ns(dir)});
+    }
+}
+
+void ExecutableResolver::revalidate(const std::string& name, uint64_t generation) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (generation != generation_ || in_flight_.count(name)) {
+        return;
+    }
+    in_flight_.insert(name);
+    std::vector<std::string> search_paths = search_paths_;
+    lock.unlock();
+    ExecutableResolution result = lookup(name, search_paths);
+    lock.lock();
+    in_flight_.erase(name);
+    if (generation == generation_) {
+        store_locked(name, result);
+    }
+    resolved_cv_.notify_all();
+}
+
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace diana {
+
+struct ExecutableResolution {
+    std::string path;           // absolute, or the bare name when nothing was found
+    bool found = false;
+    bool via_shell = false;     // only the login shell's `command -v` knew it
+    double resolve_ms = 0.0;    // time the uncached lookup took
+};
+
+// Finds agent executables (claude, codex, ...) in PATH, the usual install
+// locations and every nvm node version, and failing that asks the user's
+// login shell, which can take seconds with a heavy shell config. Results,
+// misses included, are cached. When the mtime of a directory they were built
+// from changes (the search directories, the nvm/volta/asdf roots and nvm's
+// default alias are stat()ed at most once per check interval), the cached
+// names are resolved again on the background thread while the previous
+// results keep being served, so only a name never resolved before costs a
+// lookup on the calling thread.
+//
+// Thread-safe; a name being resolved on one thread is waited for, not
+// resolved twice.
+class ExecutableResolver {
+public:
+    static constexpr std::chrono::milliseconds STAMP_CHECK_INTERVAL{1000};
+
+    explicit ExecutableResolver(std::chrono::milliseconds stamp_check_interval = STAMP_CHECK_INTERVAL);
+    ~ExecutableResolver();
+
+    ExecutableResolver(const ExecutableResolver&) = delete;
+    ExecutableResolver& operator=(const ExecutableResolver&) = delete;
+
+    // Resolves names on a background thread.
+    void prewarm(const std::vector<std::string>& names);
+
+    // Cached result, resolving on the calling thread on a miss.
+    ExecutableResolution resolve(const std::string& name);
+    // Cached result only.
+    std::optional<ExecutableResolution> cached(const std::string& name);
+
+    // Resolves the cached names again in the background.
+    void invalidate();
+    // Times the cache has been refreshed, by invalidate() or a changed directory.
+    uint64_t invalidations() const { return invalidations_.load(std::memory_order_relaxed); }
+
+private:
+    struct PathStamp {
+        std::string path;
+        int64_t mtime_ns = -1;      // -1: did not exist
+    };
+
+    void refresh_locked(bool force);
+    void rebuild_locked();
+    void store_locked(const std::string& name, const ExecutableResolution& result);
+    void revalidate(const std::string& name, uint64_t generation);
+
+    std::chrono::milliseconds stamp_check_interval_;
+    std::mutex mutex_;
+    std::condition_variable resolved_cv_;
+    std::unordered_map<std::string, ExecutableResolution> entries_;
+    std::unordered_set<std::string> in_flight_;
+    std::vector<std::string> search_paths_;
+    std::vector<PathStamp> stamps_;
+    bool built_ = false;
+    uint64_t generation_ = 0;
+    std::chrono::steady_clock::time_point last_check_{};
+    std::atomic<uint64_t> invalidations_{0};
+    std::atomic<bool> stopping_{false};
+    ThreadPool pool_{1};
+};
+
+}
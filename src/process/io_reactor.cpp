@@ -0,0 +1,410 @@
+#include "process/io_reactor.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+namespace diana {
+
+namespace {
+
+constexpr int MAX_EVENTS = 64;
+constexpr uint64_t WAKE_TOKEN = 0;
+
+#if defined(__linux__)
+uint32_t to_epoll(uint32_t interest) {
+    return ((interest & IoReactor::READABLE) ? EPOLLIN : 0u) | ((interest & IoReactor::WRITABLE) ? EPOLLOUT : 0u);
+}
+
+uint32_t from_epoll(uint32_t events) {
+    return ((events & EPOLLIN) ? IoReactor::READABLE : 0u) | ((events & EPOLLOUT) ? IoReactor::WRITABLE : 0u) |
+           ((events & (EPOLLHUP | EPOLLERR)) ? IoReactor::HANGUP : 0u);
+}
+#endif
+
+}
+
+IoReactor::IoReactor() {
+#if defined(__linux__)
+    poll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_TOKEN;
+    epoll_ctl(poll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+#elif defined(__APPLE__)
+    poll_fd_ = kqueue();
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, EV_ADD | EV_CLEAR, 0, 0, nullptr);
+    kevent(poll_fd_, &ev, 1, nullptr, 0, nullptr);
+#endif
+    thread_ = std::thread(&IoReactor::run, this);
+}
+
+IoReactor::~IoReactor() {
+    post([this] { stopping_ = true; });
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    for (auto& [pid, watch] : exits_) {
+        if (watch.pidfd >= 0) close(watch.pidfd);
+    }
+    if (wake_fd_ >= 0) close(wake_fd_);
+    if (poll_fd_ >= 0) close(poll_fd_);
+}
+
+bool IoReactor::add_fd(int fd, uint32_t interest, FdHandler handler) {
+    if (fds_.count(fd)) {
+        return false;
+    }
+    FdEntry entry;
+    entry.token = next_token_++;
+    entry.interest = interest;
+    entry.handler = std::move(handler);
+    if (!arm_fd(fd, entry, true)) {
+        return false;
+    }
+    tokens_[entry.token] = fd;
+    fds_[fd] = std::move(entry);
+    fd_count_.store(fds_.size(), std::memory_order_relaxed);
+    return true;
+}
+
+void IoReactor::set_interest(int fd, uint32_t interest) {
+    auto it = fds_.find(fd);
+    if (it == fds_.end() || it->second.interest == interest) {
+        return;
+    }
+    it->second.interest = interest;
+    arm_fd(fd, it->second, false);
+}
+
+void IoReactor::remove_fd(int fd) {
+    auto it = fds_.find(fd);
+    if (it == fds_.end()) {
+        return;
+    }
+    disarm_fd(fd, it->second);
+    tokens_.erase(it->second.token);
+    fds_.erase(it);
+    fd_count_.store(fds_.size(), std::memory_order_relaxed);
+}
+
+bool IoReactor::arm_fd(int fd, const FdEntry& entry, bool added) {
+#if defined(__linux__)
+    epoll_event ev{};
+    ev.events = to_epoll(entry.interest);
+    ev.data.u64 = entry.token;
+    return epoll_ctl(poll_fd_, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &ev) == 0;
+#elif defined(__APPLE__)
+    struct kevent changes[2];
+    void* udata = reinterpret_cast<void*>(static_cast<uintptr_t>(entry.token));
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | ((entry.interest & READABLE) ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | ((entry.interest & WRITABLE) ? EV_ENABLE : EV_DISABLE), 0, 0, udata);
+    (void)added;
+    return kevent(poll_fd_, changes, 2, nullptr, 0, nullptr) == 0;
+#else
+    (void)fd; (void)entry; (void)added;
+    return false;
+#endif
+}
+
+void IoReactor::disarm_fd(int fd, const FdEntry& entry) {
+#if defined(__linux__)
+    (void)entry;
+    epoll_ctl(poll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+#elif defined(__APPLE__)
+    (void)entry;
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    kevent(poll_fd_, changes, 2, nullptr, 0, nullptr);
+#else
+    (void)fd; (void)entry;
+#endif
+}
+
+void IoReactor::dispatch_fd(uint64_t token, uint32_t events) {
+    // The fd may have been removed by an earlier handler in the same batch.
+    auto it = tokens_.find(token);
+    if (it == tokens_.end()) {
+        return;
+    }
+    // Copied, so the handler may remove its own fd.
+    FdHandler handler = fds_[it->second].handler;
+    handler(events);
+}
+
+bool IoReactor::watch_exit(pid_t pid, ExitHandler handler) {
+    if (pid <= 0 || exits_.count(pid)) {
+        return false;
+    }
+    ExitWatch& watch = exits_[pid];
+    watch.handler = std::move(handler);
+#if defined(__linux__)
+#if defined(SYS_pidfd_open)
+    watch.pidfd = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#endif
+    if (watch.pidfd >= 0 && add_fd(watch.pidfd, READABLE, [this, pid](uint32_t) { reap(pid); })) {
+        return true;
+    }
+    if (watch.pidfd >= 0) {
+        close(watch.pidfd);
+        watch.pidfd = -1;
+    }
+#elif defined(__APPLE__)
+    struct kevent change;
+    EV_SET(&change, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+    if (kevent(poll_fd_, &change, 1, nullptr, 0, nullptr) == 0) {
+        return true;
+    }
+    if (errno == ESRCH) {
+        // Already gone; reap it on the next turn of the loop.
+        post([this, pid] { reap(pid); });
+        return true;
+    }
+#endif
+    polled_exits_.push_back(pid);
+    if (exit_poll_timer_ == 0) {
+        exit_poll_timer_ = add_timer(EXIT_POLL_INTERVAL, [this] { poll_exits(); });
+    }
+    return true;
+}
+
+void IoReactor::forget_exit(pid_t pid, std::optional<std::chrono::milliseconds> kill_after) {
+    auto it = exits_.find(pid);
+    if (it == exits_.end()) {
+        return;
+    }
+    it->second.handler = nullptr;
+    if (!kill_after || it->second.kill_timer != 0) {
+        return;
+    }
+    // Safe against pid reuse: an unreaped child keeps its pid.
+    it->second.kill_timer = add_timer(*kill_after, [this, pid] {
+        auto watch = exits_.find(pid);
+        if (watch == exits_.end()) return;
+        watch->second.kill_timer = 0;
+        ::kill(-pid, SIGKILL);
+        ::kill(pid, SIGKILL);
+    });
+}
+
+// Collects pid's status if it has exited. A pid that is no longer our child
+// (reaped elsewhere) is reported with status -1.
+void IoReactor::reap(pid_t pid) {
+    auto it = exits_.find(pid);
+    if (it == exits_.end()) {
+        return;
+    }
+    int status = 0;
+    pid_t result = waitpid(pid, &status, WNOHANG);
+    if (result == 0 || (result < 0 && errno == EINTR)) {
+        return;
+    }
+    if (result < 0) {
+        status = -1;
+    }
+
+    ExitWatch watch = std::move(it->second);
+    exits_.erase(it);
+    if (watch.pidfd >= 0) {
+        remove_fd(watch.pidfd);
+        close(watch.pidfd);
+    }
+    if (watch.kill_timer != 0) {
+        cancel_timer(watch.kill_timer);
+    }
+    polled_exits_.erase(std::remove(polled_exits_.begin(), polled_exits_.end(), pid), polled_exits_.end());
+    if (watch.handler) {
+        watch.handler(status);
+    }
+}
+
+void IoReactor::poll_exits() {
+    exit_poll_timer_ = 0;
+    std::vector<pid_t> pids = polled_exits_;
+    for (pid_t pid : pids) {
+        reap(pid);
+    }
+    if (!polled_exits_.empty()) {
+        exit_poll_timer_ = add_timer(EXIT_POLL_INTERVAL, [this] { poll_exits(); });
+    }
+}
+
+IoReactor::TimerId IoReactor::add_timer(Clock::duration delay, std::function<void()> fn) {
+    TimerId id = next_timer_++;
+    Clock::time_point deadline = Clock::now() + delay;
+    timers_.emplace(std::make_pair(deadline, id), std::move(fn));
+    timer_deadlines_[id] = deadline;
+    return id;
+}
+
+void IoReactor::cancel_timer(TimerId id) {
+    auto it = timer_deadlines_.find(id);
+    if (it == timer_deadlines_.end()) {
+        return;
+    }
+    timers_.erase(std::make_pair(it->second, id));
+    timer_deadlines_.erase(it);
+}
+
+int IoReactor::next_timeout_ms() const {
+    if (timers_.empty()) {
+        return -1;
+    }
+    auto remaining = timers_.begin()->first.first - Clock::now();
+    if (remaining <= Clock::duration::zero()) {
+        return 0;
+    }
+    // Round up so the loop does not wake just before the deadline.
+    return static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+}
+
+void IoReactor::run_timers() {
+    auto now = Clock::now();
+    while (!timers_.empty() && timers_.begin()->first.first <= now) {
+        auto node = timers_.extract(timers_.begin());
+        timer_deadlines_.erase(node.key().second);
+        node.mapped()();
+    }
+}
+
+void IoReactor::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        if (!failed()) {
+            posted_.push_back(std::move(task));
+        }
+    }
+    // A task refused above is destroyed here, outside the lock.
+    task = nullptr;
+    wake();
+}
+
+// The promise is owned by the task, so dropping the task unblocks the
+// caller with a broken promise.
+bool IoReactor::call(const std::function<void()>& task) {
+    if (in_reactor_thread()) {
+        task();
+        return true;
+    }
+    auto done = std::make_shared<std::promise<void>>();
+    std::future<void> ran = done->get_future();
+    post([&task, done = std::move(done)] {
+        task();
+        done->set_value();
+    });
+    try {
+        ran.get();
+        return true;
+    } catch (const std::future_error&) {
+        return false;
+    }
+}
+
+void IoReactor::wake() {
+#if defined(__linux__)
+    uint64_t one = 1;
+    ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+    (void)ignored;
+#elif defined(__APPLE__)
+    struct kevent ev;
+    EV_SET(&ev, 0, EVFILT_USER, 0, NOTE_TRIGGER, 0, nullptr);
+    kevent(poll_fd_, &ev, 1, nullptr, 0, nullptr);
+#endif
+}
+
+void IoReactor::run_posted() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        tasks.swap(posted_);
+    }
+    for (auto& task : tasks) {
+        task();
+    }
+}
+
+void IoReactor::run() {
+    while (!stopping_) {
+        int timeout_ms = next_timeout_ms();
+#if defined(__linux__)
+        epoll_event events[MAX_EVENTS];
+        int n = epoll_wait(poll_fd_, events, MAX_EVENTS, timeout_ms);
+#elif defined(__APPLE__)
+        struct kevent events[MAX_EVENTS];
+        timespec timeout{timeout_ms / 1000, (timeout_ms % 1000) * 1000000L};
+        int n = kevent(poll_fd_, nullptr, 0, events, MAX_EVENTS, timeout_ms < 0 ? nullptr : &timeout);
+#else
+        int n = 0;
+#endif
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+        if (n < 0 && errno != EINTR) {
+            fail(errno);
+            return;
+        }
+
+        for (int i = 0; i < n; ++i) {
+#if defined(__linux__)
+            uint64_t token = events[i].data.u64;
+            if (token == WAKE_TOKEN) {
+                uint64_t count = 0;
+                ssize_t ignored = read(wake_fd_, &count, sizeof(count));
+                (void)ignored;
+                continue;
+            }
+            dispatch_fd(token, from_epoll(events[i].events));
+#elif defined(__APPLE__)
+            const struct kevent& ev = events[i];
+            if (ev.filter == EVFILT_USER) {
+                continue;
+            }
+            if (ev.filter == EVFILT_PROC) {
+                reap(static_cast<pid_t>(ev.ident));
+                continue;
+            }
+            uint32_t flags = ev.filter == EVFILT_WRITE ? WRITABLE : READABLE;
+            if (ev.flags & (EV_EOF | EV_ERROR)) {
+                flags |= HANGUP;
+            }
+            dispatch_fd(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ev.udata)), flags);
+#endif
+        }
+
+        run_timers();
+        run_posted();
+    }
+}
+
+// Nothing will run queued tasks any more; dropping them fails their call().
+void IoReactor::fail(int error) {
+#if defined(__APPLE__)
+    const char* wait_call = "kevent";
+#else
+    const char* wait_call = "epoll_wait";
+#endif
+    fprintf(stderr, "IoReactor stopped: %s failed: %s\n", wait_call, std::strerror(error));
+    std::vector<std::function<void()>> dropped;
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        failure_errno_.store(error);
+        dropped.swap(posted_);
+    }
+}
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <sys/types.h>
+
+namespace diana {
+
+// One thread that waits on every PTY in the process: epoll on Linux, kqueue
+// on macOS. Child exits arrive on the same loop through a pidfd (Linux) or
+// EVFILT_PROC (macOS); the child has been reaped by the time its handler runs.
+// Where pidfd_open is missing the loop falls back to polling waitpid every
+// EXIT_POLL_INTERVAL, and only while such a child is being watched, so an idle
+// reactor never wakes up.
+//
+// Handlers, exit handlers and timers all run on the reactor thread, so they
+// can share state without locks. The registration functions must be called
+// on that thread too: from a handler, or from another thread through post()
+// or call().
+//
+// If waiting itself fails the loop logs the error and stops for good:
+// failed() turns true, queued tasks are dropped and call() returns false.
+class IoReactor {
+public:
+    using Clock = std::chrono::steady_clock;
+    using FdHandler = std::function<void(uint32_t events)>;
+    using ExitHandler = std::function<void(int status)>;
+    using TimerId = uint64_t;
+
+    enum : uint32_t {
+        READABLE = 1u << 0,
+        WRITABLE = 1u << 1,
+        HANGUP   = 1u << 2,   // reported whether asked for or not
+    };
+
+    static constexpr std::chrono::milliseconds EXIT_POLL_INTERVAL{100};
+
+    static IoReactor& instance() {
+        static IoReactor reactor;
+        return reactor;
+    }
+
+    IoReactor();
+    ~IoReactor();
+
+    IoReactor(const IoReactor&) = delete;
+    IoReactor& operator=(const IoReactor&) = delete;
+
+    bool add_fd(int fd, uint32_t interest, FdHandler handler);
+    void set_interest(int fd, uint32_t interest);
+    void remove_fd(int fd);
+
+    // Calls handler with the wait status once pid exits.
+    bool watch_exit(pid_t pid, ExitHandler handler);
+    // Drops the handler but keeps reaping pid. If kill_after is given and pid
+    // is still running by then, its process group and pid get SIGKILL.
+    void forget_exit(pid_t pid, std::optional<std::chrono::milliseconds> kill_after = std::nullopt);
+
+    TimerId add_timer(Clock::duration delay, std::function<void()> fn);
+    void cancel_timer(TimerId id);
+
+    // Any thread. post() queues task for the reactor thread; call() runs it
+    // there and waits, or runs it inline when already on that thread. False
+    // when the loop has stopped and task did not run.
+    void post(std::function<void()> task);
+    bool call(const std::function<void()>& task);
+    bool in_reactor_thread() const { return std::this_thread::get_id() == thread_.get_id(); }
+
+    // Times the loop has returned from waiting, for diagnostics.
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+    size_t watched_fds() const { return fd_count_.load(std::memory_order_relaxed); }
+    bool failed() const { return failure_errno_.load() != 0; }
+    // errno of the failed epoll_wait/kevent, or 0.
+    int failure_errno() const { return failure_errno_.load(); }
+
+private:
+    struct FdEntry {
+        uint64_t token = 0;
+        uint32_t interest = 0;
+        FdHandler handler;
+    };
+
+    struct ExitWatch {
+        ExitHandler handler;
+        int pidfd = -1;           // Linux only
+        TimerId kill_timer = 0;
+    };
+
+    void run();
+    void wake();
+    bool arm_fd(int fd, const FdEntry& entry, bool added);
+    void disarm_fd(int fd, const FdEntry& entry);
+    void dispatch_fd(uint64_t token, uint32_t events);
+    void reap(pid_t pid);
+    void poll_exits();
+    int next_timeout_ms() const;
+    void run_timers();
+    void run_posted();
+    void fail(int error);
+
+    int poll_fd_ = -1;
+    int wake_fd_ = -1;            // Linux eventfd; kqueue uses EVFILT_USER
+
+    std::unordered_map<int, FdEntry> fds_;
+    std::unordered_map<uint64_t, int> tokens_;
+    uint64_t next_token_ = 1;
+    std::atomic<size_t> fd_count_{0};
+
+    std::unordered_map<pid_t, ExitWatch> exits_;
+    std::vector<pid_t> polled_exits_;
+    TimerId exit_poll_timer_ = 0;
+
+    std::map<std::pair<Clock::time_point, TimerId>, std::function<void()>> timers_;
+    std::unordered_map<TimerId, Clock::time_point> timer_deadlines_;
+    TimerId next_timer_ = 1;
+
+    std::mutex posted_mutex_;
+    std::vector<std::function<void()>> posted_;
+    bool stopping_ = false;
+
+    std::atomic<int> failure_errno_{0};    // set under posted_mutex_
+    std::atomic<uint64_t> wakeups_{0};
+    std::thread thread_;
+};
+
+}
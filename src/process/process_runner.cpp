@@ -1,17 +1,15 @@
 #include "process_runner.h"
+#include "core/telemetry.h"
 
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
-#include <poll.h>
 #include <cstring>
 #include <cerrno>
 #include <termios.h>
-#include <thread>
 #include <chrono>
-#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <fstream>
@@ -23,6 +21,8 @@
 #include <pty.h>
 #endif
 
+extern char** environ;
+
 namespace diana {
 
 namespace {
@@ -103,25 +103,136 @@ std::vector<std::string> collect_nvm_bin_paths(const std::string& home_dir) {
     return paths;
 }
 
+// The agent-friendly PATH children get: system and per-user tool
+// directories and every nvm node version ahead of the inherited PATH.
+std::string child_path() {
+    std::string new_path = "/usr/local/bin:/opt/homebrew/bin:/usr/bin:/bin:/usr/sbin:/sbin";
+    const char* home = std::getenv("HOME");
+    if (home && *home) {
+        std::string home_dir = home;
+        new_path += ":" + home_dir + "/.local/bin";
+        new_path += ":" + home_dir + "/.cargo/bin";
+        new_path += ":" + home_dir + "/.npm-global/bin";
+        new_path += ":" + home_dir + "/.volta/bin";
+        new_path += ":" + home_dir + "/.asdf/shims";
+        
+        for (const auto& nvm_bin : collect_nvm_bin_paths(home_dir)) {
+            new_path += ":" + nvm_bin;
+        }
+    }
+    const char* current_path = std::getenv("PATH");
+    if (current_path && *current_path) {
+        new_path += ":";
+        new_path += current_path;
+    }
+    return new_path;
+}
+
+// execvp's lookup, done in the parent so the child can use execve.
+std::string find_in_path(const std::string& executable, const std::string& path_list) {
+    if (executable.empty() || executable.find('/') != std::string::npos) {
+        return executable;
+    }
+    size_t start = 0;
+    while (start <= path_list.size()) {
+        size_t end = path_list.find(':', start);
+        if (end == std::string::npos) end = path_list.size();
+        std::string dir = path_list.substr(start, end - start);
+        std::string candidate = (dir.empty() ? std::string(".") : dir) + "/" + executable;
+        if (access(candidate.c_str(), X_OK) == 0) {
+            return candidate;
+        }
+        start = end + 1;
+    }
+    return executable;
 }
 
-ProcessRunner::ProcessRunner() = default;
+const char* errno_reason(int err) {
+    switch (err) {
+        case ENOENT:  return "no such file or directory";
+        case EACCES:  return "permission denied";
+        case ENOTDIR: return "not a directory";
+        case ENOEXEC: return "not an executable";
+        default:      return "error";
+    }
+}
+
+// fprintf-free, for the forked child.
+void write_child_error(const char* what, const char* subject, int err) {
+    const char* parts[] = {what, subject, ": ", errno_reason(err), "\n"};
+    for (const char* part : parts) {
+        ssize_t ignored = write(STDERR_FILENO, part, strlen(part));
+        (void)ignored;
+    }
+}
+
+}
+
+std::shared_ptr<const ExecPlan> ExecPlan::build(const std::string& executable, const std::vector<std::string>& args) {
+    auto plan = std::shared_ptr<ExecPlan>(new ExecPlan());
+    
+    std::string path_list = child_path();
+    plan->path_ = find_in_path(executable, path_list);
+    plan->argv_.push_back(executable);
+    plan->argv_.insert(plan->argv_.end(), args.begin(), args.end());
+    
+    const std::pair<const char*, std::string> overrides[] = {
+        {"PATH", path_list},
+        {"TERM", "xterm-256color"},
+        {"COLORTERM", "truecolor"},
+        {"LANG", "en_US.UTF-8"},
+    };
+    for (char** entry = environ; entry && *entry; ++entry) {
+        std::string var = *entry;
+        std::string name = var.substr(0, var.find('='));
+        bool overridden = std::any_of(std::begin(overrides), std::end(overrides),
+                                      [&name](const auto& o) { return name == o.first; });
+        if (!overridden) {
+            plan->envp_.push_back(std::move(var));
+        }
+    }
+    for (const auto& [name, value] : overrides) {
+        plan->envp_.push_back(std::string(name) + "=" + value);
+    }
+    
+    for (auto& arg : plan->argv_) {
+        plan->argv_ptrs_.push_back(arg.data());
+    }
+    plan->argv_ptrs_.push_back(nullptr);
+    for (auto& var : plan->envp_) {
+        plan->envp_ptrs_.push_back(var.data());
+    }
+    plan->envp_ptrs_.push_back(nullptr);
+    return plan;
+}
+
+const char* ExecPlan::env(const char* name) const {
+    size_t len = strlen(name);
+    for (const auto& var : envp_) {
+        if (var.size() > len && var.compare(0, len, name) == 0 && var[len] == '=') {
+            return var.c_str() + len + 1;
+        }
+    }
+    return nullptr;
+}
+
+ProcessRunner::ProcessRunner(IoReactor& reactor) : reactor_(reactor) {}
 
 ProcessRunner::~ProcessRunner() {
-    stop();
-    if (io_thread_.joinable()) {
-        io_thread_.join();
+    if (output_ring_) {
+        output_ring_->set_writer_wakeup(nullptr);
     }
+    // Also waits out any task this runner posted earlier.
+    reactor_.call([this] { detach(); });
 }
 
 bool ProcessRunner::start(const ProcessConfig& config) {
-    if (running_.load()) {
+    // Nothing would read the PTY or reap the child.
+    if (running_.load() || reactor_.failed()) {
         return false;
     }
-
-    if (io_thread_.joinable()) {
-        io_thread_.join();
-    }
+    
+    std::shared_ptr<const ExecPlan> plan = config.plan ? config.plan : ExecPlan::build(config.executable, config.args);
     
     struct winsize ws;
     ws.ws_col = static_cast<unsigned short>(config.cols);
@@ -136,89 +247,118 @@ bool ProcessRunner::start(const ProcessConfig& config) {
     }
     
     if (pid_ == 0) {
+        // Only async-signal-safe calls from here: the parent has other
+        // threads, one of which may hold the allocator lock.
         setpgid(0, 0);
         
-        if (!config.working_dir.empty()) {
-            if (chdir(config.working_dir.c_str()) != 0) {
-                fprintf(stderr, "Failed to change directory to %s: %s\n", config.working_dir.c_str(), strerror(errno));
-                _exit(127);
-            }
-        }
+        // A host such as diana-sessiond blocks and ignores signals it
+        // handles itself; the agent should not inherit that.
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, nullptr);
+        signal(SIGPIPE, SIG_DFL);
         
-        const char* current_path = std::getenv("PATH");
-        std::string new_path = "/usr/local/bin:/opt/homebrew/bin:/usr/bin:/bin:/usr/sbin:/sbin";
-        const char* home = std::getenv("HOME");
-        if (home && *home) {
-            std::string home_dir = home;
-            new_path += ":" + home_dir + "/.local/bin";
-            new_path += ":" + home_dir + "/.cargo/bin";
-            new_path += ":" + home_dir + "/.npm-global/bin";
-            new_path += ":" + home_dir + "/.volta/bin";
-            new_path += ":" + home_dir + "/.asdf/shims";
-            
-            for (const auto& nvm_bin : collect_nvm_bin_paths(home_dir)) {
-                new_path += ":" + nvm_bin;
-            }
+        if (!config.working_dir.empty() && chdir(config.working_dir.c_str()) != 0) {
+            write_child_error("Failed to change directory to ", config.working_dir.c_str(), errno);
+            _exit(127);
         }
-        if (current_path && *current_path) {
-            new_path += ":";
-            new_path += current_path;
-        }
-        setenv("PATH", new_path.c_str(), 1);
-        setenv("TERM", "xterm-256color", 1);
-        setenv("COLORTERM", "truecolor", 1);
-        setenv("LANG", "en_US.UTF-8", 1);
-        
-        std::vector<char*> argv;
-        argv.push_back(const_cast<char*>(config.executable.c_str()));
-        for (const auto& arg : config.args) {
-            argv.push_back(const_cast<char*>(arg.c_str()));
-        }
-        argv.push_back(nullptr);
         
-        execvp(config.executable.c_str(), argv.data());
+        execve(plan->path().c_str(), plan->argv(), plan->envp());
         
-        fprintf(stderr, "Failed to execute '%s': %s\n", config.executable.c_str(), strerror(errno));
+        write_child_error("Failed to execute ", plan->path().c_str(), errno);
         _exit(127);
     }
     
     fcntl(pty_fd_, F_SETFL, fcntl(pty_fd_, F_GETFL) | O_NONBLOCK);
     
+    read_size_ = MIN_READ_SIZE;
+    if (!output_ring_) {
+        read_buffer_.resize(MAX_READ_SIZE);
+    }
+    
     running_.store(true);
-    stop_requested_.store(false);
     
-    io_thread_ = std::thread(&ProcessRunner::io_thread_func, this);
+    if (output_ring_) {
+        output_ring_->set_writer_wakeup([this] {
+            reactor_.post([this] { resume_reading(); });
+        });
+    }
+    bool watched = reactor_.call([this] {
+        stop_requested_ = false;
+        exited_ = false;
+        pty_closed_ = false;
+        reading_paused_ = false;
+        output_held_ = false;
+        exit_code_ = -1;
+        update_interest();
+        reactor_.watch_exit(pid_, [this](int status) { on_child_exit(status); });
+    });
+    if (!watched) {
+        if (output_ring_) {
+            output_ring_->set_writer_wakeup(nullptr);
+        }
+        ::kill(pid_, SIGKILL);
+        ::kill(-pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+        pid_ = -1;
+        close_pty();
+        running_.store(false);
+        return false;
+    }
     
     return true;
 }
 
 void ProcessRunner::stop() {
     if (!running_.load()) return;
-    
-    stop_requested_.store(true);
-    
-    if (pid_ > 0) {
-        ::kill(-pid_, SIGTERM);
-    }
+    reactor_.post([this] { request_stop(SIGTERM); });
 }
 
 void ProcessRunner::kill() {
     if (!running_.load()) return;
-    
-    stop_requested_.store(true);
-    
-    if (pid_ > 0) {
-        ::kill(pid_, SIGKILL);
-    }
+    reactor_.post([this] { request_stop(SIGKILL); });
 }
 
 bool ProcessRunner::write_stdin(const std::string& data) {
+    std::lock_guard<std::mutex> lock(input_mutex_);
     if (!running_.load() || pty_fd_ < 0) {
         return false;
     }
+    size_t pending = pending_input_.load(std::memory_order_relaxed);
+    if (pending + data.size() > MAX_PENDING_INPUT) {
+        return false;
+    }
     
-    ssize_t written = write(pty_fd_, data.c_str(), data.size());
-    return written == static_cast<ssize_t>(data.size());
+    size_t offset = 0;
+    if (pending == 0) {
+        // Nothing queued, so ordering allows writing straight away; keystrokes
+        // then never wait for the reactor.
+        while (offset < data.size()) {
+            ssize_t n = write(pty_fd_, data.data() + offset, data.size() - offset);
+            if (n > 0) {
+                offset += static_cast<size_t>(n);
+                Telemetry::instance().add_pty_written(static_cast<size_t>(n));
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                return false;
+            }
+        }
+        if (offset == data.size()) {
+            return true;
+        }
+    }
+    
+    for (size_t pos = offset; pos < data.size(); pos += INPUT_CHUNK) {
+        input_queue_.emplace_back(data, pos, INPUT_CHUNK);
+    }
+    pending_input_.store(pending + data.size() - offset, std::memory_order_relaxed);
+    if (pending == 0) {
+        reactor_.post([this] { update_interest(); });
+    }
+    return true;
 }
 
 void ProcessRunner::resize(int rows, int cols) {
@@ -233,111 +373,360 @@ void ProcessRunner::resize(int rows, int cols) {
     ioctl(pty_fd_, TIOCSWINSZ, &ws);
 }
 
-void ProcessRunner::io_thread_func() {
-    constexpr size_t BUFFER_SIZE = 4096;
-    char buffer[BUFFER_SIZE];
-    
-    struct pollfd fds[1];
-    fds[0].fd = pty_fd_;
-    fds[0].events = POLLIN;
-    
-    bool exit_reported = false;
-    int exit_code = -1;
-    
-    while (!stop_requested_.load()) {
-        int ret = poll(fds, 1, 100);
-        
-        if (ret < 0) {
-            if (errno == EINTR) continue;
-            break;
+bool ProcessRunner::hand_over(std::shared_ptr<ByteRing> ring, ExitCallback exit_callback) {
+    bool handed_over = false;
+    reactor_.call([&] {
+        if (!running_.load() || stop_requested_) {
+            return;
         }
-        
-        bool hangup = ret > 0 && (fds[0].revents & POLLHUP);
-        if (ret > 0 && (fds[0].revents & (POLLIN | POLLHUP))) {
+        if (output_ring_) {
+            output_ring_->set_writer_wakeup(nullptr);
+            // Whatever does not fit is dropped; the new ring is expected to
+            // be the larger one.
             while (true) {
-                ssize_t n = read(pty_fd_, buffer, BUFFER_SIZE - 1);
-                if (n > 0) {
-                    buffer[n] = '\0';
-                    if (output_callback_) {
-                        output_callback_(std::string(buffer, n), false);
-                    }
-                    continue;
-                }
+                ConstByteSpan from = output_ring_->read_span();
+                ByteSpan to = ring->write_span();
+                size_t n = std::min(from.size, to.size);
                 if (n == 0) {
-                    hangup = true;
-                    break;
-                }
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
                     break;
                 }
-                hangup = true;
-                break;
+                std::memcpy(to.data, from.data, n);
+                ring->commit_write(n);
+                output_ring_->commit_read(n);
+            }
+        }
+        output_ring_ = std::move(ring);
+        output_ring_->set_writer_wakeup([this] {
+            reactor_.post([this] { resume_reading(); });
+        });
+        exit_callback_ = std::move(exit_callback);
+        // Reading paused on the old ring; the next read checks the new one.
+        resume_reading();
+        handed_over = true;
+    });
+    return handed_over;
+}
+
+void ProcessRunner::set_recorder(std::shared_ptr<SessionRecorder> recorder) {
+    std::lock_guard<std::mutex> lock(recorder_mutex_);
+    recorder_ = std::move(recorder);
+}
+
+// Reads until the PTY would block, the ring passes its high-water mark, output
+// is held, or EOF. Returns false on EOF or a read error. The read size grows
+// while reads come back full and shrinks again when output turns interactive.
+bool ProcessRunner::read_available() {
+    while (true) {
+        char* dst = nullptr;
+        size_t want = read_size_;
+        if (output_ring_) {
+            if (output_ring_->above_high_water()) {
+                return true;
+            }
+            ByteSpan span = output_ring_->write_span();
+            if (span.size == 0) {
+                return true;
+            }
+            dst = span.data;
+            want = std::min(want, span.size);
+        } else {
+            if (output_held_) {
+                return true;
             }
+            dst = read_buffer_.data();
+            want = std::min(want, read_buffer_.size());
         }
         
-        int status;
-        pid_t result = waitpid(pid_, &status, WNOHANG);
-        if (result == pid_) {
-            exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-            pid_ = -1;
+        ssize_t n = read(pty_fd_, dst, want);
+        if (n > 0) {
+            size_t got = static_cast<size_t>(n);
+            Telemetry::instance().add_pty_read(got);
+            {
+                std::lock_guard<std::mutex> lock(recorder_mutex_);
+                if (recorder_) {
+                    recorder_->record_output(dst, got);
+                }
+            }
+            if (output_ring_) {
+                output_ring_->commit_write(got);
+            } else if (output_callback_) {
+                output_callback_(std::string(dst, got), false);
+            }
             
-            for (int drain_attempts = 0; drain_attempts < 50; ++drain_attempts) {
-                ssize_t n = read(pty_fd_, buffer, BUFFER_SIZE - 1);
-                if (n > 0) {
-                    buffer[n] = '\0';
-                    if (output_callback_) {
-                        output_callback_(std::string(buffer, n), false);
-                    }
-                } else if (n == 0) {
-                    break;
-                } else {
-                    if (errno != EAGAIN && errno != EWOULDBLOCK) {
-                        break;
-                    }
+            if (got == read_size_ && read_size_ < MAX_READ_SIZE) {
+                read_size_ *= 2;
+            } else if (got < read_size_ / 4 && read_size_ > MIN_READ_SIZE) {
+                read_size_ /= 2;
+            }
+            continue;
+        }
+        if (n == 0) {
+            return false;
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+// Writes queued input until the PTY would block. Input that can no longer be
+// delivered (the PTY hung up) is dropped.
+void ProcessRunner::flush_input() {
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        while (!input_queue_.empty() && pty_fd_ >= 0) {
+            const std::string& chunk = input_queue_.front();
+            ssize_t n = write(pty_fd_, chunk.data() + input_offset_, chunk.size() - input_offset_);
+            if (n > 0) {
+                input_offset_ += static_cast<size_t>(n);
+                Telemetry::instance().add_pty_written(static_cast<size_t>(n));
+                pending_input_.fetch_sub(static_cast<size_t>(n), std::memory_order_relaxed);
+                if (input_offset_ == chunk.size()) {
+                    input_queue_.pop_front();
+                    input_offset_ = 0;
                 }
-                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) {
+                continue;
             }
-            break;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            drop_input_locked();
         }
-        
-        if (hangup) {
-            break;
+    }
+    update_interest();
+}
+
+void ProcessRunner::drop_input_locked() {
+    input_queue_.clear();
+    input_offset_ = 0;
+    pending_input_.store(0, std::memory_order_relaxed);
+}
+
+void ProcessRunner::on_pty_event(uint32_t events) {
+    if (events & IoReactor::WRITABLE) {
+        flush_input();
+    }
+    // With reading paused a hangup waits until output can be read again.
+    if (!(interest_ & IoReactor::READABLE) || !(events & (IoReactor::READABLE | IoReactor::HANGUP))) {
+        return;
+    }
+    if (!read_available()) {
+        on_pty_closed();
+        return;
+    }
+    // Backpressure: while the consumer is behind, leave the data in the PTY
+    // so the child blocks on write instead of the ring growing stale.
+    if (output_ring_ && output_ring_->above_high_water()) {
+        pause_reading();
+        return;
+    }
+    // Held output stays in the PTY; the hangup is seen again once released.
+    if (output_held_) {
+        return;
+    }
+    if (events & IoReactor::HANGUP) {
+        on_pty_closed();
+    }
+}
+
+// Keeps the PTY registered for what the runner is waiting on: output unless
+// reading is paused or the PTY has closed, and writability while input is
+// queued.
+void ProcessRunner::update_interest() {
+    uint32_t wanted = 0;
+    if (pty_fd_ >= 0) {
+        if (!pty_closed_ && !reading_paused_ && !output_held_) {
+            wanted |= IoReactor::READABLE;
+        }
+        if (pending_input_.load(std::memory_order_relaxed) > 0) {
+            wanted |= IoReactor::WRITABLE;
         }
     }
-    
-    if (pid_ > 0 && stop_requested_.load()) {
-        close_pty();
-        
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        
-        int status;
-        pid_t r = waitpid(pid_, &status, WNOHANG);
-        if (r == pid_) {
-            exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-            pid_ = -1;
+    if (wanted == interest_) {
+        return;
+    }
+    if (wanted == 0) {
+        reactor_.remove_fd(pty_fd_);
+    } else if (interest_ == 0) {
+        if (!reactor_.add_fd(pty_fd_, wanted, [this](uint32_t events) { on_pty_event(events); })) {
+            wanted = 0;
+        }
+    } else {
+        reactor_.set_interest(pty_fd_, wanted);
+    }
+    interest_ = wanted;
+}
+
+void ProcessRunner::pause_reading() {
+    reading_paused_ = true;
+    update_interest();
+    if (!output_ring_->request_drain_wakeup()) {
+        // Drained while we were deciding to pause.
+        resume_reading();
+    }
+}
+
+void ProcessRunner::resume_reading() {
+    if (!reading_paused_) {
+        return;
+    }
+    reading_paused_ = false;
+    update_interest();
+}
+
+void ProcessRunner::hold_output(bool hold) {
+    if (hold == output_held_) {
+        return;
+    }
+    output_held_ = hold;
+    update_interest();
+}
+
+void ProcessRunner::on_pty_closed() {
+    pty_closed_ = true;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        drop_input_locked();
+    }
+    update_interest();
+    if (exited_) {
+        finish();
+    } else {
+        // Usually the exit is a moment behind; don't wait on a child that
+        // closed its terminal but keeps running.
+        arm_grace_timer();
+    }
+}
+
+void ProcessRunner::on_child_exit(int status) {
+    exited_ = true;
+    pid_ = -1;
+    exit_code_ = status != -1 && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    if (stop_requested_ || pty_closed_) {
+        finish();
+        return;
+    }
+    // Output written just before the exit may still be in the PTY, or
+    // come from a grandchild that inherited it.
+    if (interest_ & IoReactor::READABLE) {
+        on_pty_event(IoReactor::READABLE);
+    }
+    if (running_.load()) {
+        arm_grace_timer();
+    }
+}
+
+void ProcessRunner::arm_grace_timer() {
+    if (grace_timer_ != 0) {
+        return;
+    }
+    grace_timer_ = reactor_.add_timer(EXIT_GRACE, [this] {
+        grace_timer_ = 0;
+        if (reading_paused_ || output_held_) {
+            // Waiting on the consumer does not count against the grace period.
+            arm_grace_timer();
+            return;
+        }
+        finish();
+    });
+}
+
+void ProcessRunner::request_stop(int signal) {
+    if (!running_.load() || stop_requested_) {
+        return;
+    }
+    stop_requested_ = true;
+    if (pid_ > 0) {
+        if (signal == SIGKILL) {
+            ::kill(pid_, SIGKILL);
         } else {
+            ::kill(-pid_, signal);
+        }
+    }
+    pty_closed_ = true;
+    close_pty();
+    if (exited_) {
+        finish();
+        return;
+    }
+    cancel_timers();
+    kill_timer_ = reactor_.add_timer(STOP_KILL_DELAY, [this] {
+        // pid_ is only cleared once reaped, so it cannot have been reused.
+        if (pid_ > 0) {
             ::kill(pid_, SIGKILL);
             ::kill(-pid_, SIGKILL);
-            
-            std::this_thread::sleep_for(std::chrono::milliseconds(50));
-            r = waitpid(pid_, &status, WNOHANG);
-            if (r == pid_) {
-                exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
-            }
-            pid_ = -1;
         }
+        kill_timer_ = reactor_.add_timer(STOP_KILL_DELAY, [this] {
+            kill_timer_ = 0;
+            finish();
+        });
+    });
+}
+
+// Reports the exit once and releases the PTY. A child that has not been
+// reaped yet is left to the reactor.
+void ProcessRunner::finish() {
+    if (!running_.load()) {
+        return;
     }
-    
-    if (exit_callback_ && !exit_reported) {
-        exit_reported = true;
-        exit_callback_(exit_code);
+    cancel_timers();
+    reading_paused_ = false;
+    output_held_ = false;
+    if (output_ring_) {
+        output_ring_->set_writer_wakeup(nullptr);
     }
+    if (pid_ > 0) {
+        reactor_.forget_exit(pid_);
+        pid_ = -1;
+    }
+    close_pty();
+    running_.store(false);
     
+    // Copied and called last, so the callback may start() the next command.
+    ExitCallback callback = exit_callback_;
+    if (callback) {
+        callback(exit_code_);
+    }
+}
+
+// Like finish(), for a runner going away: no callback, and a child that is
+// still running gets SIGTERM and, if it ignores that, SIGKILL.
+void ProcessRunner::detach() {
+    if (!running_.load()) {
+        return;
+    }
+    cancel_timers();
     close_pty();
+    if (pid_ > 0) {
+        ::kill(-pid_, SIGTERM);
+        reactor_.forget_exit(pid_, STOP_KILL_DELAY);
+        pid_ = -1;
+    }
     running_.store(false);
 }
 
+void ProcessRunner::cancel_timers() {
+    if (grace_timer_ != 0) {
+        reactor_.cancel_timer(grace_timer_);
+        grace_timer_ = 0;
+    }
+    if (kill_timer_ != 0) {
+        reactor_.cancel_timer(kill_timer_);
+        kill_timer_ = 0;
+    }
+}
+
 void ProcessRunner::close_pty() {
+    if (interest_ != 0) {
+        reactor_.remove_fd(pty_fd_);
+        interest_ = 0;
+    }
+    std::lock_guard<std::mutex> lock(input_mutex_);
+    drop_input_locked();
     if (pty_fd_ >= 0) { 
         close(pty_fd_); 
         pty_fd_ = -1; 
@@ -1,28 +1,70 @@
 #pragma once
 
+#include "core/byte_ring.h"
+#include "process/io_reactor.h"
+#include "process/session_recorder.h"
 #include <string>
 #include <vector>
 #include <functional>
 #include <atomic>
-#include <thread>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
 #include <sys/types.h>
 
 namespace diana {
 
+// What the child execs, prepared in the parent. Between fork and exec a
+// child of a multithreaded process may only make async-signal-safe calls, so
+// it gets finished argv/envp arrays instead of building them itself. A plan
+// depends only on the executable, args and the parent's environment, so it
+// can be built once and reused for every launch.
+class ExecPlan {
+public:
+    // Builds the agent environment (the parent's, with the extended PATH and
+    // TERM, COLORTERM and LANG set) and resolves executable against that PATH
+    // the way execvp would.
+    static std::shared_ptr<const ExecPlan> build(const std::string& executable, const std::vector<std::string>& args);
+    
+    ExecPlan(const ExecPlan&) = delete;
+    ExecPlan& operator=(const ExecPlan&) = delete;
+    
+    const std::string& path() const { return path_; }
+    char* const* argv() const { return argv_ptrs_.data(); }
+    char* const* envp() const { return envp_ptrs_.data(); }
+    // Value of an environment variable in the plan, or nullptr.
+    const char* env(const char* name) const;
+
+private:
+    ExecPlan() = default;
+    
+    std::string path_;
+    std::vector<std::string> argv_;
+    std::vector<std::string> envp_;
+    std::vector<char*> argv_ptrs_;
+    std::vector<char*> envp_ptrs_;
+};
+
 struct ProcessConfig {
     std::string executable;
     std::vector<std::string> args;
     std::string working_dir;
     int rows = 24;
     int cols = 80;
+    // Built from executable and args by start() when not set.
+    std::shared_ptr<const ExecPlan> plan;
 };
 
 using OutputCallback = std::function<void(const std::string& data, bool is_stderr)>;
 using ExitCallback = std::function<void(int exit_code)>;
 
+// Runs a child on a PTY. Reads, exit detection and both callbacks happen on
+// the shared IoReactor thread; the exit callback is not called for a child
+// that is still running when the runner is destroyed.
 class ProcessRunner {
 public:
-    ProcessRunner();
+    explicit ProcessRunner(IoReactor& reactor = IoReactor::instance());
     ~ProcessRunner();
     
     ProcessRunner(const ProcessRunner&) = delete;
@@ -32,28 +74,102 @@ public:
     void stop();
     void kill();
     
+    // Queues data for the child, in order, and writes it as fast as the PTY
+    // takes it. Returns false when the runner has stopped or more than
+    // MAX_PENDING_INPUT bytes would be waiting; nothing is queued then.
     bool write_stdin(const std::string& data);
+    // Input accepted by write_stdin() that the PTY has not taken yet.
+    size_t pending_input() const { return pending_input_.load(std::memory_order_relaxed); }
     void resize(int rows, int cols);
     
     bool is_running() const { return running_.load(); }
-    pid_t pid() const { return pid_; }
+    // -1 once the child is reaped. Safe to call from any thread.
+    pid_t pid() const { return pid_.load(); }
     
     void set_output_callback(OutputCallback cb) { output_callback_ = std::move(cb); }
     void set_exit_callback(ExitCallback cb) { exit_callback_ = std::move(cb); }
+    
+    // Leaves output in the PTY while held, so the child blocks once the PTY
+    // buffer is full; for an output callback whose consumer is behind.
+    // Reactor thread only.
+    void hold_output(bool hold);
+    
+    // When set, PTY output is read straight into the ring instead of being
+    // passed to the output callback. Must be set before start().
+    void set_output_ring(std::shared_ptr<ByteRing> ring) { output_ring_ = std::move(ring); }
+    
+    // Moves a running child to a new consumer: output still unread in the
+    // current ring is copied into ring, later output goes there, and
+    // exit_callback replaces the exit callback. Returns false when the child
+    // has already finished or is being stopped.
+    bool hand_over(std::shared_ptr<ByteRing> ring, ExitCallback exit_callback);
+    
+    // Everything read from the PTY is also appended to the recorder while
+    // one is set. May be changed at any time; pass nullptr to stop.
+    void set_recorder(std::shared_ptr<SessionRecorder> recorder);
+    
+    size_t read_size() const { return read_size_; }
+
+    static constexpr size_t MIN_READ_SIZE = 4096;
+    static constexpr size_t MAX_READ_SIZE = 64 * 1024;
+    static constexpr size_t INPUT_CHUNK = 64 * 1024;
+    static constexpr size_t MAX_PENDING_INPUT = 64 * 1024 * 1024;
+    // How long output may keep arriving after the child exits (or the PTY
+    // closes before the exit is seen).
+    static constexpr std::chrono::milliseconds EXIT_GRACE{500};
+    // Between SIGTERM and SIGKILL, and between SIGKILL and giving up, on stop().
+    static constexpr std::chrono::milliseconds STOP_KILL_DELAY{50};
 
 private:
-    void io_thread_func();
+    // Reactor thread only, from here to detach().
+    void on_pty_event(uint32_t events);
+    bool read_available();
+    void flush_input();
+    void drop_input_locked();
+    void update_interest();
+    void pause_reading();
+    void resume_reading();
+    void on_pty_closed();
+    void on_child_exit(int status);
+    void arm_grace_timer();
+    void request_stop(int signal);
+    void finish();
+    void detach();
+    void cancel_timers();
     void close_pty();
     
-    pid_t pid_ = -1;
+    IoReactor& reactor_;
+    // Written on the reactor thread; read by samplers on others.
+    std::atomic<pid_t> pid_{-1};
     int pty_fd_ = -1;
     
     std::atomic<bool> running_{false};
-    std::atomic<bool> stop_requested_{false};
-    std::thread io_thread_;
+    
+    // Owned by the reactor thread while running.
+    bool stop_requested_ = false;
+    bool exited_ = false;
+    bool pty_closed_ = false;
+    bool reading_paused_ = false;
+    bool output_held_ = false;
+    uint32_t interest_ = 0;
+    int exit_code_ = -1;
+    IoReactor::TimerId grace_timer_ = 0;
+    IoReactor::TimerId kill_timer_ = 0;
     
     OutputCallback output_callback_;
     ExitCallback exit_callback_;
+    
+    std::shared_ptr<ByteRing> output_ring_;
+    std::mutex recorder_mutex_;
+    std::shared_ptr<SessionRecorder> recorder_;
+    std::vector<char> read_buffer_;
+    size_t read_size_ = MIN_READ_SIZE;
+    
+    // Guards pty_fd_ against close while another thread writes to it.
+    std::mutex input_mutex_;
+    std::deque<std::string> input_queue_;
+    size_t input_offset_ = 0;
+    std::atomic<size_t> pending_input_{0};
 };
 
 }
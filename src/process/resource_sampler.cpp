@@ -0,0 +1,342 @@
+#include "resource_sampler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <libproc.h>
+#include <mach/mach_time.h>
+#include <sys/resource.h>
+#else
+#include <dirent.h>
+#endif
+
+namespace diana {
+
+namespace {
+
+#ifndef __APPLE__
+
+// Reads a small /proc file into buffer without allocating. Returns the
+// length, or -1.
+ssize_t read_proc_file(const char* path, std::vector<char>& buffer) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    ssize_t total = 0;
+    while (total < static_cast<ssize_t>(buffer.size())) {
+        ssize_t n = read(fd, buffer.data() + total, buffer.size() - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    close(fd);
+    return total;
+}
+
+uint64_t parse_u64(const char*& p, const char* end) {
+    while (p < end && *p == ' ') ++p;
+    uint64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+    return value;
+}
+
+void skip_fields(const char*& p, const char* end, int count) {
+    for (int i = 0; i < count; ++i) {
+        while (p < end && *p == ' ') ++p;
+        while (p < end && *p != ' ') ++p;
+    }
+}
+
+uint64_t io_field(std::string_view io, std::string_view name) {
+    size_t pos = io.find(name);
+    if (pos == std::string_view::npos) {
+        return 0;
+    }
+    const char* p = io.data() + pos + name.size();
+    return parse_u64(p, io.data() + io.size());
+}
+
+#endif
+
+}
+
+ResourceSampler::ResourceSampler(std::chrono::milliseconds interval)
+    : interval_(interval)
+    , read_buffer_(4096)
+    , pid_buffer_(256)
+{
+    thread_ = std::thread([this] { run(); });
+}
+
+ResourceSampler::~ResourceSampler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+#ifndef __APPLE__
+    if (proc_dir_) {
+        closedir(static_cast<DIR*>(proc_dir_));
+    }
+#endif
+}
+
+void ResourceSampler::set_interval(std::chrono::milliseconds interval) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        interval_ = std::max(interval, std::chrono::milliseconds(100));
+    }
+    cv_.notify_all();
+}
+
+std::chrono::milliseconds ResourceSampler::interval() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return interval_;
+}
+
+void ResourceSampler::track(uint32_t session_id, pid_t pgid) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Tracked& tracked = tracked_[session_id];
+        if (tracked.pgid != pgid) {
+            tracked = Tracked{};
+            tracked.pgid = pgid;
+        }
+    }
+    cv_.notify_all();
+}
+
+void ResourceSampler::untrack(uint32_t session_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracked_.erase(session_id);
+}
+
+std::optional<ResourceUsage> ResourceSampler::latest(uint32_t session_id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tracked_.find(session_id);
+    if (it == tracked_.end() || it->second.count == 0) {
+        return std::nullopt;
+    }
+    const Tracked& tracked = it->second;
+    return tracked.history[(tracked.head + HISTORY - 1) % HISTORY];
+}
+
+std::vector<ResourceUsage> ResourceSampler::history(uint32_t session_id) const {
+    std::vector<ResourceUsage> out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = tracked_.find(session_id);
+    if (it == tracked_.end()) {
+        return out;
+    }
+    const Tracked& tracked = it->second;
+    out.reserve(tracked.count);
+    size_t start = (tracked.head + HISTORY - tracked.count) % HISTORY;
+    for (size_t i = 0; i < tracked.count; ++i) {
+        out.push_back(tracked.history[(start + i) % HISTORY]);
+    }
+    return out;
+}
+
+void ResourceSampler::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [this] { return stopping_ || !tracked_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        lock.unlock();
+        sample_now();
+        lock.lock();
+        // A changed interval takes effect at once.
+        auto interval = interval_;
+        cv_.wait_for(lock, interval, [&] { return stopping_ || interval_ != interval; });
+        if (stopping_) {
+            return;
+        }
+    }
+}
+
+void ResourceSampler::sample_now() {
+    std::lock_guard<std::mutex> scan_lock(scan_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = last_sample_ == std::chrono::steady_clock::time_point{}
+        ? 0.0
+        : std::chrono::duration<double>(now - last_sample_).count();
+    last_sample_ = now;
+
+    groups_.clear();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& [id, tracked] : tracked_) {
+            GroupTotals group;
+            group.session_id = id;
+            group.pgid = tracked.pgid;
+            groups_.push_back(group);
+        }
+    }
+    ++generation_;
+    if (!groups_.empty()) {
+        scan_processes();
+    }
+    for (auto it = counters_.begin(); it != counters_.end();) {
+        if (it->second.generation != generation_) {
+            it = counters_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const GroupTotals& group : groups_) {
+        auto it = tracked_.find(group.session_id);
+        if (it == tracked_.end() || it->second.pgid != group.pgid) {
+            continue;
+        }
+        ResourceUsage usage;
+        usage.rss_bytes = group.rss_bytes;
+        usage.processes = group.processes;
+        if (elapsed > 0.0) {
+            usage.cpu_percent = static_cast<float>(group.cpu_ns / 1e9 / elapsed * 100.0);
+            usage.read_bytes_per_sec = static_cast<float>(group.read_bytes / elapsed);
+            usage.write_bytes_per_sec = static_cast<float>(group.write_bytes / elapsed);
+        }
+        Tracked& tracked = it->second;
+        tracked.history[tracked.head] = usage;
+        tracked.head = (tracked.head + 1) % HISTORY;
+        tracked.count = std::min(tracked.count + 1, HISTORY);
+    }
+    samples_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Adds what the process used since the previous sample to its group. A
+// process seen for the first time only sets the baseline.
+void ResourceSampler::add_process(GroupTotals& group, pid_t pid, uint64_t cpu_ns, uint64_t rss_bytes,
+                                  uint64_t read_bytes, uint64_t write_bytes) {
+    auto [it, inserted] = counters_.try_emplace(pid);
+    ProcCounters& previous = it->second;
+    if (!inserted) {
+        // Guards against a pid reused between samples.
+        group.cpu_ns += cpu_ns >= previous.cpu_ns ? cpu_ns - previous.cpu_ns : 0;
+        group.read_bytes += read_bytes >= previous.read_bytes ? read_bytes - previous.read_bytes : 0;
+        group.write_bytes += write_bytes >= previous.write_bytes ? write_bytes - previous.write_bytes : 0;
+    }
+    previous.cpu_ns = cpu_ns;
+    previous.read_bytes = read_bytes;
+    previous.write_bytes = write_bytes;
+    previous.generation = generation_;
+    group.rss_bytes += rss_bytes;
+    ++group.processes;
+}
+
+#ifdef __APPLE__
+
+void ResourceSampler::scan_processes() {
+    static const mach_timebase_info_data_t timebase = [] {
+        mach_timebase_info_data_t info{};
+        mach_timebase_info(&info);
+        return info;
+    }();
+    for (GroupTotals& group : groups_) {
+        int count = 0;
+        while (true) {
+            int bytes = proc_listpgrppids(group.pgid, pid_buffer_.data(),
+                                          static_cast<int>(pid_buffer_.size() * sizeof(int)));
+            count = bytes > 0 ? bytes / static_cast<int>(sizeof(int)) : 0;
+            if (count < static_cast<int>(pid_buffer_.size())) {
+                break;
+            }
+            pid_buffer_.resize(pid_buffer_.size() * 2);
+        }
+        for (int i = 0; i < count; ++i) {
+            pid_t pid = pid_buffer_[i];
+            rusage_info_v2 info{};
+            if (pid <= 0 || proc_pid_rusage(pid, RUSAGE_INFO_V2, reinterpret_cast<rusage_info_t*>(&info)) != 0) {
+                continue;
+            }
+            uint64_t ticks = info.ri_user_time + info.ri_system_time;
+            uint64_t cpu_ns = ticks * timebase.numer / timebase.denom;
+            add_process(group, pid, cpu_ns, info.ri_resident_size,
+                        info.ri_diskio_bytesread, info.ri_diskio_byteswritten);
+        }
+    }
+}
+
+#else
+
+// One pass over /proc for all groups. Only the pgrp field is parsed for
+// processes outside them.
+void ResourceSampler::scan_processes() {
+    static const uint64_t ns_per_tick = 1000000000ull / static_cast<uint64_t>(sysconf(_SC_CLK_TCK));
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+
+    DIR* dir = static_cast<DIR*>(proc_dir_);
+    if (dir) {
+        rewinddir(dir);
+    } else {
+        dir = opendir("/proc");
+        proc_dir_ = dir;
+        if (!dir) {
+            return;
+        }
+    }
+
+    char path[64];
+    while (dirent* entry = readdir(dir)) {
+        const char* name = entry->d_name;
+        if (name[0] < '1' || name[0] > '9') {
+            continue;
+        }
+        pid_t pid = static_cast<pid_t>(std::strtol(name, nullptr, 10));
+        std::snprintf(path, sizeof(path), "/proc/%d/stat", static_cast<int>(pid));
+        ssize_t len = read_proc_file(path, read_buffer_);
+        if (len <= 0) {
+            continue;
+        }
+        const char* end = read_buffer_.data() + len;
+        // comm may hold spaces and parentheses; the fields resume after the
+        // last ')'.
+        const char* p = end;
+        while (p > read_buffer_.data() && p[-1] != ')') --p;
+        if (p == read_buffer_.data()) {
+            continue;
+        }
+        skip_fields(p, end, 2);                  // state, ppid
+        pid_t pgrp = static_cast<pid_t>(parse_u64(p, end));
+        auto group = std::find_if(groups_.begin(), groups_.end(),
+                                  [pgrp](const GroupTotals& g) { return g.pgid == pgrp; });
+        if (group == groups_.end()) {
+            continue;
+        }
+        skip_fields(p, end, 8);                  // session .. cmajflt
+        uint64_t ticks = parse_u64(p, end);      // utime
+        ticks += parse_u64(p, end);              // stime
+        skip_fields(p, end, 8);                  // cutime .. vsize
+        uint64_t rss_pages = parse_u64(p, end);
+
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        std::snprintf(path, sizeof(path), "/proc/%d/io", static_cast<int>(pid));
+        ssize_t io_len = read_proc_file(path, read_buffer_);
+        if (io_len > 0) {
+            std::string_view io(read_buffer_.data(), static_cast<size_t>(io_len));
+            read_bytes = io_field(io, "\nread_bytes:");
+            write_bytes = io_field(io, "\nwrite_bytes:");
+        }
+        add_process(*group, pid, ticks * ns_per_tick, rss_pages * page_size, read_bytes, write_bytes);
+    }
+}
+
+#endif
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+namespace diana {
+
+struct ResourceUsage {
+    float cpu_percent = 0.0f;           // of one core, so may pass 100
+    uint64_t rss_bytes = 0;
+    float read_bytes_per_sec = 0.0f;    // storage IO, not PTY traffic
+    float write_bytes_per_sec = 0.0f;
+    uint32_t processes = 0;
+};
+
+// Samples what each session's process group uses: the agent plus the tools,
+// test runners and language servers it started. Every interval one thread
+// walks /proc (Linux) or asks libproc for the group's members (macOS) and
+// turns the cumulative counters of each process into rates against the
+// previous sample. A process that moved to its own group is not counted.
+//
+// A sample reuses its buffers; only processes not seen before cost an
+// allocation. With nothing tracked the thread sleeps until track().
+class ResourceSampler {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_INTERVAL{1000};
+    static constexpr size_t HISTORY = 120;
+
+    explicit ResourceSampler(std::chrono::milliseconds interval = DEFAULT_INTERVAL);
+    ~ResourceSampler();
+
+    ResourceSampler(const ResourceSampler&) = delete;
+    ResourceSampler& operator=(const ResourceSampler&) = delete;
+
+    void set_interval(std::chrono::milliseconds interval);
+    std::chrono::milliseconds interval() const;
+
+    // Starts (or moves) sampling for a session whose processes are in pgid.
+    void track(uint32_t session_id, pid_t pgid);
+    void untrack(uint32_t session_id);
+
+    std::optional<ResourceUsage> latest(uint32_t session_id) const;
+    // Up to HISTORY samples, oldest first.
+    std::vector<ResourceUsage> history(uint32_t session_id) const;
+
+    // Takes a sample on the calling thread; the sampling thread calls it too.
+    void sample_now();
+    uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+
+private:
+    struct Tracked {
+        pid_t pgid = -1;
+        std::array<ResourceUsage, HISTORY> history{};
+        size_t head = 0;
+        size_t count = 0;
+    };
+
+    // Cumulative counters of one process at the previous sample.
+    struct ProcCounters {
+        uint64_t cpu_ns = 0;
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        uint64_t generation = 0;
+    };
+
+    // One group's totals while a sample is being taken.
+    struct GroupTotals {
+        uint32_t session_id = 0;
+        pid_t pgid = -1;
+        uint64_t cpu_ns = 0;
+        uint64_t read_bytes = 0;
+        uint64_t write_bytes = 0;
+        uint64_t rss_bytes = 0;
+        uint32_t processes = 0;
+    };
+
+    void run();
+    void scan_processes();
+    void add_process(GroupTotals& group, pid_t pid, uint64_t cpu_ns, uint64_t rss_bytes,
+                     uint64_t read_bytes, uint64_t write_bytes);
+
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::unordered_map<uint32_t, Tracked> tracked_;
+    std::chrono::milliseconds interval_;
+    bool stopping_ = false;
+
+    // Sampling state, under scan_mutex_.
+    std::mutex scan_mutex_;
+    std::vector<GroupTotals> groups_;
+    std::unordered_map<pid_t, ProcCounters> counters_;
+    std::vector<char> read_buffer_;
+    std::vector<int> pid_buffer_;
+    void* proc_dir_ = nullptr;          // DIR* kept open across samples (Linux)
+    uint64_t generation_ = 0;
+    std::chrono::steady_clock::time_point last_sample_{};
+
+    std::atomic<uint64_t> samples_{0};
+    std::thread thread_;
+};
+
+}
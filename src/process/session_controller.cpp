@@ -1,258 +1,13 @@
 #include "session_controller.h"
-#include <algorithm>
-#include <cctype>
-#include <cstdio>
+#include "core/redraw_scheduler.h"
 #include <cstdlib>
 #include <cstring>
-#include <filesystem>
-#include <fstream>
-#include <sstream>
-#include <vector>
+#include <random>
 
 namespace diana {
 
 namespace {
 
-std::string trim_whitespace(std::string value) {
-    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
-        value.erase(value.begin());
-    }
-    while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
-        value.pop_back();
-    }
-    return value;
-}
-
-void append_unique(std::vector<std::string>& items, const std::string& value) {
-    if (value.empty()) {
-        return;
-    }
-    if (std::find(items.begin(), items.end(), value) == items.end()) {
-        items.push_back(value);
-    }
-}
-
-void append_if_exists(std::vector<std::string>& items, const std::filesystem::path& path) {
-    std::error_code ec;
-    if (std::filesystem::exists(path, ec) && !ec) {
-        append_unique(items, path.string());
-    }
-}
-
-bool decode_next_utf8(const std::string& text, size_t& index, uint32_t& codepoint) {
-    if (index >= text.size()) {
-        return false;
-    }
-
-    unsigned char c0 = static_cast<unsigned char>(text[index]);
-    if (c0 < 0x80) {
-        codepoint = c0;
-        index += 1;
-        return true;
-    }
-
-    if ((c0 >> 5) == 0x6 && index + 1 < text.size()) {
-        unsigned char c1 = static_cast<unsigned char>(text[index + 1]);
-        if ((c1 & 0xC0) == 0x80) {
-            codepoint = ((c0 & 0x1F) << 6) | (c1 & 0x3F);
-            index += 2;
-            return true;
-        }
-    }
-
-    if ((c0 >> 4) == 0xE && index + 2 < text.size()) {
-        unsigned char c1 = static_cast<unsigned char>(text[index + 1]);
-        unsigned char c2 = static_cast<unsigned char>(text[index + 2]);
-        if ((c1 & 0xC0) == 0x80 && (c2 & 0xC0) == 0x80) {
-            codepoint = ((c0 & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
-            index += 3;
-            return true;
-        }
-    }
-
-    if ((c0 >> 3) == 0x1E && index + 3 < text.size()) {
-        unsigned char c1 = static_cast<unsigned char>(text[index + 1]);
-        unsigned char c2 = static_cast<unsigned char>(text[index + 2]);
-        unsigned char c3 = static_cast<unsigned char>(text[index + 3]);
-        if ((c1 & 0xC0) == 0x80 && (c2 & 0xC0) == 0x80 && (c3 & 0xC0) == 0x80) {
-            codepoint = ((c0 & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) | (c3 & 0x3F);
-            index += 4;
-            return true;
-        }
-    }
-
-    codepoint = 0xFFFD;
-    index += 1;
-    return true;
-}
-
-std::string read_nvm_default_version(const std::string& home_dir) {
-    std::filesystem::path alias_file = std::filesystem::path(home_dir) / ".nvm/alias/default";
-    std::error_code ec;
-    if (!std::filesystem::exists(alias_file, ec) || ec) {
-        return {};
-    }
-    std::ifstream f(alias_file);
-    if (!f) return {};
-    std::string line;
-    std::getline(f, line);
-    return trim_whitespace(line);
-}
-
-std::string find_nvm_version_bin(const std::string& home_dir, const std::string& alias) {
-    if (alias.empty()) return {};
-    std::filesystem::path versions_dir = std::filesystem::path(home_dir) / ".nvm/versions/node";
-    std::error_code ec;
-    if (!std::filesystem::exists(versions_dir, ec) || ec) return {};
-    
-    std::filesystem::path exact = versions_dir / alias;
-    if (std::filesystem::exists(exact / "bin", ec) && !ec) {
-        return (exact / "bin").string();
-    }
-    
-    std::string version_prefix = alias;
-    if (!version_prefix.empty() && version_prefix[0] != 'v') {
-        version_prefix = "v" + version_prefix;
-    }
-    
-    std::string best_match;
-    for (const auto& entry : std::filesystem::directory_iterator(versions_dir, ec)) {
-        if (ec || !entry.is_directory()) continue;
-        std::string name = entry.path().filename().string();
-        if (name.rfind(version_prefix, 0) == 0) {
-            std::filesystem::path bin = entry.path() / "bin";
-            if (std::filesystem::exists(bin, ec) && !ec) {
-                if (best_match.empty() || name > best_match) {
-                    best_match = bin.string();
-                }
-            }
-        }
-    }
-    return best_match;
-}
-
-std::vector<std::string> split_path_list(const std::string& value) {
-    std::vector<std::string> result;
-    std::stringstream ss(value);
-    std::string item;
-    while (std::getline(ss, item, ':')) {
-        item = trim_whitespace(item);
-        if (!item.empty()) {
-            result.push_back(item);
-        }
-    }
-    return result;
-}
-
-std::vector<std::string> build_search_paths() {
-    std::vector<std::string> paths;
-
-    const char* env_path = std::getenv("PATH");
-    if (env_path && *env_path) {
-        for (const auto& entry : split_path_list(env_path)) {
-            append_unique(paths, entry);
-        }
-    }
-
-    append_unique(paths, "/usr/local/bin");
-    append_unique(paths, "/opt/homebrew/bin");
-    append_unique(paths, "/usr/bin");
-    append_unique(paths, "/bin");
-    append_unique(paths, "/usr/sbin");
-    append_unique(paths, "/sbin");
-
-    const char* home = std::getenv("HOME");
-    if (home && *home) {
-        std::string home_dir = home;
-        append_if_exists(paths, std::filesystem::path(home_dir) / ".local/bin");
-        append_if_exists(paths, std::filesystem::path(home_dir) / ".cargo/bin");
-        append_if_exists(paths, std::filesystem::path(home_dir) / ".npm-global/bin");
-        append_if_exists(paths, std::filesystem::path(home_dir) / ".volta/bin");
-        append_if_exists(paths, std::filesystem::path(home_dir) / ".asdf/shims");
-
-        std::string default_alias = read_nvm_default_version(home_dir);
-        std::string default_bin = find_nvm_version_bin(home_dir, default_alias);
-        if (!default_bin.empty()) {
-            append_unique(paths, default_bin);
-        }
-        
-        std::filesystem::path nvm_dir = std::filesystem::path(home_dir) / ".nvm/versions/node";
-        std::error_code ec;
-        if (std::filesystem::exists(nvm_dir, ec) && !ec) {
-            for (const auto& entry : std::filesystem::directory_iterator(nvm_dir, ec)) {
-                if (ec) {
-                    break;
-                }
-                if (!entry.is_directory()) {
-                    continue;
-                }
-                append_if_exists(paths, entry.path() / "bin");
-            }
-        }
-    }
-
-    return paths;
-}
-
-std::string resolve_from_shell(const std::string& executable) {
-    if (executable.find('/') != std::string::npos) {
-        return executable;
-    }
-    const char* shell = std::getenv("SHELL");
-    std::string shell_path = (shell && *shell) ? shell : "/bin/zsh";
-    std::string command = shell_path + " -lc \"command -v " + executable + " 2>/dev/null\"";
-
-    FILE* pipe = popen(command.c_str(), "r");
-    if (!pipe) {
-        return {};
-    }
-
-    std::string output;
-    char buffer[256];
-    while (fgets(buffer, sizeof(buffer), pipe)) {
-        output += buffer;
-    }
-    pclose(pipe);
-
-    output = trim_whitespace(output);
-    if (output.empty()) {
-        return {};
-    }
-
-    std::filesystem::path resolved(output);
-    if (!resolved.is_absolute()) {
-        return {};
-    }
-
-    std::error_code ec;
-    if (!std::filesystem::exists(resolved, ec) || ec) {
-        return {};
-    }
-
-    return output;
-}
-
-std::string resolve_executable_path(const std::string& executable) {
-    if (executable.find('/') != std::string::npos) {
-        return executable;
-    }
-
-    for (const auto& dir : build_search_paths()) {
-        std::filesystem::path candidate = std::filesystem::path(dir) / executable;
-        std::error_code ec;
-        if (std::filesystem::exists(candidate, ec) && !ec) {
-            return candidate.string();
-        }
-    }
-
-    std::string shell_resolved = resolve_from_shell(executable);
-    if (!shell_resolved.empty()) {
-        return shell_resolved;
-    }
-
-    return executable;
-}
-
 std::string get_executable_for_app(AppKind app) {
     switch (app) {
         case AppKind::ClaudeCode: return "claude";
@@ -268,12 +23,45 @@ std::string get_working_dir() {
     return home ? home : "/tmp";
 }
 
+uint64_t new_daemon_key() {
+    std::random_device rd;
+    uint64_t key = 0;
+    while (key == 0) {
+        key = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+    return key;
+}
+
 }
 
-SessionController::SessionController() = default;
+SessionController::SessionController()
+    : warm_pool_([this](AppKind app, const std::string& working_dir) {
+          // Refill thread: exec_plans_ belongs to the UI thread, so the plan
+          // is built here rather than taken from the cache.
+          ProcessConfig config;
+          config.executable = resolver_.resolve(get_executable_for_app(app)).path;
+          config.plan = ExecPlan::build(config.executable, {});
+          config.working_dir = working_dir;
+          return config;
+      })
+{
+    // Shell startup can take seconds when an agent is only found through the
+    // login shell; do it before the first tab is started.
+    resolver_.prewarm({
+        get_executable_for_app(AppKind::ClaudeCode),
+        get_executable_for_app(AppKind::Codex),
+        get_executable_for_app(AppKind::OpenCode),
+    });
+    
+    // Optional: without a running diana-sessiond, agents are our children.
+    auto daemon = std::make_unique<SessionDaemonClient>();
+    if (!daemon->socket_path().empty() && daemon->connect()) {
+        daemon_ = std::move(daemon);
+    }
+}
 
 SessionController::~SessionController() {
-    // Clear callbacks before destruction to prevent IO threads from accessing event_queue_
+    // Clear callbacks before destruction to prevent the IO reactor from accessing event_queue_
     for (auto& [id, runner] : runners_) {
         if (runner) {
             runner->set_output_callback(nullptr);
@@ -284,27 +72,28 @@ SessionController::~SessionController() {
         }
     }
     runners_.clear();
+    // Agents in the daemon keep running; the next start reattaches to them.
+    // The client goes first so its reader stops before event_queue_ does.
+    if (daemon_) {
+        for (const auto& [id, key] : remote_sessions_) {
+            daemon_->detach(key);
+        }
+        daemon_.reset();
+    }
+    for (auto& [id, recorder] : recorders_) {
+        recorder->close();
+    }
 }
 
 void SessionController::start_session(TerminalSession& session) {
-    auto it = runners_.find(session.id());
-    if (it != runners_.end()) {
-        if (it->second && it->second->is_running()) {
-            return;
-        }
-        runners_.erase(it);
+    if (is_running(session.id())) {
+        return;
     }
+    runners_.erase(session.id());
+    remote_sessions_.erase(session.id());
     
-    auto runner = std::make_unique<ProcessRunner>();
     uint32_t session_id = session.id();
-    
-    runner->set_output_callback([this, session_id](const std::string& data, bool is_stderr) {
-        event_queue_.push(OutputEvent{session_id, data, is_stderr});
-    });
-    
-    runner->set_exit_callback([this, session_id](int exit_code) {
-        event_queue_.push(ExitEvent{session_id, exit_code});
-    });
+    ExitCallback on_exit = exit_callback(session_id);
     
     ProcessConfig config = build_config(session);
     
@@ -312,18 +101,63 @@ void SessionController::start_session(TerminalSession& session) {
     session.write_to_terminal(start_msg.data(), start_msg.size());
     session.request_scroll_to_bottom();
     
-    if (runner->start(config)) {
+    if (daemon_ && daemon_->connected()) {
+        if (start_remote(session, config, on_exit)) {
+            session.set_state(SessionState::Running);
+        } else {
+            session.set_state(SessionState::Idle);
+            const char* err_msg = "\r\n[Failed to start process in diana-sessiond]\r\n";
+            session.write_to_terminal(err_msg, strlen(err_msg));
+            session.request_scroll_to_bottom();
+        }
+        update_warm_pool(session);
+        return;
+    }
+    
+    std::shared_ptr<SessionRecorder> recorder;
+    if (auto rec = recorders_.find(session_id); rec != recorders_.end()) {
+        recorder = rec->second;
+    }
+    
+    // A warm agent has been running for a while; its first screen was
+    // buffered and arrives with the hand-over.
+    std::unique_ptr<ProcessRunner> runner = warm_pool_.take(session.config().app, config, session.output_ring(), on_exit);
+    bool started = runner != nullptr;
+    if (started) {
+        runner->set_recorder(recorder);
+    } else {
+        runner = std::make_unique<ProcessRunner>();
+        runner->set_output_ring(session.output_ring());
+        runner->set_recorder(recorder);
+        runner->set_exit_callback(on_exit);
+        started = runner->start(config);
+    }
+    
+    if (started) {
         session.set_state(SessionState::Running);
+        // The child leads its own process group, which its tools join.
+        sampler_.track(session_id, runner->pid());
         runners_[session_id] = std::move(runner);
     } else {
         session.set_state(SessionState::Idle);
-        const char* err_msg = "\r\n[Failed to start process]\r\n";
-        session.write_to_terminal(err_msg, strlen(err_msg));
+        std::string err_msg = "\r\n[Failed to start process]\r\n";
+        if (auto failure = io_failure()) {
+            err_msg = "\r\n[Failed to start process: " + *failure + "]\r\n";
+        }
+        session.write_to_terminal(err_msg.data(), err_msg.size());
         session.request_scroll_to_bottom();
     }
+    update_warm_pool(session);
 }
 
 void SessionController::stop_session(TerminalSession& session) {
+    if (auto key = remote_key(session.id())) {
+        if (is_running(session.id())) {
+            session.set_state(SessionState::Stopping);
+            daemon_->stop(*key);
+        }
+        return;
+    }
     auto it = runners_.find(session.id());
     if (it != runners_.end() && it->second && it->second->is_running()) {
         session.set_state(SessionState::Stopping);
@@ -332,71 +166,104 @@ void SessionController::stop_session(TerminalSession& session) {
 }
 
 void SessionController::send_input(TerminalSession& session, const std::string& input) {
-    auto it = runners_.find(session.id());
-    if (it != runners_.end() && it->second && it->second->is_running()) {
-        it->second->write_stdin(input + "\n");
+    if (is_running(session.id())) {
+        write_pty(session.id(), input + "\n");
     }
 }
 
 void SessionController::send_raw_key(TerminalSession& session, const std::string& key) {
-    auto it = runners_.find(session.id());
-    if (it != runners_.end() && it->second && it->second->is_running()) {
-        it->second->write_stdin(key);
+    if (is_running(session.id())) {
+        write_pty(session.id(), key);
     }
 }
 
 void SessionController::send_key(TerminalSession& session, int vterm_key) {
-    auto it = runners_.find(session.id());
-    if (it == runners_.end() || !it->second || !it->second->is_running()) {
+    if (!is_running(session.id())) {
         return;
     }
     
-    session.terminal().keyboard_key(vterm_key);
-    std::string output = session.terminal().get_output();
+    std::string output;
+    {
+        auto lock = session.lock_terminal();
+        session.terminal().keyboard_key(vterm_key);
+        output = session.terminal().get_output();
+    }
     if (!output.empty()) {
-        it->second->write_stdin(output);
+        write_pty(session.id(), output);
     }
 }
 
 void SessionController::send_char(TerminalSession& session, uint32_t codepoint) {
-    auto it = runners_.find(session.id());
-    if (it == runners_.end() || !it->second || !it->second->is_running()) {
+    if (!is_running(session.id())) {
         return;
     }
     
-    session.terminal().keyboard_unichar(codepoint);
-    std::string output = session.terminal().get_output();
+    std::string output;
+    {
+        auto lock = session.lock_terminal();
+        session.terminal().keyboard_unichar(codepoint);
+        output = session.terminal().get_output();
+    }
     if (!output.empty()) {
-        it->second->write_stdin(output);
+        write_pty(session.id(), output);
     }
 }
 
 void SessionController::send_paste(TerminalSession& session, const std::string& text) {
-    auto it = runners_.find(session.id());
-    if (it == runners_.end() || !it->second || !it->second->is_running()) {
+    if (!is_running(session.id())) {
         return;
     }
     if (text.empty()) {
         return;
     }
 
-    session.terminal().keyboard_start_paste();
-    size_t index = 0;
-    while (index < text.size()) {
-        uint32_t codepoint = 0;
-        if (!decode_next_utf8(text, index, codepoint)) {
-            break;
-        }
-        session.terminal().keyboard_unichar(codepoint);
+    std::string output;
+    {
+        auto lock = session.lock_terminal();
+        session.terminal().keyboard_paste(text, output);
     }
-    session.terminal().keyboard_end_paste();
+    if (!output.empty() && !write_pty(session.id(), output)) {
+        const char* msg = "\r\n[Paste dropped: too much input is still waiting to be sent]\r\n";
+        session.write_to_terminal(msg, strlen(msg));
+        session.request_scroll_to_bottom();
+    }
+}
 
-    std::string output = session.terminal().get_output();
-    if (!output.empty()) {
-        it->second->write_stdin(output);
+void SessionController::set_keep_warm(TerminalSession& session, bool keep_warm) {
+    session.config().keep_warm = keep_warm;
+    update_warm_pool(session);
+}
+
+void SessionController::release_session(TerminalSession& session) {
+    stop_recording(session);
+    set_keep_warm(session, false);
+    sampler_.untrack(session.id());
+    if (auto key = remote_key(session.id())) {
+        daemon_->release(*key);
+        remote_sessions_.erase(session.id());
     }
 }
 
+std::optional<std::string> SessionController::io_failure() const {
+    const IoReactor& reactor = IoReactor::instance();
+    if (!reactor.failed()) {
+        return std::nullopt;
+    }
+    return std::string("I/O loop stopped: ") + std::strerror(reactor.failure_errno());
+}
+
+std::optional<ExecutableResolution> SessionController::resolution(AppKind app) {
+    return resolver_.cached(get_executable_for_app(app));
+}
+
+size_t SessionController::pending_input(const TerminalSession& session) const {
+    auto it = runners_.find(session.id());
+    if (it == runners_.end() || !it->second) {
+        return 0;
+    }
+    return it->second->pending_input();
+}
+
 void SessionController::process_events() {
     while (auto event_opt = event_queue_.try_pop()) {
         std::visit([](auto&& evt) {
@@ -409,13 +276,139 @@ void SessionController::resize_pty(TerminalSession& session, int rows, int cols)
     auto it = runners_.find(session.id());
     if (it != runners_.end() && it->second && it->second->is_running()) {
         it->second->resize(rows, cols);
+    } else if (auto key = remote_key(session.id())) {
+        daemon_->resize(*key, rows, cols);
+    }
+    if (auto rec = recorders_.find(session.id()); rec != recorders_.end()) {
+        rec->second->record_resize(rows, cols);
+    }
+    session.resize_terminal(rows, cols);
+}
+
+bool SessionController::start_recording(TerminalSession& session, const std::string& path, std::string* error) {
+    stop_recording(session);
+    
+    auto recorder = std::make_shared<SessionRecorder>();
+    if (!recorder->open(path, session.terminal().rows(), session.terminal().cols(), error)) {
+        return false;
+    }
+    recorders_[session.id()] = recorder;
+    
+    if (auto key = remote_key(session.id())) {
+        daemon_->set_recorder(*key, recorder);
+    }
+    auto it = runners_.find(session.id());
+    if (it != runners_.end() && it->second) {
+        it->second->set_recorder(recorder);
     }
-    session.terminal().resize(rows, cols);
+    return true;
+}
+
+void SessionController::stop_recording(TerminalSession& session) {
+    auto rec = recorders_.find(session.id());
+    if (rec == recorders_.end()) {
+        return;
+    }
+    if (auto key = remote_key(session.id())) {
+        daemon_->set_recorder(*key, nullptr);
+    }
+    auto it = runners_.find(session.id());
+    if (it != runners_.end() && it->second) {
+        it->second->set_recorder(nullptr);
+    }
+    rec->second->close();
+    recorders_.erase(rec);
+}
+
+const SessionRecorder* SessionController::recorder(const TerminalSession& session) const {
+    auto rec = recorders_.find(session.id());
+    return rec != recorders_.end() ? rec->second.get() : nullptr;
+}
+
+bool SessionController::reattach(TerminalSession& session) {
+    uint64_t key = session.config().daemon_key;
+    if (!daemon_ || !daemon_->connected() || key == 0 || is_running(session.id())) {
+        return false;
+    }
+    auto info = daemon_->find(key);
+    if (!info) {
+        return false;
+    }
+    uint32_t session_id = session.id();
+    remote_sessions_[session_id] = key;
+    // An agent that exited while no GUI was attached is reported by the
+    // daemon right after its output, as an ExitEvent.
+    session.set_state(info->running ? SessionState::Running : SessionState::Idle);
+    return attach_remote(session, key, exit_callback(session_id));
+}
+
+// The daemon execs the resolved path with its own environment; the ExecPlan
+// built here for local starts is not sent.
+bool SessionController::start_remote(TerminalSession& session, const ProcessConfig& config, ExitCallback on_exit) {
+    uint64_t& key = session.config().daemon_key;
+    if (key == 0) {
+        key = new_daemon_key();
+    }
+    SpawnRequest request;
+    request.executable = config.executable;
+    request.args = config.args;
+    request.working_dir = config.working_dir;
+    request.rows = config.rows;
+    request.cols = config.cols;
+    // Spawn first: attaching replays an earlier run that exited. Output in
+    // between is kept by the daemon and replayed.
+    remote_sessions_[session.id()] = key;
+    return daemon_->spawn(key, request) && attach_remote(session, key, std::move(on_exit));
+}
+
+// The daemon reports the agent's process group for sampling; output is
+// recorded as the client receives it.
+bool SessionController::attach_remote(TerminalSession& session, uint64_t key, ExitCallback on_exit) {
+    uint32_t session_id = session.id();
+    if (auto rec = recorders_.find(session_id); rec != recorders_.end()) {
+        daemon_->set_recorder(key, rec->second);
+    }
+    return daemon_->attach(key, session.output_ring(), std::move(on_exit),
+                           [this, session_id](pid_t pgid) { sampler_.track(session_id, pgid); });
+}
+
+ExitCallback SessionController::exit_callback(uint32_t session_id) {
+    return [this, session_id](int exit_code) {
+        sampler_.untrack(session_id);
+        event_queue_.push(ExitEvent{session_id, exit_code});
+        RedrawScheduler::instance().request_redraw();
+    };
+}
+
+std::optional<uint64_t> SessionController::remote_key(uint32_t session_id) const {
+    auto it = remote_sessions_.find(session_id);
+    if (it == remote_sessions_.end() || !daemon_) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool SessionController::is_running(uint32_t session_id) const {
+    if (auto key = remote_key(session_id)) {
+        auto info = daemon_->find(*key);
+        return daemon_->connected() && info && info->running;
+    }
+    auto it = runners_.find(session_id);
+    return it != runners_.end() && it->second && it->second->is_running();
+}
+
+bool SessionController::write_pty(uint32_t session_id, const std::string& data) {
+    if (auto key = remote_key(session_id)) {
+        return daemon_->write(*key, data);
+    }
+    auto it = runners_.find(session_id);
+    return it != runners_.end() && it->second && it->second->write_stdin(data);
 }
 
 ProcessConfig SessionController::build_config(const TerminalSession& session) {
     ProcessConfig config;
-    config.executable = resolve_executable_path(get_executable_for_app(session.config().app));
+    config.executable = resolver_.resolve(get_executable_for_app(session.config().app)).path;
+    config.plan = exec_plan(session.config().app, config.executable);
     config.working_dir = session.config().working_dir.empty() 
         ? get_working_dir() 
         : session.config().working_dir;
@@ -424,4 +417,42 @@ ProcessConfig SessionController::build_config(const TerminalSession& session) {
     return config;
 }
 
+// Keeps one agent warm per app and directory that some session with
+// keep_warm uses, and none for the ones no session needs any more.
+void SessionController::update_warm_pool(const TerminalSession& session) {
+    std::optional<std::pair<AppKind, std::string>> previous;
+    if (auto it = warm_sessions_.find(session.id()); it != warm_sessions_.end()) {
+        previous = it->second;
+        warm_sessions_.erase(it);
+    }
+    if (session.config().keep_warm && !(daemon_ && daemon_->connected())) {
+        const std::string& dir = session.config().working_dir;
+        warm_sessions_[session.id()] = {session.config().app, dir.empty() ? get_working_dir() : dir};
+        const auto& key = warm_sessions_[session.id()];
+        warm_pool_.keep_warm(key.first, key.second, 1);
+    }
+    if (previous) {
+        bool still_wanted = false;
+        for (const auto& [id, key] : warm_sessions_) {
+            still_wanted |= key == *previous;
+        }
+        if (!still_wanted) {
+            warm_pool_.keep_warm(previous->first, previous->second, 0);
+        }
+    }
+}
+
+// Plans are rebuilt when the resolved executable changes or the resolver
+// saw its directories change, since the child PATH lists the same ones.
+std::shared_ptr<const ExecPlan> SessionController::exec_plan(AppKind app, const std::string& executable) {
+    CachedPlan& cached = exec_plans_[app];
+    uint64_t invalidations = resolver_.invalidations();
+    if (!cached.plan || cached.executable != executable || cached.resolver_invalidations != invalidations) {
+        cached.plan = ExecPlan::build(executable, {});
+        cached.executable = executable;
+        cached.resolver_invalidations = invalidations;
+    }
+    return cached.plan;
+}
+
 }
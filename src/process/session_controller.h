@@ -1,11 +1,18 @@
 #pragma once
 
 #include "terminal/terminal_session.h"
+#include "process/executable_resolver.h"
 #include "process/process_runner.h"
+#include "process/resource_sampler.h"
+#include "process/session_daemon_client.h"
+#include "process/warm_pool.h"
 #include "core/event_queue.h"
 #include "core/session_events.h"
 #include <memory>
+#include <optional>
+#include <string>
 #include <unordered_map>
+#include <utility>
 
 namespace diana {
 
@@ -23,15 +30,80 @@ public:
     void send_paste(TerminalSession& session, const std::string& text);
     void resize_pty(TerminalSession& session, int rows, int cols);
     
+    // Reconnects a session saved with a daemon_key to its agent in
+    // diana-sessiond, replaying the output the daemon kept. False when no
+    // daemon is connected or it no longer has the session.
+    bool reattach(TerminalSession& session);
+    // The diana-sessiond connection, or null when no daemon was running at
+    // startup; sessions then run as children of this process.
+    const SessionDaemonClient* daemon() const { return daemon_.get(); }
+    
+    // Turns the session's keep_warm setting on or off. While any session
+    // with the setting uses an app and directory, an agent for them is kept
+    // started so the next start_session() there takes it over at once. Not
+    // while diana-sessiond is connected: sessions start in the daemon and
+    // could not take over a child of this process.
+    void set_keep_warm(TerminalSession& session, bool keep_warm);
+    const WarmPool& warm_pool() const { return warm_pool_; }
+    
+    // Drops what is kept for a session that is being closed: its recording,
+    // warm agent and resource samples.
+    void release_session(TerminalSession& session);
+    
+    // CPU, memory and IO of the session's process group, sampled in the
+    // background while its process runs.
+    ResourceSampler& resource_sampler() { return sampler_; }
+    
+    // Bytes of typed or pasted input still queued for the session's PTY.
+    size_t pending_input(const TerminalSession& session) const;
+    
+    // Why the I/O loop that serves local sessions stopped, if it has; none
+    // of them can start or produce output after that.
+    std::optional<std::string> io_failure() const;
+    
+    // Where the app's executable was found and how long that took, once it
+    // has been resolved.
+    std::optional<ExecutableResolution> resolution(AppKind app);
+    
+    // Records the session's PTY output to path until stop_recording(); the
+    // recording carries over restarts of the session's process.
+    bool start_recording(TerminalSession& session, const std::string& path, std::string* error = nullptr);
+    void stop_recording(TerminalSession& session);
+    const SessionRecorder* recorder(const TerminalSession& session) const;
+    
     void process_events();
     
     EventQueue<SessionEvent>& event_queue() { return event_queue_; }
 
 private:
+    struct CachedPlan {
+        std::string executable;
+        uint64_t resolver_invalidations = 0;
+        std::shared_ptr<const ExecPlan> plan;
+    };
+    
     ProcessConfig build_config(const TerminalSession& session);
+    std::shared_ptr<const ExecPlan> exec_plan(AppKind app, const std::string& executable);
+    void update_warm_pool(const TerminalSession& session);
+    bool start_remote(TerminalSession& session, const ProcessConfig& config, ExitCallback on_exit);
+    bool attach_remote(TerminalSession& session, uint64_t key, ExitCallback on_exit);
+    ExitCallback exit_callback(uint32_t session_id);
+    std::optional<uint64_t> remote_key(uint32_t session_id) const;
+    bool is_running(uint32_t session_id) const;
+    bool write_pty(uint32_t session_id, const std::string& data);
     
     std::unordered_map<uint32_t, std::unique_ptr<ProcessRunner>> runners_;
+    // Sessions whose agent runs in diana-sessiond, by key.
+    std::unordered_map<uint32_t, uint64_t> remote_sessions_;
+    std::unique_ptr<SessionDaemonClient> daemon_;
+    std::unordered_map<uint32_t, std::shared_ptr<SessionRecorder>> recorders_;
     EventQueue<SessionEvent> event_queue_;
+    ExecutableResolver resolver_;
+    std::unordered_map<AppKind, CachedPlan> exec_plans_;
+    // Sessions with keep_warm set, and the app and directory each keeps warm.
+    std::unordered_map<uint32_t, std::pair<AppKind, std::string>> warm_sessions_;
+    WarmPool warm_pool_;
+    ResourceSampler sampler_;
 };
 
 }
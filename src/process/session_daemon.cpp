@@ -0,0 +1,488 @@
+#include "session_daemon.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace diana {
+
+namespace {
+
+bool fill_address(const std::string& path, sockaddr_un& addr, std::string* error) {
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        if (error) *error = "Socket path is empty or too long: " + path;
+        return false;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+void set_nonblocking(int fd) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+}
+
+// Directories that do not exist yet are made private to this user; ones
+// that do are left as they are.
+void create_private_directories(const std::filesystem::path& dir) {
+    if (dir.empty() || std::filesystem::exists(dir)) {
+        return;
+    }
+    create_private_directories(dir.parent_path());
+    mkdir(dir.c_str(), S_IRWXU);
+}
+
+// The socket is created owner-only rather than chmod-ed after the fact,
+// so no other user can connect in between.
+int bind_private(int fd, const sockaddr_un& addr) {
+    mode_t old_mask = umask(0077);
+    int rc = bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+    umask(old_mask);
+    return rc;
+}
+
+bool same_user(int fd) {
+#if defined(SO_PEERCRED)
+    ucred cred{};
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 && cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+}
+
+SessionDaemon::SessionDaemon(IoReactor& reactor) : reactor_(reactor) {}
+
+SessionDaemon::~SessionDaemon() {
+    reactor_.call([this] {
+        if (listen_fd_ >= 0) {
+            reactor_.remove_fd(listen_fd_);
+            close(listen_fd_);
+            listen_fd_ = -1;
+            unlink(socket_path_.c_str());
+        }
+        while (!clients_.empty()) {
+            drop_client(clients_.begin()->first);
+        }
+        // Each runner's destructor sends SIGTERM and reaps the child.
+        sessions_.clear();
+        update_counts();
+    });
+}
+
+bool SessionDaemon::listen(const std::string& socket_path, std::string* error) {
+    sockaddr_un addr;
+    if (!fill_address(socket_path, addr, error)) {
+        return false;
+    }
+    create_private_directories(std::filesystem::path(socket_path).parent_path());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        if (error) *error = std::string("socket: ") + std::strerror(errno);
+        return false;
+    }
+    int rc = bind_private(fd, addr);
+    if (rc != 0 && errno == EADDRINUSE) {
+        // Left behind by a daemon that did not exit cleanly, unless one
+        // still answers on it.
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+        if (probe >= 0) close(probe);
+        if (live) {
+            if (error) *error = "Another diana-sessiond is listening on " + socket_path;
+            close(fd);
+            return false;
+        }
+        struct stat st;
+        if (lstat(socket_path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+            if (error) *error = socket_path + " exists and is not a socket";
+            close(fd);
+            return false;
+        }
+        unlink(socket_path.c_str());
+        rc = bind_private(fd, addr);
+    }
+    if (rc != 0 || ::listen(fd, 16) != 0) {
+        if (error) *error = "Cannot listen on " + socket_path + ": " + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    set_nonblocking(fd);
+
+    bool added = false;
+    reactor_.call([&] {
+        listen_fd_ = fd;
+        socket_path_ = socket_path;
+        added = reactor_.add_fd(fd, IoReactor::READABLE, [this](uint32_t) { on_accept(); });
+    });
+    if (!added) {
+        if (error) *error = "Cannot watch the listening socket";
+        return false;
+    }
+    return true;
+}
+
+void SessionDaemon::on_accept() {
+    while (true) {
+        int fd = accept(listen_fd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        // The socket is owner-only, but its directory may not be.
+        if (!same_user(fd)) {
+            fprintf(stderr, "diana-sessiond: refused a connection from another user\n");
+            close(fd);
+            continue;
+        }
+        set_nonblocking(fd);
+        disable_sigpipe(fd);
+        ClientId id = next_client_++;
+        clients_[id].fd = fd;
+        reactor_.add_fd(fd, IoReactor::READABLE, [this, id](uint32_t events) { on_client_event(id, events); });
+        update_counts();
+    }
+}
+
+void SessionDaemon::on_client_event(ClientId id, uint32_t events) {
+    auto it = clients_.find(id);
+    if (it == clients_.end()) {
+        return;
+    }
+    dispatching_ = id;
+    if (events & IoReactor::WRITABLE) {
+        flush(id);
+    }
+    bool eof = false;
+    if (events & (IoReactor::READABLE | IoReactor::HANGUP)) {
+        char buffer[64 * 1024];
+        while (true) {
+            ssize_t n = recv(it->second.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                it->second.reader.feed(buffer, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            eof = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+            break;
+        }
+        Frame frame;
+        while (!it->second.closing && it->second.reader.next(frame)) {
+            handle_frame(id, frame);
+        }
+    }
+    dispatching_ = 0;
+    if (eof || it->second.closing || it->second.reader.failed()) {
+        drop_client(id);
+    }
+}
+
+void SessionDaemon::handle_frame(ClientId id, const Frame& frame) {
+    auto session = sessions_.find(frame.session);
+    switch (frame.type) {
+        case FrameType::Hello: {
+            std::string version;
+            append_u32(version, SESSION_PROTOCOL_VERSION);
+            send(id, FrameType::Hello, 0, version);
+            break;
+        }
+        case FrameType::List: {
+            std::vector<DaemonSessionInfo> list;
+            for (const auto& [key, s] : sessions_) {
+                list.push_back({key, s.running, s.exit_code, s.pgid});
+            }
+            send(id, FrameType::Sessions, 0, encode_sessions(list));
+            break;
+        }
+        case FrameType::Spawn:
+            spawn(id, frame.session, frame.payload);
+            break;
+        case FrameType::Attach:
+            attach(id, frame.session, frame.payload);
+            break;
+        case FrameType::Detach:
+            if (session != sessions_.end() && session->second.client == id) {
+                detach(session->second);
+            }
+            break;
+        case FrameType::Credit: {
+            size_t pos = 0;
+            uint32_t bytes = 0;
+            if (session != sessions_.end() && session->second.client == id && read_u32(frame.payload, pos, bytes)) {
+                session->second.credit += bytes;
+                pump(frame.session, session->second);
+            }
+            break;
+        }
+        case FrameType::Input:
+            if (session != sessions_.end() && session->second.running) {
+                session->second.runner->write_stdin(frame.payload);
+            }
+            break;
+        case FrameType::Resize: {
+            size_t pos = 0;
+            uint16_t rows = 0;
+            uint16_t cols = 0;
+            if (session != sessions_.end() && read_u16(frame.payload, pos, rows) && read_u16(frame.payload, pos, cols)) {
+                session->second.runner->resize(rows, cols);
+            }
+            break;
+        }
+        case FrameType::Stop:
+            if (session != sessions_.end()) session->second.runner->stop();
+            break;
+        case FrameType::Kill:
+            if (session != sessions_.end()) session->second.runner->kill();
+            break;
+        case FrameType::Release:
+            if (session != sessions_.end()) {
+                sessions_.erase(session);
+                update_counts();
+            }
+            break;
+        default:
+            send(id, FrameType::Error, frame.session, "Unexpected frame");
+            break;
+    }
+}
+
+void SessionDaemon::spawn(ClientId id, uint64_t key, const std::string& payload) {
+    SpawnRequest request;
+    if (!decode_spawn(payload, request)) {
+        send(id, FrameType::Error, key, "Malformed spawn request");
+        return;
+    }
+    auto existing = sessions_.find(key);
+    if (existing != sessions_.end()) {
+        if (existing->second.running) {
+            send(id, FrameType::Error, key, "Session is already running");
+            return;
+        }
+        sessions_.erase(existing);
+    }
+
+    Session& session = sessions_[key];
+    session.runner = std::make_unique<ProcessRunner>(reactor_);
+    session.runner->set_output_callback([this, key](const std::string& data, bool) { on_output(key, data); });
+    session.runner->set_exit_callback([this, key](int exit_code) { on_exit(key, exit_code); });
+
+    ProcessConfig config;
+    config.executable = request.executable;
+    config.args = request.args;
+    config.working_dir = request.working_dir;
+    config.rows = request.rows;
+    config.cols = request.cols;
+    session.running = session.runner->start(config);
+    if (!session.running) {
+        send(id, FrameType::Error, key, "Failed to start process");
+    } else {
+        // The GUI samples the agent's process group from here on.
+        session.pgid = session.runner->pid();
+        send(id, FrameType::Sessions, key, encode_sessions({{key, true, -1, session.pgid}}));
+    }
+    update_counts();
+}
+
+// Replaces any client already attached to the session: the newest GUI wins.
+// The replay starts at the requested stream position, or at the oldest
+// output kept.
+void SessionDaemon::attach(ClientId id, uint64_t key, const std::string& payload) {
+    auto it = sessions_.find(key);
+    if (it == sessions_.end()) {
+        send(id, FrameType::Error, key, "No such session");
+        return;
+    }
+    Session& session = it->second;
+    uint64_t start = session.written - session.scrollback.size();
+    size_t pos = 0;
+    uint64_t from = 0;
+    if (read_u64(payload, pos, from)) {
+        start = std::clamp(from, start, session.written);
+    }
+    session.client = id;
+    session.unsent = session.scrollback.substr(session.scrollback.size() - static_cast<size_t>(session.written - start));
+    session.unsent_offset = 0;
+    session.unsent_position = start;
+    session.credit = SESSION_OUTPUT_WINDOW;
+    session.exit_sent = false;
+    pump(key, session);
+}
+
+void SessionDaemon::detach(Session& session) {
+    session.client = 0;
+    session.unsent.clear();
+    session.unsent_offset = 0;
+    session.credit = 0;
+    if (session.running) {
+        session.runner->hold_output(false);
+    }
+}
+
+// Sends the attached client as much unsent output as its credit allows, and
+// the exit once all of it is out. The agent's PTY is held while output waits.
+void SessionDaemon::pump(uint64_t key, Session& session) {
+    if (session.client == 0) {
+        return;
+    }
+    ClientId client = session.client;
+    size_t n = std::min(session.credit, session.unsent.size() - session.unsent_offset);
+    if (n > 0) {
+        std::string payload;
+        payload.reserve(8 + n);
+        append_u64(payload, session.unsent_position);
+        payload.append(session.unsent, session.unsent_offset, n);
+        session.unsent_offset += n;
+        session.unsent_position += n;
+        session.credit -= n;
+        if (session.unsent_offset == session.unsent.size()) {
+            session.unsent.clear();
+            session.unsent_offset = 0;
+        } else if (session.unsent_offset > session.unsent.size() / 2) {
+            session.unsent.erase(0, session.unsent_offset);
+            session.unsent_offset = 0;
+        }
+        send(client, FrameType::Output, key, payload);
+    }
+    if (session.unsent.empty() && !session.running && !session.exit_sent) {
+        std::string code;
+        append_u32(code, static_cast<uint32_t>(session.exit_code));
+        session.exit_sent = true;
+        send(client, FrameType::Exited, key, code);
+    }
+    if (session.running) {
+        session.runner->hold_output(!session.unsent.empty());
+    }
+}
+
+void SessionDaemon::send(ClientId id, FrameType type, uint64_t key, std::string_view payload) {
+    auto it = clients_.find(id);
+    if (it == clients_.end() || it->second.closing) {
+        return;
+    }
+    Client& client = it->second;
+    append_frame(client.out, type, key, payload);
+    if (client.out.size() - client.out_offset > MAX_CLIENT_BACKLOG) {
+        // It can attach again for a replay.
+        close_client(id);
+        return;
+    }
+    if (!client.want_writable) {
+        flush(id);
+    }
+}
+
+void SessionDaemon::flush(ClientId id) {
+    auto it = clients_.find(id);
+    if (it == clients_.end()) {
+        return;
+    }
+    Client& client = it->second;
+    while (client.out_offset < client.out.size()) {
+        ssize_t n = send_some(client.fd, client.out.data() + client.out_offset, client.out.size() - client.out_offset);
+        if (n > 0) {
+            client.out_offset += static_cast<size_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        close_client(id);
+        return;
+    }
+    bool pending = client.out_offset < client.out.size();
+    if (!pending) {
+        client.out.clear();
+        client.out_offset = 0;
+    } else if (client.out_offset > client.out.size() / 2) {
+        client.out.erase(0, client.out_offset);
+        client.out_offset = 0;
+    }
+    if (pending != client.want_writable) {
+        client.want_writable = pending;
+        reactor_.set_interest(client.fd, IoReactor::READABLE | (pending ? IoReactor::WRITABLE : 0u));
+    }
+}
+
+// A client whose event is being handled is dropped when that finishes, so
+// the handler never sees its state go away.
+void SessionDaemon::close_client(ClientId id) {
+    auto it = clients_.find(id);
+    if (it == clients_.end()) {
+        return;
+    }
+    it->second.closing = true;
+    if (id != dispatching_) {
+        drop_client(id);
+    }
+}
+
+void SessionDaemon::drop_client(ClientId id) {
+    auto it = clients_.find(id);
+    if (it == clients_.end()) {
+        return;
+    }
+    reactor_.remove_fd(it->second.fd);
+    close(it->second.fd);
+    clients_.erase(it);
+    for (auto& [key, session] : sessions_) {
+        if (session.client == id) {
+            detach(session);
+        }
+    }
+    update_counts();
+}
+
+void SessionDaemon::on_output(uint64_t key, const std::string& data) {
+    auto it = sessions_.find(key);
+    if (it == sessions_.end()) {
+        return;
+    }
+    Session& session = it->second;
+    session.scrollback += data;
+    session.written += data.size();
+    if (session.scrollback.size() > 2 * SCROLLBACK_BYTES) {
+        // A replay must not begin inside an escape sequence or a UTF-8
+        // character: cut after a newline, else before an escape.
+        size_t cut = session.scrollback.size() - SCROLLBACK_BYTES;
+        size_t line = session.scrollback.find('\n', cut);
+        if (line != std::string::npos) {
+            cut = line + 1;
+        } else if (size_t escape = session.scrollback.find('\x1b', cut); escape != std::string::npos) {
+            cut = escape;
+        }
+        session.scrollback.erase(0, cut);
+    }
+    if (session.client != 0) {
+        session.unsent += data;
+        pump(key, session);
+    }
+}
+
+void SessionDaemon::on_exit(uint64_t key, int exit_code) {
+    auto it = sessions_.find(key);
+    if (it == sessions_.end()) {
+        return;
+    }
+    it->second.running = false;
+    it->second.exit_code = exit_code;
+    pump(key, it->second);
+}
+
+void SessionDaemon::update_counts() {
+    session_count_.store(sessions_.size(), std::memory_order_relaxed);
+    client_count_.store(clients_.size(), std::memory_order_relaxed);
+}
+
+}
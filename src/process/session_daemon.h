@@ -0,0 +1,105 @@
+#pragma once
+
+#include "process/io_reactor.h"
+#include "process/process_runner.h"
+#include "process/session_protocol.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace diana {
+
+// What diana-sessiond runs: owns agent PTYs so they outlive the GUI that
+// started them. GUIs connect over a Unix socket and speak the frames of
+// session_protocol.h. Each session keeps its most recent output, so a GUI
+// that attaches again (after a restart, or a crash) gets the scrollback
+// replayed before live output resumes.
+//
+// Sockets, PTYs and exits are all handled on the IoReactor thread, so the
+// state below needs no locks. An attached session's output beyond the
+// client's credit waits in the session while its PTY is held, so the agent
+// blocks instead of the client's backlog growing. A client that stops
+// reading anyway is disconnected once MAX_CLIENT_BACKLOG bytes are waiting
+// for it; its sessions keep running and it can attach again.
+class SessionDaemon {
+public:
+    static constexpr size_t SCROLLBACK_BYTES = 4 * 1024 * 1024;
+    static constexpr size_t MAX_CLIENT_BACKLOG = 32 * 1024 * 1024;
+
+    explicit SessionDaemon(IoReactor& reactor = IoReactor::instance());
+    // Ends every session and removes the socket.
+    ~SessionDaemon();
+
+    SessionDaemon(const SessionDaemon&) = delete;
+    SessionDaemon& operator=(const SessionDaemon&) = delete;
+
+    // Binds socket_path (mode 0600). A stale socket left by a daemon that
+    // died is replaced; a live one is an error.
+    bool listen(const std::string& socket_path, std::string* error = nullptr);
+
+    size_t session_count() const { return session_count_.load(std::memory_order_relaxed); }
+    size_t client_count() const { return client_count_.load(std::memory_order_relaxed); }
+
+private:
+    using ClientId = uint64_t;
+
+    struct Session {
+        std::unique_ptr<ProcessRunner> runner;
+        // Trimmed to about SCROLLBACK_BYTES, at a line start, once twice that.
+        std::string scrollback;
+        uint64_t written = 0;       // stream position where scrollback ends
+        bool running = false;
+        int exit_code = -1;
+        pid_t pgid = -1;
+        ClientId client = 0;        // attached client, 0 for none
+        // For the attached client: output not sent yet (from unsent_offset,
+        // at stream position unsent_position) and how much more it may be
+        // sent.
+        std::string unsent;
+        size_t unsent_offset = 0;
+        uint64_t unsent_position = 0;
+        size_t credit = 0;
+        bool exit_sent = false;
+    };
+
+    struct Client {
+        int fd = -1;
+        FrameReader reader;
+        std::string out;
+        size_t out_offset = 0;
+        bool want_writable = false;
+        bool closing = false;
+    };
+
+    void on_accept();
+    void on_client_event(ClientId id, uint32_t events);
+    void handle_frame(ClientId id, const Frame& frame);
+    void spawn(ClientId id, uint64_t key, const std::string& payload);
+    void attach(ClientId id, uint64_t key, const std::string& payload);
+    void detach(Session& session);
+    void pump(uint64_t key, Session& session);
+    void send(ClientId id, FrameType type, uint64_t key, std::string_view payload = {});
+    void flush(ClientId id);
+    void close_client(ClientId id);
+    void drop_client(ClientId id);
+    void on_output(uint64_t key, const std::string& data);
+    void on_exit(uint64_t key, int exit_code);
+    void update_counts();
+
+    IoReactor& reactor_;
+    int listen_fd_ = -1;
+    std::string socket_path_;
+
+    std::unordered_map<uint64_t, Session> sessions_;
+    std::unordered_map<ClientId, Client> clients_;
+    ClientId next_client_ = 1;
+    ClientId dispatching_ = 0;      // client whose event is being handled
+
+    std::atomic<size_t> session_count_{0};
+    std::atomic<size_t> client_count_{0};
+};
+
+}
@@ -0,0 +1,611 @@
+#include "session_daemon_client.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace diana {
+
+namespace {
+
+constexpr int CONNECT_TIMEOUT_SECONDS = 2;
+constexpr std::chrono::milliseconds FIRST_RETRY_DELAY{100};
+constexpr std::chrono::milliseconds MAX_RETRY_DELAY{1000};
+// Credit is returned in batches rather than per frame.
+constexpr size_t CREDIT_BATCH = SESSION_OUTPUT_WINDOW / 4;
+
+void set_receive_timeout(int fd, int seconds) {
+    timeval tv{};
+    tv.tv_sec = seconds;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+void set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) {
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    }
+}
+
+}
+
+SessionDaemonClient::SessionDaemonClient(std::string socket_path)
+    : socket_path_(std::move(socket_path))
+{
+}
+
+SessionDaemonClient::~SessionDaemonClient() {
+    stopping_.store(true);
+    if (io_thread_.joinable()) {
+        wake();
+        io_thread_.join();
+    }
+    for (auto& [key, attachment] : attachments_) {
+        attachment.ring->set_writer_wakeup(nullptr);
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    for (int fd : wake_fds_) {
+        if (fd >= 0) close(fd);
+    }
+}
+
+bool SessionDaemonClient::connect(std::string* error) {
+    if (io_thread_.joinable()) {
+        return connected_.load();
+    }
+    int fd = -1;
+    std::vector<DaemonSessionInfo> sessions;
+    if (!open_connection(fd, sessions, error)) {
+        return false;
+    }
+    if (pipe(wake_fds_) != 0) {
+        if (error) *error = std::string("pipe: ") + std::strerror(errno);
+        close(fd);
+        return false;
+    }
+    set_nonblocking(wake_fds_[0]);
+    set_nonblocking(wake_fds_[1]);
+    fcntl(wake_fds_[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wake_fds_[1], F_SETFD, FD_CLOEXEC);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& info : sessions) {
+            known_[info.key] = info;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(out_mutex_);
+        fd_ = fd;
+        connected_.store(true);
+    }
+    io_thread_ = std::thread([this] { run(); });
+    return true;
+}
+
+// Connects and does the Hello/List handshake on a blocking socket, then
+// makes it non-blocking for the I/O thread.
+bool SessionDaemonClient::open_connection(int& fd, std::vector<DaemonSessionInfo>& sessions,
+                                          std::string* error) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path_.empty() || socket_path_.size() >= sizeof(addr.sun_path)) {
+        if (error) *error = "Socket path is empty or too long: " + socket_path_;
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        if (error) *error = "diana-sessiond is not running on " + socket_path_;
+        if (fd >= 0) close(fd);
+        fd = -1;
+        return false;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    disable_sigpipe(fd);
+    set_receive_timeout(fd, CONNECT_TIMEOUT_SECONDS);
+
+    std::string hello;
+    append_u32(hello, SESSION_PROTOCOL_VERSION);
+    std::string request;
+    append_frame(request, FrameType::Hello, 0, hello);
+    append_frame(request, FrameType::List, 0);
+    bool greeted = false;
+    bool listed = false;
+    reader_ = FrameReader();
+    if (send_all(fd, request.data(), request.size())) {
+        char buffer[4096];
+        Frame frame;
+        while (!listed) {
+            ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            reader_.feed(buffer, static_cast<size_t>(n));
+            while (reader_.next(frame)) {
+                size_t pos = 0;
+                uint32_t version = 0;
+                if (frame.type == FrameType::Hello) {
+                    greeted = read_u32(frame.payload, pos, version) && version == SESSION_PROTOCOL_VERSION;
+                } else if (frame.type == FrameType::Sessions) {
+                    listed = decode_sessions(frame.payload, sessions);
+                }
+            }
+            if (reader_.failed()) break;
+        }
+    }
+    if (!greeted || !listed) {
+        if (error) *error = "diana-sessiond on " + socket_path_ + " did not answer with protocol version " +
+                            std::to_string(SESSION_PROTOCOL_VERSION);
+        close(fd);
+        fd = -1;
+        reader_ = FrameReader();
+        return false;
+    }
+    set_receive_timeout(fd, 0);
+    set_nonblocking(fd);
+    return true;
+}
+
+std::optional<DaemonSessionInfo> SessionDaemonClient::find(uint64_t key) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = known_.find(key);
+    if (it == known_.end()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+bool SessionDaemonClient::spawn(uint64_t key, const SpawnRequest& request) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        known_[key] = DaemonSessionInfo{key, true, -1, -1};
+    }
+    return send_frame(FrameType::Spawn, key, encode_spawn(request));
+}
+
+bool SessionDaemonClient::attach(uint64_t key, std::shared_ptr<ByteRing> ring, ExitCallback on_exit,
+                                 StartedCallback on_started) {
+    pid_t pgid = -1;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // Either the spawn report is already in known_ or the I/O thread
+        // finds this attachment when it arrives.
+        if (auto it = known_.find(key); it != known_.end() && it->second.running) {
+            pgid = it->second.pgid;
+        }
+        forget_locked(key);
+        Attachment& attachment = attachments_[key];
+        attachment.ring = std::move(ring);
+        attachment.on_exit = std::move(on_exit);
+        attachment.on_started = on_started;
+        attachment.ring->set_writer_wakeup([this] { wake(); });
+    }
+    if (pgid > 0 && on_started) {
+        on_started(pgid);
+    }
+    return send_frame(FrameType::Attach, key);
+}
+
+void SessionDaemonClient::set_recorder(uint64_t key, std::shared_ptr<SessionRecorder> recorder) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (recorder) {
+        recorders_[key] = std::move(recorder);
+    } else {
+        recorders_.erase(key);
+    }
+}
+
+void SessionDaemonClient::detach(uint64_t key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        forget_locked(key);
+    }
+    send_frame(FrameType::Detach, key);
+}
+
+bool SessionDaemonClient::write(uint64_t key, std::string_view data) {
+    std::lock_guard<std::mutex> lock(out_mutex_);
+    if (!connected_.load() || out_.size() - out_offset_ + data.size() > MAX_PENDING_INPUT) {
+        return false;
+    }
+    bool idle = out_.empty();
+    for (size_t offset = 0; offset < data.size(); offset += MAX_INPUT_FRAME) {
+        append_frame(out_, FrameType::Input, key, data.substr(offset, MAX_INPUT_FRAME));
+    }
+    flush_locked(idle);
+    return true;
+}
+
+bool SessionDaemonClient::resize(uint64_t key, int rows, int cols) {
+    std::string payload;
+    append_u16(payload, static_cast<uint16_t>(rows));
+    append_u16(payload, static_cast<uint16_t>(cols));
+    return send_frame(FrameType::Resize, key, payload);
+}
+
+bool SessionDaemonClient::stop(uint64_t key) {
+    return send_frame(FrameType::Stop, key);
+}
+
+bool SessionDaemonClient::kill(uint64_t key) {
+    return send_frame(FrameType::Kill, key);
+}
+
+bool SessionDaemonClient::release(uint64_t key) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        forget_locked(key);
+        recorders_.erase(key);
+        known_.erase(key);
+    }
+    return send_frame(FrameType::Release, key);
+}
+
+void SessionDaemonClient::forget_locked(uint64_t key) {
+    auto it = attachments_.find(key);
+    if (it == attachments_.end()) {
+        return;
+    }
+    it->second.ring->set_writer_wakeup(nullptr);
+    attachments_.erase(it);
+}
+
+bool SessionDaemonClient::send_frame(FrameType type, uint64_t key, std::string_view payload) {
+    std::lock_guard<std::mutex> lock(out_mutex_);
+    if (!connected_.load()) {
+        return false;
+    }
+    bool idle = out_.empty();
+    append_frame(out_, type, key, payload);
+    flush_locked(idle);
+    return true;
+}
+
+// Sends what the socket takes without waiting; the I/O thread polls for the
+// rest, woken when wake_if_left is set. A send error shuts the socket down so
+// the I/O thread sees the loss.
+void SessionDaemonClient::flush_locked(bool wake_if_left) {
+    while (out_offset_ < out_.size()) {
+        ssize_t n = send_some(fd_, out_.data() + out_offset_, out_.size() - out_offset_);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                shutdown(fd_, SHUT_RDWR);
+            }
+            break;
+        }
+        out_offset_ += static_cast<size_t>(n);
+    }
+    if (out_offset_ == out_.size()) {
+        out_.clear();
+        out_offset_ = 0;
+    } else if (wake_if_left) {
+        wake();
+    }
+}
+
+void SessionDaemonClient::wake() {
+    char c = 1;
+    ssize_t n = ::write(wake_fds_[1], &c, 1);
+    (void)n;
+}
+
+void SessionDaemonClient::run() {
+    while (!stopping_.load()) {
+        if (!connected_.load()) {
+            if (!reconnect()) {
+                break;
+            }
+            move_pending();
+        }
+        pollfd fds[2];
+        fds[0].fd = fd_;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        {
+            std::lock_guard<std::mutex> lock(out_mutex_);
+            if (!out_.empty()) {
+                fds[0].events |= POLLOUT;
+            }
+        }
+        fds[1].fd = wake_fds_[0];
+        fds[1].events = POLLIN;
+        fds[1].revents = 0;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            drop_connection();
+            continue;
+        }
+        if (fds[1].revents & POLLIN) {
+            char buffer[64];
+            while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {
+            }
+        }
+        if (fds[0].revents & POLLOUT) {
+            std::lock_guard<std::mutex> lock(out_mutex_);
+            flush_locked(false);
+        }
+        bool lost = (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) && !receive();
+        move_pending();
+        if (lost) {
+            drop_connection();
+        }
+    }
+    if (stopping_.load()) {
+        return;
+    }
+    std::unordered_map<uint64_t, Attachment> lost;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        lost.swap(attachments_);
+    }
+    for (auto& [key, attachment] : lost) {
+        attachment.ring->set_writer_wakeup(nullptr);
+        if (attachment.on_exit) {
+            attachment.on_exit(-1);
+        }
+    }
+}
+
+// Reads until the socket would block. Returns false once the connection is
+// gone.
+bool SessionDaemonClient::receive() {
+    char buffer[64 * 1024];
+    Frame frame;
+    while (true) {
+        ssize_t n = recv(fd_, buffer, sizeof(buffer), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (n <= 0) return false;
+        reader_.feed(buffer, static_cast<size_t>(n));
+        while (reader_.next(frame)) {
+            if (frame.type == FrameType::Output) {
+                handle_output(frame.session, frame.payload);
+            } else if (frame.type == FrameType::Exited) {
+                size_t pos = 0;
+                uint32_t code = static_cast<uint32_t>(-1);
+                read_u32(frame.payload, pos, code);
+                handle_exit(frame.session, static_cast<int>(code));
+            } else if (frame.type == FrameType::Sessions) {
+                handle_sessions(frame.payload);
+            } else if (frame.type == FrameType::Error && frame.session != 0) {
+                handle_error(frame.session, frame.payload);
+            }
+        }
+        if (reader_.failed()) return false;
+    }
+}
+
+void SessionDaemonClient::drop_connection() {
+    std::lock_guard<std::mutex> lock(out_mutex_);
+    connected_.store(false);
+    if (fd_ >= 0) {
+        close(fd_);
+        fd_ = -1;
+    }
+    out_.clear();
+    out_offset_ = 0;
+}
+
+// Retries the handshake with a growing delay for RECONNECT_TIMEOUT, then
+// attaches again to every session still held by the daemon, from where its
+// output stopped. Sessions the daemon no longer has exit with -1.
+bool SessionDaemonClient::reconnect() {
+    auto deadline = std::chrono::steady_clock::now() + RECONNECT_TIMEOUT;
+    std::chrono::milliseconds delay = FIRST_RETRY_DELAY;
+    int fd = -1;
+    std::vector<DaemonSessionInfo> sessions;
+    while (true) {
+        pollfd waker{wake_fds_[0], POLLIN, 0};
+        poll(&waker, 1, static_cast<int>(delay.count()));
+        char buffer[64];
+        while (read(wake_fds_[0], buffer, sizeof(buffer)) > 0) {
+        }
+        if (stopping_.load()) {
+            return false;
+        }
+        if (open_connection(fd, sessions, nullptr)) {
+            break;
+        }
+        if (std::chrono::steady_clock::now() >= deadline) {
+            fprintf(stderr, "diana: lost diana-sessiond on %s\n", socket_path_.c_str());
+            return false;
+        }
+        delay = std::min(delay * 2, MAX_RETRY_DELAY);
+    }
+
+    std::string attaches;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& info : sessions) {
+            known_[info.key] = info;
+        }
+        for (auto& [key, attachment] : attachments_) {
+            auto it = std::find_if(sessions.begin(), sessions.end(),
+                                   [key = key](const DaemonSessionInfo& info) { return info.key == key; });
+            if (it == sessions.end()) {
+                known_.erase(key);
+                attachment.exited = true;
+                attachment.exit_code = -1;
+                continue;
+            }
+            // Output the daemon sent but the ring has not taken stays in
+            // pending; the new window starts after it.
+            attachment.owed = 0;
+            attachment.ungranted = 0;
+            std::string from;
+            append_u64(from, attachment.received);
+            append_frame(attaches, FrameType::Attach, key, from);
+        }
+    }
+    std::lock_guard<std::mutex> lock(out_mutex_);
+    fd_ = fd;
+    connected_.store(true);
+    out_ = std::move(attaches);
+    out_offset_ = 0;
+    flush_locked(false);
+    return true;
+}
+
+void SessionDaemonClient::handle_output(uint64_t key, const std::string& payload) {
+    size_t pos = 0;
+    uint64_t position = 0;
+    if (!read_u64(payload, pos, position)) {
+        return;
+    }
+    std::string_view data(payload);
+    data.remove_prefix(pos);
+    size_t duplicate = 0;
+    std::shared_ptr<SessionRecorder> recorder;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = attachments_.find(key);
+        if (it == attachments_.end()) {
+            return;
+        }
+        Attachment& attachment = it->second;
+        // A resumed attach can replay output the ring already has.
+        if (position < attachment.received) {
+            duplicate = static_cast<size_t>(std::min<uint64_t>(attachment.received - position, data.size()));
+            data.remove_prefix(duplicate);
+        }
+        attachment.ungranted += duplicate;
+        attachment.received = std::max(attachment.received, position + duplicate + data.size());
+        attachment.pending.append(data.data(), data.size());
+        attachment.owed += data.size();
+        if (auto rec = recorders_.find(key); rec != recorders_.end()) {
+            recorder = rec->second;
+        }
+    }
+    if (recorder && !data.empty()) {
+        recorder->record_output(data.data(), data.size());
+    }
+}
+
+void SessionDaemonClient::handle_error(uint64_t key, const std::string& message) {
+    // A session that could not be started or attached.
+    std::string text = "\r\n[diana-sessiond: " + message + "]\r\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = attachments_.find(key);
+        if (it != attachments_.end()) {
+            it->second.pending += text;
+        }
+    }
+    handle_exit(key, -1);
+}
+
+// Moves pending output into the rings until they reach their high-water
+// mark, returns credit for it and reports exits once their output is in.
+// A full ring arms its drain wakeup, which pokes this thread.
+void SessionDaemonClient::move_pending() {
+    std::vector<std::pair<ExitCallback, int>> exits;
+    std::string credits;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = attachments_.begin(); it != attachments_.end();) {
+            Attachment& attachment = it->second;
+            ByteRing& ring = *attachment.ring;
+            if (attachment.waiting && ring.size() > ring.low_water()) {
+                ++it;
+                continue;
+            }
+            attachment.waiting = false;
+            size_t moved = 0;
+            while (attachment.pending_offset < attachment.pending.size()) {
+                ByteSpan span = ring.above_high_water() ? ByteSpan{} : ring.write_span();
+                if (span.size == 0) {
+                    if (ring.request_drain_wakeup()) {
+                        attachment.waiting = true;
+                        break;
+                    }
+                    continue;
+                }
+                size_t n = std::min(span.size, attachment.pending.size() - attachment.pending_offset);
+                std::memcpy(span.data, attachment.pending.data() + attachment.pending_offset, n);
+                ring.commit_write(n);
+                attachment.pending_offset += n;
+                moved += n;
+            }
+            if (attachment.pending_offset == attachment.pending.size()) {
+                attachment.pending.clear();
+                attachment.pending_offset = 0;
+            }
+            size_t granted = std::min(moved, attachment.owed);
+            attachment.owed -= granted;
+            attachment.ungranted += granted;
+            if (attachment.ungranted >= CREDIT_BATCH) {
+                std::string credit;
+                append_u32(credit, static_cast<uint32_t>(attachment.ungranted));
+                append_frame(credits, FrameType::Credit, it->first, credit);
+                attachment.ungranted = 0;
+            }
+            if (attachment.exited && attachment.pending.empty()) {
+                ring.set_writer_wakeup(nullptr);
+                exits.emplace_back(std::move(attachment.on_exit), attachment.exit_code);
+                it = attachments_.erase(it);
+                continue;
+            }
+            ++it;
+        }
+    }
+    if (!credits.empty()) {
+        std::lock_guard<std::mutex> lock(out_mutex_);
+        if (connected_.load()) {
+            out_ += credits;
+            flush_locked(false);
+        }
+    }
+    for (auto& [on_exit, code] : exits) {
+        if (on_exit) {
+            on_exit(code);
+        }
+    }
+}
+
+// Sent by the daemon after a spawn, with the new agent's process group.
+void SessionDaemonClient::handle_sessions(const std::string& payload) {
+    std::vector<DaemonSessionInfo> sessions;
+    if (!decode_sessions(payload, sessions)) {
+        return;
+    }
+    for (const auto& info : sessions) {
+        StartedCallback on_started;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            known_[info.key] = info;
+            auto it = attachments_.find(info.key);
+            if (it != attachments_.end() && info.running) {
+                on_started = it->second.on_started;
+            }
+        }
+        if (on_started && info.pgid > 0) {
+            on_started(info.pgid);
+        }
+    }
+}
+
+void SessionDaemonClient::handle_exit(uint64_t key, int exit_code) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto it = known_.find(key); it != known_.end()) {
+        it->second.running = false;
+        it->second.exit_code = exit_code;
+    }
+    auto it = attachments_.find(key);
+    if (it != attachments_.end() && !it->second.exited) {
+        it->second.exited = true;
+        it->second.exit_code = exit_code;
+    }
+}
+
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "core/byte_ring.h"
+#include "process/process_runner.h"
+#include "process/session_protocol.h"
+#include "process/session_recorder.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace diana {
+
+// The GUI's connection to diana-sessiond. Sessions are named by keys the GUI
+// chooses and saves, so after a restart it can attach to the ones still
+// held by the daemon.
+//
+// One I/O thread serves the socket. It writes each attached session's output
+// into that session's ring (and recorder), the way a local ProcessRunner
+// would, and never waits on a ring: output that does not fit stays with the
+// session, and the daemon is only given credit for what the ring took in.
+// If the connection drops, the thread reconnects for RECONNECT_TIMEOUT and
+// resumes every attached session where its output stopped.
+//
+// The requests are thread-safe and do not wait: frames the socket does not
+// take at once are queued for the I/O thread. Failures show up as an exit of
+// the session.
+class SessionDaemonClient {
+public:
+    static constexpr std::chrono::milliseconds RECONNECT_TIMEOUT{10000};
+
+    explicit SessionDaemonClient(std::string socket_path = default_sessiond_socket_path());
+    ~SessionDaemonClient();
+
+    SessionDaemonClient(const SessionDaemonClient&) = delete;
+    SessionDaemonClient& operator=(const SessionDaemonClient&) = delete;
+
+    // Connects and fetches the daemon's session list. Fails quickly when no
+    // daemon is running.
+    bool connect(std::string* error = nullptr);
+    bool connected() const { return connected_.load(); }
+    const std::string& socket_path() const { return socket_path_; }
+
+    // The daemon's record of a session: from the list fetched by connect(),
+    // updated as sessions are spawned and exit.
+    std::optional<DaemonSessionInfo> find(uint64_t key) const;
+
+    using StartedCallback = std::function<void(pid_t pgid)>;
+
+    bool spawn(uint64_t key, const SpawnRequest& request);
+    // Replays what the daemon kept of the session's output into ring, then
+    // streams new output. on_exit is called on the I/O thread when the
+    // session exits or the connection is lost for good (with -1). on_started
+    // gets the agent's process group once the daemon reports it (at once for
+    // a session that is already running), on the calling or the I/O thread.
+    bool attach(uint64_t key, std::shared_ptr<ByteRing> ring, ExitCallback on_exit,
+                StartedCallback on_started = nullptr);
+    // Output of the session is also appended to recorder while set; set it
+    // before attach() to record the replay too.
+    void set_recorder(uint64_t key, std::shared_ptr<SessionRecorder> recorder);
+    // Stops streaming; the session keeps running in the daemon.
+    void detach(uint64_t key);
+    // Sent in frames of at most MAX_INPUT_FRAME bytes. Returns false, sending
+    // nothing, when not connected or more than MAX_PENDING_INPUT bytes would
+    // be waiting for the socket.
+    bool write(uint64_t key, std::string_view data);
+    bool resize(uint64_t key, int rows, int cols);
+    bool stop(uint64_t key);
+    bool kill(uint64_t key);
+    // Ends the session if it still runs and frees its buffer in the daemon.
+    bool release(uint64_t key);
+
+    static constexpr size_t MAX_PENDING_INPUT = ProcessRunner::MAX_PENDING_INPUT;
+
+private:
+    struct Attachment {
+        std::shared_ptr<ByteRing> ring;
+        ExitCallback on_exit;
+        StartedCallback on_started;
+        std::string pending;        // received, waiting for room in the ring
+        size_t pending_offset = 0;
+        uint64_t received = 0;      // stream position after the last output
+        size_t owed = 0;            // daemon output in pending, not yet credited
+        size_t ungranted = 0;       // taken into the ring, not yet credited
+        bool waiting = false;       // for the ring's drain wakeup
+        bool exited = false;        // reported once pending is empty
+        int exit_code = -1;
+    };
+
+    bool open_connection(int& fd, std::vector<DaemonSessionInfo>& sessions, std::string* error);
+    bool send_frame(FrameType type, uint64_t key, std::string_view payload = {});
+    void flush_locked(bool wake_if_left);
+    void wake();
+    void run();
+    bool receive();
+    bool reconnect();
+    void drop_connection();
+    void handle_output(uint64_t key, const std::string& payload);
+    void handle_exit(uint64_t key, int exit_code);
+    void handle_error(uint64_t key, const std::string& message);
+    void handle_sessions(const std::string& payload);
+    void move_pending();
+    void forget_locked(uint64_t key);
+
+    std::string socket_path_;
+    std::atomic<bool> connected_{false};
+    std::atomic<bool> stopping_{false};
+    int wake_fds_[2] = {-1, -1};
+
+    // Frames the socket has not taken yet. fd_ changes only on the I/O
+    // thread, under this lock.
+    std::mutex out_mutex_;
+    int fd_ = -1;
+    std::string out_;
+    size_t out_offset_ = 0;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint64_t, Attachment> attachments_;
+    std::unordered_map<uint64_t, std::shared_ptr<SessionRecorder>> recorders_;
+    std::unordered_map<uint64_t, DaemonSessionInfo> known_;
+
+    FrameReader reader_;
+    std::thread io_thread_;
+};
+
+}
@@ -0,0 +1,214 @@
+#include "session_protocol.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+
+namespace diana {
+
+namespace {
+
+void append_string(std::string& out, std::string_view value) {
+    append_u32(out, static_cast<uint32_t>(value.size()));
+    out.append(value.data(), value.size());
+}
+
+bool read_string(std::string_view data, size_t& pos, std::string& value) {
+    uint32_t size = 0;
+    if (!read_u32(data, pos, size) || data.size() - pos < size) {
+        return false;
+    }
+    value.assign(data.data() + pos, size);
+    pos += size;
+    return true;
+}
+
+template <typename T>
+bool read_le(std::string_view data, size_t& pos, T& value) {
+    if (data.size() < pos || data.size() - pos < sizeof(T)) {
+        return false;
+    }
+    T result = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        result |= static_cast<T>(static_cast<unsigned char>(data[pos + i])) << (8 * i);
+    }
+    value = result;
+    pos += sizeof(T);
+    return true;
+}
+
+template <typename T>
+void append_le(std::string& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+}
+
+void append_u16(std::string& out, uint16_t value) { append_le(out, value); }
+void append_u32(std::string& out, uint32_t value) { append_le(out, value); }
+void append_u64(std::string& out, uint64_t value) { append_le(out, value); }
+bool read_u16(std::string_view data, size_t& pos, uint16_t& value) { return read_le(data, pos, value); }
+bool read_u32(std::string_view data, size_t& pos, uint32_t& value) { return read_le(data, pos, value); }
+bool read_u64(std::string_view data, size_t& pos, uint64_t& value) { return read_le(data, pos, value); }
+
+void append_frame(std::string& out, FrameType type, uint64_t session, std::string_view payload) {
+    out.reserve(out.size() + FRAME_HEADER_SIZE + payload.size());
+    append_u32(out, static_cast<uint32_t>(payload.size()));
+    out.push_back(static_cast<char>(type));
+    append_u64(out, session);
+    out.append(payload.data(), payload.size());
+}
+
+void FrameReader::feed(const char* data, size_t size) {
+    // Compact once the consumed prefix dominates, so the buffer stays small.
+    if (offset_ > 0 && offset_ >= buffer_.size() / 2) {
+        buffer_.erase(0, offset_);
+        offset_ = 0;
+    }
+    buffer_.append(data, size);
+}
+
+bool FrameReader::next(Frame& frame) {
+    if (failed_) {
+        return false;
+    }
+    std::string_view available(buffer_.data() + offset_, buffer_.size() - offset_);
+    if (available.size() < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    size_t pos = 0;
+    uint32_t size = 0;
+    read_u32(available, pos, size);
+    auto type = static_cast<uint8_t>(available[pos++]);
+    if (size > MAX_FRAME_PAYLOAD || type < static_cast<uint8_t>(FrameType::Hello) ||
+        type > static_cast<uint8_t>(FrameType::Credit)) {
+        failed_ = true;
+        return false;
+    }
+    if (available.size() < FRAME_HEADER_SIZE + size) {
+        return false;
+    }
+    frame.type = static_cast<FrameType>(type);
+    read_u64(available, pos, frame.session);
+    frame.payload.assign(available.data() + FRAME_HEADER_SIZE, size);
+    offset_ += FRAME_HEADER_SIZE + size;
+    return true;
+}
+
+std::string encode_spawn(const SpawnRequest& request) {
+    std::string out;
+    append_string(out, request.executable);
+    append_string(out, request.working_dir);
+    append_u16(out, static_cast<uint16_t>(request.rows));
+    append_u16(out, static_cast<uint16_t>(request.cols));
+    append_u32(out, static_cast<uint32_t>(request.args.size()));
+    for (const auto& arg : request.args) {
+        append_string(out, arg);
+    }
+    return out;
+}
+
+bool decode_spawn(std::string_view payload, SpawnRequest& request) {
+    size_t pos = 0;
+    uint16_t rows = 0;
+    uint16_t cols = 0;
+    uint32_t argc = 0;
+    if (!read_string(payload, pos, request.executable) || !read_string(payload, pos, request.working_dir) ||
+        !read_u16(payload, pos, rows) || !read_u16(payload, pos, cols) || !read_u32(payload, pos, argc)) {
+        return false;
+    }
+    request.rows = rows;
+    request.cols = cols;
+    request.args.clear();
+    for (uint32_t i = 0; i < argc; ++i) {
+        std::string arg;
+        if (!read_string(payload, pos, arg)) {
+            return false;
+        }
+        request.args.push_back(std::move(arg));
+    }
+    return pos == payload.size();
+}
+
+std::string encode_sessions(const std::vector<DaemonSessionInfo>& sessions) {
+    std::string out;
+    append_u32(out, static_cast<uint32_t>(sessions.size()));
+    for (const auto& session : sessions) {
+        append_u64(out, session.key);
+        out.push_back(session.running ? 1 : 0);
+        append_u32(out, static_cast<uint32_t>(session.exit_code));
+        append_u32(out, static_cast<uint32_t>(session.pgid));
+    }
+    return out;
+}
+
+bool decode_sessions(std::string_view payload, std::vector<DaemonSessionInfo>& sessions) {
+    size_t pos = 0;
+    uint32_t count = 0;
+    if (!read_u32(payload, pos, count)) {
+        return false;
+    }
+    sessions.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        DaemonSessionInfo info;
+        uint32_t exit_code = 0;
+        uint32_t pgid = 0;
+        if (!read_u64(payload, pos, info.key) || pos >= payload.size()) {
+            return false;
+        }
+        info.running = payload[pos++] != 0;
+        if (!read_u32(payload, pos, exit_code) || !read_u32(payload, pos, pgid)) {
+            return false;
+        }
+        info.exit_code = static_cast<int>(exit_code);
+        info.pgid = static_cast<pid_t>(static_cast<int32_t>(pgid));
+        sessions.push_back(info);
+    }
+    return true;
+}
+
+std::string default_sessiond_socket_path() {
+    if (const char* path = std::getenv("DIANA_SESSIOND_SOCKET"); path && *path) {
+        return path;
+    }
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"); runtime && *runtime) {
+        return std::string(runtime) + "/diana-sessiond.sock";
+    }
+    const char* home = std::getenv("HOME");
+    if (!home) return "";
+    return std::string(home) + "/.config/diana/diana-sessiond.sock";
+}
+
+ssize_t send_some(int fd, const char* data, size_t size) {
+#ifdef MSG_NOSIGNAL
+    return send(fd, data, size, MSG_NOSIGNAL);
+#else
+    return send(fd, data, size, 0);
+#endif
+}
+
+bool send_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = send_some(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void disable_sigpipe(int fd) {
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#else
+    (void)fd;
+#endif
+}
+
+}
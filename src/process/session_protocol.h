@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <sys/types.h>
+
+namespace diana {
+
+// Wire format between diana and diana-sessiond over a Unix stream socket.
+// Every message is one frame:
+//
+//   u32 payload length | u8 type | u64 session key | payload
+//
+// with integers little-endian. Session keys are chosen by the GUI and saved
+// with its tabs, so a restarted GUI finds its sessions again.
+//
+// Output is flow-controlled per session: after an Attach the daemon sends
+// at most SESSION_OUTPUT_WINDOW bytes beyond what the GUI has returned in
+// Credit frames, and holds the agent's PTY meanwhile. A GUI that cannot keep
+// up with one session therefore never holds back the others.
+enum class FrameType : uint8_t {
+    Hello = 1,      // both ways, first frame; payload u32 protocol version
+    List,           // GUI: which sessions do you hold
+    Sessions,       // daemon: per session u64 key, u8 running, i32 exit code,
+                    // i32 process group; also sent for one session after Spawn
+    Spawn,          // GUI: start a session (encode_spawn payload)
+    Attach,         // GUI: replay the session's buffered output, then stream
+                    // it; optional u64 stream position to replay from
+    Detach,         // GUI: stop streaming; the session keeps running
+    Input,          // GUI: bytes for the PTY
+    Resize,         // GUI: u16 rows, u16 cols
+    Stop,           // GUI: SIGTERM, then SIGKILL
+    Kill,           // GUI: SIGKILL
+    Release,        // GUI: end the session if needed and drop its buffer
+    Output,         // daemon: u64 stream position, then bytes from the PTY
+    Exited,         // daemon: i32 exit code
+    Error,          // daemon: payload is a message
+    Credit,         // GUI: u32 bytes of output it has taken in
+};
+
+struct Frame {
+    FrameType type = FrameType::Error;
+    uint64_t session = 0;
+    std::string payload;
+};
+
+struct SpawnRequest {
+    std::string executable;
+    std::vector<std::string> args;
+    std::string working_dir;
+    int rows = 24;
+    int cols = 80;
+};
+
+struct DaemonSessionInfo {
+    uint64_t key = 0;
+    bool running = false;
+    int exit_code = -1;
+    pid_t pgid = -1;        // the agent leads it; -1 until it has started
+};
+
+constexpr uint32_t SESSION_PROTOCOL_VERSION = 1;
+constexpr size_t FRAME_HEADER_SIZE = 13;
+constexpr size_t MAX_FRAME_PAYLOAD = 16 * 1024 * 1024;
+constexpr size_t SESSION_OUTPUT_WINDOW = 1024 * 1024;
+// Input is split into frames of at most this size.
+constexpr size_t MAX_INPUT_FRAME = 64 * 1024;
+
+void append_frame(std::string& out, FrameType type, uint64_t session, std::string_view payload = {});
+
+// Reassembles frames from a byte stream that may split them anywhere.
+class FrameReader {
+public:
+    void feed(const char* data, size_t size);
+    // Pops the next complete frame. Returns false when none is complete yet
+    // or the stream is broken (see failed()).
+    bool next(Frame& frame);
+    // A frame announced more than MAX_FRAME_PAYLOAD bytes or an unknown type.
+    bool failed() const { return failed_; }
+
+private:
+    std::string buffer_;
+    size_t offset_ = 0;
+    bool failed_ = false;
+};
+
+void append_u16(std::string& out, uint16_t value);
+void append_u32(std::string& out, uint32_t value);
+void append_u64(std::string& out, uint64_t value);
+// Readers advance pos; they return false when data is too short.
+bool read_u16(std::string_view data, size_t& pos, uint16_t& value);
+bool read_u32(std::string_view data, size_t& pos, uint32_t& value);
+bool read_u64(std::string_view data, size_t& pos, uint64_t& value);
+
+std::string encode_spawn(const SpawnRequest& request);
+bool decode_spawn(std::string_view payload, SpawnRequest& request);
+std::string encode_sessions(const std::vector<DaemonSessionInfo>& sessions);
+bool decode_sessions(std::string_view payload, std::vector<DaemonSessionInfo>& sessions);
+
+// $DIANA_SESSIOND_SOCKET, else diana-sessiond.sock in $XDG_RUNTIME_DIR or
+// ~/.config/diana.
+std::string default_sessiond_socket_path();
+
+// send(2) without SIGPIPE for a closed peer.
+ssize_t send_some(int fd, const char* data, size_t size);
+// Writes all of data to a blocking socket. Returns false on error.
+bool send_all(int fd, const char* data, size_t size);
+// Makes writes to a closed peer fail with EPIPE instead of a signal where
+// the platform needs a socket option for it (macOS).
+void disable_sigpipe(int fd);
+
+}
@@ -0,0 +1,289 @@
+#include "process/session_recorder.h"
+
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace diana {
+
+namespace {
+
+constexpr char MAGIC[8] = {'D', 'I', 'A', 'N', 'A', 'R', 'E', 'C'};
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 4 + 2 + 2 + 8;
+constexpr size_t FRAME_HEADER_SIZE = 8 + 4 + 1;
+
+template <typename T>
+void put_le(char* out, T value) {
+    auto bits = static_cast<typename std::make_unsigned<T>::type>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out[i] = static_cast<char>((bits >> (8 * i)) & 0xFF);
+    }
+}
+
+template <typename T>
+T get_le(const char* in) {
+    typename std::make_unsigned<T>::type bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bits |= static_cast<typename std::make_unsigned<T>::type>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return static_cast<T>(bits);
+}
+
+int64_t unix_now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+void set_error(std::string* error, const std::string& message) {
+    if (error) *error = message;
+}
+
+// Length of the longest prefix of data that does not end inside a UTF-8
+// sequence.
+size_t complete_utf8_prefix(const std::string& data) {
+    size_t n = data.size();
+    for (size_t back = 1; back <= std::min<size_t>(3, n); ++back) {
+        auto c = static_cast<unsigned char>(data[n - back]);
+        if ((c & 0xC0) == 0x80) continue;
+        size_t need = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+        return need > back ? n - back : n;
+    }
+    return n;
+}
+
+}
+
+bool Recording::resize_of(const RecordedFrame& frame, int& rows_out, int& cols_out) const {
+    if (frame.kind != RecordedFrameKind::Resize || frame.size < 4) return false;
+    const char* p = payload.data() + frame.offset;
+    cols_out = get_le<uint16_t>(p);
+    rows_out = get_le<uint16_t>(p + 2);
+    return true;
+}
+
+uint64_t Recording::output_bytes() const {
+    uint64_t total = 0;
+    for (const auto& frame : frames) {
+        if (frame.kind == RecordedFrameKind::Output) total += frame.size;
+    }
+    return total;
+}
+
+std::optional<Recording> Recording::load(const std::string& path, std::string* error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        set_error(error, "cannot open " + path);
+        return std::nullopt;
+    }
+    std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    
+    if (bytes.size() < HEADER_SIZE || std::memcmp(bytes.data(), MAGIC, sizeof(MAGIC)) != 0) {
+        set_error(error, path + " is not a session recording");
+        return std::nullopt;
+    }
+    const char* p = bytes.data() + sizeof(MAGIC);
+    uint32_t version = get_le<uint32_t>(p);
+    if (version != SessionRecorder::FORMAT_VERSION) {
+        set_error(error, "unsupported recording version " + std::to_string(version));
+        return std::nullopt;
+    }
+    
+    Recording recording;
+    recording.cols = get_le<uint16_t>(p + 4);
+    recording.rows = get_le<uint16_t>(p + 6);
+    recording.start_unix_us = get_le<int64_t>(p + 8);
+    recording.payload.reserve(bytes.size() - HEADER_SIZE);
+    
+    size_t pos = HEADER_SIZE;
+    while (pos < bytes.size()) {
+        if (bytes.size() - pos < FRAME_HEADER_SIZE) {
+            recording.truncated = true;
+            break;
+        }
+        const char* f = bytes.data() + pos;
+        RecordedFrame frame;
+        frame.time_us = get_le<uint64_t>(f);
+        frame.size = get_le<uint32_t>(f + 8);
+        frame.kind = static_cast<RecordedFrameKind>(f[12]);
+        pos += FRAME_HEADER_SIZE;
+        if (bytes.size() - pos < frame.size) {
+            recording.truncated = true;
+            break;
+        }
+        frame.offset = recording.payload.size();
+        recording.payload.append(bytes, pos, frame.size);
+        pos += frame.size;
+        
+        if (frame.kind == RecordedFrameKind::Output || frame.kind == RecordedFrameKind::Resize) {
+            recording.frames.push_back(frame);
+        }
+    }
+    return recording;
+}
+
+bool Recording::export_asciicast(const std::string& path, std::string* error) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        set_error(error, "cannot write " + path);
+        return false;
+    }
+    
+    const auto dump = [](const nlohmann::json& value) {
+        return value.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+    };
+    
+    nlohmann::json header;
+    header["version"] = 2;
+    header["width"] = cols;
+    header["height"] = rows;
+    header["timestamp"] = start_unix_us / 1000000;
+    out << dump(header) << '\n';
+    
+    std::string carry;
+    for (const auto& frame : frames) {
+        double t = static_cast<double>(frame.time_us) / 1e6;
+        if (frame.kind == RecordedFrameKind::Resize) {
+            int r = 0, c = 0;
+            resize_of(frame, r, c);
+            out << dump(nlohmann::json::array({t, "r", std::to_string(c) + "x" + std::to_string(r)})) << '\n';
+            continue;
+        }
+        carry.append(payload, frame.offset, frame.size);
+        size_t complete = complete_utf8_prefix(carry);
+        if (complete == 0) continue;
+        out << dump(nlohmann::json::array({t, "o", carry.substr(0, complete)})) << '\n';
+        carry.erase(0, complete);
+    }
+    if (!carry.empty()) {
+        out << dump(nlohmann::json::array({duration_seconds(), "o", carry})) << '\n';
+    }
+    
+    if (!out) {
+        set_error(error, "failed writing " + path);
+        return false;
+    }
+    return true;
+}
+
+SessionRecorder::~SessionRecorder() {
+    close();
+}
+
+bool SessionRecorder::open(const std::string& path, int rows, int cols, std::string* error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0) {
+        set_error(error, "already recording to " + path_);
+        return false;
+    }
+    
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        set_error(error, "cannot create " + path + ": " + std::strerror(errno));
+        return false;
+    }
+    fd_ = fd;
+    path_ = path;
+    buffer_.clear();
+    buffer_.reserve(BUFFER_SIZE);
+    start_ = Clock::now();
+    last_flush_ = start_;
+    bytes_recorded_.store(0, std::memory_order_relaxed);
+    
+    char header[HEADER_SIZE];
+    std::memcpy(header, MAGIC, sizeof(MAGIC));
+    put_le<uint32_t>(header + 8, FORMAT_VERSION);
+    put_le<uint16_t>(header + 12, static_cast<uint16_t>(cols));
+    put_le<uint16_t>(header + 14, static_cast<uint16_t>(rows));
+    put_le<int64_t>(header + 16, unix_now_us());
+    buffer_.insert(buffer_.end(), header, header + HEADER_SIZE);
+    return true;
+}
+
+void SessionRecorder::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) return;
+    flush_locked();
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool SessionRecorder::is_open() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return fd_ >= 0;
+}
+
+void SessionRecorder::record_output(const char* data, size_t len) {
+    if (len == 0) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) return;
+    append_frame_locked(RecordedFrameKind::Output, data, len);
+    bytes_recorded_.fetch_add(len, std::memory_order_relaxed);
+}
+
+void SessionRecorder::record_resize(int rows, int cols) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ < 0) return;
+    char size[4];
+    put_le<uint16_t>(size, static_cast<uint16_t>(cols));
+    put_le<uint16_t>(size + 2, static_cast<uint16_t>(rows));
+    append_frame_locked(RecordedFrameKind::Resize, size, sizeof(size));
+}
+
+void SessionRecorder::flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (fd_ >= 0) flush_locked();
+}
+
+void SessionRecorder::append_frame_locked(RecordedFrameKind kind, const char* data, size_t len) {
+    Clock::time_point now = Clock::now();
+    auto time_us = std::chrono::duration_cast<std::chrono::microseconds>(now - start_).count();
+    
+    char frame[FRAME_HEADER_SIZE];
+    put_le<uint64_t>(frame, static_cast<uint64_t>(time_us));
+    put_le<uint32_t>(frame + 8, static_cast<uint32_t>(len));
+    frame[12] = static_cast<char>(kind);
+    
+    if (buffer_.size() + FRAME_HEADER_SIZE + len > BUFFER_SIZE) {
+        flush_locked();
+    }
+    buffer_.insert(buffer_.end(), frame, frame + FRAME_HEADER_SIZE);
+    if (len > BUFFER_SIZE) {
+        // Too big to stage; write it through.
+        flush_locked();
+        write_all_locked(data, len);
+    } else {
+        buffer_.insert(buffer_.end(), data, data + len);
+    }
+    
+    if (now - last_flush_ >= FLUSH_INTERVAL) {
+        flush_locked();
+    }
+}
+
+void SessionRecorder::flush_locked() {
+    last_flush_ = Clock::now();
+    if (buffer_.empty()) return;
+    write_all_locked(buffer_.data(), buffer_.size());
+    buffer_.clear();
+}
+
+void SessionRecorder::write_all_locked(const char* data, size_t len) {
+    writes_.fetch_add(1, std::memory_order_relaxed);
+    while (len > 0) {
+        ssize_t n = ::write(fd_, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Disk full or similar: drop the data rather than stall the
+            // session's IO thread.
+            return;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace diana {
+
+// On-disk layout of a session recording (all integers little-endian):
+//   header  "DIANAREC", u32 version, u16 cols, u16 rows, i64 start (unix us)
+//   frames  u64 time since start (us), u32 payload size, u8 kind, payload
+// Frames are only ever appended, so a recording cut short by a crash loses at
+// most its unflushed tail.
+enum class RecordedFrameKind : uint8_t {
+    Output = 'o',   // bytes read from the PTY
+    Resize = 'r',   // payload is u16 cols, u16 rows
+};
+
+struct RecordedFrame {
+    uint64_t time_us = 0;
+    RecordedFrameKind kind = RecordedFrameKind::Output;
+    size_t offset = 0;   // into Recording::payload
+    size_t size = 0;
+};
+
+struct Recording {
+    int rows = 24;
+    int cols = 80;
+    int64_t start_unix_us = 0;
+    std::string payload;
+    std::vector<RecordedFrame> frames;
+    bool truncated = false;   // the file ended inside a frame
+
+    std::string_view data(const RecordedFrame& frame) const {
+        return std::string_view(payload).substr(frame.offset, frame.size);
+    }
+    bool resize_of(const RecordedFrame& frame, int& rows_out, int& cols_out) const;
+    double duration_seconds() const {
+        return frames.empty() ? 0.0 : static_cast<double>(frames.back().time_us) / 1e6;
+    }
+    uint64_t output_bytes() const;
+
+    static std::optional<Recording> load(const std::string& path, std::string* error = nullptr);
+
+    // asciicast v2: a JSON header line followed by [time, "o"|"r", data]
+    // events. Output is split on UTF-8 boundaries as asciinema expects.
+    bool export_asciicast(const std::string& path, std::string* error = nullptr) const;
+};
+
+// Appends PTY output to a recording. Frames are staged in memory and written
+// when the buffer fills or FLUSH_INTERVAL has passed, so recording costs a
+// memcpy per read rather than a syscall. Safe to call from the IO thread and
+// the UI thread at once.
+class SessionRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr size_t BUFFER_SIZE = 256 * 1024;
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{1000};
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    SessionRecorder() = default;
+    ~SessionRecorder();
+
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+
+    bool open(const std::string& path, int rows, int cols, std::string* error = nullptr);
+    void close();
+    bool is_open() const;
+
+    void record_output(const char* data, size_t len);
+    void record_resize(int rows, int cols);
+    void flush();
+
+    const std::string& path() const { return path_; }
+    uint64_t bytes_recorded() const { return bytes_recorded_.load(std::memory_order_relaxed); }
+    uint64_t writes() const { return writes_.load(std::memory_order_relaxed); }
+
+private:
+    void append_frame_locked(RecordedFrameKind kind, const char* data, size_t len);
+    void flush_locked();
+    void write_all_locked(const char* data, size_t len);
+
+    mutable std::mutex mutex_;
+    int fd_ = -1;
+    std::string path_;
+    std::vector<char> buffer_;
+    Clock::time_point start_;
+    Clock::time_point last_flush_;
+    std::atomic<uint64_t> bytes_recorded_{0};
+    std::atomic<uint64_t> writes_{0};
+};
+
+}
@@ -0,0 +1,241 @@
+#include "warm_pool.h"
+#include <fstream>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <libproc.h>
+#endif
+
+namespace diana {
+
+namespace {
+
+// Resident memory of a single process, 0 when it cannot be read.
+size_t resident_bytes(pid_t pid) {
+    if (pid <= 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    struct proc_taskinfo info;
+    if (proc_pidinfo(pid, PROC_PIDTASKINFO, 0, &info, sizeof(info)) != static_cast<int>(sizeof(info))) {
+        return 0;
+    }
+    return static_cast<size_t>(info.pti_resident_size);
+#else
+    std::ifstream statm("/proc/" + std::to_string(pid) + "/statm");
+    size_t total_pages = 0;
+    size_t resident_pages = 0;
+    if (!(statm >> total_pages >> resident_pages)) {
+        return 0;
+    }
+    return resident_pages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+}
+
+WarmPool::WarmPool(ConfigFactory factory, WarmPoolLimits limits, IoReactor& reactor)
+    : factory_(std::move(factory))
+    , limits_(limits)
+    , reactor_(reactor)
+{
+}
+
+WarmPool::~WarmPool() {
+    std::vector<Agent> agents;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for (auto& [key, slot] : slots_) {
+            for (auto& agent : slot.idle) {
+                agents.push_back(std::move(agent));
+            }
+        }
+        slots_.clear();
+    }
+    // Each runner's destructor waits out its exit callback and ends the child.
+    agents.clear();
+}
+
+void WarmPool::keep_warm(AppKind app, const std::string& working_dir, size_t count) {
+    std::vector<Agent> dead;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Key key(app, working_dir);
+        if (count == 0) {
+            auto it = slots_.find(key);
+            if (it == slots_.end()) {
+                return;
+            }
+            for (auto& agent : it->second.idle) {
+                dead.push_back(std::move(agent));
+            }
+            slots_.erase(it);
+        } else {
+            Slot& slot = slots_[key];
+            slot.wanted = count;
+            slot.paused = false;
+            while (slot.idle.size() > count) {
+                dead.push_back(std::move(slot.idle.back()));
+                slot.idle.pop_back();
+            }
+        }
+    }
+    dead.clear();
+    schedule_refill();
+}
+
+std::unique_ptr<ProcessRunner> WarmPool::take(AppKind app, const ProcessConfig& config,
+                                              std::shared_ptr<ByteRing> ring, ExitCallback on_exit) {
+    std::vector<Agent> dead;
+    std::unique_ptr<ProcessRunner> taken;
+    while (!taken) {
+        Agent agent;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = slots_.find(Key(app, config.working_dir));
+            if (it == slots_.end() || it->second.idle.empty()) {
+                break;
+            }
+            agent = std::move(it->second.idle.back());
+            it->second.idle.pop_back();
+        }
+        // An agent for an executable that has since moved is no use.
+        bool current = !config.plan || agent.executable == config.plan->path();
+        if (current && agent.runner->is_running()) {
+            agent.runner->resize(config.rows, config.cols);
+            if (agent.runner->hand_over(ring, on_exit)) {
+                taken = std::move(agent.runner);
+                break;
+            }
+        }
+        dead.push_back(std::move(agent));
+    }
+    dead.clear();
+    if (taken) {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    schedule_refill();
+    return taken;
+}
+
+size_t WarmPool::idle() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_locked();
+}
+
+void WarmPool::schedule_refill() {
+    if (!refill_pending_.exchange(true)) {
+        pool_.submit([this] { refill(); });
+    }
+}
+
+// Starts agents one at a time, outside the lock: start() waits on the
+// reactor thread, where exit callbacks take the lock.
+void WarmPool::refill() {
+    refill_pending_.store(false);
+    std::vector<Agent> dead;
+    while (true) {
+        Key key;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) {
+                break;
+            }
+            prune_locked(dead);
+            auto it = slots_.begin();
+            while (it != slots_.end() && (it->second.paused || it->second.idle.size() >= it->second.wanted)) {
+                ++it;
+            }
+            if (it == slots_.end()) {
+                break;
+            }
+            if (idle_locked() >= limits_.max_processes || idle_rss_locked() >= limits_.max_rss_bytes) {
+                limited_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+            key = it->first;
+        }
+        dead.clear();
+
+        ProcessConfig config = factory_(key.first, key.second);
+        auto started = std::chrono::steady_clock::now();
+        Agent agent;
+        agent.runner = std::make_unique<ProcessRunner>(reactor_);
+        agent.runner->set_output_ring(std::make_shared<ByteRing>(IDLE_RING_CAPACITY));
+        agent.runner->set_exit_callback([this, key, started](int) { on_idle_exit(key, started); });
+        agent.executable = config.plan ? config.plan->path() : config.executable;
+        agent.started = started;
+        if (!agent.runner->start(config)) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = slots_.find(key);
+            if (it != slots_.end()) {
+                it->second.paused = true;
+            }
+            continue;
+        }
+        spawned_.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = slots_.find(key);
+        if (stopping_ || it == slots_.end() || it->second.idle.size() >= it->second.wanted) {
+            dead.push_back(std::move(agent));
+        } else {
+            it->second.idle.push_back(std::move(agent));
+        }
+    }
+    dead.clear();
+}
+
+// Reactor thread. The agent itself is removed by the next refill.
+void WarmPool::on_idle_exit(const Key& key, std::chrono::steady_clock::time_point started) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        auto it = slots_.find(key);
+        if (it != slots_.end() && std::chrono::steady_clock::now() - started < EARLY_EXIT) {
+            it->second.paused = true;
+        }
+    }
+    schedule_refill();
+}
+
+size_t WarmPool::idle_locked() const {
+    size_t count = 0;
+    for (const auto& [key, slot] : slots_) {
+        count += slot.idle.size();
+    }
+    return count;
+}
+
+// Counts only each agent's own process; tools it starts later are not
+// running yet while it idles.
+size_t WarmPool::idle_rss_locked() const {
+    size_t total = 0;
+    for (const auto& [key, slot] : slots_) {
+        for (const auto& agent : slot.idle) {
+            if (agent.runner->is_running()) {
+                total += resident_bytes(agent.runner->pid());
+            }
+        }
+    }
+    return total;
+}
+
+void WarmPool::prune_locked(std::vector<Agent>& dead) {
+    for (auto& [key, slot] : slots_) {
+        for (auto it = slot.idle.begin(); it != slot.idle.end();) {
+            if (it->runner->is_running()) {
+                ++it;
+            } else {
+                dead.push_back(std::move(*it));
+                it = slot.idle.erase(it);
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "core/byte_ring.h"
+#include "core/thread_pool.h"
+#include "core/types.h"
+#include "process/io_reactor.h"
+#include "process/process_runner.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace diana {
+
+struct WarmPoolLimits {
+    size_t max_processes = 4;                       // idle agents across all keys
+    size_t max_rss_bytes = size_t(2) << 30;         // summed RSS of the idle agents
+};
+
+// Agents started ahead of time so a new tab does not wait for a runtime to
+// boot. For each (app, working directory) that is kept warm, up to the
+// requested number of agents idle on their own PTY, buffering their first
+// screen into a private ring. take() hands one to a session, resized to the
+// session's terminal, and a background thread starts its replacement.
+//
+// Refills stop at the process and memory limits. An idle agent that exits
+// within EARLY_EXIT of being started pauses its key until keep_warm() is
+// called for it again, so a broken install is not restarted in a loop.
+class WarmPool {
+public:
+    // Builds the launch config for an app in a directory. Called on the
+    // refill thread.
+    using ConfigFactory = std::function<ProcessConfig(AppKind app, const std::string& working_dir)>;
+
+    static constexpr size_t IDLE_RING_CAPACITY = 256 * 1024;
+    static constexpr std::chrono::seconds EARLY_EXIT{10};
+
+    explicit WarmPool(ConfigFactory factory, WarmPoolLimits limits = {},
+                      IoReactor& reactor = IoReactor::instance());
+    ~WarmPool();
+
+    WarmPool(const WarmPool&) = delete;
+    WarmPool& operator=(const WarmPool&) = delete;
+
+    // Keeps count agents idle for app in working_dir; 0 stops the idle ones.
+    void keep_warm(AppKind app, const std::string& working_dir, size_t count);
+
+    // An idle agent matching config's app directory and executable, now
+    // writing to ring and reporting its exit to on_exit, or nullptr.
+    std::unique_ptr<ProcessRunner> take(AppKind app, const ProcessConfig& config,
+                                        std::shared_ptr<ByteRing> ring, ExitCallback on_exit);
+
+    size_t idle() const;
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+    uint64_t spawned() const { return spawned_.load(std::memory_order_relaxed); }
+    // Refills skipped because a limit was reached.
+    uint64_t limited() const { return limited_.load(std::memory_order_relaxed); }
+
+private:
+    using Key = std::pair<AppKind, std::string>;
+
+    struct Agent {
+        std::unique_ptr<ProcessRunner> runner;
+        std::string executable;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    struct Slot {
+        size_t wanted = 0;
+        bool paused = false;
+        std::vector<Agent> idle;
+    };
+
+    void schedule_refill();
+    void refill();
+    void on_idle_exit(const Key& key, std::chrono::steady_clock::time_point started);
+    size_t idle_locked() const;
+    size_t idle_rss_locked() const;
+    void prune_locked(std::vector<Agent>& dead);
+
+    ConfigFactory factory_;
+    WarmPoolLimits limits_;
+    IoReactor& reactor_;
+
+    mutable std::mutex mutex_;
+    std::map<Key, Slot> slots_;
+    bool stopping_ = false;
+
+    std::atomic<bool> refill_pending_{false};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> spawned_{0};
+    std::atomic<uint64_t> limited_{0};
+    // Last, so it is joined before the state its tasks use goes away.
+    ThreadPool pool_{1};
+};
+
+}
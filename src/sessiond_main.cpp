@@ -0,0 +1,121 @@
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "process/io_reactor.h"
+#include "process/session_daemon.h"
+#include "process/session_protocol.h"
+
+// diana-sessiond: keeps agent sessions running across GUI restarts. Diana
+// connects to it on startup when it is running; see session_daemon.h.
+
+static void print_usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [--socket PATH] [--detach]\n"
+            "  --socket PATH  listen on PATH (default: %s)\n"
+            "  --detach       run in the background once listening\n",
+            argv0, diana::default_sessiond_socket_path().c_str());
+}
+
+// Forks before any thread exists. The parent exits once the child reports
+// whether it is listening, so `diana-sessiond --detach && diana` is safe.
+static int detach_or_report(int& report_fd) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (pid > 0) {
+        close(fds[1]);
+        std::string message;
+        char buffer[256];
+        ssize_t n;
+        while ((n = read(fds[0], buffer, sizeof(buffer))) > 0) {
+            message.append(buffer, static_cast<size_t>(n));
+        }
+        if (message == "ok") {
+            _exit(0);
+        }
+        fprintf(stderr, "diana-sessiond: %s\n", message.empty() ? "exited during startup" : message.c_str());
+        _exit(1);
+    }
+    close(fds[0]);
+    setsid();
+    int null_fd = open("/dev/null", O_RDWR);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDIN_FILENO);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (null_fd > STDERR_FILENO) close(null_fd);
+    }
+    report_fd = fds[1];
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    std::string socket_path = diana::default_sessiond_socket_path();
+    bool detach = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--socket") == 0 && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else if (std::strcmp(argv[i], "--detach") == 0) {
+            detach = true;
+        } else {
+            print_usage(argv[0]);
+            return std::strcmp(argv[i], "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    int report_fd = -1;
+    if (detach) {
+        if (int rc = detach_or_report(report_fd); rc >= 0) {
+            return rc;
+        }
+    }
+
+    // Blocked before the reactor thread starts so every thread inherits the
+    // mask and the signals are only taken by sigwait below.
+    signal(SIGPIPE, SIG_IGN);
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    diana::SessionDaemon daemon(diana::IoReactor::instance());
+    std::string error;
+    bool listening = daemon.listen(socket_path, &error);
+    if (report_fd >= 0) {
+        const std::string message = listening ? "ok" : error;
+        ssize_t written = write(report_fd, message.data(), message.size());
+        (void)written;
+        close(report_fd);
+    }
+    if (!listening) {
+        fprintf(stderr, "diana-sessiond: %s\n", error.c_str());
+        return 1;
+    }
+    if (!detach) {
+        fprintf(stderr, "diana-sessiond: listening on %s\n", socket_path.c_str());
+    }
+
+    while (true) {
+        int sig = 0;
+        if (sigwait(&signals, &sig) != 0 || sig == SIGHUP) {
+            continue;
+        }
+        break;
+    }
+    return 0;
+}
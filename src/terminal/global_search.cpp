@@ -0,0 +1,319 @@
+#include "global_search.h"
+#include "core/redraw_scheduler.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <optional>
+#include <regex>
+
+namespace diana {
+
+namespace {
+
+// Lines copied out of a scrollback per lock when matching a regex.
+constexpr uint64_t REGEX_CHUNK_LINES = 2048;
+constexpr size_t CONTEXT_BEFORE = 40;
+constexpr size_t CONTEXT_AFTER = 100;
+
+bool is_utf8_continuation(char c) {
+    return (static_cast<unsigned char>(c) & 0xC0) == 0x80;
+}
+
+// A match inside one line, in bytes of the line's projected text.
+struct LineMatch {
+    uint64_t line = 0;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+SearchHit to_hit(const LineText& line, const LineMatch& match) {
+    SearchHit hit;
+    hit.line = match.line;
+    hit.col = line.column_of(match.begin);
+    hit.end_col = match.end < line.text.size() ? line.column_of(match.end) : line.column_of(match.end - 1) + 1;
+    return hit;
+}
+
+GlobalSearchResult make_result(uint32_t session_id, const LineText& display, const LineMatch& match) {
+    GlobalSearchResult result;
+    result.session_id = session_id;
+    result.hit = to_hit(display, match);
+    
+    const std::string& text = display.text;
+    size_t start = match.begin > CONTEXT_BEFORE ? match.begin - CONTEXT_BEFORE : 0;
+    while (start > 0 && is_utf8_continuation(text[start])) --start;
+    size_t end = std::min(text.size(), match.end + CONTEXT_AFTER);
+    while (end < text.size() && is_utf8_continuation(text[end])) ++end;
+    
+    result.context = text.substr(start, end - start);
+    result.match_begin = match.begin - start;
+    result.match_end = match.end - start;
+    return result;
+}
+
+}
+
+struct GlobalSearch::Job {
+    std::string folded_pattern;
+    std::optional<std::regex> regex;
+    size_t max_results = 0;
+    
+    std::atomic<bool> cancelled{false};
+    std::atomic<bool> truncated{false};
+    std::atomic<size_t> result_count{0};
+    
+    std::mutex results_mutex;
+    std::vector<GlobalSearchResult> results;
+    
+    std::mutex done_mutex;
+    std::condition_variable done_cv;
+    int pending_tasks = 0;
+    
+    void find(const std::string& text, uint64_t line, std::vector<LineMatch>& out) const {
+        if (regex) {
+            for (auto it = std::sregex_iterator(text.begin(), text.end(), *regex); it != std::sregex_iterator(); ++it) {
+                if (it->length(0) == 0) continue;
+                auto begin = static_cast<size_t>(it->position(0));
+                out.push_back({line, begin, begin + static_cast<size_t>(it->length(0))});
+            }
+            return;
+        }
+        size_t pos = text.find(folded_pattern);
+        while (pos != std::string::npos) {
+            out.push_back({line, pos, pos + folded_pattern.size()});
+            pos = text.find(folded_pattern, pos + folded_pattern.size());
+        }
+    }
+    
+    // Returns false once the result limit is reached.
+    bool publish(std::vector<GlobalSearchResult>& found) {
+        if (found.empty()) return !cancelled.load(std::memory_order_relaxed);
+        
+        size_t before = result_count.fetch_add(found.size(), std::memory_order_relaxed);
+        if (before >= max_results) {
+            truncated.store(true, std::memory_order_relaxed);
+            cancelled.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        size_t keep = std::min(found.size(), max_results - before);
+        {
+            std::lock_guard<std::mutex> lock(results_mutex);
+            std::move(found.begin(), found.begin() + static_cast<std::ptrdiff_t>(keep), std::back_inserter(results));
+        }
+        found.clear();
+        RedrawScheduler::instance().request_redraw();
+        
+        if (before + keep >= max_results) {
+            truncated.store(true, std::memory_order_relaxed);
+            cancelled.store(true, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+    
+    void finish_task() {
+        {
+            std::lock_guard<std::mutex> lock(done_mutex);
+            --pending_tasks;
+        }
+        done_cv.notify_all();
+        RedrawScheduler::instance().request_redraw();
+    }
+};
+
+bool GlobalSearch::start(const GlobalSearchQuery& query, const std::vector<TerminalSession*>& sessions, std::string& error) {
+    cancel();
+    error.clear();
+    
+    auto job = std::make_shared<Job>();
+    job->max_results = query.max_results;
+    if (query.regex) {
+        try {
+            job->regex.emplace(query.pattern, std::regex::ECMAScript | std::regex::icase | std::regex::optimize);
+        } catch (const std::regex_error& e) {
+            error = e.what();
+            return false;
+        }
+    } else {
+        job->folded_pattern = fold_search_text(query.pattern);
+        if (job->folded_pattern.empty()) {
+            return true;
+        }
+    }
+    job_ = job;
+    
+    std::vector<std::function<void()>> tasks;
+    
+    for (TerminalSession* session : sessions) {
+        // The screen comes from the UI's snapshot, so take the newest one.
+        if (session->refresh_snapshot() && !session->user_scrolled_up()) {
+            session->request_scroll_to_bottom();
+        }
+        const ScreenSnapshot& snapshot = session->snapshot();
+        const uint64_t screen_first_line = snapshot.scrollback_evicted + snapshot.scrollback_size;
+        
+        std::vector<LineText> rows(static_cast<size_t>(snapshot.rows));
+        for (int row = 0; row < snapshot.rows; ++row) {
+            project_line(snapshot.row(row), snapshot.cols, rows[static_cast<size_t>(row)], false);
+        }
+        uint32_t session_id = session->id();
+        tasks.push_back([this, job, session_id, rows = std::move(rows), screen_first_line]() mutable {
+            search_screen(job, session_id, std::move(rows), screen_first_line);
+        });
+        
+        if (!query.regex) {
+            tasks.push_back([this, job, session, screen_first_line] {
+                search_scrollback_literal(job, session, screen_first_line);
+            });
+        } else {
+            for (uint64_t begin = snapshot.scrollback_evicted; begin < screen_first_line; begin += REGEX_CHUNK_LINES) {
+                uint64_t end = std::min(screen_first_line, begin + REGEX_CHUNK_LINES);
+                tasks.push_back([this, job, session, begin, end] {
+                    search_scrollback_regex(job, session, begin, end);
+                });
+            }
+        }
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(job->done_mutex);
+        job->pending_tasks = static_cast<int>(tasks.size());
+    }
+    for (auto& task : tasks) {
+        pool_.submit([job, task = std::move(task)] {
+            if (!job->cancelled.load(std::memory_order_relaxed)) {
+                task();
+            }
+            job->finish_task();
+        });
+    }
+    return true;
+}
+
+void GlobalSearch::cancel() {
+    if (!job_) return;
+    
+    job_->cancelled.store(true, std::memory_order_relaxed);
+    std::unique_lock<std::mutex> lock(job_->done_mutex);
+    job_->done_cv.wait(lock, [this] { return job_->pending_tasks == 0; });
+}
+
+size_t GlobalSearch::drain(std::vector<GlobalSearchResult>& out) {
+    if (!job_) return 0;
+    
+    std::lock_guard<std::mutex> lock(job_->results_mutex);
+    size_t count = job_->results.size();
+    std::move(job_->results.begin(), job_->results.end(), std::back_inserter(out));
+    job_->results.clear();
+    return count;
+}
+
+bool GlobalSearch::running() const {
+    if (!job_) return false;
+    std::lock_guard<std::mutex> lock(job_->done_mutex);
+    return job_->pending_tasks > 0;
+}
+
+bool GlobalSearch::truncated() const {
+    return job_ && job_->truncated.load(std::memory_order_relaxed);
+}
+
+void GlobalSearch::search_screen(const std::shared_ptr<Job>& job, uint32_t session_id, std::vector<LineText> rows,
+                                 uint64_t first_line) {
+    std::vector<LineMatch> matches;
+    std::vector<GlobalSearchResult> found;
+    std::string folded;
+    for (size_t row = 0; row < rows.size(); ++row) {
+        matches.clear();
+        if (job->regex) {
+            job->find(rows[row].text, first_line + row, matches);
+        } else {
+            folded = fold_search_text(rows[row].text);
+            job->find(folded, first_line + row, matches);
+        }
+        for (const auto& match : matches) {
+            found.push_back(make_result(session_id, rows[row], match));
+        }
+    }
+    job->publish(found);
+}
+
+void GlobalSearch::search_scrollback_literal(const std::shared_ptr<Job>& job, TerminalSession* session, uint64_t end_line) {
+    const VTerminal& terminal = session->terminal();
+    std::vector<GlobalSearchResult> found;
+    std::vector<SearchHit> hits;
+    LineText display;
+    
+    auto lock = terminal.lock_scrollback();
+    const auto& index = terminal.scrollback_index();
+    index.find(job->folded_pattern, hits, job->max_results);
+    
+    const auto& scrollback = terminal.scrollback();
+    uint64_t projected_line = UINT64_MAX;
+    for (const auto& hit : hits) {
+        if (hit.line >= end_line) break;
+        if (hit.line != projected_line) {
+            const auto& cells = scrollback[static_cast<size_t>(hit.line - index.first_line())];
+            project_line(cells.data(), static_cast<int>(cells.size()), display, false);
+            projected_line = hit.line;
+        }
+        // The index reports columns; recover the byte range from the fold.
+        const LineText& folded = index.line(hit.line);
+        size_t begin = 0;
+        while (begin < folded.text.size() && folded.column_of(begin) < hit.col) ++begin;
+        found.push_back(make_result(session->id(), display, {hit.line, begin, begin + job->folded_pattern.size()}));
+    }
+    lock.unlock();
+    
+    job->publish(found);
+}
+
+void GlobalSearch::search_scrollback_regex(const std::shared_ptr<Job>& job, TerminalSession* session,
+                                           uint64_t begin_line, uint64_t end_line) {
+    const VTerminal& terminal = session->terminal();
+    std::vector<LineText> lines;
+    uint64_t first = 0;
+    {
+        auto lock = terminal.lock_scrollback();
+        const auto& index = terminal.scrollback_index();
+        first = std::max(begin_line, index.first_line());
+        uint64_t last = std::min(end_line, index.end_line());
+        for (uint64_t line = first; line < last; ++line) {
+            lines.push_back(index.line(line));
+        }
+    }
+    
+    std::vector<LineMatch> matches;
+    for (size_t i = 0; i < lines.size(); ++i) {
+        if (job->cancelled.load(std::memory_order_relaxed)) return;
+        job->find(lines[i].text, first + i, matches);
+    }
+    if (matches.empty()) return;
+    
+    // Show the line with its original case if it is still in the scrollback.
+    std::vector<GlobalSearchResult> found;
+    LineText display;
+    {
+        auto lock = terminal.lock_scrollback();
+        const auto& scrollback = terminal.scrollback();
+        uint64_t live_first = terminal.scrollback_evicted();
+        uint64_t projected_line = UINT64_MAX;
+        for (const auto& match : matches) {
+            const LineText* source = &lines[static_cast<size_t>(match.line - first)];
+            if (match.line >= live_first && match.line - live_first < scrollback.size()) {
+                if (match.line != projected_line) {
+                    const auto& cells = scrollback[static_cast<size_t>(match.line - live_first)];
+                    project_line(cells.data(), static_cast<int>(cells.size()), display, false);
+                    projected_line = match.line;
+                }
+                if (display.text.size() == source->text.size()) {
+                    source = &display;
+                }
+            }
+            found.push_back(make_result(session->id(), *source, match));
+        }
+    }
+    job->publish(found);
+}
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "core/thread_pool.h"
+#include "terminal_session.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace diana {
+
+struct GlobalSearchQuery {
+    std::string pattern;
+    bool regex = false;
+    size_t max_results = 5000;
+};
+
+struct GlobalSearchResult {
+    uint32_t session_id = 0;
+    SearchHit hit;
+    std::string context;       // the matching line, cut to a window around the match
+    size_t match_begin = 0;    // byte range of the match within context
+    size_t match_end = 0;
+};
+
+// Searches the scrollback and screen of many sessions at once on a thread
+// pool. Case-insensitive; literal patterns go through each session's
+// ScrollbackIndex, regular expressions (ECMAScript) are matched against the
+// projected lines in chunks so that no scrollback lock is held for long while
+// the sessions keep producing output. Results stream in through drain() in
+// no particular order.
+//
+// start(), cancel() and drain() are for the UI thread. The sessions passed to
+// start() must stay alive until cancel() returns or the search finishes.
+class GlobalSearch {
+public:
+    explicit GlobalSearch(ThreadPool& pool) : pool_(pool) {}
+    ~GlobalSearch() { cancel(); }
+
+    GlobalSearch(const GlobalSearch&) = delete;
+    GlobalSearch& operator=(const GlobalSearch&) = delete;
+
+    // Cancels any running search first. Returns false and sets error if the
+    // pattern is not a valid regular expression.
+    bool start(const GlobalSearchQuery& query, const std::vector<TerminalSession*>& sessions, std::string& error);
+
+    // Stops the current search and waits for its tasks to finish.
+    void cancel();
+
+    // Moves results found since the last call into out; returns how many.
+    size_t drain(std::vector<GlobalSearchResult>& out);
+
+    bool running() const;
+    bool truncated() const;
+
+private:
+    struct Job;
+
+    void search_screen(const std::shared_ptr<Job>& job, uint32_t session_id, std::vector<LineText> rows,
+                       uint64_t first_line);
+    void search_scrollback_literal(const std::shared_ptr<Job>& job, TerminalSession* session, uint64_t end_line);
+    void search_scrollback_regex(const std::shared_ptr<Job>& job, TerminalSession* session,
+                                 uint64_t begin_line, uint64_t end_line);
+
+    ThreadPool& pool_;
+    std::shared_ptr<Job> job_;
+};
+
+}
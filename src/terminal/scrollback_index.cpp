@@ -0,0 +1,303 @@
+#include "scrollback_index.h"
+#include "vterminal.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+namespace diana {
+
+namespace {
+
+constexpr uint32_t CONTINUATION_CELL = 0xFFFFFFFF;
+constexpr uint32_t BLANK_TRIGRAM = 0x202020;
+// Evicted lines linger in the posting lists until at least this many have
+// piled up (or as many as there are live lines), then the lists are rebuilt.
+constexpr uint64_t MIN_STALE_LINES = 1024;
+// Enough posting lists to narrow the candidates; the text check is exact.
+constexpr size_t MAX_INTERSECTED_LISTS = 4;
+
+char fold_ascii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+void append_utf8(uint32_t cp, std::string& out, bool fold_case) {
+    if (cp < 0x80) {
+        out.push_back(fold_case ? fold_ascii(static_cast<char>(cp)) : static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp <= 0x10FFFF) {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back('?');
+    }
+}
+
+}
+
+void project_line(const TerminalCell* cells, int count, LineText& out, bool fold_case) {
+    out.text.clear();
+    out.columns.clear();
+    bool identity = true;
+    
+    for (int col = 0; col < count; ++col) {
+        uint32_t ch = cells[col].chars[0];
+        if (ch == CONTINUATION_CELL) continue;
+        if (ch == 0) ch = ' ';
+        
+        size_t before = out.text.size();
+        append_utf8(ch, out.text, fold_case);
+        
+        if (identity && out.text.size() != static_cast<size_t>(col) + 1) {
+            identity = false;
+            out.columns.resize(before);
+            std::iota(out.columns.begin(), out.columns.end(), static_cast<uint16_t>(0));
+        }
+        if (!identity) {
+            out.columns.resize(out.text.size(), static_cast<uint16_t>(col));
+        }
+    }
+    
+    while (!out.text.empty() && out.text.back() == ' ') {
+        out.text.pop_back();
+    }
+    if (!identity) {
+        out.columns.resize(out.text.size());
+    }
+}
+
+std::string fold_search_text(const std::string& needle) {
+    std::string folded = needle;
+    for (char& c : folded) {
+        c = fold_ascii(c);
+    }
+    return folded;
+}
+
+void find_in_line(const LineText& line, const std::string& folded_needle, uint64_t line_number,
+                  std::vector<SearchHit>& hits, size_t max_hits) {
+    if (folded_needle.empty()) return;
+    
+    size_t pos = line.text.find(folded_needle);
+    while (pos != std::string::npos && hits.size() < max_hits) {
+        size_t end = pos + folded_needle.size();
+        SearchHit hit;
+        hit.line = line_number;
+        hit.col = line.column_of(pos);
+        hit.end_col = end < line.text.size() ? line.column_of(end) : line.column_of(end - 1) + 1;
+        hits.push_back(hit);
+        pos = line.text.find(folded_needle, end);
+    }
+}
+
+void ScrollbackIndex::collect_trigrams(const std::string& text, std::vector<Trigram>& out) {
+    out.clear();
+    if (text.size() < 3) return;
+    
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    for (size_t i = 0; i + 2 < text.size(); ++i) {
+        Trigram t = static_cast<Trigram>(bytes[i]) |
+                    (static_cast<Trigram>(bytes[i + 1]) << 8) |
+                    (static_cast<Trigram>(bytes[i + 2]) << 16);
+        if (t != BLANK_TRIGRAM) {
+            out.push_back(t);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+void ScrollbackIndex::index_line(const LineText& line, uint64_t number) {
+    auto id = static_cast<uint32_t>(number - posting_base_);
+    collect_trigrams(line.text, scratch_);
+    for (Trigram t : scratch_) {
+        postings_[t].push_back(id);
+    }
+}
+
+void ScrollbackIndex::push_line(LineText line) {
+    if (end_line() - posting_base_ >= std::numeric_limits<uint32_t>::max()) {
+        rebuild_postings();
+    }
+    index_line(line, end_line());
+    lines_.push_back(std::move(line));
+}
+
+void ScrollbackIndex::pop_line() {
+    if (lines_.empty()) return;
+    
+    auto id = static_cast<uint32_t>(end_line() - 1 - posting_base_);
+    collect_trigrams(lines_.back().text, scratch_);
+    for (Trigram t : scratch_) {
+        auto it = postings_.find(t);
+        if (it == postings_.end()) continue;
+        if (!it->second.empty() && it->second.back() == id) {
+            it->second.pop_back();
+        }
+        if (it->second.empty()) {
+            postings_.erase(it);
+        }
+    }
+    lines_.pop_back();
+}
+
+void ScrollbackIndex::evict_front() {
+    if (lines_.empty()) return;
+    
+    lines_.pop_front();
+    ++first_line_;
+    
+    uint64_t stale = first_line_ - posting_base_;
+    if (stale >= std::max<uint64_t>(MIN_STALE_LINES, lines_.size())) {
+        rebuild_postings();
+    }
+}
+
+void ScrollbackIndex::rebuild_postings() {
+    postings_.clear();
+    posting_base_ = first_line_;
+    uint64_t number = first_line_;
+    for (const auto& line : lines_) {
+        index_line(line, number++);
+    }
+}
+
+// The posting lists of trigrams, shortest first and at most
+// MAX_INTERSECTED_LISTS of them. Returns false if a trigram occurs nowhere.
+bool ScrollbackIndex::posting_lists(const std::vector<Trigram>& trigrams,
+                                    std::vector<const std::vector<uint32_t>*>& lists) const {
+    lists.reserve(trigrams.size());
+    for (Trigram t : trigrams) {
+        auto it = postings_.find(t);
+        if (it == postings_.end()) return false;
+        lists.push_back(&it->second);
+    }
+    std::sort(lists.begin(), lists.end(), [](const auto* a, const auto* b) { return a->size() < b->size(); });
+    if (lists.size() > MAX_INTERSECTED_LISTS) {
+        lists.resize(MAX_INTERSECTED_LISTS);
+    }
+    return true;
+}
+
+bool ScrollbackIndex::find(const std::string& needle, std::vector<SearchHit>& hits, size_t max_hits) const {
+    std::string folded = fold_search_text(needle);
+    if (folded.empty()) return true;
+    
+    std::vector<Trigram> trigrams;
+    collect_trigrams(folded, trigrams);
+    
+    // Too short (or all blanks) for the index: scan the projected text.
+    if (trigrams.empty()) {
+        uint64_t number = first_line_;
+        for (const auto& line : lines_) {
+            find_in_line(line, folded, number++, hits, max_hits);
+            if (hits.size() >= max_hits) return false;
+        }
+        return true;
+    }
+    
+    std::vector<const std::vector<uint32_t>*> lists;
+    if (!posting_lists(trigrams, lists)) return true;
+    
+    // Walk the shortest list; the others are probed with a galloping search
+    // from where the previous probe stopped, so each is scanned at most once.
+    const auto first_id = static_cast<uint32_t>(first_line_ - posting_base_);
+    const auto& smallest = *lists.front();
+    std::vector<const uint32_t*> cursors;
+    for (size_t i = 1; i < lists.size(); ++i) {
+        cursors.push_back(lists[i]->data());
+    }
+    for (auto it = std::lower_bound(smallest.begin(), smallest.end(), first_id); it != smallest.end(); ++it) {
+        uint32_t id = *it;
+        bool candidate = true;
+        for (size_t i = 1; i < lists.size() && candidate; ++i) {
+            const uint32_t*& cursor = cursors[i - 1];
+            const uint32_t* end = lists[i]->data() + lists[i]->size();
+            size_t step = 1;
+            const uint32_t* probe = cursor;
+            while (probe < end && *probe < id) {
+                cursor = probe;
+                probe = (static_cast<size_t>(end - probe) > step) ? probe + step : end;
+                step <<= 1;
+            }
+            cursor = std::lower_bound(cursor, probe, id);
+            candidate = cursor < end && *cursor == id;
+        }
+        if (!candidate) continue;
+        
+        find_in_line(lines_[id - first_id], folded, posting_base_ + id, hits, max_hits);
+        if (hits.size() >= max_hits) return false;
+    }
+    return true;
+}
+
+bool ScrollbackIndex::find_last(const std::string& needle, uint64_t end, std::vector<SearchHit>& hits,
+                                size_t max_hits) const {
+    std::string folded = fold_search_text(needle);
+    if (folded.empty()) return true;
+    end = std::clamp(end, first_line_, end_line());
+    
+    // Newest first, each line's matches reversed too; flipped once at the
+    // end. Collecting stops once there is one more than max_hits.
+    std::vector<SearchHit> found;
+    auto take = [&](uint64_t number) {
+        size_t before = found.size();
+        find_in_line(line(number), folded, number, found, SIZE_MAX);
+        std::reverse(found.begin() + static_cast<std::ptrdiff_t>(before), found.end());
+        return found.size() <= max_hits;
+    };
+    auto finish = [&] {
+        bool complete = found.size() <= max_hits;
+        if (!complete) {
+            found.resize(max_hits);
+        }
+        hits.insert(hits.end(), found.rbegin(), found.rend());
+        return complete;
+    };
+    
+    std::vector<Trigram> trigrams;
+    collect_trigrams(folded, trigrams);
+    if (trigrams.empty()) {
+        for (uint64_t number = end; number > first_line_;) {
+            if (!take(--number)) break;
+        }
+        return finish();
+    }
+    
+    std::vector<const std::vector<uint32_t>*> lists;
+    if (!posting_lists(trigrams, lists)) return true;
+    
+    // Walk the shortest list backwards; each other list is searched only
+    // below where its previous probe landed.
+    const auto first_id = static_cast<uint32_t>(first_line_ - posting_base_);
+    const auto end_id = static_cast<uint32_t>(end - posting_base_);
+    const auto& smallest = *lists.front();
+    std::vector<const uint32_t*> limits;
+    for (size_t i = 1; i < lists.size(); ++i) {
+        limits.push_back(lists[i]->data() + lists[i]->size());
+    }
+    auto stop = std::lower_bound(smallest.begin(), smallest.end(), first_id);
+    for (auto it = std::lower_bound(stop, smallest.end(), end_id); it != stop;) {
+        uint32_t id = *--it;
+        bool candidate = true;
+        for (size_t i = 1; i < lists.size() && candidate; ++i) {
+            const uint32_t*& limit = limits[i - 1];
+            const uint32_t* probe = std::lower_bound(lists[i]->data(), limit, id);
+            candidate = probe < limit && *probe == id;
+            limit = probe;
+        }
+        if (!candidate) continue;
+        
+        if (!take(posting_base_ + id)) break;
+    }
+    return finish();
+}
+
+}
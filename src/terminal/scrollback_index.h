@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace diana {
+
+struct TerminalCell;
+
+// A match in terminal text. line is an absolute scrollback line number
+// (lines evicted so far + index into the live scrollback); screen rows
+// continue the numbering after the last scrollback line. col/end_col are a
+// half-open range of cell columns.
+struct SearchHit {
+    uint64_t line = 0;
+    int col = 0;
+    int end_col = 0;
+};
+
+// Searchable text of one terminal row: UTF-8 with ASCII letters folded to
+// lower case and trailing blanks trimmed. columns maps each byte to the cell
+// column it came from; it is left empty when every byte is its own
+// single-width cell, which is the common case.
+struct LineText {
+    std::string text;
+    std::vector<uint16_t> columns;
+
+    int column_of(size_t byte) const {
+        return columns.empty() ? static_cast<int>(byte) : static_cast<int>(columns[byte]);
+    }
+};
+
+// With fold_case false the text keeps its case; byte offsets and columns
+// are identical either way, so a match found in the folded projection can be
+// shown from the unfolded one.
+void project_line(const TerminalCell* cells, int count, LineText& out, bool fold_case = true);
+std::string fold_search_text(const std::string& needle);
+
+// Appends every occurrence of an already folded needle in line to hits.
+void find_in_line(const LineText& line, const std::string& folded_needle, uint64_t line_number,
+                  std::vector<SearchHit>& hits, size_t max_hits);
+
+// Incrementally maintained index over the scrollback: the projected text of
+// each line plus a trigram -> lines posting list. VTerminal updates it as
+// lines are pushed, popped and evicted, so a query only verifies the lines
+// whose trigrams all match instead of decoding every cell.
+class ScrollbackIndex {
+public:
+    // line is usually projected by the caller before taking whatever lock
+    // guards the index.
+    void push_line(LineText line);
+    void pop_line();
+    void evict_front();
+
+    uint64_t first_line() const { return first_line_; }
+    uint64_t end_line() const { return first_line_ + lines_.size(); }
+    size_t size() const { return lines_.size(); }
+    const LineText& line(uint64_t number) const { return lines_[static_cast<size_t>(number - first_line_)]; }
+
+    // Finds occurrences of needle (ASCII case-insensitive) in line order.
+    // Returns false if the search stopped at max_hits.
+    bool find(const std::string& needle, std::vector<SearchHit>& hits, size_t max_hits = SIZE_MAX) const;
+    // Like find(), but keeps the newest max_hits occurrences in lines before
+    // end, still appended in line order. Returns false if older ones were
+    // left out.
+    bool find_last(const std::string& needle, uint64_t end, std::vector<SearchHit>& hits, size_t max_hits) const;
+
+private:
+    using Trigram = uint32_t;
+
+    static void collect_trigrams(const std::string& text, std::vector<Trigram>& out);
+    bool posting_lists(const std::vector<Trigram>& trigrams, std::vector<const std::vector<uint32_t>*>& lists) const;
+    void index_line(const LineText& line, uint64_t number);
+    void rebuild_postings();
+
+    std::deque<LineText> lines_;
+    uint64_t first_line_ = 0;
+
+    // Posting lists hold line numbers relative to posting_base_, in
+    // ascending order. Evicted lines stay in them until enough accumulate to
+    // make a rebuild worthwhile; queries skip them.
+    std::unordered_map<Trigram, std::vector<uint32_t>> postings_;
+    uint64_t posting_base_ = 0;
+
+    std::vector<Trigram> scratch_;
+};
+
+}
@@ -0,0 +1,108 @@
+#include "session_replayer.h"
+#include "core/redraw_scheduler.h"
+#include <algorithm>
+#include <cstring>
+
+namespace diana {
+
+void SessionReplayer::start(TerminalSession& session, std::shared_ptr<const Recording> recording,
+                            const ReplayOptions& options) {
+    stop();
+    
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = false;
+    }
+    frame_count_ = recording->frames.size();
+    frames_done_.store(0, std::memory_order_relaxed);
+    running_.store(true, std::memory_order_release);
+    thread_ = std::thread(&SessionReplayer::run, this, std::ref(session), std::move(recording), options);
+}
+
+void SessionReplayer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stop_mutex_);
+        stop_ = true;
+    }
+    stop_cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void SessionReplayer::wait() {
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+double SessionReplayer::progress() const {
+    if (frame_count_ == 0) return 1.0;
+    return static_cast<double>(frames_done_.load(std::memory_order_relaxed)) / static_cast<double>(frame_count_);
+}
+
+void SessionReplayer::run(TerminalSession& session, std::shared_ptr<const Recording> recording, ReplayOptions options) {
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    
+    for (const auto& frame : recording->frames) {
+        if (options.speed > 0.0) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::micro>(static_cast<double>(frame.time_us) / options.speed));
+            std::unique_lock<std::mutex> lock(stop_mutex_);
+            if (stop_cv_.wait_until(lock, due, [this] { return stop_; })) {
+                break;
+            }
+        } else {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            if (stop_) break;
+        }
+        
+        int rows = 0, cols = 0;
+        if (recording->resize_of(frame, rows, cols)) {
+            if (options.apply_resizes) {
+                // Everything before the resize must be parsed at the old size.
+                session.wait_until_parsed(std::chrono::seconds(5));
+                session.resize_terminal(rows, cols);
+            }
+        } else {
+            auto data = recording->data(frame);
+            if (!push_bytes(session, data.data(), data.size())) {
+                break;
+            }
+        }
+        frames_done_.fetch_add(1, std::memory_order_relaxed);
+    }
+    
+    running_.store(false, std::memory_order_release);
+    RedrawScheduler::instance().request_redraw();
+}
+
+// Writes into the session's ring the way ProcessRunner does, including its
+// backpressure. Returns false if stopped.
+bool SessionReplayer::push_bytes(TerminalSession& session, const char* data, size_t len) {
+    const auto& ring = session.output_ring();
+    while (len > 0) {
+        {
+            std::lock_guard<std::mutex> lock(stop_mutex_);
+            if (stop_) return false;
+        }
+        if (ring->above_high_water()) {
+            ring->wait_for_drain(std::chrono::milliseconds(100));
+            continue;
+        }
+        ByteSpan span = ring->write_span();
+        if (span.size == 0) {
+            ring->wait_for_space(std::chrono::milliseconds(100));
+            continue;
+        }
+        size_t n = std::min(span.size, len);
+        std::memcpy(span.data, data, n);
+        ring->commit_write(n);
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "process/session_recorder.h"
+#include "terminal_session.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace diana {
+
+struct ReplayOptions {
+    static constexpr double MAX_SPEED = 0.0;
+
+    // Playback rate relative to the recording; MAX_SPEED feeds frames as
+    // fast as the session's parser takes them.
+    double speed = 1.0;
+    // Apply recorded resizes to the session. Off in the UI, where the panel
+    // sizes the terminal to its window.
+    bool apply_resizes = false;
+};
+
+// Feeds a recording back into a TerminalSession through its output ring, so
+// it is parsed exactly as the original PTY output was. The ring has a single
+// producer: the session must not have a running process during replay.
+class SessionReplayer {
+public:
+    SessionReplayer() = default;
+    ~SessionReplayer() { stop(); }
+
+    SessionReplayer(const SessionReplayer&) = delete;
+    SessionReplayer& operator=(const SessionReplayer&) = delete;
+
+    void start(TerminalSession& session, std::shared_ptr<const Recording> recording, const ReplayOptions& options);
+    void stop();
+    // Blocks until every frame has been handed to the session.
+    void wait();
+
+    bool running() const { return running_.load(std::memory_order_acquire); }
+    double progress() const;
+
+private:
+    void run(TerminalSession& session, std::shared_ptr<const Recording> recording, ReplayOptions options);
+    bool push_bytes(TerminalSession& session, const char* data, size_t len);
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<size_t> frames_done_{0};
+    size_t frame_count_ = 0;
+
+    std::mutex stop_mutex_;
+    std::condition_variable stop_cv_;
+    bool stop_ = false;
+};
+
+}
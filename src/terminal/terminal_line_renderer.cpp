@@ -0,0 +1,201 @@
+#include "terminal_line_renderer.h"
+#include <imgui.h>
+#include <algorithm>
+
+namespace diana {
+
+namespace {
+
+int utf8_encode(uint32_t codepoint, char* out) {
+    if (codepoint < 0x80) {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+int brightness(uint32_t abgr) {
+    uint8_t r = abgr & 0xFF;
+    uint8_t g = (abgr >> 8) & 0xFF;
+    uint8_t b = (abgr >> 16) & 0xFF;
+    return (r * 299 + g * 587 + b * 114) / 1000;
+}
+
+bool is_blank(const TerminalCell& cell) {
+    return cell.chars[0] == 0 || cell.chars[0] == ' ';
+}
+
+bool is_ascii_glyph(const TerminalCell& cell) {
+    return cell.width == 1 && cell.chars[0] > 0x20 && cell.chars[0] < 0x7F && cell.chars[1] == 0;
+}
+
+}
+
+bool terminal_bg_is_custom(uint32_t bg, uint32_t default_bg) {
+    return (bg & 0xFF000000) != 0 && bg != default_bg && brightness(bg) >= 40;
+}
+
+uint32_t terminal_fg_for_theme(uint32_t fg, bool light_theme) {
+    if (!light_theme) return fg;
+    if (brightness(fg) <= 180) return fg;
+
+    uint8_t r = fg & 0xFF;
+    uint8_t g = (fg >> 8) & 0xFF;
+    uint8_t b = (fg >> 16) & 0xFF;
+    uint8_t a = (fg >> 24) & 0xFF;
+
+    r = static_cast<uint8_t>(r * 0.4f);
+    g = static_cast<uint8_t>(g * 0.4f);
+    b = static_cast<uint8_t>(b * 0.4f);
+
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+TerminalLineStats TerminalLineRenderer::draw(ImDrawList* draw_list, const ImVec2& origin, float char_w, float line_height,
+                                             const TerminalCell* cells, int count,
+                                             int sel_min_col, int sel_max_col,
+                                             const TerminalLineStyle& style) {
+    TerminalLineStats stats;
+    if (count <= 0) {
+        return stats;
+    }
+
+    const float top = origin.y;
+    const float bottom = origin.y + line_height;
+
+    // Backgrounds: one rect per run of equal custom colours.
+    int col = 0;
+    while (col < count) {
+        const auto& cell = cells[col];
+        if (cell.width == 0 || !terminal_bg_is_custom(cell.bg, style.default_bg)) {
+            ++col;
+            continue;
+        }
+
+        uint32_t bg = cell.bg;
+        int run_start = col;
+        int run_end = col + cell.width;
+        int next = col + 1;
+        while (next < count) {
+            const auto& other = cells[next];
+            if (other.width == 0) {
+                ++next;
+                continue;
+            }
+            if (other.bg != bg) {
+                break;
+            }
+            run_end = next + other.width;
+            ++next;
+        }
+
+        draw_list->AddRectFilled(ImVec2(origin.x + run_start * char_w, top),
+                                 ImVec2(origin.x + run_end * char_w, bottom), bg);
+        ++stats.background_rects;
+        col = next;
+    }
+
+    // Selection: a single rect covering the selected cells.
+    if (sel_min_col >= 0 && sel_min_col < sel_max_col) {
+        int first = -1;
+        int last_end = -1;
+        int limit = std::min(sel_max_col, count);
+        for (int i = std::max(0, sel_min_col); i < limit; ++i) {
+            if (cells[i].width == 0) continue;
+            if (first < 0) first = i;
+            last_end = i + cells[i].width;
+        }
+        if (first >= 0) {
+            draw_list->AddRectFilled(ImVec2(origin.x + first * char_w, top),
+                                     ImVec2(origin.x + last_end * char_w, bottom), style.selection_color);
+            ++stats.background_rects;
+        }
+    }
+
+    // Glyphs: ASCII cells with the same colour become one text run; interior
+    // blanks are folded into the run so a whole line usually costs one call.
+    run_text_.clear();
+    int run_start = -1;
+    int pending_blanks = 0;
+    uint32_t run_fg = 0;
+
+    auto flush_run = [&]() {
+        if (!run_text_.empty()) {
+            const char* begin = run_text_.data();
+            draw_list->AddText(ImVec2(origin.x + run_start * char_w, top), run_fg, begin, begin + run_text_.size());
+            ++stats.text_runs;
+        }
+        run_text_.clear();
+        run_start = -1;
+        pending_blanks = 0;
+    };
+
+    for (int i = 0; i < count; ++i) {
+        const auto& cell = cells[i];
+
+        if (cell.width == 1 && is_blank(cell)) {
+            if (run_start >= 0) {
+                ++pending_blanks;
+            }
+            continue;
+        }
+
+        if (cell.width == 0 || is_blank(cell) || cell.chars[0] > 0x10FFFF) {
+            flush_run();
+            continue;
+        }
+
+        uint32_t fg = terminal_fg_for_theme(cell.fg, style.light_theme);
+
+        if (is_ascii_glyph(cell)) {
+            if (run_start >= 0 && fg == run_fg) {
+                run_text_.append(static_cast<size_t>(pending_blanks), ' ');
+                pending_blanks = 0;
+            } else {
+                flush_run();
+                run_start = i;
+                run_fg = fg;
+            }
+            run_text_.push_back(static_cast<char>(cell.chars[0]));
+            continue;
+        }
+
+        flush_run();
+
+        char utf8_buf[32];
+        int utf8_len = 0;
+        for (int j = 0; j < TERMINAL_MAX_CHARS_PER_CELL && cell.chars[j] != 0; ++j) {
+            uint32_t cp = cell.chars[j];
+            if (cp > 0x10FFFF) break;
+            char tmp[4];
+            int len = utf8_encode(cp, tmp);
+            if (utf8_len + len > static_cast<int>(sizeof(utf8_buf))) break;
+            std::copy(tmp, tmp + len, utf8_buf + utf8_len);
+            utf8_len += len;
+        }
+        if (utf8_len > 0) {
+            draw_list->AddText(ImVec2(origin.x + i * char_w, top), fg, utf8_buf, utf8_buf + utf8_len);
+            ++stats.text_runs;
+        }
+    }
+    flush_run();
+
+    return stats;
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "vterminal.h"
+#include <cstdint>
+#include <string>
+
+struct ImDrawList;
+struct ImVec2;
+
+namespace diana {
+
+struct TerminalLineStyle {
+    uint32_t default_bg = 0;
+    uint32_t selection_color = 0x40FFFFFF;
+    bool light_theme = false;
+};
+
+struct TerminalLineStats {
+    int text_runs = 0;
+    int background_rects = 0;
+};
+
+// Draws one row of terminal cells into a draw list.
+//
+// Adjacent ASCII cells sharing a foreground colour are emitted as a single
+// AddText run, and adjacent cells sharing a custom background are merged into
+// one rectangle (the selection highlight is a single rectangle too). Non-ASCII
+// glyphs are still placed per cell because fallback fonts do not guarantee a
+// monospace advance. sel_min_col/sel_max_col describe a half-open column range;
+// pass -1 for both when the row is not selected.
+class TerminalLineRenderer {
+public:
+    TerminalLineStats draw(ImDrawList* draw_list, const ImVec2& origin, float char_w, float line_height,
+                           const TerminalCell* cells, int count,
+                           int sel_min_col, int sel_max_col,
+                           const TerminalLineStyle& style);
+
+private:
+    std::string run_text_;
+};
+
+bool terminal_bg_is_custom(uint32_t bg, uint32_t default_bg);
+uint32_t terminal_fg_for_theme(uint32_t fg, bool light_theme);
+
+}
@@ -1,15 +1,24 @@
 #include "terminal_panel.h"
+#include "terminal_line_renderer.h"
+#include "terminal_snapshot_file.h"
 #include "vterminal.h"
 #include "core/session_events.h"
+#include "core/profiler.h"
+#include "core/redraw_scheduler.h"
+#include "core/telemetry.h"
 #include "ui/theme.h"
 #include <imgui.h>
 #include <nfd.h>
 #include <algorithm>
+#include <cctype>
 #include <chrono>
 #include <cstdlib>
 #include <cmath>
 #include <cstdio>
+#include <ctime>
 #include <filesystem>
+#include <fstream>
+#include <limits>
 #include <optional>
 #include <sstream>
 
@@ -26,49 +35,13 @@ namespace {
 const char* APP_NAMES[] = { "Claude Code", "Codex", "OpenCode", "Shell" };
 constexpr int APP_COUNT = 4;
 
-void utf8_encode(uint32_t codepoint, char* out, int* len) {
-    if (codepoint > 0x10FFFF) {
-        out[0] = '?';
-        *len = 1;
-        return;
-    }
-    if (codepoint < 0x80) {
-        out[0] = static_cast<char>(codepoint);
-        *len = 1;
-    } else if (codepoint < 0x800) {
-        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
-        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
-        *len = 2;
-    } else if (codepoint < 0x10000) {
-        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
-        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
-        *len = 3;
-    } else {
-        out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
-        out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
-        out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
-        out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
-        *len = 4;
-    }
-}
-
-void cell_to_utf8(const uint32_t* chars, std::string& out) {
-    if (chars[0] == 0 || chars[0] > 0x10FFFF) {
-        out += ' ';
-        return;
-    }
-    for (int i = 0; i < TERMINAL_MAX_CHARS_PER_CELL && chars[i] != 0; ++i) {
-        uint32_t cp = chars[i];
-        if (cp > 0x10FFFF) {
-            break;
-        }
-        char utf8[5] = {0};
-        int len;
-        utf8_encode(cp, utf8, &len);
-        out.append(utf8, static_cast<size_t>(len));
-    }
-}
+const char* REPLAY_SPEED_NAMES[] = { "1x", "2x", "4x", "16x", "Max" };
+const double REPLAY_SPEEDS[] = { 1.0, 2.0, 4.0, 16.0, ReplayOptions::MAX_SPEED };
+constexpr int REPLAY_SPEED_COUNT = 5;
+constexpr float MAX_CURSOR_DT = 1.0f / 30.0f;
+constexpr double CURSOR_PULSE_STEP = 1.0 / 20.0;
+constexpr size_t MAX_SEARCH_HITS = 10000;
+constexpr std::chrono::milliseconds TAB_CATCH_UP_TIMEOUT{12};
 
 ImVec4 u32_to_imvec4(uint32_t color) {
     return ImVec4(
@@ -79,39 +52,6 @@ ImVec4 u32_to_imvec4(uint32_t color) {
     );
 }
 
-std::string filter_cpr_and_build_reply(const std::string& input, std::string& pending, const CursorInfo& cursor, bool& has_reply) {
-    std::string data = pending + input;
-    pending.clear();
-
-    std::string filtered;
-    filtered.reserve(data.size());
-
-    size_t i = 0;
-    while (i < data.size()) {
-        if (data[i] == '\x1b') {
-            if (i + 3 >= data.size()) {
-                pending = data.substr(i);
-                break;
-            }
-            if (data[i + 1] == '[' && data[i + 2] == '6' && data[i + 3] == 'n') {
-                has_reply = true;
-                i += 4;
-                continue;
-            }
-        }
-        filtered.push_back(data[i]);
-        i += 1;
-    }
-
-    return filtered;
-}
-
-std::string build_cpr_reply(const CursorInfo& cursor) {
-    int row = cursor.row + 1;
-    int col = cursor.col + 1;
-    return "\x1b[" + std::to_string(row) + ";" + std::to_string(col) + "R";
-}
-
 std::string escape_osascript_string(const std::string& value) {
     std::string escaped;
     escaped.reserve(value.size());
@@ -179,6 +119,32 @@ std::optional<std::string> write_clipboard_image_to_temp_file() {
     return std::nullopt;
 }
 
+std::string recordings_dir() {
+    const char* home = std::getenv("HOME");
+    if (!home) return {};
+    return std::string(home) + "/.config/diana/recordings";
+}
+
+// "<session name>-YYYYmmdd-HHMMSS" with anything odd in the name replaced.
+std::string timestamped_name(const std::string& session_name) {
+    std::string stem;
+    for (char c : session_name) {
+        stem.push_back(std::isalnum(static_cast<unsigned char>(c)) ? c : '-');
+    }
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    return stem + "-" + stamp;
+}
+
+std::string default_recording_path(const std::string& session_name) {
+    return recordings_dir() + "/" + timestamped_name(session_name) + ".dianarec";
+}
+
+std::string new_snapshot_file(uint32_t session_id) {
+    return timestamped_name("session-" + std::to_string(session_id)) + ".dsnap";
+}
+
 }
 
 TerminalPanel::TerminalPanel() {
@@ -188,6 +154,14 @@ TerminalPanel::TerminalPanel() {
     }
 }
 
+TerminalPanel::~TerminalPanel() {
+    // Search tasks read the sessions, and parser threads post replies into
+    // the controller's queue; stop both before what they use goes away.
+    global_search_.cancel();
+    replayers_.clear();
+    sessions_.clear();
+}
+
 void TerminalPanel::save_sessions() {
     std::vector<SavedSessionConfig> configs;
     for (const auto& session : sessions_) {
@@ -195,6 +169,12 @@ void TerminalPanel::save_sessions() {
         cfg.name = session->name();
         cfg.app = session->config().app;
         cfg.working_dir = session->config().working_dir;
+        cfg.keep_warm = session->config().keep_warm;
+        cfg.daemon_key = session->config().daemon_key;
+        auto it = snapshots_.find(session->id());
+        if (it != snapshots_.end()) {
+            cfg.snapshot_file = it->second.file;
+        }
         configs.push_back(cfg);
     }
     config_store_.save(configs);
@@ -204,16 +184,103 @@ void TerminalPanel::load_sessions() {
     auto configs = config_store_.load();
     for (const auto& cfg : configs) {
         uint32_t id = next_session_id_++;
-        auto session = std::make_unique<TerminalSession>(id);
+        auto session = make_session(id);
         session->set_name(cfg.name);
         session->config().app = cfg.app;
         session->config().working_dir = cfg.working_dir;
+        SnapshotState& snapshot = snapshots_[id];
+        snapshot.file = cfg.snapshot_file.empty() ? new_snapshot_file(id) : cfg.snapshot_file;
+        snapshot.restored = cfg.snapshot_file.empty();
+        if (cfg.keep_warm) {
+            controller_.set_keep_warm(*session, true);
+        }
+        session->config().daemon_key = cfg.daemon_key;
+        if (controller_.reattach(*session)) {
+            // The daemon replays the agent's own output, which the saved
+            // snapshot would only duplicate.
+            snapshot.restored = true;
+        }
         sessions_.push_back(std::move(session));
     }
 }
 
+void TerminalPanel::save_snapshots() {
+    for (auto& session : sessions_) {
+        session->wait_until_parsed(std::chrono::milliseconds(100));
+        session->refresh_snapshot();
+        save_snapshot(*session);
+    }
+}
+
+std::string TerminalPanel::snapshot_path(uint32_t session_id) const {
+    auto it = snapshots_.find(session_id);
+    std::string dir = config_store_.snapshot_dir();
+    if (it == snapshots_.end() || it->second.file.empty() || dir.empty()) {
+        return {};
+    }
+    return dir + "/" + it->second.file;
+}
+
+// Saves a session whose screen changed since its last save. The UI thread,
+// which owns the snapshot, encodes it; the file is written on
+// snapshot_writer_.
+void TerminalPanel::save_snapshot(TerminalSession& session) {
+    auto it = snapshots_.find(session.id());
+    std::string path = snapshot_path(session.id());
+    if (it == snapshots_.end() || !it->second.restored || path.empty() ||
+        session.snapshot().generation == it->second.saved_generation) {
+        return;
+    }
+    
+    std::string data = encode_terminal(session.terminal(), session.snapshot());
+    it->second.saved_generation = session.snapshot().generation;
+    snapshot_writer_.submit([dir = config_store_.snapshot_dir(), path = std::move(path), data = std::move(data),
+                             name = session.name()] {
+        std::error_code ec;
+        std::filesystem::create_directories(dir, ec);
+        std::string error;
+        if (!write_terminal_file(path, data, &error)) {
+            fprintf(stderr, "Failed to save %s: %s\n", name.c_str(), error.c_str());
+        }
+    });
+}
+
+void TerminalPanel::save_changed_snapshots() {
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_snapshot_save_ < SNAPSHOT_SAVE_INTERVAL) {
+        return;
+    }
+    last_snapshot_save_ = now;
+    for (auto& session : sessions_) {
+        save_snapshot(*session);
+    }
+}
+
+void TerminalPanel::restore_snapshot(TerminalSession& session) {
+    auto it = snapshots_.find(session.id());
+    if (it == snapshots_.end() || it->second.restored) {
+        return;
+    }
+    it->second.restored = true;
+    
+    std::string path = snapshot_path(session.id());
+    std::error_code ec;
+    if (path.empty() || !std::filesystem::exists(path, ec)) {
+        return;
+    }
+    std::string error;
+    auto saved = SavedTerminal::load(path, &error);
+    if (!saved) {
+        session.write_to_terminal("[Could not restore previous output: " + error + "]\r\n");
+        return;
+    }
+    session.restore_terminal(std::move(saved->scrollback), saved->screen);
+    session.request_scroll_to_bottom();
+}
+
 void TerminalPanel::render() {
     process_events();
+    save_changed_snapshots();
     
     for (uint32_t id : sessions_to_close_) {
         close_session(id);
@@ -222,6 +289,14 @@ void TerminalPanel::render() {
     
     ImGui::SetNextWindowSizeConstraints(ImVec2(400, 300), ImVec2(FLT_MAX, FLT_MAX));
     if (ImGui::Begin("Terminal")) {
+        ImGuiIO& io = ImGui::GetIO();
+        if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) &&
+            ImGui::IsKeyPressed(ImGuiKey_F, false) &&
+            ((io.KeySuper && io.KeyShift) || (io.KeyCtrl && io.KeyAlt))) {
+            global_view_.open = true;
+            global_view_.focus_input = true;
+        }
+        
         if (sessions_.empty()) {
             ImGui::TextDisabled("No sessions. Press + to create one.");
             if (ImGui::Button("+##CreateSession")) {
@@ -237,6 +312,9 @@ void TerminalPanel::render() {
                     if (session->state() == SessionState::Running) {
                         flags |= ImGuiTabItemFlags_UnsavedDocument;
                     }
+                    if (select_session_id_ == session->id()) {
+                        flags |= ImGuiTabItemFlags_SetSelected;
+                    }
                     
                     bool is_renaming = (renaming_session_id_ == session->id());
                     
@@ -261,7 +339,17 @@ void TerminalPanel::render() {
                     }
                     
                     std::string tab_id = session->name() + "##" + std::to_string(session->id());
-                    if (ImGui::BeginTabItem(tab_id.c_str(), &open, flags)) {
+                    bool tab_visible = ImGui::BeginTabItem(tab_id.c_str(), &open, flags);
+                    if (tab_visible && !session->foreground()) {
+                        // Finish whatever the tab deferred while hidden so its
+                        // first frame is current.
+                        restore_snapshot(*session);
+                        session->set_foreground(true);
+                        session->wait_until_parsed(TAB_CATCH_UP_TIMEOUT);
+                    } else {
+                        session->set_foreground(tab_visible);
+                    }
+                    if (tab_visible) {
                         if (ImGui::IsItemHovered()) {
                             ImGui::SetTooltip("Double-click to rename session");
                         }
@@ -276,6 +364,7 @@ void TerminalPanel::render() {
                         render_control_bar(*session);
                         handle_start_stop(*session);
                         ImGui::Separator();
+                        render_search_bar(*session);
                         render_output_area(*session);
                         render_input_line(*session);
                         
@@ -295,9 +384,18 @@ void TerminalPanel::render() {
                     }
                 }
                 
+                select_session_id_ = 0;
+                
                 if (ImGui::TabItemButton("+", ImGuiTabItemFlags_Trailing | ImGuiTabItemFlags_NoTooltip)) {
                     create_session();
                 }
+                if (ImGui::TabItemButton("Search", ImGuiTabItemFlags_Trailing | ImGuiTabItemFlags_NoTooltip)) {
+                    global_view_.open = true;
+                    global_view_.focus_input = true;
+                }
+                if (ImGui::IsItemHovered()) {
+                    ImGui::SetTooltip("Search all sessions (Cmd+Shift+F / Ctrl+Alt+F)");
+                }
                 
                 ImGui::EndTabBar();
             }
@@ -347,36 +445,30 @@ void TerminalPanel::render() {
         }
     }
     ImGui::End();
+    
+    render_global_search();
 }
 
 void TerminalPanel::process_events() {
-    while (auto event_opt = controller_.event_queue().try_pop()) {
+    DIANA_PROFILE_SCOPE("terminal.process_events");
+    size_t handled = controller_.event_queue().drain(drained_events_);
+    for (auto& event : drained_events_) {
         std::visit([this](auto&& evt) {
             using T = std::decay_t<decltype(evt)>;
             
             if constexpr (std::is_same_v<T, OutputEvent>) {
                 if (auto* session = find_session(evt.session_id)) {
-                    auto& pending = cpr_buffers_[evt.session_id];
-                    bool has_reply = false;
-                    std::string filtered = filter_cpr_and_build_reply(
-                        evt.data,
-                        pending,
-                        session->terminal().get_cursor(),
-                        has_reply
-                    );
-
-                    if (!filtered.empty()) {
-                        session->write_to_terminal(filtered.data(), filtered.size());
-                        if (!session->user_scrolled_up()) {
-                            session->request_scroll_to_bottom();
-                        }
-                    }
-
-                    if (has_reply) {
-                        controller_.send_raw_key(*session, build_cpr_reply(session->terminal().get_cursor()));
+                    session->write_to_terminal(evt.data);
+                    if (!session->user_scrolled_up()) {
+                        session->request_scroll_to_bottom();
                     }
                 }
             }
+            else if constexpr (std::is_same_v<T, InputEvent>) {
+                if (auto* session = find_session(evt.session_id)) {
+                    controller_.send_raw_key(*session, evt.data);
+                }
+            }
             else if constexpr (std::is_same_v<T, ExitEvent>) {
                 if (auto* session = find_session(evt.session_id)) {
                     std::string msg;
@@ -400,8 +492,10 @@ void TerminalPanel::process_events() {
                     }
                 }
             }
-        }, *event_opt);
+        }, event);
     }
+    drained_events_.clear();
+    Telemetry::instance().record_events(handled);
 }
 
 TerminalSession* TerminalPanel::active_session() {
@@ -418,9 +512,19 @@ TerminalSession* TerminalPanel::find_session(uint32_t id) {
     return nullptr;
 }
 
+std::unique_ptr<TerminalSession> TerminalPanel::make_session(uint32_t id) {
+    auto session = std::make_unique<TerminalSession>(id);
+    session->set_reply_callback([this, id](const std::string& reply) {
+        controller_.event_queue().push(InputEvent{id, reply});
+        RedrawScheduler::instance().request_redraw();
+    });
+    return session;
+}
+
 uint32_t TerminalPanel::create_session() {
     uint32_t id = next_session_id_++;
-    sessions_.push_back(std::make_unique<TerminalSession>(id));
+    sessions_.push_back(make_session(id));
+    snapshots_[id] = SnapshotState{new_snapshot_file(id), true, 0};
     save_sessions();
     ImGui::SaveIniSettingsToDisk(ImGui::GetIO().IniFilename);
     return id;
@@ -431,7 +535,21 @@ void TerminalPanel::close_session(uint32_t id) {
         [id](const auto& s) { return s->id() == id; });
     
     if (it != sessions_.end()) {
-        cpr_buffers_.erase(id);
+        global_search_.cancel();
+        auto& results = global_view_.results;
+        results.erase(std::remove_if(results.begin(), results.end(),
+            [id](const GlobalSearchResult& r) { return r.session_id == id; }), results.end());
+        located_hits_.erase(id);
+        replayers_.erase(id);
+        recording_errors_.erase(id);
+        controller_.release_session(**it);
+        std::string snapshot = snapshot_path(id);
+        if (!snapshot.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(snapshot, ec);
+        }
+        snapshots_.erase(id);
+        
         sessions_.erase(it);
         
         if (active_session_idx_ >= sessions_.size() && !sessions_.empty()) {
@@ -452,6 +570,7 @@ void TerminalPanel::render_control_bar(TerminalSession& session) {
     if (!can_change) ImGui::BeginDisabled();
     if (ImGui::Combo("##App", &app_idx, APP_NAMES, APP_COUNT)) {
         session.config().app = static_cast<AppKind>(app_idx);
+        controller_.set_keep_warm(session, session.config().keep_warm);
         save_sessions();
     }
     if (!can_change) ImGui::EndDisabled();
@@ -477,6 +596,8 @@ void TerminalPanel::render_control_bar(TerminalSession& session) {
         if (result == NFD_OKAY && out_path) {
             session.config().working_dir = out_path;
             NFD_FreePath(out_path);
+            // Moves the warm agent, if any, to the new directory.
+            controller_.set_keep_warm(session, session.config().keep_warm);
             save_sessions();
         }
     }
@@ -488,7 +609,8 @@ void TerminalPanel::render_control_bar(TerminalSession& session) {
     bool is_starting = session.state() == SessionState::Starting;
     bool is_stopping = session.state() == SessionState::Stopping;
     
-    if (is_starting || is_stopping) ImGui::BeginDisabled();
+    bool replaying = is_replaying(session.id());
+    if (is_starting || is_stopping || replaying) ImGui::BeginDisabled();
     
     if (is_running) {
         if (ImGui::Button("Stop")) {
@@ -504,7 +626,7 @@ void TerminalPanel::render_control_bar(TerminalSession& session) {
         }
     }
     
-    if (is_starting || is_stopping) ImGui::EndDisabled();
+    if (is_starting || is_stopping || replaying) ImGui::EndDisabled();
     
     ImGui::SameLine();
     
@@ -517,13 +639,244 @@ void TerminalPanel::render_control_bar(TerminalSession& session) {
     }
     if (is_starting || is_stopping || !is_running) ImGui::EndDisabled();
     
+    ImGui::SameLine();
+    const SessionRecorder* recorder = controller_.recorder(session);
+    if (ImGui::Button(recorder ? "Rec *" : "Rec")) {
+        recording_errors_.erase(session.id());
+        ImGui::OpenPopup("RecordingMenu");
+    }
+    if (ImGui::BeginPopup("RecordingMenu")) {
+        render_recording_menu(session);
+        ImGui::EndPopup();
+    }
+    
+    ImGui::SameLine();
+    bool keep_warm = session.config().keep_warm;
+    if (ImGui::Checkbox("Warm", &keep_warm)) {
+        controller_.set_keep_warm(session, keep_warm);
+        save_sessions();
+    }
+    if (ImGui::IsItemHovered()) {
+        const WarmPool& pool = controller_.warm_pool();
+        ImGui::SetTooltip("Keep an agent for this app and directory started in the background\n"
+                          "%zu warm, %llu taken, %llu cold starts",
+                          pool.idle(), static_cast<unsigned long long>(pool.hits()),
+                          static_cast<unsigned long long>(pool.misses()));
+    }
+    
     ImGui::SameLine();
     ImGui::TextDisabled("| %s", TerminalSession::state_name(session.state()));
+    if (ImGui::IsItemHovered()) {
+        if (auto resolved = controller_.resolution(session.config().app)) {
+            ImGui::SetTooltip("%s%s\nresolved in %.1f ms%s", resolved->path.c_str(),
+                              resolved->found ? "" : " (not found)", resolved->resolve_ms,
+                              resolved->via_shell ? " via login shell" : "");
+        }
+    }
+    
+    // Refreshed with whatever redraws the bar; agents that are busy enough
+    // to matter print often enough.
+    auto usage = controller_.resource_sampler().latest(session.id());
+    if (usage && usage->processes > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("| cpu %.0f%% %.0f MB", usage->cpu_percent,
+                            static_cast<double>(usage->rss_bytes) / (1024.0 * 1024.0));
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%u processes in the group\nread %.1f KB/s, write %.1f KB/s",
+                              usage->processes, usage->read_bytes_per_sec / 1024.0,
+                              usage->write_bytes_per_sec / 1024.0);
+        }
+    }
+    
+    if (recorder) {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.35f, 1.0f), "| REC %.1f MB",
+                           static_cast<double>(recorder->bytes_recorded()) / (1024.0 * 1024.0));
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%s", recorder->path().c_str());
+        }
+    }
+    auto error_it = recording_errors_.find(session.id());
+    if (error_it != recording_errors_.end() && !error_it->second.empty()) {
+        ImGui::SameLine();
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "| %s", error_it->second.c_str());
+    }
+    if (replaying) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("| Replay %.0f%%", replayers_[session.id()]->progress() * 100.0);
+        RedrawScheduler::instance().request_redraw_in(0.25);
+    }
+    
+    size_t pending_input = controller_.pending_input(session);
+    if (pending_input > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("| sending %.1f KB", static_cast<double>(pending_input) / 1024.0);
+        RedrawScheduler::instance().request_redraw_in(0.1);
+    }
+    
+    IngestStats ingest = session.ingest_stats();
+    if (ingest.pending_bytes > 0) {
+        ImGui::SameLine();
+        ImGui::TextDisabled("| backlog %.1f KB, lag %.0f ms",
+                            static_cast<double>(ingest.pending_bytes) / 1024.0, ingest.parse_lag_ms);
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("Parsed %.1f MB in %llu slices\nPTY reads paused %llu times",
+                              static_cast<double>(ingest.bytes_parsed) / (1024.0 * 1024.0),
+                              static_cast<unsigned long long>(ingest.slices),
+                              static_cast<unsigned long long>(ingest.backpressure_stalls));
+        }
+    }
     
     ImGui::PopItemWidth();
     ImGui::PopID();
 }
 
+void TerminalPanel::render_recording_menu(TerminalSession& session) {
+    const nfdfilteritem_t recording_filter[1] = {{"Diana recording", "dianarec"}};
+    std::string& error = recording_errors_[session.id()];
+    
+    if (controller_.recorder(session)) {
+        if (ImGui::MenuItem("Stop Recording")) {
+            controller_.stop_recording(session);
+        }
+    } else if (ImGui::MenuItem("Start Recording")) {
+        std::error_code ec;
+        std::filesystem::create_directories(recordings_dir(), ec);
+        controller_.start_recording(session, default_recording_path(session.name()), &error);
+    }
+    
+    ImGui::Separator();
+    
+    bool replaying = is_replaying(session.id());
+    bool can_replay = session.state() == SessionState::Idle && !replaying;
+    if (ImGui::MenuItem("Replay Recording...", nullptr, false, can_replay)) {
+        nfdchar_t* out_path = nullptr;
+        std::string dir = recordings_dir();
+        if (NFD_OpenDialog(&out_path, recording_filter, 1, dir.c_str()) == NFD_OKAY && out_path) {
+            std::string path = out_path;
+            NFD_FreePath(out_path);
+            if (auto recording = Recording::load(path, &error)) {
+                std::string msg = "\r\n[Replaying " + std::filesystem::path(path).filename().string() + "]\r\n";
+                session.write_to_terminal(msg);
+                session.request_scroll_to_bottom();
+                
+                ReplayOptions options;
+                options.speed = REPLAY_SPEEDS[replay_speed_idx_];
+                auto& replayer = replayers_[session.id()];
+                if (!replayer) {
+                    replayer = std::make_unique<SessionReplayer>();
+                }
+                replayer->start(session, std::make_shared<Recording>(std::move(*recording)), options);
+            }
+        }
+    }
+    if (ImGui::BeginMenu("Replay Speed")) {
+        for (int i = 0; i < REPLAY_SPEED_COUNT; ++i) {
+            if (ImGui::MenuItem(REPLAY_SPEED_NAMES[i], nullptr, i == replay_speed_idx_)) {
+                replay_speed_idx_ = i;
+            }
+        }
+        ImGui::EndMenu();
+    }
+    if (ImGui::MenuItem("Stop Replay", nullptr, false, replaying)) {
+        replayers_[session.id()]->stop();
+    }
+    
+    ImGui::Separator();
+    
+    bool save_plain = ImGui::MenuItem("Save Output...");
+    bool save_sgr = ImGui::MenuItem("Save Output with Colors...");
+    if (save_plain || save_sgr) {
+        const nfdfilteritem_t text_filter[1] = {{"Text", "txt,log,ansi"}};
+        std::string default_name = timestamped_name(session.name()) + (save_sgr ? ".ansi" : ".txt");
+        nfdchar_t* out_path = nullptr;
+        if (NFD_SaveDialog(&out_path, text_filter, 1, nullptr, default_name.c_str()) == NFD_OKAY && out_path) {
+            std::string path = out_path;
+            NFD_FreePath(out_path);
+            save_output(session, path, save_sgr, &error);
+        }
+    }
+    
+    ImGui::Separator();
+    
+    if (ImGui::MenuItem("Export as asciicast...")) {
+        nfdchar_t* in_path = nullptr;
+        std::string dir = recordings_dir();
+        if (NFD_OpenDialog(&in_path, recording_filter, 1, dir.c_str()) == NFD_OKAY && in_path) {
+            std::filesystem::path source = in_path;
+            NFD_FreePath(in_path);
+            if (auto recording = Recording::load(source.string(), &error)) {
+                const nfdfilteritem_t cast_filter[1] = {{"asciicast", "cast"}};
+                std::string default_name = source.stem().string() + ".cast";
+                nfdchar_t* out_path = nullptr;
+                if (NFD_SaveDialog(&out_path, cast_filter, 1, nullptr, default_name.c_str()) == NFD_OKAY && out_path) {
+                    recording->export_asciicast(out_path, &error);
+                    NFD_FreePath(out_path);
+                }
+            }
+        }
+    }
+    
+}
+
+bool TerminalPanel::save_output(TerminalSession& session, const std::string& path, bool sgr, std::string* error) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        if (error) *error = "Cannot write " + path;
+        return false;
+    }
+    
+    const VTerminal& terminal = session.terminal();
+    const ScreenSnapshot& snapshot = session.snapshot();
+    TextExtractOptions options;
+    options.sgr = sgr;
+    
+    // Everything up to the last screen row with something on it.
+    int used_rows = snapshot.rows;
+    auto row_is_empty = [&snapshot](int row) {
+        const TerminalCell* cells = snapshot.row(row);
+        return std::all_of(cells, cells + snapshot.cols, [](const TerminalCell& cell) {
+            return cell.chars[0] == 0 || cell.chars[0] == ' ';
+        });
+    };
+    while (used_rows > 0 && row_is_empty(used_rows - 1)) {
+        --used_rows;
+    }
+    const uint64_t end_line = snapshot.scrollback_evicted + snapshot.scrollback_size + static_cast<uint64_t>(used_rows);
+    
+    uint64_t line = 0;
+    {
+        auto lock = terminal.lock_scrollback();
+        line = terminal.scrollback_evicted();
+    }
+    // Chunked so the parser thread is never kept off the scrollback for long.
+    while (line < end_line && file) {
+        uint64_t last = std::min(end_line, line + SAVE_CHUNK_LINES) - 1;
+        text_buffer_.clear();
+        size_t lines = 0;
+        {
+            auto lock = terminal.lock_scrollback();
+            lines = terminal.extract_text({line, 0}, {last, std::numeric_limits<int>::max()}, snapshot, text_buffer_, options);
+        }
+        if (lines > 0) {
+            text_buffer_ += '\n';
+            file.write(text_buffer_.data(), static_cast<std::streamsize>(text_buffer_.size()));
+        }
+        line = last + 1;
+    }
+    
+    if (!file) {
+        if (error) *error = "Failed writing " + path;
+        return false;
+    }
+    return true;
+}
+
+bool TerminalPanel::is_replaying(uint32_t session_id) const {
+    auto it = replayers_.find(session_id);
+    return it != replayers_.end() && it->second->running();
+}
+
 void TerminalPanel::handle_start_stop(TerminalSession& session) {
     if (session.state() == SessionState::Starting) {
         controller_.start_session(session);
@@ -581,6 +934,7 @@ void TerminalPanel::render_banner() {
 }
 
 void TerminalPanel::render_output_area(TerminalSession& session) {
+    DIANA_PROFILE_SCOPE("terminal.render_output_area");
     const auto& theme = get_current_theme();
     ImVec4 term_bg = u32_to_imvec4(theme.terminal_bg);
     
@@ -604,10 +958,14 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
         if (new_cols != terminal.cols() || new_rows != terminal.rows()) {
             controller_.resize_pty(session, new_rows, new_cols);
         }
+        if (session.refresh_snapshot() && !session.user_scrolled_up()) {
+            session.request_scroll_to_bottom();
+        }
+        const ScreenSnapshot& snapshot = session.snapshot();
         
         ImGui::PopStyleVar();
         
-        if (session.state() == SessionState::Idle && session.terminal().scrollback().empty()) {
+        if (session.state() == SessionState::Idle && snapshot.scrollback_size == 0) {
             render_banner();
             ImGui::Dummy(ImVec2(1.0f, ImGui::GetContentRegionAvail().y));
         } else {
@@ -621,19 +979,56 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
                     last_scroll = scroll_y;
                 }
                 
+                // Lines are laid out from the snapshot; the live scrollback may
+                // have grown (or evicted lines) since it was taken.
+                auto scrollback_lock = terminal.lock_scrollback();
                 const auto& scrollback = terminal.scrollback();
-                int total_lines = static_cast<int>(scrollback.size()) + terminal.rows();
+                const int scrollback_lines = static_cast<int>(snapshot.scrollback_size);
+                const int64_t scrollback_shift = static_cast<int64_t>(terminal.scrollback_evicted() - snapshot.scrollback_evicted);
+                int total_lines = scrollback_lines + snapshot.rows;
+                
+                // Display line i is absolute line snapshot.scrollback_evicted + i.
+                auto search_it = searches_.find(session.id());
+                SearchState* search = (search_it != searches_.end() && search_it->second.open) ? &search_it->second : nullptr;
+                int jump_line = -1;
+                if (search) {
+                    update_search(*search, terminal, snapshot);
+                    if (search->jump_pending && search->current >= 0) {
+                        jump_line = static_cast<int>(search->hits[static_cast<size_t>(search->current)].line - snapshot.scrollback_evicted);
+                        search->jump_pending = false;
+                    }
+                }
+                
+                // A result picked in the global search; it is dropped once
+                // its line has been evicted.
+                std::vector<SearchHit> located;
+                auto located_it = located_hits_.find(session.id());
+                if (located_it != located_hits_.end()) {
+                    const SearchHit& hit = located_it->second.hit;
+                    if (hit.line < snapshot.scrollback_evicted) {
+                        located_hits_.erase(located_it);
+                    } else {
+                        located.push_back(hit);
+                        if (located_it->second.jump_pending && jump_line < 0) {
+                            jump_line = static_cast<int>(hit.line - snapshot.scrollback_evicted);
+                        }
+                        located_it->second.jump_pending = false;
+                    }
+                }
+                bool jumped = false;
                 
                 auto& selection = selections_[session.id()];
                 if (ImGui::IsWindowHovered()) {
                     if (ImGui::IsMouseClicked(0)) {
+                        located_hits_.erase(session.id());
+                        
                         ImVec2 mouse_pos = ImGui::GetMousePos();
                         ImVec2 rel_pos = ImVec2(mouse_pos.x - content_start.x, mouse_pos.y - content_start.y + scroll_y);
                         
                         int hover_col = static_cast<int>(rel_pos.x / char_size.x);
                         int hover_line = static_cast<int>(rel_pos.y / line_height);
                         
-                        hover_col = std::max(0, std::min(hover_col, terminal.cols() - 1));
+                        hover_col = std::max(0, std::min(hover_col, snapshot.cols - 1));
                         hover_line = std::max(0, std::min(hover_line, total_lines - 1));
                         
                         selection.active = true;
@@ -649,7 +1044,7 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
                         int hover_col = static_cast<int>(rel_pos.x / char_size.x);
                         int hover_line = static_cast<int>(rel_pos.y / line_height);
                         
-                        hover_col = std::max(0, std::min(hover_col, terminal.cols() - 1));
+                        hover_col = std::max(0, std::min(hover_col, snapshot.cols - 1));
                         hover_line = std::max(0, std::min(hover_line, total_lines - 1));
                         
                         selection.end_row = hover_line;
@@ -661,22 +1056,44 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
                     selection.dragging = false;
                 }
                 
-                bool has_scrollback = !scrollback.empty();
+                bool has_scrollback = scrollback_lines > 0;
                 
                 if (has_scrollback) {
                     ImGuiListClipper clipper;
                     clipper.Begin(total_lines, line_height);
+                    if (jump_line >= 0 && jump_line < total_lines) {
+                        clipper.IncludeItemByIndex(jump_line);
+                    }
                     
                     while (clipper.Step()) {
                         for (int line_idx = clipper.DisplayStart; line_idx < clipper.DisplayEnd; ++line_idx) {
-                            bool is_scrollback = line_idx < static_cast<int>(scrollback.size());
+                            bool is_scrollback = line_idx < scrollback_lines;
+                            ImVec2 line_origin = ImGui::GetCursorScreenPos();
                             
                             if (is_scrollback) {
-                                const auto& line = scrollback[static_cast<size_t>(line_idx)];
-                                render_terminal_line(line.data(), static_cast<int>(line.size()), line_height, line_idx, selection);
+                                int64_t live_idx = line_idx - scrollback_shift;
+                                if (live_idx >= 0 && live_idx < static_cast<int64_t>(scrollback.size())) {
+                                    const auto& line = scrollback[static_cast<size_t>(live_idx)];
+                                    render_terminal_line(line.data(), static_cast<int>(line.size()), line_height, line_idx, selection);
+                                } else {
+                                    ImGui::Dummy(ImVec2(1.0f, line_height));
+                                }
                             } else {
-                                int screen_row = line_idx - static_cast<int>(scrollback.size());
-                                render_screen_row(session, screen_row, line_height, line_idx, selection);
+                                int screen_row = line_idx - scrollback_lines;
+                                render_screen_row(snapshot, screen_row, line_height, line_idx, selection);
+                            }
+                            
+                            uint64_t abs_line = snapshot.scrollback_evicted + static_cast<uint64_t>(line_idx);
+                            if (search) {
+                                draw_search_highlights(search->hits, search->current, abs_line, line_origin, char_size.x, line_height);
+                            }
+                            if (!located.empty()) {
+                                draw_search_highlights(located, 0, abs_line, line_origin, char_size.x, line_height);
+                            }
+                            if (line_idx == jump_line) {
+                                ImGui::SetScrollHereY(0.5f);
+                                session.set_user_scrolled_up(true);
+                                jumped = true;
                             }
                         }
                     }
@@ -688,21 +1105,23 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
                         session.set_user_scrolled_up(!at_bottom);
                     }
                     
-                    if (at_bottom) {
+                    // The jump takes effect next frame; until then we may still
+                    // be at the bottom.
+                    if (at_bottom && !jumped) {
                         session.set_user_scrolled_up(false);
                     }
                     
-                    if (session.scroll_to_bottom() || (!session.user_scrolled_up() && session.state() == SessionState::Running)) {
+                    if (!jumped && (session.scroll_to_bottom() || (!session.user_scrolled_up() && session.state() == SessionState::Running))) {
                         ImGui::SetScrollHereY(1.0f);
                         session.set_scroll_to_bottom(false);
                     }
                     
                     if (session.config().app == AppKind::Shell) {
-                        auto cursor = terminal.get_cursor();
-                        int cursor_line_idx = static_cast<int>(scrollback.size()) + cursor.row;
+                        const auto& cursor = snapshot.cursor;
+                        int cursor_line_idx = scrollback_lines + cursor.row;
                         float target_x = content_start.x + cursor.col * char_size.x;
                         float target_y = content_start.y + cursor_line_idx * line_height - scroll_y;
-                        auto cursor_cell = terminal.get_cell(cursor.row, cursor.col);
+                        const auto& cursor_cell = snapshot.cell(cursor.row, cursor.col);
                         int cursor_cell_width = cursor_cell.width > 0 ? cursor_cell.width : 1;
                         
                         ImVec2 clip_min = ImGui::GetWindowPos();
@@ -712,15 +1131,23 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
                         }
                     }
                 } else {
-                    for (int row = 0; row < terminal.rows(); ++row) {
-                        render_screen_row(session, row, line_height, row, selection);
+                    for (int row = 0; row < snapshot.rows; ++row) {
+                        ImVec2 line_origin = ImGui::GetCursorScreenPos();
+                        render_screen_row(snapshot, row, line_height, row, selection);
+                        uint64_t abs_line = snapshot.scrollback_evicted + static_cast<uint64_t>(row);
+                        if (search) {
+                            draw_search_highlights(search->hits, search->current, abs_line, line_origin, char_size.x, line_height);
+                        }
+                        if (!located.empty()) {
+                            draw_search_highlights(located, 0, abs_line, line_origin, char_size.x, line_height);
+                        }
                     }
                     
                     if (session.config().app == AppKind::Shell) {
-                        auto cursor = terminal.get_cursor();
+                        const auto& cursor = snapshot.cursor;
                         float target_x = content_start.x + cursor.col * char_size.x;
                         float target_y = content_start.y + cursor.row * line_height;
-                        auto cursor_cell = terminal.get_cell(cursor.row, cursor.col);
+                        const auto& cursor_cell = snapshot.cell(cursor.row, cursor.col);
                         int cursor_cell_width = cursor_cell.width > 0 ? cursor_cell.width : 1;
                         render_cursor(session, target_x, target_y, char_size.x, line_height, cursor_cell_width);
                     }
@@ -740,7 +1167,9 @@ void TerminalPanel::render_output_area(TerminalSession& session) {
 
 void TerminalPanel::render_cursor(TerminalSession& session, float target_x, float target_y, float char_w, float char_h, int cell_width) {
     auto& anim = cursor_animations_[session.id()];
-    float dt = ImGui::GetIO().DeltaTime;
+    // Frames stop while idle, so the first one after a pause can carry a
+    // long delta; clamp it to keep the spring and trail decay stable.
+    float dt = std::min(ImGui::GetIO().DeltaTime, MAX_CURSOR_DT);
     const auto& theme = get_current_theme();
     
     float base_cursor_w = char_w * cell_width;
@@ -787,6 +1216,13 @@ void TerminalPanel::render_cursor(TerminalSession& session, float target_x, floa
     anim.current_y += anim.velocity_y * dt;
     
     float speed = std::sqrt(anim.velocity_x * anim.velocity_x + anim.velocity_y * anim.velocity_y);
+    if (speed < 0.5f && std::abs(anim.target_x - anim.current_x) < 0.5f && std::abs(anim.target_y - anim.current_y) < 0.5f) {
+        anim.current_x = anim.target_x;
+        anim.current_y = anim.target_y;
+        anim.velocity_x = 0.0f;
+        anim.velocity_y = 0.0f;
+        speed = 0.0f;
+    }
     
     constexpr float NARROW_WIDTH = 0.15f;
     constexpr float FULL_WIDTH = 1.0f;
@@ -811,8 +1247,20 @@ void TerminalPanel::render_cursor(TerminalSession& session, float target_x, floa
         anim.trail_alpha[anim.trail_head] = std::min(1.0f, speed / 800.0f);
     }
     
+    bool trail_visible = false;
     for (int i = 0; i < CursorAnimation::TRAIL_LENGTH; ++i) {
         anim.trail_alpha[i] *= (1.0f - dt * 8.0f);
+        trail_visible = trail_visible || anim.trail_alpha[i] >= 0.01f;
+    }
+    
+    // Run at full rate only while the cursor is moving; the pulse is slow
+    // enough to step at a lower rate and holds still when unfocused.
+    bool cursor_focused = ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+    bool animating = speed > 0.0f || trail_visible || std::abs(anim.target_width - anim.current_width) > 0.01f;
+    if (animating) {
+        RedrawScheduler::instance().request_redraw_in(0.0);
+    } else if (cursor_focused) {
+        RedrawScheduler::instance().request_redraw_in(CURSOR_PULSE_STEP);
     }
     
     ImDrawList* draw_list = ImGui::GetWindowDrawList();
@@ -841,7 +1289,7 @@ void TerminalPanel::render_cursor(TerminalSession& session, float target_x, floa
         );
     }
     
-    float blink = (std::sin(ImGui::GetTime() * 4.0f) + 1.0f) * 0.5f;
+    float blink = cursor_focused ? (std::sin(ImGui::GetTime() * 4.0f) + 1.0f) * 0.5f : 1.0f;
     int base_alpha = 200 + static_cast<int>(blink * 55);
     
     ImU32 cursor_color = IM_COL32(cursor_r, cursor_g, cursor_b, base_alpha);
@@ -862,49 +1310,291 @@ void TerminalPanel::render_cursor(TerminalSession& session, float target_x, floa
     );
 }
 
-void TerminalPanel::render_screen_row(TerminalSession& session, int screen_row, float line_height, int line_idx, const Selection& selection) {
-    const auto& terminal = session.terminal();
+void TerminalPanel::render_search_bar(TerminalSession& session) {
+    ImGuiIO& io = ImGui::GetIO();
+    bool find_pressed = ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) &&
+                        ImGui::IsKeyPressed(ImGuiKey_F, false) &&
+                        ((io.KeySuper && !io.KeyShift) || (io.KeyCtrl && io.KeyShift && !io.KeyAlt));
+    if (find_pressed) {
+        auto& search = searches_[session.id()];
+        search.open = true;
+        search.focus_input = true;
+    }
+    
+    auto it = searches_.find(session.id());
+    if (it == searches_.end() || !it->second.open) {
+        return;
+    }
+    auto& search = it->second;
+    
+    ImGui::PushID(static_cast<int>(session.id()));
+    if (search.focus_input) {
+        ImGui::SetKeyboardFocusHere();
+        search.focus_input = false;
+    }
+    ImGui::SetNextItemWidth(260);
+    if (ImGui::InputTextWithHint("##Find", "Find in output", search.query, sizeof(search.query),
+                                 ImGuiInputTextFlags_EnterReturnsTrue)) {
+        step_search(search, io.KeyShift ? 1 : -1);
+        ImGui::SetKeyboardFocusHere(-1);
+    }
+    if (ImGui::IsItemActive() && ImGui::IsKeyPressed(ImGuiKey_Escape)) {
+        search.open = false;
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::SmallButton("^")) {
+        step_search(search, -1);
+    }
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Previous match (Enter)");
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("v")) {
+        step_search(search, 1);
+    }
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Next match (Shift+Enter)");
+    }
+    
+    ImGui::SameLine();
+    if (search.hits.empty()) {
+        ImGui::TextDisabled("%s", search.query[0] ? "No matches" : "");
+    } else {
+        ImGui::Text("%d of %zu%s", search.current + 1, search.hits.size(), search.truncated ? "+" : "");
+    }
+    
+    ImGui::SameLine();
+    if (ImGui::SmallButton("x")) {
+        search.open = false;
+    }
+    ImGui::PopID();
+}
+
+void TerminalPanel::update_search(SearchState& search, const VTerminal& terminal, const ScreenSnapshot& snapshot) {
+    bool query_changed = search.searched_query != search.query;
+    if (!query_changed && search.searched_generation == snapshot.generation) {
+        return;
+    }
+    
+    bool had_current = search.current >= 0 && search.current < static_cast<int>(search.hits.size());
+    SearchHit previous = had_current ? search.hits[static_cast<size_t>(search.current)] : SearchHit{};
     
-    std::vector<TerminalCell> row_cells;
-    row_cells.reserve(static_cast<size_t>(terminal.cols()));
+    search.searched_query = search.query;
+    search.searched_generation = snapshot.generation;
+    search.hits.clear();
+    search.truncated = false;
+    if (search.searched_query.empty()) {
+        search.current = -1;
+        return;
+    }
+    
+    // Screen rows hold the newest output, so they are searched first and the
+    // scrollback fills the rest of MAX_SEARCH_HITS from its newest line back.
+    // The index may already hold lines the snapshot still shows on screen;
+    // those are matched as screen rows only.
+    const uint64_t screen_first_line = snapshot.scrollback_evicted + snapshot.scrollback_size;
+    std::string folded = fold_search_text(search.searched_query);
+    std::vector<SearchHit> screen_hits;
+    LineText row_text;
+    for (int row = 0; row < snapshot.rows && screen_hits.size() < MAX_SEARCH_HITS; ++row) {
+        project_line(snapshot.row(row), snapshot.cols, row_text);
+        find_in_line(row_text, folded, screen_first_line + static_cast<uint64_t>(row), screen_hits, MAX_SEARCH_HITS);
+    }
+    search.truncated = screen_hits.size() >= MAX_SEARCH_HITS ||
+                       !terminal.scrollback_index().find_last(search.searched_query, screen_first_line, search.hits,
+                                                              MAX_SEARCH_HITS - screen_hits.size());
+    search.hits.insert(search.hits.end(), screen_hits.begin(), screen_hits.end());
     
-    for (int col = 0; col < terminal.cols(); ++col) {
-        row_cells.push_back(terminal.get_cell(screen_row, col));
+    if (search.hits.empty()) {
+        search.current = -1;
+    } else if (query_changed || !had_current) {
+        // Start from the most recent output.
+        search.current = static_cast<int>(search.hits.size()) - 1;
+        search.jump_pending = true;
+    } else {
+        // Output kept arriving: stay on the same match.
+        auto it = std::lower_bound(search.hits.begin(), search.hits.end(), previous, [](const SearchHit& a, const SearchHit& b) {
+            return a.line < b.line || (a.line == b.line && a.col < b.col);
+        });
+        if (it == search.hits.end()) --it;
+        search.current = static_cast<int>(it - search.hits.begin());
     }
     
-    render_terminal_line(row_cells.data(), static_cast<int>(row_cells.size()), line_height, line_idx, selection);
+    if (query_changed) {
+        RedrawScheduler::instance().request_redraw_in(0.0);
+    }
 }
 
-static bool is_dark_color(uint32_t abgr) {
-    uint8_t r = abgr & 0xFF;
-    uint8_t g = (abgr >> 8) & 0xFF;
-    uint8_t b = (abgr >> 16) & 0xFF;
-    int brightness = (r * 299 + g * 587 + b * 114) / 1000;
-    return brightness < 40;
+void TerminalPanel::step_search(SearchState& search, int direction) {
+    if (search.hits.empty()) return;
+    
+    int count = static_cast<int>(search.hits.size());
+    search.current = ((search.current < 0 ? 0 : search.current) + direction + count) % count;
+    search.jump_pending = true;
 }
 
-static bool is_light_color(uint32_t abgr) {
-    uint8_t r = abgr & 0xFF;
-    uint8_t g = (abgr >> 8) & 0xFF;
-    uint8_t b = (abgr >> 16) & 0xFF;
-    int brightness = (r * 299 + g * 587 + b * 114) / 1000;
-    return brightness > 180;
+void TerminalPanel::draw_search_highlights(const std::vector<SearchHit>& hits, int current, uint64_t line, const ImVec2& origin,
+                                           float char_w, float line_height) {
+    auto it = std::lower_bound(hits.begin(), hits.end(), line, [](const SearchHit& hit, uint64_t value) {
+        return hit.line < value;
+    });
+    if (it == hits.end() || it->line != line) return;
+    
+    const auto& theme = get_current_theme();
+    ImDrawList* draw_list = ImGui::GetWindowDrawList();
+    const uint32_t accent = theme.accent & 0x00FFFFFF;
+    for (; it != hits.end() && it->line == line; ++it) {
+        bool is_current = (it - hits.begin()) == current;
+        ImVec2 min(origin.x + it->col * char_w, origin.y);
+        ImVec2 max(origin.x + it->end_col * char_w, origin.y + line_height);
+        draw_list->AddRectFilled(min, max, accent | (is_current ? 0x90000000u : 0x48000000u));
+        if (is_current) {
+            draw_list->AddRect(min, max, accent | 0xFF000000u);
+        }
+    }
 }
 
-static uint32_t adjust_fg_for_light_theme(uint32_t fg, bool is_light_theme) {
-    if (!is_light_theme) return fg;
-    if (!is_light_color(fg)) return fg;
+void TerminalPanel::render_global_search() {
+    auto& view = global_view_;
+    if (!view.open) {
+        return;
+    }
     
-    uint8_t r = fg & 0xFF;
-    uint8_t g = (fg >> 8) & 0xFF;
-    uint8_t b = (fg >> 16) & 0xFF;
-    uint8_t a = (fg >> 24) & 0xFF;
+    if (global_search_.drain(view.results) > 0) {
+        view.sorted = false;
+    }
+    bool running = global_search_.running();
+    if (!running && !view.sorted) {
+        sort_global_results();
+    }
+    
+    ImGui::SetNextWindowSize(ImVec2(720, 420), ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Search All Sessions", &view.open)) {
+        if (view.focus_input) {
+            ImGui::SetKeyboardFocusHere();
+            view.focus_input = false;
+        }
+        ImGui::SetNextItemWidth(-90.0f);
+        bool changed = ImGui::InputTextWithHint("##Pattern", view.regex ? "Regular expression" : "Search every session",
+                                                view.pattern, sizeof(view.pattern));
+        if (ImGui::IsItemActive() && ImGui::IsKeyPressed(ImGuiKey_Escape)) {
+            view.open = false;
+        }
+        ImGui::SameLine();
+        changed |= ImGui::Checkbox("Regex", &view.regex);
+        if (changed) {
+            restart_global_search();
+            running = global_search_.running();
+        }
+        
+        if (!view.error.empty()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Invalid pattern: %s", view.error.c_str());
+        } else if (view.searched_pattern.empty()) {
+            ImGui::TextDisabled("Matches in the scrollback and screen of every tab");
+        } else if (running) {
+            ImGui::TextDisabled("Searching... %zu results", view.results.size());
+        } else {
+            ImGui::TextDisabled("%zu results%s", view.results.size(),
+                                global_search_.truncated() ? " (limit reached)" : "");
+        }
+        
+        const auto& theme = get_current_theme();
+        ImVec4 accent = u32_to_imvec4(theme.accent);
+        ImGuiTableFlags table_flags = ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY |
+                                      ImGuiTableFlags_BordersInnerV | ImGuiTableFlags_SizingFixedFit;
+        if (ImGui::BeginTable("##GlobalResults", 3, table_flags)) {
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Session");
+            ImGui::TableSetupColumn("Line");
+            ImGui::TableSetupColumn("Context", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableHeadersRow();
+            
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(view.results.size()));
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    const auto& result = view.results[static_cast<size_t>(i)];
+                    TerminalSession* session = find_session(result.session_id);
+                    if (!session) continue;
+                    
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::PushID(i);
+                    bool clicked = ImGui::Selectable(session->name().c_str(), false, ImGuiSelectableFlags_SpanAllColumns);
+                    ImGui::PopID();
+                    
+                    ImGui::TableNextColumn();
+                    ImGui::TextDisabled("%llu", static_cast<unsigned long long>(result.hit.line + 1));
+                    
+                    ImGui::TableNextColumn();
+                    const char* text = result.context.c_str();
+                    ImGui::TextUnformatted(text, text + result.match_begin);
+                    ImGui::SameLine(0.0f, 0.0f);
+                    ImGui::PushStyleColor(ImGuiCol_Text, accent);
+                    ImGui::TextUnformatted(text + result.match_begin, text + result.match_end);
+                    ImGui::PopStyleColor();
+                    ImGui::SameLine(0.0f, 0.0f);
+                    ImGui::TextUnformatted(text + result.match_end, text + result.context.size());
+                    
+                    if (clicked) {
+                        located_hits_[session->id()] = LocatedHit{result.hit, true};
+                        select_session_id_ = session->id();
+                        ImGui::SetWindowFocus("Terminal");
+                    }
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+    ImGui::End();
     
-    r = static_cast<uint8_t>(r * 0.4f);
-    g = static_cast<uint8_t>(g * 0.4f);
-    b = static_cast<uint8_t>(b * 0.4f);
+    if (!view.open) {
+        global_search_.cancel();
+    }
+}
+
+void TerminalPanel::restart_global_search() {
+    auto& view = global_view_;
+    view.results.clear();
+    view.sorted = true;
+    view.error.clear();
+    view.searched_pattern = view.pattern;
+    view.searched_regex = view.regex;
+    if (view.searched_pattern.empty()) {
+        global_search_.cancel();
+        return;
+    }
     
-    return r | (g << 8) | (b << 16) | (a << 24);
+    std::vector<TerminalSession*> sessions;
+    sessions.reserve(sessions_.size());
+    for (auto& session : sessions_) {
+        sessions.push_back(session.get());
+    }
+    GlobalSearchQuery query;
+    query.pattern = view.searched_pattern;
+    query.regex = view.searched_regex;
+    global_search_.start(query, sessions, view.error);
+}
+
+void TerminalPanel::sort_global_results() {
+    std::unordered_map<uint32_t, size_t> tab_order;
+    for (size_t i = 0; i < sessions_.size(); ++i) {
+        tab_order[sessions_[i]->id()] = i;
+    }
+    std::sort(global_view_.results.begin(), global_view_.results.end(),
+        [&tab_order](const GlobalSearchResult& a, const GlobalSearchResult& b) {
+            size_t ta = tab_order[a.session_id];
+            size_t tb = tab_order[b.session_id];
+            if (ta != tb) return ta < tb;
+            if (a.hit.line != b.hit.line) return a.hit.line < b.hit.line;
+            return a.hit.col < b.hit.col;
+        });
+    global_view_.sorted = true;
+}
+
+void TerminalPanel::render_screen_row(const ScreenSnapshot& snapshot, int screen_row, float line_height, int line_idx, const Selection& selection) {
+    render_terminal_line(snapshot.row(screen_row), snapshot.cols, line_height, line_idx, selection);
 }
 
 void TerminalPanel::render_terminal_line(const TerminalCell* cells, int count, float line_height, int line_idx, const Selection& selection) {
@@ -914,12 +1604,13 @@ void TerminalPanel::render_terminal_line(const TerminalCell* cells, int count, f
     }
     
     const auto& theme = get_current_theme();
-    uint32_t default_bg = theme.terminal_bg;
-    bool is_light_theme = (theme.kind == ThemeKind::Light);
+    TerminalLineStyle style;
+    style.default_bg = theme.terminal_bg;
+    style.light_theme = (theme.kind == ThemeKind::Light);
+    style.selection_color = style.light_theme ? 0x40000000 : 0x40FFFFFF;
     
     ImVec2 start_pos = ImGui::GetCursorScreenPos();
     ImVec2 char_size = ImGui::CalcTextSize("W");
-    ImDrawList* draw_list = ImGui::GetWindowDrawList();
     
     int sel_min_col = -1;
     int sel_max_col = -1;
@@ -944,63 +1635,8 @@ void TerminalPanel::render_terminal_line(const TerminalCell* cells, int count, f
         }
     }
     
-    for (int i = 0; i < count; ++i) {
-        const auto& cell = cells[i];
-        
-        if (cell.width == 0) {
-            continue;
-        }
-        
-        float cell_x = start_pos.x + i * char_size.x;
-        float cell_width_px = char_size.x * cell.width;
-        
-        bool has_custom_bg = (cell.bg & 0xFF000000) != 0 && 
-                             cell.bg != default_bg &&
-                             !is_dark_color(cell.bg);
-        if (has_custom_bg) {
-            ImVec2 bg_min(cell_x, start_pos.y);
-            ImVec2 bg_max(cell_x + cell_width_px, start_pos.y + line_height);
-            draw_list->AddRectFilled(bg_min, bg_max, cell.bg);
-        }
-        
-        if (i >= sel_min_col && i < sel_max_col) {
-            ImVec2 sel_min(cell_x, start_pos.y);
-            ImVec2 sel_max(cell_x + cell_width_px, start_pos.y + line_height);
-            uint32_t sel_color = is_light_theme ? 0x40000000 : 0x40FFFFFF;
-            draw_list->AddRectFilled(sel_min, sel_max, sel_color);
-        }
-    }
-
-    for (int i = 0; i < count; ++i) {
-        const auto& cell = cells[i];
-        
-        if (cell.width == 0) {
-            continue;
-        }
-        
-        if (cell.chars[0] != 0 && cell.chars[0] != ' ' && cell.chars[0] <= 0x10FFFF) {
-            char utf8_buf[32];
-            int utf8_len = 0;
-            for (int j = 0; j < TERMINAL_MAX_CHARS_PER_CELL && cell.chars[j] != 0; ++j) {
-                uint32_t cp = cell.chars[j];
-                if (cp > 0x10FFFF) break;
-                char tmp[8];
-                int len;
-                utf8_encode(cp, tmp, &len);
-                if (utf8_len + len < 31) {
-                    memcpy(utf8_buf + utf8_len, tmp, static_cast<size_t>(len));
-                    utf8_len += len;
-                }
-            }
-            utf8_buf[utf8_len] = '\0';
-            
-            if (utf8_len > 0) {
-                float cell_x = start_pos.x + i * char_size.x;
-                uint32_t fg = adjust_fg_for_light_theme(cell.fg, is_light_theme);
-                draw_list->AddText(ImVec2(cell_x, start_pos.y), fg, utf8_buf);
-            }
-        }
-    }
+    line_renderer_.draw(ImGui::GetWindowDrawList(), start_pos, char_size.x, line_height,
+                        cells, count, sel_min_col, sel_max_col, style);
     
     ImGui::Dummy(ImVec2(count * char_size.x, line_height));
 }
@@ -1011,7 +1647,8 @@ void TerminalPanel::render_input_line(TerminalSession& session) {
     if (can_input) {
         ImGuiIO& io = ImGui::GetIO();
         
-        if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows)) {
+        // Text fields in this window (find bar, tab rename) keep their keys.
+        if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) && !io.WantTextInput) {
             bool has_ime_input = false;
             for (int i = 0; i < io.InputQueueCharacters.Size; ++i) {
                 if (io.InputQueueCharacters[i] >= 0x80) {
@@ -1050,10 +1687,8 @@ void TerminalPanel::render_input_line(TerminalSession& session) {
                 if (ImGui::IsKeyPressed(ImGuiKey_C) && (ctrl_pressed || cmd_pressed)) {
                     auto& selection = selections_[session.id()];
                     if (selection.active) {
-                        std::string clipboard_text;
                         const auto& terminal = session.terminal();
-                        const auto& scrollback = terminal.scrollback();
-                        int total_lines = static_cast<int>(scrollback.size()) + terminal.rows();
+                        const ScreenSnapshot& snapshot = session.snapshot();
                         
                         int r1 = selection.start_row;
                         int c1 = selection.start_col;
@@ -1065,45 +1700,18 @@ void TerminalPanel::render_input_line(TerminalSession& session) {
                             std::swap(c1, c2);
                         }
                         
-                        for (int r = r1; r <= r2; ++r) {
-                            if (r >= total_lines) break;
-                            
-                            int width = terminal.cols();
-                            const std::vector<TerminalCell>* sb_line = nullptr;
-                            
-                            if (r < static_cast<int>(scrollback.size())) {
-                                sb_line = &scrollback[r];
-                                width = static_cast<int>(sb_line->size());
-                            }
-                            
-                            int min_c = (r == r1) ? c1 : 0;
-                            int max_c = (r == r2) ? c2 : width - 1;
-                            
-                            if (min_c < 0) min_c = 0;
-                            if (max_c >= width) max_c = width - 1;
-                            
-                            for (int c = min_c; c <= max_c; ++c) {
-                                TerminalCell cell;
-                                if (sb_line) {
-                                    cell = (*sb_line)[c];
-                                } else {
-                                    cell = terminal.get_cell(r - static_cast<int>(scrollback.size()), c);
-                                }
-                                
-                                if (cell.width == 0) continue;
-                                
-                                std::string utf8;
-                                cell_to_utf8(cell.chars, utf8);
-                                clipboard_text += utf8;
-                            }
-                            
-                            if (r < r2) {
-                                clipboard_text += '\n';
-                            }
+                        // Selection rows count from the snapshot's first
+                        // scrollback line.
+                        TextPosition from{snapshot.scrollback_evicted + static_cast<uint64_t>(std::max(r1, 0)), c1};
+                        TextPosition to{snapshot.scrollback_evicted + static_cast<uint64_t>(std::max(r2, 0)), c2};
+                        text_buffer_.clear();
+                        {
+                            auto scrollback_lock = terminal.lock_scrollback();
+                            terminal.extract_text(from, to, snapshot, text_buffer_);
                         }
                         
-                        if (!clipboard_text.empty()) {
-                            ImGui::SetClipboardText(clipboard_text.c_str());
+                        if (!text_buffer_.empty()) {
+                            ImGui::SetClipboardText(text_buffer_.c_str());
                         }
                     } else if (ctrl_pressed) {
                         controller_.send_raw_key(session, "\x03");
@@ -1145,7 +1753,7 @@ void TerminalPanel::render_input_line(TerminalSession& session) {
                 else if (ctrl_pressed && ImGui::IsKeyPressed(ImGuiKey_B)) {
                     controller_.send_raw_key(session, "\x02");
                 }
-                else if (ctrl_pressed && ImGui::IsKeyPressed(ImGuiKey_F)) {
+                else if (ctrl_pressed && !io.KeyShift && !io.KeyAlt && ImGui::IsKeyPressed(ImGuiKey_F)) {
                     controller_.send_raw_key(session, "\x06");
                 }
                 else if (ctrl_pressed && ImGui::IsKeyPressed(ImGuiKey_T)) {
@@ -1,8 +1,13 @@
 #pragma once
 
 #include "terminal_session.h"
+#include "terminal_line_renderer.h"
+#include "global_search.h"
+#include "session_replayer.h"
+#include "core/thread_pool.h"
 #include "process/session_controller.h"
 #include "adapters/session_config_store.h"
+#include <chrono>
 #include <vector>
 #include <memory>
 #include <unordered_map>
@@ -35,12 +40,15 @@ struct CursorAnimation {
 class TerminalPanel {
 public:
     TerminalPanel();
+    ~TerminalPanel();
     
     void render();
     void process_events();
     
     void save_sessions();
     void load_sessions();
+    // Writes every session's scrollback and screen; called on shutdown.
+    void save_snapshots();
     
     TerminalSession* active_session();
     TerminalSession* find_session(uint32_t id);
@@ -60,18 +68,80 @@ private:
         int end_row = 0;
         int end_col = 0;
     };
+    
+    // Find-in-output state for one session. Hits use the absolute line
+    // numbers of ScrollbackIndex; screen rows follow the snapshot's last
+    // scrollback line.
+    struct SearchState {
+        bool open = false;
+        bool focus_input = false;
+        bool jump_pending = false;
+        char query[256] = {};
+        std::string searched_query;
+        uint64_t searched_generation = 0;
+        std::vector<SearchHit> hits;
+        bool truncated = false;
+        int current = -1;
+    };
+    
+    // "Search All Sessions" window. Results arrive from the pool unordered
+    // and are sorted by tab and line once the search finishes.
+    struct GlobalSearchView {
+        bool open = false;
+        bool focus_input = false;
+        char pattern[256] = {};
+        bool regex = false;
+        std::string searched_pattern;
+        bool searched_regex = false;
+        std::string error;
+        std::vector<GlobalSearchResult> results;
+        bool sorted = true;
+    };
+    
+    // Where a session's scrollback and screen are saved. A session loaded
+    // from the config is restored from its file the first time its tab is
+    // shown, and the file is not written before that.
+    struct SnapshotState {
+        std::string file;
+        bool restored = false;
+        uint64_t saved_generation = 0;
+    };
+    
+    // A global search result the user picked; the session scrolls to it
+    // and highlights it the next time its tab is drawn.
+    struct LocatedHit {
+        SearchHit hit;
+        bool jump_pending = false;
+    };
 
     void render_control_bar(TerminalSession& session);
     void render_output_area(TerminalSession& session);
     void render_input_line(TerminalSession& session);
     void render_terminal_line(const TerminalCell* cells, int count, float line_height, int line_idx, const Selection& selection);
-    void render_screen_row(TerminalSession& session, int screen_row, float line_height, int line_idx, const Selection& selection);
+    void render_screen_row(const ScreenSnapshot& snapshot, int screen_row, float line_height, int line_idx, const Selection& selection);
     void render_cursor(TerminalSession& session, float target_x, float target_y, float char_w, float char_h, int cell_width);
+    void render_search_bar(TerminalSession& session);
+    void update_search(SearchState& search, const VTerminal& terminal, const ScreenSnapshot& snapshot);
+    void step_search(SearchState& search, int direction);
+    void draw_search_highlights(const std::vector<SearchHit>& hits, int current, uint64_t line, const ImVec2& origin,
+                                float char_w, float line_height);
+    void render_global_search();
+    void restart_global_search();
+    void sort_global_results();
+    void render_recording_menu(TerminalSession& session);
+    bool save_output(TerminalSession& session, const std::string& path, bool sgr, std::string* error);
+    bool is_replaying(uint32_t session_id) const;
+    void save_snapshot(TerminalSession& session);
+    void save_changed_snapshots();
+    void restore_snapshot(TerminalSession& session);
+    std::string snapshot_path(uint32_t session_id) const;
     void render_banner();
     void handle_start_stop(TerminalSession& session);
+    std::unique_ptr<TerminalSession> make_session(uint32_t id);
     
     std::vector<std::unique_ptr<TerminalSession>> sessions_;
     std::vector<uint32_t> sessions_to_close_;
+    std::vector<SessionEvent> drained_events_;   // reused by process_events
     uint32_t active_session_idx_ = 0;
     uint32_t next_session_id_ = 1;
     
@@ -82,12 +152,36 @@ private:
     
     uint32_t confirm_start_session_id_ = 0;
     
+    std::unordered_map<uint32_t, std::unique_ptr<SessionReplayer>> replayers_;
+    int replay_speed_idx_ = 0;
+    std::unordered_map<uint32_t, std::string> recording_errors_;
+    
+    // Reused by copy and save so large extractions do not reallocate.
+    std::string text_buffer_;
+    static constexpr uint64_t SAVE_CHUNK_LINES = 1024;
+    
+    std::unordered_map<uint32_t, SnapshotState> snapshots_;
+    std::chrono::steady_clock::time_point last_snapshot_save_ = std::chrono::steady_clock::now();
+    static constexpr std::chrono::seconds SNAPSHOT_SAVE_INTERVAL{30};
+    
     std::unordered_map<uint32_t, CursorAnimation> cursor_animations_;
-    std::unordered_map<uint32_t, std::string> cpr_buffers_;
     std::unordered_map<uint32_t, Selection> selections_;
     std::unordered_map<uint32_t, float> last_scroll_y_;
+    std::unordered_map<uint32_t, SearchState> searches_;
+    std::unordered_map<uint32_t, LocatedHit> located_hits_;
+    uint32_t select_session_id_ = 0;
+    
+    // The pool must outlive the search running on it.
+    ThreadPool search_pool_;
+    GlobalSearch global_search_{search_pool_};
+    GlobalSearchView global_view_;
     
+    TerminalLineRenderer line_renderer_;
     SessionConfigStore config_store_;
+    
+    // One thread, so saves of a file land in order; the ones still queued
+    // are written before the panel goes away.
+    ThreadPool snapshot_writer_{1};
 };
 
 }
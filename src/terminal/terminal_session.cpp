@@ -1,25 +1,405 @@
 #include "terminal_session.h"
+#include "core/profiler.h"
+#include "core/redraw_scheduler.h"
+#include "core/telemetry.h"
+#include <cstring>
+#include <string_view>
+#include <thread>
 
 namespace diana {
 
 namespace {
 constexpr int DEFAULT_ROWS = 24;
 constexpr int DEFAULT_COLS = 80;
+constexpr char CPR_REQUEST[] = "\x1b[6n";
+constexpr size_t CPR_REQUEST_LEN = sizeof(CPR_REQUEST) - 1;
+constexpr std::string_view SYNC_UPDATE_BEGIN = "\x1b[?2026h";
+constexpr std::string_view SYNC_UPDATE_END = "\x1b[?2026l";
+
+std::string build_cpr_reply(const CursorInfo& cursor) {
+    return "\x1b[" + std::to_string(cursor.row + 1) + ";" + std::to_string(cursor.col + 1) + "R";
+}
+
+int64_t steady_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 }
 
 TerminalSession::TerminalSession(uint32_t id)
     : id_(id)
     , name_("Session " + std::to_string(id))
     , terminal_(std::make_unique<VTerminal>(DEFAULT_ROWS, DEFAULT_COLS))
+    , output_ring_(std::make_shared<ByteRing>())
 {
+    output_ring_->set_reader_wakeup([this] {
+        mark_pending();
+        { std::lock_guard<std::mutex> lock(input_mutex_); }
+        input_cv_.notify_one();
+    });
+    {
+        std::lock_guard<std::mutex> lock(terminal_mutex_);
+        publish_snapshot_locked();
+    }
+    refresh_snapshot();
+    parser_thread_ = std::thread(&TerminalSession::parser_loop, this);
+}
+
+TerminalSession::~TerminalSession() {
+    // A runner may still hold the ring after the session is gone.
+    output_ring_->set_reader_wakeup(nullptr);
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        stop_ = true;
+    }
+    input_cv_.notify_all();
+    if (parser_thread_.joinable()) {
+        parser_thread_.join();
+    }
 }
 
 void TerminalSession::resize_terminal(int rows, int cols) {
+    std::lock_guard<std::mutex> lock(terminal_mutex_);
     terminal_->resize(rows, cols);
+    publish_snapshot_locked();
+}
+
+void TerminalSession::restore_terminal(std::vector<std::vector<TerminalCell>> scrollback, const ScreenSnapshot& screen) {
+    std::lock_guard<std::mutex> lock(terminal_mutex_);
+    terminal_->restore(std::move(scrollback), screen);
+    publish_snapshot_locked();
 }
 
 void TerminalSession::write_to_terminal(const char* data, size_t len) {
-    terminal_->write(data, len);
+    if (len == 0) return;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        pending_writes_.push_back({output_ring_->write_position(), std::string(data, len)});
+        pending_write_bytes_ += len;
+    }
+    mark_pending();
+    input_cv_.notify_one();
+}
+
+void TerminalSession::set_reply_callback(ReplyCallback cb) {
+    std::lock_guard<std::mutex> lock(terminal_mutex_);
+    reply_cb_ = std::move(cb);
+}
+
+bool TerminalSession::wait_until_parsed(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(input_mutex_);
+    ++flush_waiters_;
+    input_cv_.notify_one();
+    bool parsed = idle_cv_.wait_for(lock, timeout, [this] {
+        return pending_writes_.empty() && !parsing_ && output_ring_->empty();
+    });
+    --flush_waiters_;
+    return parsed;
+}
+
+void TerminalSession::set_foreground(bool foreground) {
+    if (foreground_.exchange(foreground, std::memory_order_relaxed) || !foreground) {
+        return;
+    }
+    { std::lock_guard<std::mutex> lock(input_mutex_); }
+    input_cv_.notify_one();
+}
+
+bool TerminalSession::refresh_snapshot() {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    if (!snapshot_ready_) {
+        return false;
+    }
+    std::swap(front_snapshot_, ready_snapshot_);
+    snapshot_ready_ = false;
+    return true;
+}
+
+void TerminalSession::set_ingest_budget(const IngestBudget& budget) {
+    std::lock_guard<std::mutex> lock(input_mutex_);
+    budget_ = budget;
+}
+
+IngestStats TerminalSession::ingest_stats() const {
+    IngestStats stats;
+    {
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        stats.pending_bytes = pending_write_bytes_;
+    }
+    stats.pending_bytes += output_ring_->size();
+    int64_t since = pending_since_ns_.load(std::memory_order_relaxed);
+    if (since != 0 && stats.pending_bytes > 0) {
+        stats.parse_lag_ms = static_cast<double>(steady_now_ns() - since) / 1e6;
+    }
+    stats.bytes_parsed = bytes_parsed_.load(std::memory_order_relaxed);
+    stats.slices = slices_.load(std::memory_order_relaxed);
+    stats.backpressure_stalls = output_ring_->producer_stalls();
+    stats.held_snapshots = held_snapshots_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TerminalSession::mark_pending() {
+    int64_t expected = 0;
+    pending_since_ns_.compare_exchange_strong(expected, steady_now_ns(), std::memory_order_relaxed);
+}
+
+void TerminalSession::parser_loop() {
+    DIANA_PROFILE_THREAD("terminal parser");
+    std::deque<PendingWrite> writes;
+    // Set while a synchronized update keeps the last complete snapshot on
+    // screen; if no more output arrives by hold_deadline the partial screen
+    // is published anyway.
+    bool holding = false;
+    std::chrono::steady_clock::time_point hold_deadline{};
+    // Set while a background batch is being worked through, or a cursor
+    // position request is waiting for its last bytes; either way the next
+    // bytes are parsed without waiting for a new batch.
+    bool parse_now = false;
+    while (true) {
+        uint64_t ring_target = 0;
+        IngestBudget budget;
+        {
+            std::unique_lock<std::mutex> lock(input_mutex_);
+            auto has_work = [this, &writes] {
+                return stop_ || !writes.empty() || !pending_writes_.empty() || !output_ring_->empty();
+            };
+            if (!holding) {
+                input_cv_.wait(lock, has_work);
+            } else if (!input_cv_.wait_until(lock, hold_deadline, has_work)) {
+                lock.unlock();
+                std::lock_guard<std::mutex> terminal_lock(terminal_mutex_);
+                publish_snapshot_locked();
+                holding = false;
+                continue;
+            }
+            if (stop_) {
+                return;
+            }
+            if (!parse_now && writes.empty() && !wait_for_batch(lock, budget_)) {
+                return;
+            }
+            // Read the ring position before taking the writes: anything
+            // written after this point is positioned at or beyond it.
+            ring_target = output_ring_->write_position();
+            for (auto& write : pending_writes_) {
+                pending_write_bytes_ -= write.data.size();
+                writes.push_back(std::move(write));
+            }
+            pending_writes_.clear();
+            budget = budget_;
+            parsing_ = true;
+        }
+        
+        const bool foreground = foreground_.load(std::memory_order_relaxed);
+        const int slice_us = foreground ? budget.foreground_slice_us : budget.background_slice_us;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(slice_us);
+        
+        bool caught_up = false;
+        {
+            std::lock_guard<std::mutex> lock(terminal_mutex_);
+            caught_up = parse_slice_locked(writes, ring_target, deadline, std::max<size_t>(budget.chunk_bytes, 1));
+            holding = hold_snapshot_locked(budget.sync_update_timeout_ms);
+            if (holding) {
+                hold_deadline = terminal_->update_started() + std::chrono::milliseconds(budget.sync_update_timeout_ms);
+                held_snapshots_.fetch_add(1, std::memory_order_relaxed);
+            } else if (foreground || caught_up) {
+                // Nobody looks at a background tab halfway through a batch.
+                publish_snapshot_locked();
+            }
+            parse_now = !caught_up || !split_sequence_.empty();
+        }
+        slices_.fetch_add(1, std::memory_order_relaxed);
+        
+        if (caught_up) {
+            pending_since_ns_.store(0, std::memory_order_relaxed);
+            if (!output_ring_->empty()) {
+                mark_pending();
+            }
+        }
+        
+        {
+            std::lock_guard<std::mutex> lock(input_mutex_);
+            parsing_ = !caught_up;
+        }
+        idle_cv_.notify_all();
+        
+        if (!caught_up && !foreground && budget.background_pause_us > 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(budget.background_pause_us));
+        }
+    }
+}
+
+// Lets background output build up into a batch before it is parsed. Called
+// with input_mutex_ held; returns false when the session is stopping.
+bool TerminalSession::wait_for_batch(std::unique_lock<std::mutex>& lock, const IngestBudget& budget) {
+    int64_t since = pending_since_ns_.load(std::memory_order_relaxed);
+    auto oldest = since != 0
+        ? std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+              std::chrono::nanoseconds(since)))
+        : std::chrono::steady_clock::now();
+    input_cv_.wait_until(lock, oldest + std::chrono::milliseconds(budget.background_defer_ms), [&] {
+        return stop_ || foreground_.load(std::memory_order_relaxed) || flush_waiters_ > 0 ||
+               pending_write_bytes_ + output_ring_->size() >= budget.background_batch_bytes ||
+               cpr_request_waiting();
+    });
+    return !stop_;
+}
+
+// Searches ring bytes that arrived since the last call for ESC [ 6 n. The
+// child blocks on the reply, so such a request must not sit in a batch.
+bool TerminalSession::cpr_request_waiting() {
+    uint64_t read_pos = output_ring_->read_position();
+    if (cpr_scan_pos_ < read_pos) {
+        cpr_scan_pos_ = read_pos;
+        cpr_scan_match_ = 0;
+    }
+    while (true) {
+        ConstByteSpan span = output_ring_->peek_span(cpr_scan_pos_);
+        if (span.size == 0) {
+            return false;
+        }
+        size_t i = 0;
+        while (i < span.size) {
+            if (cpr_scan_match_ == 0) {
+                const void* esc = std::memchr(span.data + i, '\x1b', span.size - i);
+                if (!esc) break;
+                i = static_cast<size_t>(static_cast<const char*>(esc) - span.data) + 1;
+                cpr_scan_match_ = 1;
+                continue;
+            }
+            char c = span.data[i++];
+            if (c == CPR_REQUEST[cpr_scan_match_]) {
+                if (++cpr_scan_match_ == CPR_REQUEST_LEN) {
+                    cpr_scan_pos_ += i;
+                    cpr_scan_match_ = 0;
+                    return true;
+                }
+            } else {
+                cpr_scan_match_ = c == '\x1b' ? 1 : 0;
+            }
+        }
+        cpr_scan_pos_ += span.size;
+    }
+}
+
+// Parses queued writes and ring bytes in stream order until both are
+// consumed up to ring_target or the deadline passes. Returns true when
+// nothing is left.
+bool TerminalSession::parse_slice_locked(std::deque<PendingWrite>& writes, uint64_t ring_target,
+                                         std::chrono::steady_clock::time_point deadline, size_t chunk_bytes) {
+    while (true) {
+        uint64_t read_pos = output_ring_->read_position();
+        if (!writes.empty() && read_pos >= writes.front().ring_position) {
+            const auto& write = writes.front();
+            ingest_locked(write.data.data(), write.data.size());
+            bytes_parsed_.fetch_add(write.data.size(), std::memory_order_relaxed);
+            Telemetry::instance().add_parsed(write.data.size());
+            writes.pop_front();
+        } else {
+            uint64_t limit = writes.empty() ? ring_target : writes.front().ring_position;
+            if (read_pos >= limit) {
+                return writes.empty();
+            }
+            size_t want = static_cast<size_t>(std::min<uint64_t>(limit - read_pos, chunk_bytes));
+            ConstByteSpan span = output_ring_->read_span(want);
+            if (span.size == 0) {
+                return writes.empty();
+            }
+            ingest_locked(span.data, span.size);
+            output_ring_->commit_read(span.size);
+            bytes_parsed_.fetch_add(span.size, std::memory_order_relaxed);
+            Telemetry::instance().add_parsed(span.size);
+        }
+        
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return writes.empty() && output_ring_->read_position() >= ring_target;
+        }
+    }
+}
+
+void TerminalSession::ingest_locked(const char* data, size_t len) {
+    // Cursor position requests are answered here, right after the bytes before
+    // them were parsed, so the reported position matches the stream. A request
+    // or an update start split across reads is held back until the rest
+    // arrives.
+    auto feed = [this](const char* bytes, size_t n) {
+        if (n == 0) return;
+        terminal_->write(bytes, n);
+        unpublished_ = true;
+    };
+    std::string joined;
+    if (!split_sequence_.empty()) {
+        joined = split_sequence_;
+        joined.append(data, len);
+        split_sequence_.clear();
+        data = joined.data();
+        len = joined.size();
+    }
+    
+    size_t segment = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        const void* esc = std::memchr(data + pos, '\x1b', len - pos);
+        if (!esc) break;
+        size_t i = static_cast<size_t>(static_cast<const char*>(esc) - data);
+        size_t remain = len - i;
+        
+        // The start of a synchronized update is the last point at which the
+        // screen is known to be complete, so it is published there, unless
+        // the update also ends within this buffer and a later frame will do.
+        std::string_view rest(data + i, remain);
+        if (rest.substr(0, SYNC_UPDATE_BEGIN.size()) == SYNC_UPDATE_BEGIN) {
+            feed(data + segment, i - segment);
+            segment = i;
+            if (unpublished_ && !terminal_->update_in_progress() &&
+                rest.find(SYNC_UPDATE_END) == std::string_view::npos) {
+                publish_snapshot_locked();
+            }
+            pos = i + SYNC_UPDATE_BEGIN.size();
+            continue;
+        }
+        
+        if (remain >= CPR_REQUEST_LEN && std::memcmp(data + i, CPR_REQUEST, CPR_REQUEST_LEN) == 0) {
+            feed(data + segment, i - segment);
+            if (reply_cb_) {
+                reply_cb_(build_cpr_reply(terminal_->get_cursor()));
+            }
+            segment = i + CPR_REQUEST_LEN;
+            pos = segment;
+            continue;
+        }
+        
+        if ((remain < CPR_REQUEST_LEN && std::memcmp(data + i, CPR_REQUEST, remain) == 0) ||
+            (remain < SYNC_UPDATE_BEGIN.size() && SYNC_UPDATE_BEGIN.substr(0, remain) == rest)) {
+            feed(data + segment, i - segment);
+            split_sequence_.assign(data + i, remain);
+            return;
+        }
+        pos = i + 1;
+    }
+    
+    feed(data + segment, len - segment);
+}
+
+bool TerminalSession::hold_snapshot_locked(int timeout_ms) const {
+    return terminal_->update_in_progress() &&
+           std::chrono::steady_clock::now() < terminal_->update_started() + std::chrono::milliseconds(timeout_ms);
+}
+
+void TerminalSession::publish_snapshot_locked() {
+    unpublished_ = false;
+    terminal_->snapshot_screen(back_snapshot_);
+    back_snapshot_.generation = ++generation_;
+    
+    {
+        std::lock_guard<std::mutex> lock(snapshot_mutex_);
+        std::swap(back_snapshot_, ready_snapshot_);
+        snapshot_ready_ = true;
+    }
+    // Background tabs are picked up when they become visible.
+    if (foreground_.load(std::memory_order_relaxed)) {
+        RedrawScheduler::instance().request_redraw();
+    }
 }
 
 const char* TerminalSession::app_kind_name(AppKind kind) {
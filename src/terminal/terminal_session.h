@@ -2,9 +2,17 @@
 
 #include "vterminal.h"
 #include "core/types.h"
+#include "core/byte_ring.h"
 #include <string>
 #include <cstdint>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+#include <chrono>
+#include <deque>
+#include <atomic>
 
 namespace diana {
 
@@ -20,11 +28,55 @@ struct SessionConfig {
     std::string provider;
     std::string model;
     std::string working_dir;
+    bool keep_warm = false;     // keep a spare agent for this app and directory running
+    uint64_t daemon_key = 0;    // the session's name in diana-sessiond, 0 until it runs there
 };
 
+// Parser thread budget. Work is done in slices: each slice parses for at most
+// slice_us (checked every chunk_bytes) and then publishes a snapshot, so a
+// flood of output still shows progress and never holds the terminal lock for
+// long. Background sessions get a smaller slice and pause between slices, and
+// do not parse as output arrives: bytes wait in the ring until
+// background_batch_bytes have built up or the oldest is background_defer_ms
+// old, and only the end of a batch is published. A cursor position request
+// among the waiting bytes, wait_until_parsed() or becoming foreground ends the
+// wait early.
+// While the application holds a synchronized update open (DEC mode 2026) no
+// snapshot is published, so the UI keeps the last complete frame; after
+// sync_update_timeout_ms the partial screen is shown anyway.
+struct IngestBudget {
+    int foreground_slice_us = 8000;
+    int background_slice_us = 2000;
+    int background_pause_us = 6000;
+    size_t background_batch_bytes = 32 * 1024;
+    int background_defer_ms = 100;
+    size_t chunk_bytes = 4096;
+    int sync_update_timeout_ms = 250;
+};
+
+struct IngestStats {
+    size_t pending_bytes = 0;        // ring bytes plus queued status text
+    double parse_lag_ms = 0.0;       // age of the oldest unparsed output
+    uint64_t bytes_parsed = 0;
+    uint64_t slices = 0;
+    uint64_t backpressure_stalls = 0;
+    uint64_t held_snapshots = 0;     // publishes skipped inside a synchronized update
+};
+
+// A session owns its VTerminal and a parser thread. PTY output arrives through
+// output_ring(), which the process runner reads into directly; status text
+// handed to write_to_terminal() is spliced in at the ring position current
+// when it was written. Both are parsed on that thread; after each batch the screen is
+// copied into a snapshot which the UI picks up with refresh_snapshot(), so
+// rendering never waits on libvterm. Anything else that touches the VTerminal
+// (keyboard encoding, resize) must hold lock_terminal().
 class TerminalSession {
 public:
     explicit TerminalSession(uint32_t id);
+    ~TerminalSession();
+    
+    TerminalSession(const TerminalSession&) = delete;
+    TerminalSession& operator=(const TerminalSession&) = delete;
     
     uint32_t id() const { return id_; }
     const std::string& name() const { return name_; }
@@ -38,6 +90,12 @@ public:
     
     VTerminal& terminal() { return *terminal_; }
     const VTerminal& terminal() const { return *terminal_; }
+    std::unique_lock<std::mutex> lock_terminal() { return std::unique_lock<std::mutex>(terminal_mutex_); }
+    
+    // Latest screen handed over by the parser thread. Stable until the next
+    // refresh_snapshot() call, which returns true if a newer one was taken.
+    const ScreenSnapshot& snapshot() const { return front_snapshot_; }
+    bool refresh_snapshot();
     
     std::string& input_buffer() { return input_buffer_; }
     const std::string& input_buffer() const { return input_buffer_; }
@@ -56,12 +114,50 @@ public:
     void set_pending_restart(bool v) { pending_restart_ = v; }
     
     void resize_terminal(int rows, int cols);
+    // Puts a saved scrollback and screen back into the terminal; see
+    // VTerminal::restore().
+    void restore_terminal(std::vector<std::vector<TerminalCell>> scrollback, const ScreenSnapshot& screen);
     void write_to_terminal(const char* data, size_t len);
+    void write_to_terminal(const std::string& data) { write_to_terminal(data.data(), data.size()); }
+    
+    const std::shared_ptr<ByteRing>& output_ring() const { return output_ring_; }
+    
+    // Called on the parser thread with bytes that must go back to the child,
+    // currently cursor position reports answering ESC [ 6 n.
+    using ReplyCallback = std::function<void(const std::string&)>;
+    void set_reply_callback(ReplyCallback cb);
+    
+    // Blocks until everything written so far has been parsed and published
+    // (or held back by an open synchronized update). A background batch that
+    // is still building up is parsed right away.
+    bool wait_until_parsed(std::chrono::milliseconds timeout);
+    
+    // The visible tab is parsed with the foreground budget. Becoming
+    // foreground wakes the parser to finish any deferred batch.
+    void set_foreground(bool foreground);
+    bool foreground() const { return foreground_.load(std::memory_order_relaxed); }
+    void set_ingest_budget(const IngestBudget& budget);
+    IngestStats ingest_stats() const;
     
     static const char* app_kind_name(AppKind kind);
     static const char* state_name(SessionState state);
 
 private:
+    struct PendingWrite {
+        uint64_t ring_position;
+        std::string data;
+    };
+    
+    void parser_loop();
+    bool parse_slice_locked(std::deque<PendingWrite>& writes, uint64_t ring_target,
+                            std::chrono::steady_clock::time_point deadline, size_t chunk_bytes);
+    void mark_pending();
+    bool wait_for_batch(std::unique_lock<std::mutex>& lock, const IngestBudget& budget);
+    bool cpr_request_waiting();
+    void ingest_locked(const char* data, size_t len);
+    void publish_snapshot_locked();
+    bool hold_snapshot_locked(int timeout_ms) const;
+    
     uint32_t id_;
     std::string name_;
     SessionState state_ = SessionState::Idle;
@@ -72,6 +168,47 @@ private:
     bool user_scrolled_up_ = false;
     bool pending_restart_ = false;
     int scroll_offset_ = 0;
+    
+    // Guards terminal_, back_snapshot_, split_sequence_, unpublished_ and
+    // reply_cb_.
+    std::mutex terminal_mutex_;
+    std::string split_sequence_;
+    bool unpublished_ = false;
+    ReplyCallback reply_cb_;
+    
+    std::shared_ptr<ByteRing> output_ring_;
+    
+    mutable std::mutex input_mutex_;
+    std::condition_variable input_cv_;
+    std::condition_variable idle_cv_;
+    std::deque<PendingWrite> pending_writes_;
+    size_t pending_write_bytes_ = 0;
+    int flush_waiters_ = 0;
+    IngestBudget budget_;
+    
+    // Parser thread only: how far the unread ring bytes have been searched
+    // for a cursor position request, and how much of one ends the search.
+    uint64_t cpr_scan_pos_ = 0;
+    size_t cpr_scan_match_ = 0;
+    
+    std::atomic<bool> foreground_{false};
+    std::atomic<int64_t> pending_since_ns_{0};
+    std::atomic<uint64_t> bytes_parsed_{0};
+    std::atomic<uint64_t> slices_{0};
+    std::atomic<uint64_t> held_snapshots_{0};
+    bool parsing_ = false;
+    bool stop_ = false;
+    
+    // Triple buffer: the parser fills back, swaps it with ready; the UI swaps
+    // ready with front. Neither side ever waits on the other's copy.
+    std::mutex snapshot_mutex_;
+    ScreenSnapshot back_snapshot_;
+    ScreenSnapshot ready_snapshot_;
+    ScreenSnapshot front_snapshot_;
+    bool snapshot_ready_ = false;
+    uint64_t generation_ = 0;
+    
+    std::thread parser_thread_;
 };
 
 }
@@ -0,0 +1,382 @@
+#include "terminal_snapshot_file.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace diana {
+
+namespace {
+
+constexpr char MAGIC[8] = {'D', 'I', 'A', 'N', 'A', 'S', 'N', 'P'};
+constexpr size_t HEADER_SIZE = sizeof(MAGIC) + 4 + 2 + 2 + 2 + 2 + 1 + 4 + 4 + 4;
+constexpr size_t LINE_HEADER_SIZE = 2 + 2 + 4;
+constexpr size_t RUN_SIZE = 2 + 1 + 4 + 4;
+constexpr uint32_t CONTINUATION_CELL = 0xFFFFFFFF;
+
+enum : uint8_t {
+    ATTR_BOLD      = 1 << 0,
+    ATTR_ITALIC    = 1 << 1,
+    ATTR_UNDERLINE = 1 << 2,
+    ATTR_STRIKE    = 1 << 3,
+    ATTR_REVERSE   = 1 << 4,
+    ATTR_WIDE      = 1 << 5,
+};
+
+struct Run {
+    uint16_t cells = 0;
+    uint8_t attrs = 0;
+    uint32_t fg = 0;
+    uint32_t bg = 0;
+};
+
+template <typename T>
+void append_le(std::string& out, T value) {
+    auto bits = static_cast<typename std::make_unsigned<T>::type>(value);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<char>((bits >> (8 * i)) & 0xFF));
+    }
+}
+
+template <typename T>
+T get_le(const char* in) {
+    typename std::make_unsigned<T>::type bits = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bits |= static_cast<typename std::make_unsigned<T>::type>(static_cast<unsigned char>(in[i])) << (8 * i);
+    }
+    return static_cast<T>(bits);
+}
+
+void set_error(std::string* error, const std::string& message) {
+    if (error) *error = message;
+}
+
+void append_codepoint(uint32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+bool decode_codepoint(const char*& p, const char* end, uint32_t& cp) {
+    if (p >= end) return false;
+    auto c = static_cast<unsigned char>(*p++);
+    size_t extra = c < 0x80 ? 0 : (c & 0xE0) == 0xC0 ? 1 : (c & 0xF0) == 0xE0 ? 2 : (c & 0xF8) == 0xF0 ? 3 : 4;
+    if (extra > 3 || static_cast<size_t>(end - p) < extra) return false;
+    cp = extra == 0 ? c : c & (0x3F >> extra);
+    for (size_t i = 0; i < extra; ++i) {
+        auto next = static_cast<unsigned char>(*p++);
+        if ((next & 0xC0) != 0x80) return false;
+        cp = (cp << 6) | (next & 0x3F);
+    }
+    return true;
+}
+
+uint8_t attributes_of(const TerminalCell& cell) {
+    return (cell.bold ? ATTR_BOLD : 0) | (cell.italic ? ATTR_ITALIC : 0) | (cell.underline ? ATTR_UNDERLINE : 0) |
+           (cell.strike ? ATTR_STRIKE : 0) | (cell.reverse ? ATTR_REVERSE : 0) | (cell.width > 1 ? ATTR_WIDE : 0);
+}
+
+bool is_default_blank(const TerminalCell& cell, uint32_t fg, uint32_t bg) {
+    return (cell.chars[0] == 0 || cell.chars[0] == ' ') && cell.fg == fg && cell.bg == bg && attributes_of(cell) == 0;
+}
+
+TerminalCell blank_cell(uint32_t fg, uint32_t bg) {
+    TerminalCell cell{};
+    cell.width = 1;
+    cell.fg = fg;
+    cell.bg = bg;
+    return cell;
+}
+
+void encode_line(const TerminalCell* cells, int width, uint32_t fg, uint32_t bg, std::vector<Run>& runs,
+                 std::string& text, std::string& out) {
+    int end = width;
+    while (end > 0 && is_default_blank(cells[end - 1], fg, bg)) {
+        --end;
+    }
+
+    runs.clear();
+    text.clear();
+    for (int col = 0; col < end; ++col) {
+        const TerminalCell& cell = cells[col];
+        if (cell.chars[0] == CONTINUATION_CELL) continue;
+        uint8_t attrs = attributes_of(cell);
+        if (runs.empty() || runs.back().attrs != attrs || runs.back().fg != cell.fg || runs.back().bg != cell.bg ||
+            runs.back().cells == UINT16_MAX) {
+            runs.push_back({0, attrs, cell.fg, cell.bg});
+        }
+        ++runs.back().cells;
+
+        uint32_t first = cell.chars[0];
+        if (first == 0 || first > 0x10FFFF) {
+            text.push_back(' ');
+            continue;
+        }
+        append_codepoint(first, text);
+        for (int i = 1; i < TERMINAL_MAX_CHARS_PER_CELL && cell.chars[i] != 0 && cell.chars[i] <= 0x10FFFF; ++i) {
+            text.push_back('\0');
+            append_codepoint(cell.chars[i], text);
+        }
+    }
+
+    append_le<uint16_t>(out, static_cast<uint16_t>(width));
+    append_le<uint16_t>(out, static_cast<uint16_t>(runs.size()));
+    append_le<uint32_t>(out, static_cast<uint32_t>(text.size()));
+    for (const Run& run : runs) {
+        append_le<uint16_t>(out, run.cells);
+        out.push_back(static_cast<char>(run.attrs));
+        append_le<uint32_t>(out, run.fg);
+        append_le<uint32_t>(out, run.bg);
+    }
+    out += text;
+}
+
+// Decodes one line at p into line, which ends up exactly the stored width.
+bool decode_line(const char*& p, const char* end, uint32_t fg, uint32_t bg, std::vector<TerminalCell>& line) {
+    if (static_cast<size_t>(end - p) < LINE_HEADER_SIZE) return false;
+    int width = get_le<uint16_t>(p);
+    size_t run_count = get_le<uint16_t>(p + 2);
+    size_t text_size = get_le<uint32_t>(p + 4);
+    p += LINE_HEADER_SIZE;
+    if (static_cast<size_t>(end - p) < run_count * RUN_SIZE + text_size) return false;
+
+    const char* run = p;
+    const char* text = p + run_count * RUN_SIZE;
+    const char* text_end = text + text_size;
+    p = text_end;
+
+    line.assign(static_cast<size_t>(width), blank_cell(fg, bg));
+    int col = 0;
+    for (size_t r = 0; r < run_count; ++r, run += RUN_SIZE) {
+        size_t cells = get_le<uint16_t>(run);
+        uint8_t attrs = static_cast<uint8_t>(run[2]);
+        TerminalCell cell = blank_cell(get_le<uint32_t>(run + 3), get_le<uint32_t>(run + 7));
+        cell.bold = attrs & ATTR_BOLD;
+        cell.italic = attrs & ATTR_ITALIC;
+        cell.underline = attrs & ATTR_UNDERLINE;
+        cell.strike = attrs & ATTR_STRIKE;
+        cell.reverse = attrs & ATTR_REVERSE;
+        cell.width = (attrs & ATTR_WIDE) ? 2 : 1;
+
+        for (size_t i = 0; i < cells; ++i) {
+            if (col + cell.width > width) return false;
+            std::fill(std::begin(cell.chars), std::end(cell.chars), 0u);
+            if (!decode_codepoint(text, text_end, cell.chars[0])) return false;
+            for (int n = 1; text < text_end && *text == '\0'; ++n) {
+                ++text;
+                uint32_t mark = 0;
+                if (!decode_codepoint(text, text_end, mark)) return false;
+                if (n < TERMINAL_MAX_CHARS_PER_CELL) cell.chars[n] = mark;
+            }
+            line[static_cast<size_t>(col)] = cell;
+            if (cell.width > 1) {
+                TerminalCell continuation = cell;
+                std::fill(std::begin(continuation.chars), std::end(continuation.chars), 0u);
+                continuation.chars[0] = CONTINUATION_CELL;
+                continuation.width = 1;
+                line[static_cast<size_t>(col + 1)] = continuation;
+            }
+            col += cell.width;
+        }
+    }
+    return text == text_end;
+}
+
+// Read-only mapping of a whole file, unmapped when it goes out of scope.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    ~MappedFile() {
+        if (data) munmap(const_cast<char*>(data), size);
+    }
+
+    bool map(const std::string& path, std::string* error) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            set_error(error, "cannot open " + path + ": " + std::strerror(errno));
+            return false;
+        }
+        struct stat st {};
+        if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+            ::close(fd);
+            set_error(error, path + " is empty");
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            set_error(error, "cannot map " + path + ": " + std::strerror(errno));
+            return false;
+        }
+        data = static_cast<const char*>(mapped);
+        size = static_cast<size_t>(st.st_size);
+        return true;
+    }
+};
+
+}
+
+std::optional<SavedTerminal> SavedTerminal::load(const std::string& path, std::string* error) {
+    MappedFile file;
+    if (!file.map(path, error)) {
+        return std::nullopt;
+    }
+    if (file.size < HEADER_SIZE || std::memcmp(file.data, MAGIC, sizeof(MAGIC)) != 0) {
+        set_error(error, path + " is not a saved terminal");
+        return std::nullopt;
+    }
+    const char* p = file.data + sizeof(MAGIC);
+    uint32_t version = get_le<uint32_t>(p);
+    if (version != FORMAT_VERSION) {
+        set_error(error, "unsupported saved terminal version " + std::to_string(version));
+        return std::nullopt;
+    }
+
+    SavedTerminal saved;
+    ScreenSnapshot& screen = saved.screen;
+    screen.rows = get_le<uint16_t>(p + 4);
+    screen.cols = get_le<uint16_t>(p + 6);
+    screen.cursor.row = std::min<int>(get_le<uint16_t>(p + 8), std::max(screen.rows - 1, 0));
+    screen.cursor.col = std::min<int>(get_le<uint16_t>(p + 10), std::max(screen.cols - 1, 0));
+    screen.cursor.visible = p[12] != 0;
+    uint32_t fg = get_le<uint32_t>(p + 13);
+    uint32_t bg = get_le<uint32_t>(p + 17);
+    size_t line_count = get_le<uint32_t>(p + 21);
+    if (screen.rows == 0 || screen.cols == 0) {
+        set_error(error, path + " has an empty screen");
+        return std::nullopt;
+    }
+
+    p = file.data + HEADER_SIZE;
+    const char* end = file.data + file.size;
+    if (line_count > static_cast<size_t>(end - p) / LINE_HEADER_SIZE) {
+        set_error(error, path + " is truncated");
+        return std::nullopt;
+    }
+    saved.scrollback.resize(line_count);
+    for (auto& line : saved.scrollback) {
+        if (!decode_line(p, end, fg, bg, line)) {
+            set_error(error, path + " is corrupt");
+            return std::nullopt;
+        }
+    }
+
+    screen.cells.assign(static_cast<size_t>(screen.rows) * static_cast<size_t>(screen.cols), blank_cell(fg, bg));
+    std::vector<TerminalCell> row;
+    for (int r = 0; r < screen.rows; ++r) {
+        if (!decode_line(p, end, fg, bg, row)) {
+            set_error(error, path + " is corrupt");
+            return std::nullopt;
+        }
+        size_t n = std::min(row.size(), static_cast<size_t>(screen.cols));
+        std::copy_n(row.begin(), n, screen.cells.begin() + static_cast<ptrdiff_t>(r) * screen.cols);
+    }
+    return saved;
+}
+
+namespace {
+
+// Chunked, it holds terminal.lock_scrollback() for this many lines at a time.
+constexpr uint64_t ENCODE_CHUNK_LINES = 512;
+
+std::string encode(const VTerminal& terminal, const ScreenSnapshot& screen, bool chunked) {
+    const uint32_t fg = terminal.default_fg();
+    const uint32_t bg = terminal.default_bg();
+    const uint64_t screen_first = screen.scrollback_evicted + screen.scrollback_size;
+
+    std::string out;
+    out.reserve(HEADER_SIZE + (screen.scrollback_size + static_cast<size_t>(screen.rows)) *
+                                  (LINE_HEADER_SIZE + RUN_SIZE + 32));
+    out.append(MAGIC, sizeof(MAGIC));
+    append_le<uint32_t>(out, SavedTerminal::FORMAT_VERSION);
+    append_le<uint16_t>(out, static_cast<uint16_t>(screen.rows));
+    append_le<uint16_t>(out, static_cast<uint16_t>(screen.cols));
+    append_le<uint16_t>(out, static_cast<uint16_t>(std::max(screen.cursor.row, 0)));
+    append_le<uint16_t>(out, static_cast<uint16_t>(std::max(screen.cursor.col, 0)));
+    out.push_back(screen.cursor.visible ? 1 : 0);
+    append_le<uint32_t>(out, fg);
+    append_le<uint32_t>(out, bg);
+    append_le<uint32_t>(out, 0);
+
+    // Line numbers are absolute, so lines evicted between chunks are skipped.
+    std::vector<Run> runs;
+    std::string text;
+    uint32_t count = 0;
+    uint64_t next = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock;
+        if (chunked) {
+            lock = terminal.lock_scrollback();
+        }
+        const auto& lines = terminal.scrollback();
+        const uint64_t first = terminal.scrollback_evicted();
+        const uint64_t end = std::min<uint64_t>(first + lines.size(), screen_first);
+        next = std::max(next, first);
+        const uint64_t stop = chunked ? std::min(end, next + ENCODE_CHUNK_LINES) : end;
+        for (; next < stop; ++next) {
+            const auto& line = lines[static_cast<size_t>(next - first)];
+            encode_line(line.data(), static_cast<int>(line.size()), fg, bg, runs, text, out);
+            ++count;
+        }
+        if (next >= end) break;
+    }
+    std::string count_bytes;
+    append_le<uint32_t>(count_bytes, count);
+    out.replace(HEADER_SIZE - count_bytes.size(), count_bytes.size(), count_bytes);
+
+    for (int r = 0; r < screen.rows; ++r) {
+        encode_line(screen.row(r), screen.cols, fg, bg, runs, text, out);
+    }
+    return out;
+}
+
+}
+
+std::string encode_terminal(const VTerminal& terminal, const ScreenSnapshot& screen) {
+    return encode(terminal, screen, true);
+}
+
+bool write_terminal_file(const std::string& path, const std::string& data, std::string* error) {
+    const std::string temp = path + ".tmp";
+    {
+        std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+        if (!file || !file.write(data.data(), static_cast<std::streamsize>(data.size())) || !file.flush()) {
+            set_error(error, "cannot write " + temp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        set_error(error, "cannot replace " + path + ": " + ec.message());
+        return false;
+    }
+    return true;
+}
+
+bool save_terminal(const std::string& path, const VTerminal& terminal, const ScreenSnapshot& screen,
+                   std::string* error) {
+    return write_terminal_file(path, encode(terminal, screen, false), error);
+}
+
+}
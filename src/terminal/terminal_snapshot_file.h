@@ -0,0 +1,44 @@
+#pragma once
+
+#include "vterminal.h"
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace diana {
+
+// On-disk layout of a saved terminal (all integers little-endian):
+//   header  "DIANASNP", u32 version, u16 rows, u16 cols, u16 cursor row,
+//           u16 cursor col, u8 cursor visible, u32 default fg, u32 default bg,
+//           u32 scrollback line count
+//   lines   the scrollback lines, then the screen rows, each
+//           u16 width, u16 run count, u32 text size, runs, text
+//   run     u16 cells, u8 attributes, u32 fg, u32 bg
+// A line's text is the UTF-8 of its cells, one code point per cell with each
+// combining mark prefixed by a NUL. Blank cells are stored as spaces, the
+// second half of a wide character is left out, and trailing blanks in the
+// default colours are dropped.
+struct SavedTerminal {
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    ScreenSnapshot screen;
+    std::vector<std::vector<TerminalCell>> scrollback;
+
+    // Maps the file and decodes it.
+    static std::optional<SavedTerminal> load(const std::string& path, std::string* error = nullptr);
+};
+
+// Writes the scrollback lines that precede screen, then screen itself
+// (normally the snapshot the UI shows), replacing path atomically. Requires
+// terminal.lock_scrollback().
+bool save_terminal(const std::string& path, const VTerminal& terminal, const ScreenSnapshot& screen,
+                   std::string* error = nullptr);
+
+// The two halves of save_terminal(), for writing the file on another thread.
+// encode_terminal() takes terminal.lock_scrollback() itself, a chunk of lines
+// at a time, so output keeps being parsed meanwhile; lines evicted before
+// their chunk are left out.
+std::string encode_terminal(const VTerminal& terminal, const ScreenSnapshot& screen);
+bool write_terminal_file(const std::string& path, const std::string& data, std::string* error = nullptr);
+
+}
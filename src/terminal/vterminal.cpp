@@ -1,4 +1,5 @@
 #include "vterminal.h"
+#include "core/profiler.h"
 
 extern "C" {
 #include <vterm.h>
@@ -45,6 +46,137 @@ void convert_vterm_cell(const VTermScreen* screen, const VTermScreenCell* src, T
     dst->reverse = src->attrs.reverse;
 }
 
+namespace {
+
+constexpr uint32_t CONTINUATION_CELL = 0xFFFFFFFF;
+
+void append_codepoint(uint32_t cp, std::string& out) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp <= 0x10FFFF) {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+// The attributes an SGR sequence can carry, as last written to the output.
+struct SgrPen {
+    uint32_t fg = 0;
+    uint32_t bg = 0;
+    bool bold = false;
+    bool italic = false;
+    bool underline = false;
+    bool strike = false;
+    bool reverse = false;
+    
+    static SgrPen of(const TerminalCell& cell) {
+        return {cell.fg, cell.bg, cell.bold, cell.italic, cell.underline, cell.strike, cell.reverse};
+    }
+    bool operator==(const SgrPen& o) const {
+        return fg == o.fg && bg == o.bg && bold == o.bold && italic == o.italic &&
+               underline == o.underline && strike == o.strike && reverse == o.reverse;
+    }
+    bool operator!=(const SgrPen& o) const { return !(*this == o); }
+};
+
+void append_sgr_color(std::string& out, const char* base, uint32_t color) {
+    out += base;
+    out += ";2;";
+    out += std::to_string(color & 0xFF);
+    out += ';';
+    out += std::to_string((color >> 8) & 0xFF);
+    out += ';';
+    out += std::to_string((color >> 16) & 0xFF);
+}
+
+// Colours equal to the terminal defaults are written as "default" so the
+// text picks up the reader's own theme.
+void append_sgr(std::string& out, const SgrPen& pen, uint32_t default_fg, uint32_t default_bg) {
+    out += "\x1b[0";
+    if (pen.bold) out += ";1";
+    if (pen.italic) out += ";3";
+    if (pen.underline) out += ";4";
+    if (pen.reverse) out += ";7";
+    if (pen.strike) out += ";9";
+    if (pen.fg != default_fg) append_sgr_color(out, ";38", pen.fg);
+    if (pen.bg != default_bg) append_sgr_color(out, ";48", pen.bg);
+    out += 'm';
+}
+
+bool is_blank(const TerminalCell& cell) {
+    return cell.chars[0] == 0 || cell.chars[0] == ' ';
+}
+
+bool is_paste_safe_ascii(unsigned char c) {
+    return (c >= 0x20 && c < 0x7F) || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Length of the well-formed UTF-8 sequence starting at text[i] (lead byte
+// >= 0x80), or 0. Same acceptance as the per-codepoint decoder it replaces.
+size_t utf8_sequence_length(std::string_view text, size_t i) {
+    unsigned char c0 = static_cast<unsigned char>(text[i]);
+    size_t len = (c0 >> 5) == 0x6 ? 2 : (c0 >> 4) == 0xE ? 3 : (c0 >> 3) == 0x1E ? 4 : 0;
+    if (len == 0 || i + len > text.size()) {
+        return 0;
+    }
+    for (size_t k = 1; k < len; ++k) {
+        if ((static_cast<unsigned char>(text[i + k]) & 0xC0) != 0x80) {
+            return 0;
+        }
+    }
+    return len;
+}
+
+// Copies text to out in runs, dropping C0/C1 controls (bar tab, CR, LF) and
+// DEL so a paste cannot smuggle in escape sequences or end a bracketed paste
+// early.
+void append_sanitized_paste(std::string_view text, std::string& out) {
+    size_t run_start = 0;
+    size_t i = 0;
+    auto flush_run = [&](size_t end) {
+        out.append(text.data() + run_start, end - run_start);
+    };
+    while (i < text.size()) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c < 0x80) {
+            if (is_paste_safe_ascii(c)) {
+                ++i;
+                continue;
+            }
+            flush_run(i);
+            run_start = ++i;
+            continue;
+        }
+        size_t len = utf8_sequence_length(text, i);
+        if (len == 2 && c == 0xC2 && static_cast<unsigned char>(text[i + 1]) < 0xA0) {
+            // U+0080..U+009F: C1 controls, including the 8-bit CSI.
+            flush_run(i);
+            i += 2;
+            run_start = i;
+            continue;
+        }
+        if (len == 0) {
+            flush_run(i);
+            out += "\xEF\xBF\xBD";
+            run_start = ++i;
+            continue;
+        }
+        i += len;
+    }
+    flush_run(i);
+}
+
+}
+
 class VTerminalImpl {
 public:
     VTerm* vt = nullptr;
@@ -61,7 +193,7 @@ public:
             .damage = on_damage,
             .moverect = nullptr,
             .movecursor = on_movecursor,
-            .settermprop = nullptr,
+            .settermprop = on_settermprop,
             .bell = nullptr,
             .resize = nullptr,
             .sb_pushline = on_sb_pushline,
@@ -82,8 +214,12 @@ public:
     }
     
     static int on_damage(VTermRect rect, void* user) {
-        (void)rect;
-        (void)user;
+        auto* impl = static_cast<VTerminalImpl*>(user);
+        auto& dirty = impl->owner->dirty_rows_;
+        int end_row = std::min(rect.end_row, static_cast<int>(dirty.size()));
+        for (int row = std::max(0, rect.start_row); row < end_row; ++row) {
+            dirty[static_cast<size_t>(row)] = 1;
+        }
         return 1;
     }
     
@@ -96,6 +232,18 @@ public:
         return 1;
     }
     
+    static int on_settermprop(VTermProp prop, VTermValue* val, void* user) {
+        auto* owner = static_cast<VTerminalImpl*>(user)->owner;
+        if (prop == VTERM_PROP_SYNCUPDATE) {
+            bool begin = val->boolean != 0;
+            if (begin && !owner->update_in_progress_) {
+                owner->update_started_ = std::chrono::steady_clock::now();
+            }
+            owner->update_in_progress_ = begin;
+        }
+        return 1;
+    }
+    
     static int on_sb_pushline(int cols, const VTermScreenCell* cells, void* user) {
         auto* impl = static_cast<VTerminalImpl*>(user);
         auto* owner = impl->owner;
@@ -109,10 +257,19 @@ public:
             line.push_back(tc);
         }
         
-        owner->scrollback_.push_back(std::move(line));
+        LineText text;
+        project_line(line.data(), cols, text);
         
-        if (owner->scrollback_.size() > VTerminal::MAX_SCROLLBACK) {
-            owner->scrollback_.erase(owner->scrollback_.begin());
+        {
+            std::lock_guard<std::mutex> lock(owner->scrollback_mutex_);
+            owner->scrollback_.push_back(std::move(line));
+            owner->scrollback_index_.push_line(std::move(text));
+            
+            if (owner->scrollback_.size() > VTerminal::MAX_SCROLLBACK) {
+                owner->scrollback_.pop_front();
+                owner->scrollback_index_.evict_front();
+                ++owner->scrollback_evicted_;
+            }
         }
         
         if (owner->scrollback_cb_) {
@@ -164,7 +321,9 @@ public:
             cells[i].width = 1;
         }
         
+        std::lock_guard<std::mutex> lock(owner->scrollback_mutex_);
         owner->scrollback_.pop_back();
+        owner->scrollback_index_.pop_line();
         return 1;
     }
 };
@@ -194,10 +353,12 @@ void VTerminal::resize(int rows, int cols) {
     
     rows_ = rows;
     cols_ = cols;
+    screen_cache_valid_ = false;
     vterm_set_size(impl_->vt, rows, cols);
 }
 
 void VTerminal::write(const char* data, size_t len) {
+    DIANA_PROFILE_SCOPE("vterminal.write");
     vterm_input_write(impl_->vt, data, len);
     vterm_screen_flush_damage(impl_->screen);
 }
@@ -219,6 +380,39 @@ CursorInfo VTerminal::get_cursor() const {
     return cursor_;
 }
 
+void VTerminal::snapshot_screen(ScreenSnapshot& out) {
+    const size_t cell_count = static_cast<size_t>(rows_) * static_cast<size_t>(cols_);
+    if (!screen_cache_valid_ || screen_cache_.size() != cell_count) {
+        screen_cache_.assign(cell_count, TerminalCell{});
+        dirty_rows_.assign(static_cast<size_t>(rows_), 1);
+        screen_cache_valid_ = true;
+    }
+    
+    VTermScreenCell cell;
+    for (int row = 0; row < rows_; ++row) {
+        if (!dirty_rows_[static_cast<size_t>(row)]) continue;
+        dirty_rows_[static_cast<size_t>(row)] = 0;
+        
+        TerminalCell* dst = screen_cache_.data() + static_cast<size_t>(row) * static_cast<size_t>(cols_);
+        for (int col = 0; col < cols_; ++col) {
+            VTermPos pos = { .row = row, .col = col };
+            dst[col] = TerminalCell{};
+            if (vterm_screen_get_cell(impl_->screen, pos, &cell)) {
+                convert_vterm_cell(impl_->screen, &cell, &dst[col], default_fg_, default_bg_);
+            }
+        }
+    }
+    
+    out.rows = rows_;
+    out.cols = cols_;
+    out.cells.assign(screen_cache_.begin(), screen_cache_.end());
+    out.cursor = cursor_;
+    
+    std::lock_guard<std::mutex> lock(scrollback_mutex_);
+    out.scrollback_size = scrollback_.size();
+    out.scrollback_evicted = scrollback_evicted_;
+}
+
 std::string VTerminal::get_output() {
     std::string result;
     size_t len = vterm_output_get_buffer_current(impl_->vt);
@@ -229,9 +423,116 @@ std::string VTerminal::get_output() {
     return result;
 }
 
+size_t VTerminal::extract_text(TextPosition from, TextPosition to, const ScreenSnapshot& screen, std::string& out,
+                               const TextExtractOptions& options) const {
+    const uint64_t screen_first = screen.scrollback_evicted + screen.scrollback_size;
+    const uint64_t end_line = std::min(to.line + 1, screen_first + static_cast<uint64_t>(screen.rows));
+    const SgrPen default_pen{default_fg_, default_bg_};
+    SgrPen pen = default_pen;
+    size_t lines = 0;
+    
+    for (uint64_t line = std::max(from.line, scrollback_evicted_); line < end_line; ++line) {
+        const TerminalCell* cells = nullptr;
+        int width = 0;
+        if (line < screen_first) {
+            uint64_t index = line - scrollback_evicted_;
+            if (index >= scrollback_.size()) continue;
+            cells = scrollback_[static_cast<size_t>(index)].data();
+            width = static_cast<int>(scrollback_[static_cast<size_t>(index)].size());
+        } else {
+            cells = screen.row(static_cast<int>(line - screen_first));
+            width = screen.cols;
+        }
+        
+        int begin = line == from.line ? std::max(from.col, 0) : 0;
+        int end = line == to.line ? std::min(to.col + 1, width) : width;
+        if (options.trim_trailing_blanks) {
+            // With SGR a coloured background is content too.
+            while (end > begin && is_blank(cells[end - 1]) &&
+                   (!options.sgr || (cells[end - 1].bg == default_bg_ && !cells[end - 1].reverse))) {
+                --end;
+            }
+        }
+        
+        if (lines > 0) {
+            out += '\n';
+        }
+        ++lines;
+        
+        for (int col = begin; col < end; ++col) {
+            const TerminalCell& cell = cells[col];
+            if (cell.chars[0] == CONTINUATION_CELL) continue;
+            if (options.sgr) {
+                SgrPen cell_pen = SgrPen::of(cell);
+                if (cell_pen != pen) {
+                    append_sgr(out, cell_pen, default_fg_, default_bg_);
+                    pen = cell_pen;
+                }
+            }
+            uint32_t first = cell.chars[0];
+            if (first == 0 || first > 0x10FFFF) {
+                out.push_back(' ');
+                continue;
+            }
+            append_codepoint(first, out);
+            for (int i = 1; i < TERMINAL_MAX_CHARS_PER_CELL && cell.chars[i] != 0; ++i) {
+                append_codepoint(cell.chars[i], out);
+            }
+        }
+    }
+    
+    if (options.sgr && pen != default_pen) {
+        out += "\x1b[0m";
+    }
+    return lines;
+}
+
+void VTerminal::restore(std::vector<std::vector<TerminalCell>> scrollback, const ScreenSnapshot& screen) {
+    if (screen.rows > 0 && screen.cols > 0 && (screen.rows != rows_ || screen.cols != cols_)) {
+        resize(screen.rows, screen.cols);
+    }
+    
+    std::string vt = "\x1b[H\x1b[2J";
+    {
+        std::lock_guard<std::mutex> lock(scrollback_mutex_);
+        for (auto& line : scrollback) {
+            LineText text;
+            project_line(line.data(), static_cast<int>(line.size()), text);
+            scrollback_.push_back(std::move(line));
+            scrollback_index_.push_line(std::move(text));
+            if (scrollback_.size() > MAX_SCROLLBACK) {
+                scrollback_.pop_front();
+                scrollback_index_.evict_front();
+                ++scrollback_evicted_;
+            }
+        }
+        
+        // The screen goes back in as output, so libvterm owns it like any
+        // other text and the application can draw over it.
+        ScreenSnapshot view;
+        view.rows = std::min(screen.rows, rows_);
+        view.cols = screen.cols;
+        view.cells = screen.cells;
+        view.scrollback_evicted = scrollback_evicted_;
+        TextExtractOptions options;
+        options.sgr = true;
+        for (int row = 0; row < view.rows; ++row) {
+            uint64_t line = scrollback_evicted_ + static_cast<uint64_t>(row);
+            vt += "\x1b[" + std::to_string(row + 1) + ";1H";
+            extract_text({line, 0}, {line, view.cols - 1}, view, vt, options);
+        }
+    }
+    vt += "\x1b[" + std::to_string(screen.cursor.row + 1) + ";" + std::to_string(screen.cursor.col + 1) + "H";
+    if (!screen.cursor.visible) {
+        vt += "\x1b[?25l";
+    }
+    write(vt.data(), vt.size());
+}
+
 void VTerminal::set_default_colors(uint32_t fg, uint32_t bg) {
     default_fg_ = fg;
     default_bg_ = bg;
+    screen_cache_valid_ = false;
     
     VTermColor vfg, vbg;
     vterm_color_rgb(&vfg,
@@ -265,4 +566,19 @@ void VTerminal::keyboard_end_paste() {
     vterm_keyboard_end_paste(impl_->vt);
 }
 
+void VTerminal::keyboard_paste(std::string_view text, std::string& out) {
+    out += get_output();
+    // libvterm only emits the start marker in bracketed-paste mode, which
+    // answers the question for the end marker too.
+    vterm_keyboard_start_paste(impl_->vt);
+    std::string start_marker = get_output();
+    out.reserve(out.size() + start_marker.size() * 2 + text.size() + 16);
+    out += start_marker;
+    append_sanitized_paste(text, out);
+    if (!start_marker.empty()) {
+        vterm_keyboard_end_paste(impl_->vt);
+        out += get_output();
+    }
+}
+
 }
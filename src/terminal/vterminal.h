@@ -1,10 +1,15 @@
 #pragma once
 
+#include "scrollback_index.h"
+#include <chrono>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 
 namespace diana {
 
@@ -29,6 +34,41 @@ struct CursorInfo {
     int shape;
 };
 
+// Converted copy of the visible screen. Built by whichever thread drives the
+// VTerminal and handed to the UI, which can then render without touching
+// libvterm. scrollback_evicted counts lines dropped from the front of the
+// scrollback so far; together with scrollback_size it lets a reader map its
+// line indices onto the live scrollback after further lines were pushed.
+struct ScreenSnapshot {
+    int rows = 0;
+    int cols = 0;
+    std::vector<TerminalCell> cells;
+    CursorInfo cursor{0, 0, true, 1};
+    size_t scrollback_size = 0;
+    uint64_t scrollback_evicted = 0;
+    uint64_t generation = 0;
+    
+    const TerminalCell* row(int r) const {
+        return cells.data() + static_cast<size_t>(r) * static_cast<size_t>(cols);
+    }
+    const TerminalCell& cell(int r, int c) const { return row(r)[c]; }
+};
+
+// A cell in absolute line numbering: scrollback lines are numbered from
+// the first line ever pushed (evicted lines included), screen rows follow
+// the last scrollback line.
+struct TextPosition {
+    uint64_t line = 0;
+    int col = 0;
+};
+
+struct TextExtractOptions {
+    // Emit SGR sequences so colours and attributes survive, e.g. when saving
+    // to a file meant for `less -R` or `cat`.
+    bool sgr = false;
+    bool trim_trailing_blanks = true;
+};
+
 class VTerminalImpl;
 
 class VTerminal {
@@ -48,21 +88,61 @@ public:
     TerminalCell get_cell(int row, int col) const;
     CursorInfo get_cursor() const;
     
+    // Copies the screen into out, reconverting only rows damaged since the
+    // previous call.
+    void snapshot_screen(ScreenSnapshot& out);
+    
     std::string get_output();
     
+    // True between DECSET and DECRST 2026 (synchronized update): the
+    // application is repainting and the screen is not meant to be shown until
+    // it ends the batch. update_started() is when the current batch began.
+    bool update_in_progress() const { return update_in_progress_; }
+    std::chrono::steady_clock::time_point update_started() const { return update_started_; }
+    
     // Keyboard input - generates correct escape sequences based on terminal mode
     void keyboard_key(int key);  // Use VTermKey enum values
     void keyboard_unichar(uint32_t c, int modifiers = 0);
     void keyboard_start_paste();
     void keyboard_end_paste();
+    // Appends a whole paste to out, after any output already pending: the
+    // bracketed-paste markers if the application enabled them, around the
+    // UTF-8 text with control characters other than tab, CR and LF removed
+    // and malformed bytes replaced by U+FFFD. Works on the bytes in bulk
+    // instead of going through libvterm one codepoint at a time.
+    void keyboard_paste(std::string_view text, std::string& out);
     
     void set_default_colors(uint32_t fg, uint32_t bg);
+    uint32_t default_fg() const { return default_fg_; }
+    uint32_t default_bg() const { return default_bg_; }
+    
+    // Kept in step with scrollback(); same locking rule. Line numbers are
+    // absolute, i.e. scrollback_evicted() + index.
+    const ScrollbackIndex& scrollback_index() const { return scrollback_index_; }
     
     using ScrollbackCallback = std::function<void(const std::vector<TerminalCell>&)>;
     void set_scrollback_callback(ScrollbackCallback cb);
     
-    const std::vector<std::vector<TerminalCell>>& scrollback() const { return scrollback_; }
+    // The scrollback is appended to while parsing; readers on another thread
+    // must hold lock_scrollback() while touching it.
+    const std::deque<std::vector<TerminalCell>>& scrollback() const { return scrollback_; }
     size_t scrollback_size() const { return scrollback_.size(); }
+    uint64_t scrollback_evicted() const { return scrollback_evicted_; }
+    std::unique_lock<std::mutex> lock_scrollback() const { return std::unique_lock<std::mutex>(scrollback_mutex_); }
+    
+    // Appends the text from..to (both inclusive; to.col may be past the end
+    // of its line) to out in one pass, lines separated by '\n'. Lines before
+    // screen's first row come from the scrollback, the rest from screen,
+    // which is normally the snapshot the UI shows. Lines already evicted are
+    // skipped. Requires lock_scrollback(). Returns the number of lines
+    // written.
+    size_t extract_text(TextPosition from, TextPosition to, const ScreenSnapshot& screen, std::string& out,
+                        const TextExtractOptions& options = {}) const;
+    
+    // Puts back a terminal saved earlier: the lines are appended to the
+    // scrollback and the screen is redrawn from screen's cells and cursor,
+    // resizing to match first. Meant for a terminal nothing was written to.
+    void restore(std::vector<std::vector<TerminalCell>> scrollback, const ScreenSnapshot& screen);
 
 private:
     friend class VTerminalImpl;
@@ -73,9 +153,19 @@ private:
     
     CursorInfo cursor_{0, 0, true, 1};
     
-    std::vector<std::vector<TerminalCell>> scrollback_;
+    bool update_in_progress_ = false;
+    std::chrono::steady_clock::time_point update_started_{};
+    
+    std::deque<std::vector<TerminalCell>> scrollback_;
+    uint64_t scrollback_evicted_ = 0;
+    ScrollbackIndex scrollback_index_;
+    mutable std::mutex scrollback_mutex_;
     static constexpr size_t MAX_SCROLLBACK = 10000;
     
+    std::vector<TerminalCell> screen_cache_;
+    std::vector<uint8_t> dirty_rows_;
+    bool screen_cache_valid_ = false;
+    
     ScrollbackCallback scrollback_cb_;
     
     uint32_t default_fg_ = 0xFFD4D4D4;
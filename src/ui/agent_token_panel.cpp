@@ -1,4 +1,5 @@
 #include "ui/agent_token_panel.h"
+#include "core/redraw_scheduler.h"
 #include "imgui.h"
 #include <algorithm>
 #include <map>
@@ -45,6 +46,7 @@ void AgentTokenPanel::update() {
         last_update_ = now;
         last_selected_agent_ = selected_agent_;
     }
+    RedrawScheduler::instance().request_redraw_in(1.0);
 }
 
 void AgentTokenPanel::render() {
@@ -1,4 +1,5 @@
 #include "claude_code_panel.h"
+#include "core/redraw_scheduler.h"
 #include "theme.h"
 #include <cstring>
 
@@ -29,6 +30,7 @@ void ClaudeCodePanel::render_content() {
             ? ImVec4(1, 0.4f, 0.4f, 1) : ImVec4(0.4f, 1, 0.4f, 1);
         ImGui::TextColored(color, "%s", status_message_.c_str());
         status_time_ -= ImGui::GetIO().DeltaTime;
+        RedrawScheduler::instance().request_redraw_in(status_time_);
     }
     
     float list_width = 180.0f;
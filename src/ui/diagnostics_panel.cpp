@@ -0,0 +1,234 @@
+#include "ui/diagnostics_panel.h"
+#include "core/redraw_scheduler.h"
+#include "imgui.h"
+#include <algorithm>
+#include <sys/resource.h>
+
+namespace diana {
+
+namespace {
+
+constexpr double SAMPLE_INTERVAL_SECONDS = 1.0;
+
+double process_cpu_seconds() {
+    struct rusage usage {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0.0;
+    }
+    auto to_seconds = [](const timeval& tv) {
+        return static_cast<double>(tv.tv_sec) + static_cast<double>(tv.tv_usec) / 1e6;
+    };
+    return to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime);
+}
+
+}
+
+void DiagnosticsPanel::sample() {
+    auto& redraw = RedrawScheduler::instance();
+    auto now = std::chrono::steady_clock::now();
+    uint64_t frames = redraw.frames();
+    uint64_t wakeups = redraw.wakeups();
+    double idle = redraw.idle_seconds();
+    double cpu = process_cpu_seconds();
+
+    if (!has_baseline_) {
+        has_baseline_ = true;
+    } else {
+        double wall = std::chrono::duration<double>(now - last_sample_).count();
+        if (wall < SAMPLE_INTERVAL_SECONDS) {
+            return;
+        }
+        uint64_t frame_delta = frames - last_frames_;
+        double idle_delta = idle - last_idle_seconds_;
+        fps_ = static_cast<float>(frame_delta / wall);
+        frame_ms_ = frame_delta > 0 ? static_cast<float>((wall - idle_delta) * 1000.0 / frame_delta) : 0.0f;
+        idle_percent_ = static_cast<float>(std::clamp(idle_delta / wall, 0.0, 1.0) * 100.0);
+        cpu_percent_ = static_cast<float>((cpu - last_cpu_seconds_) / wall * 100.0);
+        wakeups_per_sec_ = static_cast<float>((wakeups - last_wakeups_) / wall);
+
+        fps_history_[history_head_] = fps_;
+        cpu_history_[history_head_] = cpu_percent_;
+        history_head_ = (history_head_ + 1) % HISTORY;
+        history_count_ = std::min(history_count_ + 1, HISTORY);
+    }
+
+    last_sample_ = now;
+    last_frames_ = frames;
+    last_wakeups_ = wakeups;
+    last_idle_seconds_ = idle;
+    last_cpu_seconds_ = cpu;
+}
+
+void DiagnosticsPanel::render(bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(420, 360), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Diagnostics", open)) {
+        ImGui::End();
+        return;
+    }
+
+    sample();
+    RedrawScheduler::instance().request_redraw_in(SAMPLE_INTERVAL_SECONDS);
+
+    ImGui::Text("FPS: %.1f", fps_);
+    ImGui::SameLine(160);
+    ImGui::Text("Frame: %.2f ms", frame_ms_);
+    ImGui::Text("Idle: %.0f%%", idle_percent_);
+    ImGui::SameLine(160);
+    ImGui::Text("CPU: %.1f%%", cpu_percent_);
+    ImGui::Text("Wakeups: %.1f/s", wakeups_per_sec_);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Redraws requested from outside the UI thread\n(PTY output, agent exits, network replies).");
+    }
+
+    if (history_count_ > 0) {
+        int offset = history_count_ < HISTORY ? 0 : history_head_;
+        ImGui::PlotLines("FPS", fps_history_.data(), history_count_, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+        ImGui::PlotLines("CPU %", cpu_history_.data(), history_count_, offset, nullptr, 0.0f, FLT_MAX, ImVec2(0, 40));
+    }
+
+    if (terminal_panel_) {
+        if (auto failure = terminal_panel_->controller().io_failure()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", failure->c_str());
+        }
+        const SessionDaemonClient* daemon = terminal_panel_->controller().daemon();
+        if (daemon && daemon->connected()) {
+            ImGui::Text("Sessions run in diana-sessiond");
+        } else {
+            ImGui::TextDisabled(daemon ? "diana-sessiond disconnected" : "diana-sessiond not running");
+        }
+        if (ImGui::IsItemHovered()) {
+            ImGui::SetTooltip("%s", daemon ? daemon->socket_path().c_str()
+                                           : "Start diana-sessiond before Diana to keep agents\nrunning across restarts.");
+        }
+    }
+
+    ImGui::Separator();
+    render_session_table();
+    ImGui::Separator();
+    render_resource_table();
+
+    ImGui::End();
+}
+
+void DiagnosticsPanel::render_session_table() {
+    if (!terminal_panel_ || terminal_panel_->sessions().empty()) {
+        ImGui::TextDisabled("No terminal sessions.");
+        return;
+    }
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+    if (!ImGui::BeginTable("DiagnosticsSessions", 6, flags)) {
+        return;
+    }
+    ImGui::TableSetupColumn("Session", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Backlog");
+    ImGui::TableSetupColumn("Lag");
+    ImGui::TableSetupColumn("Parsed");
+    ImGui::TableSetupColumn("Stalls");
+    ImGui::TableSetupColumn("Held");
+    ImGui::TableHeadersRow();
+
+    for (const auto& session : terminal_panel_->sessions()) {
+        IngestStats stats = session->ingest_stats();
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s%s", session->name().c_str(), session->foreground() ? "" : " (bg)");
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f KB", stats.pending_bytes / 1024.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.0f ms", stats.parse_lag_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f MB", stats.bytes_parsed / (1024.0 * 1024.0));
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(stats.backpressure_stalls));
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", static_cast<unsigned long long>(stats.held_snapshots));
+    }
+    ImGui::EndTable();
+}
+
+void DiagnosticsPanel::render_resource_table() {
+    if (!terminal_panel_) {
+        return;
+    }
+    ResourceSampler& sampler = terminal_panel_->controller().resource_sampler();
+    int interval_ms = static_cast<int>(sampler.interval().count());
+    ImGui::SetNextItemWidth(160);
+    if (ImGui::SliderInt("Sample every", &interval_ms, 250, 5000, "%d ms")) {
+        sampler.set_interval(std::chrono::milliseconds(interval_ms));
+    }
+
+    resource_rows_.clear();
+    for (const auto& session : terminal_panel_->sessions()) {
+        if (auto usage = sampler.latest(session->id())) {
+            resource_rows_.push_back({session.get(), *usage});
+        }
+    }
+    if (resource_rows_.empty()) {
+        ImGui::TextDisabled("No running sessions.");
+        return;
+    }
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit |
+                            ImGuiTableFlags_Sortable;
+    if (!ImGui::BeginTable("DiagnosticsResources", 7, flags)) {
+        return;
+    }
+    ImGui::TableSetupColumn("Session", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("CPU", ImGuiTableColumnFlags_DefaultSort | ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Memory", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Read", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Write", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("Procs", ImGuiTableColumnFlags_PreferSortDescending);
+    ImGui::TableSetupColumn("CPU history", ImGuiTableColumnFlags_NoSort, 120.0f);
+    ImGui::TableHeadersRow();
+
+    if (const ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsCount > 0) {
+        const ImGuiTableColumnSortSpecs& spec = specs->Specs[0];
+        auto key = [&spec](const ResourceRow& row) -> double {
+            switch (spec.ColumnIndex) {
+                case 1: return row.usage.cpu_percent;
+                case 2: return static_cast<double>(row.usage.rss_bytes);
+                case 3: return row.usage.read_bytes_per_sec;
+                case 4: return row.usage.write_bytes_per_sec;
+                case 5: return row.usage.processes;
+                default: return 0.0;
+            }
+        };
+        bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+        std::stable_sort(resource_rows_.begin(), resource_rows_.end(), [&](const ResourceRow& a, const ResourceRow& b) {
+            if (spec.ColumnIndex == 0) {
+                return ascending ? a.session->name() < b.session->name() : b.session->name() < a.session->name();
+            }
+            return ascending ? key(a) < key(b) : key(b) < key(a);
+        });
+    }
+
+    for (const ResourceRow& row : resource_rows_) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(row.session->name().c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f%%", row.usage.cpu_percent);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f MB", row.usage.rss_bytes / (1024.0 * 1024.0));
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f KB/s", row.usage.read_bytes_per_sec / 1024.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f KB/s", row.usage.write_bytes_per_sec / 1024.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", row.usage.processes);
+        ImGui::TableNextColumn();
+        cpu_plot_.clear();
+        for (const ResourceUsage& usage : sampler.history(row.session->id())) {
+            cpu_plot_.push_back(usage.cpu_percent);
+        }
+        ImGui::PushID(static_cast<int>(row.session->id()));
+        ImGui::PlotLines("##cpu", cpu_plot_.data(), static_cast<int>(cpu_plot_.size()), 0, nullptr, 0.0f, FLT_MAX,
+                         ImVec2(120, ImGui::GetTextLineHeight()));
+        ImGui::PopID();
+    }
+    ImGui::EndTable();
+}
+
+}
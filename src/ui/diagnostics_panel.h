@@ -0,0 +1,55 @@
+#pragma once
+
+#include "terminal/terminal_panel.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+namespace diana {
+
+// Frame pacing and CPU use of the render loop, per-session parser backlog
+// and what each session's processes use. Samples once a second so leaving it open barely changes the
+// numbers it shows.
+class DiagnosticsPanel {
+public:
+    void set_terminal_panel(TerminalPanel* panel) { terminal_panel_ = panel; }
+
+    void render(bool* open);
+
+private:
+    static constexpr int HISTORY = 120;
+
+    void sample();
+    void render_session_table();
+    void render_resource_table();
+
+    TerminalPanel* terminal_panel_ = nullptr;
+
+    bool has_baseline_ = false;
+    std::chrono::steady_clock::time_point last_sample_;
+    uint64_t last_frames_ = 0;
+    uint64_t last_wakeups_ = 0;
+    double last_idle_seconds_ = 0.0;
+    double last_cpu_seconds_ = 0.0;
+
+    float fps_ = 0.0f;
+    float frame_ms_ = 0.0f;
+    float idle_percent_ = 0.0f;
+    float cpu_percent_ = 0.0f;
+    float wakeups_per_sec_ = 0.0f;
+
+    std::array<float, HISTORY> fps_history_{};
+    std::array<float, HISTORY> cpu_history_{};
+    int history_head_ = 0;
+    int history_count_ = 0;
+
+    struct ResourceRow {
+        const TerminalSession* session = nullptr;
+        ResourceUsage usage;
+    };
+    std::vector<ResourceRow> resource_rows_;
+    std::vector<float> cpu_plot_;
+};
+
+}
@@ -1,5 +1,6 @@
 #include "metrics_panel.h"
 #include "ui/metrics_panel.h"
+#include "core/redraw_scheduler.h"
 #include "imgui.h"
 #include "implot.h"
 #include <array>
@@ -7,6 +8,10 @@
 
 namespace diana {
 
+namespace {
+constexpr double COLLECTOR_POLL_SECONDS = 0.5;
+}
+
 MetricsPanel::MetricsPanel()
     : hub_(std::make_unique<MultiMetricsStore>())
     , claude_collector_(std::make_unique<ClaudeUsageCollector>())
@@ -22,6 +27,8 @@ void MetricsPanel::update() {
     claude_collector_->poll();
     codex_collector_->poll();
     opencode_collector_->poll();
+    // Collectors rate-limit themselves; wake up in time for their next poll.
+    RedrawScheduler::instance().request_redraw_in(COLLECTOR_POLL_SECONDS);
 }
 
 void MetricsPanel::render() {
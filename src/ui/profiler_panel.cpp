@@ -0,0 +1,262 @@
+#include "ui/profiler_panel.h"
+#include "core/redraw_scheduler.h"
+#include "imgui.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <map>
+#include <utility>
+
+namespace diana {
+
+namespace {
+
+constexpr uint64_t WINDOW_NS = 5'000'000'000ULL;
+constexpr double REFRESH_SECONDS = 0.25;
+constexpr const char* FRAME_SCOPE = "frame";
+
+std::string traces_dir() {
+    const char* home = std::getenv("HOME");
+    if (!home) return {};
+    return std::string(home) + "/.config/diana/traces";
+}
+
+std::string thread_label(const ProfileThread& thread) {
+    return thread.name.empty() ? "thread " + std::to_string(thread.tid) : thread.name;
+}
+
+double to_ms(uint64_t ns) {
+    return static_cast<double>(ns) / 1e6;
+}
+
+}
+
+void ProfilerPanel::refresh() {
+    threads_ = Profiler::instance().snapshot(Profiler::now_ns() - WINDOW_NS);
+
+    frames_.clear();
+    for (const auto& thread : threads_) {
+        for (const auto& event : thread.events) {
+            if (event.name && std::strcmp(event.name, FRAME_SCOPE) == 0) {
+                frames_.push_back({event.start_ns, event.end_ns});
+            }
+        }
+    }
+    std::sort(frames_.begin(), frames_.end(), [](const Frame& a, const Frame& b) { return a.start_ns < b.start_ns; });
+    frame_ms_.clear();
+    for (const auto& frame : frames_) {
+        frame_ms_.push_back(static_cast<float>(to_ms(frame.end_ns - frame.start_ns)));
+    }
+
+    if (frames_.empty()) {
+        selected_frame_ = -1;
+    } else if (follow_latest_ || selected_frame_ < 0) {
+        selected_frame_ = static_cast<int>(frames_.size()) - 1;
+    } else {
+        selected_frame_ = std::min(selected_frame_, static_cast<int>(frames_.size()) - 1);
+    }
+}
+
+void ProfilerPanel::save_trace() {
+    std::string dir = traces_dir();
+    if (dir.empty()) {
+        status_ = "HOME is not set";
+        return;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+
+    std::time_t now = std::time(nullptr);
+    char stamp[32];
+    std::strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", std::localtime(&now));
+    std::string path = dir + "/diana-trace-" + stamp + ".json";
+
+    std::string error;
+    status_ = Profiler::instance().write_chrome_trace(path, &error) ? "Saved " + path : error;
+}
+
+void ProfilerPanel::render(bool* open) {
+    ImGui::SetNextWindowSize(ImVec2(520, 480), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Profiler", open)) {
+        ImGui::End();
+        return;
+    }
+
+#if !DIANA_PROFILING
+    ImGui::TextDisabled("Built with DIANA_ENABLE_PROFILING=OFF.");
+    ImGui::End();
+    return;
+#endif
+
+    Profiler& profiler = Profiler::instance();
+    bool recording = profiler.enabled();
+    if (ImGui::Checkbox("Record", &recording)) {
+        profiler.set_enabled(recording);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused_);
+    ImGui::SameLine();
+    if (ImGui::Button("Save Chrome trace")) {
+        save_trace();
+    }
+    if (!status_.empty()) {
+        ImGui::TextWrapped("%s", status_.c_str());
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    if (!paused_ && std::chrono::duration<double>(now - last_refresh_).count() >= REFRESH_SECONDS) {
+        last_refresh_ = now;
+        refresh();
+    }
+    if (!paused_ && recording) {
+        RedrawScheduler::instance().request_redraw_in(REFRESH_SECONDS);
+    }
+
+    if (frames_.empty()) {
+        ImGui::TextDisabled("No frames recorded in the last %d s.", static_cast<int>(WINDOW_NS / 1'000'000'000ULL));
+        ImGui::End();
+        return;
+    }
+
+    float worst = *std::max_element(frame_ms_.begin(), frame_ms_.end());
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%zu frames, worst %.2f ms", frame_ms_.size(), worst);
+    ImGui::PlotHistogram("##frames", frame_ms_.data(), static_cast<int>(frame_ms_.size()), 0, overlay,
+                         0.0f, std::max(worst, 1.0f), ImVec2(-FLT_MIN, 60));
+
+    int last = static_cast<int>(frames_.size()) - 1;
+    ImGui::SetNextItemWidth(200);
+    if (ImGui::SliderInt("Frame", &selected_frame_, 0, last)) {
+        follow_latest_ = selected_frame_ == last;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Slowest")) {
+        selected_frame_ = static_cast<int>(std::max_element(frame_ms_.begin(), frame_ms_.end()) - frame_ms_.begin());
+        follow_latest_ = false;
+    }
+    ImGui::SameLine();
+    if (ImGui::Checkbox("Latest", &follow_latest_) && follow_latest_) {
+        selected_frame_ = last;
+    }
+
+    ImGui::Separator();
+    render_frame_table();
+    ImGui::Separator();
+    render_summary_table();
+
+    ImGui::End();
+}
+
+// Scopes on any thread that ran while the selected frame was being built,
+// clipped to the frame. Times are inclusive of nested scopes.
+void ProfilerPanel::render_frame_table() {
+    if (selected_frame_ < 0 || selected_frame_ >= static_cast<int>(frames_.size())) {
+        return;
+    }
+    const Frame& frame = frames_[static_cast<size_t>(selected_frame_)];
+    ImGui::Text("Frame %d: %.2f ms", selected_frame_, to_ms(frame.end_ns - frame.start_ns));
+
+    std::map<std::pair<std::string, std::string>, Row> by_scope;
+    for (const auto& thread : threads_) {
+        std::string label = thread_label(thread);
+        for (const auto& event : thread.events) {
+            if (!event.name || event.end_ns <= frame.start_ns || event.start_ns >= frame.end_ns) {
+                continue;
+            }
+            if (std::strcmp(event.name, FRAME_SCOPE) == 0) {
+                continue;
+            }
+            Row& row = by_scope[{label, event.name}];
+            row.thread = label;
+            row.scope = event.name;
+            double ms = to_ms(std::min(event.end_ns, frame.end_ns) - std::max(event.start_ns, frame.start_ns));
+            row.calls++;
+            row.total_ms += ms;
+            row.max_ms = std::max(row.max_ms, ms);
+        }
+    }
+    rows_.clear();
+    for (auto& [key, row] : by_scope) {
+        rows_.push_back(std::move(row));
+    }
+    std::sort(rows_.begin(), rows_.end(), [](const Row& a, const Row& b) { return a.total_ms > b.total_ms; });
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit |
+                            ImGuiTableFlags_ScrollY;
+    if (!ImGui::BeginTable("ProfilerFrame", 4, flags, ImVec2(0, 160))) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Thread");
+    ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("ms");
+    ImGui::TableHeadersRow();
+    for (const auto& row : rows_) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(row.thread.c_str());
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(row.scope.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", row.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", row.total_ms);
+    }
+    ImGui::EndTable();
+}
+
+// Every scope recorded in the window, across all threads.
+void ProfilerPanel::render_summary_table() {
+    std::map<std::string, Row> by_scope;
+    for (const auto& thread : threads_) {
+        for (const auto& event : thread.events) {
+            if (!event.name) {
+                continue;
+            }
+            Row& row = by_scope[event.name];
+            double ms = to_ms(event.end_ns - event.start_ns);
+            row.calls++;
+            row.total_ms += ms;
+            row.max_ms = std::max(row.max_ms, ms);
+        }
+    }
+    rows_.clear();
+    for (auto& [name, row] : by_scope) {
+        row.scope = name;
+        rows_.push_back(std::move(row));
+    }
+    std::sort(rows_.begin(), rows_.end(), [](const Row& a, const Row& b) { return a.total_ms > b.total_ms; });
+
+    ImGuiTableFlags flags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit |
+                            ImGuiTableFlags_ScrollY;
+    if (!ImGui::BeginTable("ProfilerSummary", 5, flags, ImVec2(0, 0))) {
+        return;
+    }
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Scope", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableSetupColumn("Calls");
+    ImGui::TableSetupColumn("Total ms");
+    ImGui::TableSetupColumn("Avg ms");
+    ImGui::TableSetupColumn("Max ms");
+    ImGui::TableHeadersRow();
+    for (const auto& row : rows_) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(row.scope.c_str());
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", row.calls);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", row.total_ms);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", row.calls ? row.total_ms / row.calls : 0.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.3f", row.max_ms);
+    }
+    ImGui::EndTable();
+}
+
+}
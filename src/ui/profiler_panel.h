@@ -0,0 +1,49 @@
+#pragma once
+
+#include "core/profiler.h"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace diana {
+
+// Where the last few seconds of UI frames went, from the DIANA_PROFILE_SCOPE
+// timers: frame times, the scopes that ran during a chosen frame on every
+// thread, and totals per scope. "Save Chrome trace" writes everything still
+// in the profiler's buffers for chrome://tracing or ui.perfetto.dev.
+class ProfilerPanel {
+public:
+    void render(bool* open);
+
+private:
+    struct Frame {
+        uint64_t start_ns = 0;
+        uint64_t end_ns = 0;
+    };
+
+    struct Row {
+        std::string thread;
+        std::string scope;
+        uint32_t calls = 0;
+        double total_ms = 0.0;
+        double max_ms = 0.0;
+    };
+
+    void refresh();
+    void save_trace();
+    void render_frame_table();
+    void render_summary_table();
+
+    std::vector<ProfileThread> threads_;
+    std::vector<Frame> frames_;
+    std::vector<float> frame_ms_;
+    std::vector<Row> rows_;
+    std::chrono::steady_clock::time_point last_refresh_{};
+    int selected_frame_ = -1;
+    bool follow_latest_ = true;
+    bool paused_ = false;
+    std::string status_;
+};
+
+}
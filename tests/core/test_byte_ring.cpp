@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "core/byte_ring.h"
+#include <cstring>
+#include <string>
+#include <thread>
+
+TEST(ByteRingTest, CapacityRoundsUpToPowerOfTwo) {
+    diana::ByteRing ring(1000);
+    EXPECT_EQ(ring.capacity(), 1024u);
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.free_space(), 1024u);
+}
+
+TEST(ByteRingTest, WriteAndReadSpans) {
+    diana::ByteRing ring(16);
+
+    auto span = ring.write_span();
+    ASSERT_EQ(span.size, 16u);
+    std::memcpy(span.data, "hello", 5);
+    ring.commit_write(5);
+
+    EXPECT_EQ(ring.size(), 5u);
+    EXPECT_EQ(ring.write_position(), 5u);
+
+    auto readable = ring.read_span();
+    ASSERT_EQ(readable.size, 5u);
+    EXPECT_EQ(std::string(readable.data, readable.size), "hello");
+    ring.commit_read(readable.size);
+
+    EXPECT_TRUE(ring.empty());
+    EXPECT_EQ(ring.read_position(), 5u);
+}
+
+TEST(ByteRingTest, SpansStopAtTheWrapPoint) {
+    diana::ByteRing ring(16);
+
+    auto span = ring.write_span();
+    std::memset(span.data, 'a', 12);
+    ring.commit_write(12);
+    ring.commit_read(12);
+
+    span = ring.write_span();
+    EXPECT_EQ(span.size, 4u);
+    std::memcpy(span.data, "wxyz", 4);
+    ring.commit_write(4);
+
+    span = ring.write_span();
+    EXPECT_EQ(span.size, 12u);
+    std::memcpy(span.data, "12", 2);
+    ring.commit_write(2);
+
+    auto readable = ring.read_span();
+    EXPECT_EQ(std::string(readable.data, readable.size), "wxyz");
+    ring.commit_read(readable.size);
+    readable = ring.read_span();
+    EXPECT_EQ(std::string(readable.data, readable.size), "12");
+
+    readable = ring.read_span(1);
+    EXPECT_EQ(readable.size, 1u);
+}
+
+TEST(ByteRingTest, PeekDoesNotConsume) {
+    diana::ByteRing ring(16);
+    auto span = ring.write_span();
+    std::memset(span.data, 'a', 14);
+    ring.commit_write(14);
+    ring.commit_read(12);
+    span = ring.write_span();
+    std::memcpy(span.data, "bc", 2);
+    ring.commit_write(2);
+    span = ring.write_span();
+    std::memcpy(span.data, "de", 2);
+    ring.commit_write(2);
+
+    auto peeked = ring.peek_span(13);
+    EXPECT_EQ(std::string(peeked.data, peeked.size), "abc");
+    peeked = ring.peek_span(16);
+    EXPECT_EQ(std::string(peeked.data, peeked.size), "de");
+    EXPECT_EQ(ring.peek_span(18).size, 0u);
+    EXPECT_EQ(ring.peek_span(11).size, 0u);
+    EXPECT_EQ(ring.size(), 6u);
+}
+
+TEST(ByteRingTest, FullRingHasNoWriteSpan) {
+    diana::ByteRing ring(8);
+    auto span = ring.write_span();
+    ring.commit_write(span.size);
+
+    EXPECT_EQ(ring.free_space(), 0u);
+    EXPECT_EQ(ring.write_span().size, 0u);
+    EXPECT_FALSE(ring.wait_for_space(std::chrono::milliseconds(1)));
+}
+
+TEST(ByteRingTest, ReaderWakeupRunsOnCommit) {
+    diana::ByteRing ring(8);
+    int wakeups = 0;
+    ring.set_reader_wakeup([&wakeups] { ++wakeups; });
+
+    auto span = ring.write_span();
+    span.data[0] = 'x';
+    ring.commit_write(1);
+    ring.commit_write(0);
+    EXPECT_EQ(wakeups, 1);
+
+    ring.set_reader_wakeup(nullptr);
+    ring.commit_write(1);
+    EXPECT_EQ(wakeups, 1);
+}
+
+TEST(ByteRingTest, ProducerConsumerStream) {
+    diana::ByteRing ring(64);
+    constexpr size_t TOTAL = 1 << 20;
+
+    std::thread producer([&ring] {
+        size_t produced = 0;
+        while (produced < TOTAL) {
+            auto span = ring.write_span();
+            if (span.size == 0) {
+                ring.wait_for_space(std::chrono::milliseconds(10));
+                continue;
+            }
+            size_t n = std::min(span.size, TOTAL - produced);
+            for (size_t i = 0; i < n; ++i) {
+                span.data[i] = static_cast<char>((produced + i) & 0xFF);
+            }
+            ring.commit_write(n);
+            produced += n;
+        }
+    });
+
+    size_t consumed = 0;
+    bool in_order = true;
+    while (consumed < TOTAL) {
+        auto span = ring.read_span();
+        if (span.size == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (size_t i = 0; i < span.size; ++i) {
+            if (span.data[i] != static_cast<char>((consumed + i) & 0xFF)) {
+                in_order = false;
+            }
+        }
+        consumed += span.size;
+        ring.commit_read(span.size);
+    }
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(ring.read_position(), TOTAL);
+}
+
+TEST(ByteRingTest, WatermarksDefaultToQuarters) {
+    diana::ByteRing ring(64);
+    EXPECT_EQ(ring.high_water(), 48u);
+    EXPECT_EQ(ring.low_water(), 16u);
+
+    ring.set_watermarks(32, 8);
+    ring.commit_write(31);
+    EXPECT_FALSE(ring.above_high_water());
+    ring.commit_write(1);
+    EXPECT_TRUE(ring.above_high_water());
+
+    std::thread consumer([&ring] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        ring.commit_read(24);
+    });
+    EXPECT_TRUE(ring.wait_for_drain(std::chrono::seconds(2)));
+    consumer.join();
+
+    EXPECT_EQ(ring.size(), 8u);
+    EXPECT_EQ(ring.producer_stalls(), 1u);
+}
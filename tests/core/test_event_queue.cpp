@@ -1,7 +1,10 @@
 #include <gtest/gtest.h>
 #include "core/event_queue.h"
+#include <atomic>
+#include <cstdint>
 #include <thread>
 #include <string>
+#include <vector>
 
 TEST(EventQueueTest, PushAndTryPop) {
     diana::EventQueue<int> queue;
@@ -89,3 +92,152 @@ TEST(EventQueueTest, WaitPop) {
     
     producer.join();
 }
+
+TEST(EventQueueTest, DrainAppendsInPushOrder) {
+    diana::EventQueue<int> queue;
+    std::vector<int> out{-1};
+
+    EXPECT_EQ(queue.drain(out), 0u);
+    for (int i = 0; i < 5; ++i) {
+        queue.push(i);
+    }
+    EXPECT_EQ(queue.drain(out), 5u);
+    EXPECT_EQ(out, (std::vector<int>{-1, 0, 1, 2, 3, 4}));
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(EventQueueTest, DrainAfterTryPopKeepsOrder) {
+    diana::EventQueue<int> queue;
+    queue.push(1);
+    queue.push(2);
+    queue.push(3);
+    EXPECT_EQ(queue.try_pop().value(), 1);
+    queue.push(4);
+
+    std::vector<int> out;
+    queue.drain(out);
+    EXPECT_EQ(out, (std::vector<int>{2, 3, 4}));
+}
+
+TEST(EventQueueTest, GrowsItsPool) {
+    // Two-node chunks: 512 pooled nodes, the rest come from the heap.
+    diana::EventQueue<std::string> queue(2);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            queue.push(std::to_string(i));
+        }
+        EXPECT_EQ(queue.size(), 1000u);
+        std::vector<std::string> out;
+        ASSERT_EQ(queue.drain(out), 1000u);
+        for (int i = 0; i < 1000; ++i) {
+            EXPECT_EQ(out[i], std::to_string(i));
+        }
+    }
+    queue.push("left behind");   // freed by the destructor
+}
+
+namespace {
+
+// Events carry their producer and sequence number so the consumer can check
+// that nothing was lost, duplicated or reordered within a producer.
+uint64_t encode(uint32_t producer, uint32_t seq) {
+    return (static_cast<uint64_t>(producer) << 32) | seq;
+}
+
+void run_stress(size_t chunk_size, bool use_drain) {
+    constexpr uint32_t producers = 8;
+    constexpr uint32_t per_producer = 50000;
+    diana::EventQueue<uint64_t> queue(chunk_size);
+    std::atomic<bool> go{false};
+
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue, &go, p] {
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+            for (uint32_t i = 0; i < per_producer; ++i) {
+                queue.push(encode(p, i));
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(producers, 0);
+    size_t received = 0;
+    bool ordered = true;
+    auto check = [&](uint64_t event) {
+        uint32_t p = static_cast<uint32_t>(event >> 32);
+        uint32_t seq = static_cast<uint32_t>(event);
+        if (p >= producers || seq != next[p]) {
+            ordered = false;
+            return;
+        }
+        ++next[p];
+        ++received;
+    };
+
+    go.store(true);
+    std::vector<uint64_t> batch;
+    while (received < producers * per_producer && ordered) {
+        if (use_drain) {
+            batch.clear();
+            queue.drain(batch);
+            for (uint64_t event : batch) {
+                check(event);
+            }
+        } else if (auto event = queue.try_pop()) {
+            check(*event);
+        }
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    EXPECT_TRUE(ordered);
+    EXPECT_EQ(received, static_cast<size_t>(producers) * per_producer);
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.try_pop().has_value());
+}
+
+}
+
+TEST(EventQueueTest, StressManyProducersDrain) {
+    run_stress(diana::EventQueue<uint64_t>::DEFAULT_CHUNK_SIZE, true);
+}
+
+TEST(EventQueueTest, StressManyProducersTryPop) {
+    run_stress(diana::EventQueue<uint64_t>::DEFAULT_CHUNK_SIZE, false);
+}
+
+// Tiny chunks keep producers fighting over the same few free nodes and
+// growing the pool until it spills onto the heap.
+TEST(EventQueueTest, StressSmallPool) {
+    run_stress(2, true);
+}
+
+TEST(EventQueueTest, WaitPopWakesForEveryProducer) {
+    diana::EventQueue<int> queue;
+    constexpr int producers = 4;
+    constexpr int per_producer = 2000;
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&queue] {
+            for (int i = 0; i < per_producer; ++i) {
+                queue.push(1);
+                if (i % 100 == 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+            }
+        });
+    }
+
+    int sum = 0;
+    for (int i = 0; i < producers * per_producer; ++i) {
+        sum += queue.wait_pop();
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(sum, producers * per_producer);
+}
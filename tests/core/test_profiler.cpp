@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include "core/profiler.h"
+#include <nlohmann/json.hpp>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Each test records on threads of its own, so other tests' events stay out.
+const diana::ProfileThread* find_thread(const std::vector<diana::ProfileThread>& threads, const std::string& name) {
+    for (const auto& thread : threads) {
+        if (thread.name == name) {
+            return &thread;
+        }
+    }
+    return nullptr;
+}
+
+}
+
+TEST(ProfilerTest, RecordsNestedScopes) {
+    uint64_t since = diana::Profiler::now_ns();
+    std::thread([] {
+        DIANA_PROFILE_THREAD("nested");
+        DIANA_PROFILE_SCOPE("outer");
+        {
+            DIANA_PROFILE_SCOPE("inner");
+        }
+    }).join();
+
+    auto threads = diana::Profiler::instance().snapshot(since);
+    const auto* thread = find_thread(threads, "nested");
+    ASSERT_NE(thread, nullptr);
+    ASSERT_EQ(thread->events.size(), 2u);
+    const auto& inner = thread->events[0];
+    const auto& outer = thread->events[1];
+    EXPECT_STREQ(inner.name, "inner");
+    EXPECT_STREQ(outer.name, "outer");
+    EXPECT_LE(outer.start_ns, inner.start_ns);
+    EXPECT_GE(outer.end_ns, inner.end_ns);
+}
+
+TEST(ProfilerTest, RingKeepsNewestEvents) {
+    constexpr size_t extra = 100;
+    std::thread([] {
+        DIANA_PROFILE_THREAD("wrap");
+        auto& profiler = diana::Profiler::instance();
+        for (size_t i = 0; i < diana::Profiler::EVENTS_PER_THREAD + extra; ++i) {
+            profiler.record(i < extra ? "old" : "new", i + 1, i + 1);
+        }
+    }).join();
+
+    auto threads = diana::Profiler::instance().snapshot();
+    const auto* thread = find_thread(threads, "wrap");
+    ASSERT_NE(thread, nullptr);
+    ASSERT_EQ(thread->events.size(), diana::Profiler::EVENTS_PER_THREAD);
+    EXPECT_EQ(thread->events.front().start_ns, extra + 1);
+    for (const auto& event : thread->events) {
+        EXPECT_STREQ(event.name, "new");
+    }
+}
+
+TEST(ProfilerTest, SnapshotHasOneEntryPerThread) {
+    uint64_t since = diana::Profiler::now_ns();
+    // A buffer is handed to the next new thread once its owner exits, so the
+    // workers stay alive until the snapshot is taken.
+    std::atomic<int> recorded{0};
+    std::atomic<bool> done{false};
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 4; ++i) {
+        workers.emplace_back([i, &recorded, &done] {
+            static const char* names[] = {"worker 0", "worker 1", "worker 2", "worker 3"};
+            DIANA_PROFILE_THREAD(names[i]);
+            for (int n = 0; n <= i; ++n) {
+                DIANA_PROFILE_SCOPE("work");
+            }
+            recorded.fetch_add(1);
+            while (!done.load()) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (recorded.load() < 4) {
+        std::this_thread::yield();
+    }
+
+    auto threads = diana::Profiler::instance().snapshot(since);
+    done.store(true);
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    for (int i = 0; i < 4; ++i) {
+        const auto* thread = find_thread(threads, "worker " + std::to_string(i));
+        ASSERT_NE(thread, nullptr) << i;
+        EXPECT_EQ(thread->events.size(), static_cast<size_t>(i + 1));
+    }
+}
+
+TEST(ProfilerTest, ChromeTraceIsValidJson) {
+    std::vector<diana::ProfileThread> threads(1);
+    threads[0].tid = 7;
+    threads[0].name = "ui \"main\"";
+    threads[0].events.push_back({"frame", 1'000'000, 3'000'000});
+    threads[0].events.push_back({"vterminal.write", 1'500'000, 2'000'000});
+
+    auto trace = nlohmann::json::parse(diana::Profiler::chrome_trace_json(threads));
+    const auto& events = trace["traceEvents"];
+    ASSERT_EQ(events.size(), 3u);
+    EXPECT_EQ(events[0]["ph"], "M");
+    EXPECT_EQ(events[0]["args"]["name"], "ui \"main\"");
+    EXPECT_EQ(events[1]["name"], "frame");
+    EXPECT_EQ(events[1]["ph"], "X");
+    EXPECT_EQ(events[1]["tid"], 7);
+    EXPECT_DOUBLE_EQ(events[1]["ts"].get<double>(), 0.0);
+    EXPECT_DOUBLE_EQ(events[1]["dur"].get<double>(), 2000.0);
+    EXPECT_DOUBLE_EQ(events[2]["ts"].get<double>(), 500.0);
+}
+
+TEST(ProfilerTest, DisabledRecordsNothing) {
+    uint64_t since = diana::Profiler::now_ns();
+    diana::Profiler::instance().set_enabled(false);
+    std::thread([] {
+        DIANA_PROFILE_THREAD("disabled");
+        DIANA_PROFILE_SCOPE("skipped");
+    }).join();
+    diana::Profiler::instance().set_enabled(true);
+
+    auto threads = diana::Profiler::instance().snapshot(since);
+    EXPECT_EQ(find_thread(threads, "disabled"), nullptr);
+}
@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "core/telemetry.h"
+#include "metrics/metrics_exporter.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+std::string http_get(const std::string& socket_path, const std::string& target) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(fd);
+        return {};
+    }
+    std::string request = "GET " + target + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    send(fd, request.data(), request.size(), 0);
+    std::string reply;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        reply.append(buffer, static_cast<size_t>(n));
+    }
+    close(fd);
+    return reply;
+}
+
+}
+
+TEST(MetricsExporterTest, RendersCountersAndPublishedSessions) {
+    auto& collector = diana::Telemetry::instance().collector(diana::AppKind::Codex);
+    uint64_t before = collector.output_tokens.load();
+    collector.record_entry(10, 25);
+    diana::Telemetry::instance().add_pty_read(100);
+
+    diana::MetricsExporter exporter;
+    diana::SessionMetrics session;
+    session.id = 3;
+    session.name = "say \"hi\"";
+    session.app = diana::AppKind::ClaudeCode;
+    session.running = true;
+    session.backlog_bytes = 4096;
+    exporter.publish_sessions({session});
+
+    std::string text = exporter.render();
+    EXPECT_NE(text.find("# TYPE diana_tokens_total counter"), std::string::npos);
+    EXPECT_NE(text.find("diana_tokens_total{agent=\"codex\",direction=\"output\"} " + std::to_string(before + 25)),
+              std::string::npos) << text;
+    EXPECT_NE(text.find("diana_pty_read_bytes_total "), std::string::npos);
+    EXPECT_NE(text.find("diana_session_backlog_bytes{session=\"3\",name=\"say \\\"hi\\\"\",agent=\"claude\"} 4096"),
+              std::string::npos) << text;
+
+    exporter.publish_sessions({});
+    EXPECT_NE(exporter.render().find("diana_sessions 0\n"), std::string::npos);
+}
+
+TEST(MetricsExporterTest, ServesScrapesOverUnixSocket) {
+    std::string path = ::testing::TempDir() + "diana-metrics-" + std::to_string(getpid()) + ".sock";
+    diana::MetricsExporter exporter;
+    std::string error;
+    ASSERT_TRUE(exporter.start("unix:" + path, &error)) << error;
+
+    std::string reply = http_get(path, "/metrics");
+    EXPECT_EQ(reply.rfind("HTTP/1.1 200 OK\r\n", 0), 0u) << reply;
+    EXPECT_NE(reply.find("text/plain; version=0.0.4"), std::string::npos);
+    EXPECT_NE(reply.find("diana_frames_total"), std::string::npos);
+    EXPECT_EQ(exporter.scrapes(), 1u);
+
+    EXPECT_EQ(http_get(path, "/other").rfind("HTTP/1.1 404", 0), 0u);
+
+    struct stat st;
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 077, 0u);
+
+    diana::MetricsExporter second;
+    EXPECT_FALSE(second.start("unix:" + path, &error));
+    EXPECT_EQ(http_get(path, "/metrics").rfind("HTTP/1.1 200 OK\r\n", 0), 0u);
+
+    exporter.stop();
+    EXPECT_FALSE(exporter.running());
+    EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+
+TEST(MetricsExporterTest, LeavesFilesThatAreNotSocketsAlone) {
+    std::string path = ::testing::TempDir() + "diana-metrics-" + std::to_string(getpid()) + ".txt";
+    std::ofstream(path) << "keep";
+    diana::MetricsExporter exporter;
+    std::string error;
+    EXPECT_FALSE(exporter.start("unix:" + path, &error));
+    EXPECT_NE(error.find("not a socket"), std::string::npos) << error;
+    std::string contents;
+    std::ifstream(path) >> contents;
+    EXPECT_EQ(contents, "keep");
+    unlink(path.c_str());
+}
+
+TEST(MetricsExporterTest, RefusesNonLoopbackAddresses) {
+    diana::MetricsExporter exporter;
+    std::string error;
+    EXPECT_FALSE(exporter.start("0.0.0.0:9464", &error));
+    EXPECT_NE(error.find("127.0.0.1"), std::string::npos);
+    EXPECT_FALSE(exporter.start("127.0.0.1:notaport", &error));
+    EXPECT_FALSE(exporter.running());
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include "process/executable_resolver.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+class ExecutableResolverTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / "diana_resolver_test";
+        fs::remove_all(test_dir_);
+        fs::create_directories(test_dir_ / "bin");
+        fs::create_directories(test_dir_ / "home");
+        save_env("PATH");
+        save_env("HOME");
+        save_env("SHELL");
+        setenv("PATH", (test_dir_ / "bin").c_str(), 1);
+        setenv("HOME", (test_dir_ / "home").c_str(), 1);
+        setenv("SHELL", "/bin/sh", 1);
+    }
+
+    void TearDown() override {
+        for (const auto& [name, value] : saved_env_) {
+            if (value) {
+                setenv(name.c_str(), value->c_str(), 1);
+            } else {
+                unsetenv(name.c_str());
+            }
+        }
+        fs::remove_all(test_dir_);
+    }
+
+    void save_env(const char* name) {
+        const char* value = std::getenv(name);
+        saved_env_.emplace_back(name, value ? std::optional<std::string>(value) : std::nullopt);
+    }
+
+    fs::path install(const fs::path& dir, const std::string& name) {
+        fs::create_directories(dir);
+        fs::path path = dir / name;
+        std::ofstream(path) << "#!/bin/sh\n";
+        fs::permissions(path, fs::perms::owner_all);
+        return path;
+    }
+
+    fs::path test_dir_;
+    std::vector<std::pair<std::string, std::optional<std::string>>> saved_env_;
+};
+
+TEST_F(ExecutableResolverTest, ResolvesFromPathAndCaches) {
+    fs::path agent = install(test_dir_ / "bin", "diana-test-agent");
+    diana::ExecutableResolver resolver(0ms);
+
+    auto first = resolver.resolve("diana-test-agent");
+    EXPECT_TRUE(first.found);
+    EXPECT_FALSE(first.via_shell);
+    EXPECT_EQ(first.path, agent.string());
+
+    auto cached = resolver.cached("diana-test-agent");
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->path, agent.string());
+    EXPECT_EQ(resolver.invalidations(), 0u);
+}
+
+TEST_F(ExecutableResolverTest, MissesAreCachedUntilADirectoryChanges) {
+    diana::ExecutableResolver resolver(0ms);
+    auto missing = resolver.resolve("diana-test-agent");
+    EXPECT_FALSE(missing.found);
+    EXPECT_EQ(missing.path, "diana-test-agent");
+    ASSERT_TRUE(resolver.cached("diana-test-agent"));
+
+    // A new version manager root appearing is enough to look again. The
+    // old result is served until the background lookup replaces it.
+    fs::path agent = install(test_dir_ / "home" / ".volta" / "bin", "diana-test-agent");
+    auto stale = resolver.cached("diana-test-agent");
+    ASSERT_TRUE(stale);
+    EXPECT_EQ(resolver.invalidations(), 1u);
+
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!resolver.cached("diana-test-agent")->found && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    auto found = resolver.resolve("diana-test-agent");
+    EXPECT_TRUE(found.found);
+    EXPECT_EQ(found.path, agent.string());
+    EXPECT_EQ(resolver.invalidations(), 1u);
+}
+
+TEST_F(ExecutableResolverTest, FindsNvmDefaultVersion) {
+    fs::path nvm = test_dir_ / "home" / ".nvm";
+    install(nvm / "versions" / "node" / "v18.1.0" / "bin", "diana-test-agent");
+    fs::path v20 = install(nvm / "versions" / "node" / "v20.3.0" / "bin", "diana-test-agent");
+    fs::create_directories(nvm / "alias");
+    std::ofstream(nvm / "alias" / "default") << "20\n";
+
+    diana::ExecutableResolver resolver(0ms);
+    EXPECT_EQ(resolver.resolve("diana-test-agent").path, v20.string());
+}
+
+TEST_F(ExecutableResolverTest, PrewarmFillsCacheInBackground) {
+    fs::path agent = install(test_dir_ / "bin", "diana-test-agent");
+    diana::ExecutableResolver resolver(0ms);
+    resolver.prewarm({"diana-test-agent"});
+
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (!resolver.cached("diana-test-agent") && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    auto cached = resolver.cached("diana-test-agent");
+    ASSERT_TRUE(cached);
+    EXPECT_EQ(cached->path, agent.string());
+}
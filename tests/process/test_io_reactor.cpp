@@ -0,0 +1,333 @@
+#include <gtest/gtest.h>
+#include "process/io_reactor.h"
+#include "process/process_runner.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+using diana::test::eventually;
+
+namespace {
+
+diana::ProcessConfig shell(const std::string& script) {
+    diana::ProcessConfig config;
+    config.executable = "/bin/sh";
+    config.args = {"-c", script};
+    return config;
+}
+
+}
+
+TEST(IoReactorTest, IdleReactorDoesNotWakeUp) {
+    diana::IoReactor reactor;
+    reactor.call([] {});
+    uint64_t before = reactor.wakeups();
+    std::this_thread::sleep_for(150ms);
+    EXPECT_EQ(reactor.wakeups(), before);
+}
+
+TEST(IoReactorTest, PostAndCallRunOnReactorThread) {
+    diana::IoReactor reactor;
+    EXPECT_FALSE(reactor.in_reactor_thread());
+
+    bool inside = false;
+    reactor.call([&] { inside = reactor.in_reactor_thread(); });
+    EXPECT_TRUE(inside);
+
+    std::promise<bool> posted;
+    reactor.post([&] { posted.set_value(reactor.in_reactor_thread()); });
+    EXPECT_TRUE(posted.get_future().get());
+}
+
+TEST(IoReactorTest, DispatchesReadableFd) {
+    diana::IoReactor reactor;
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+
+    std::promise<std::string> received;
+    reactor.call([&] {
+        reactor.add_fd(fds[0], diana::IoReactor::READABLE, [&](uint32_t events) {
+            char buf[16];
+            ssize_t n = read(fds[0], buf, sizeof(buf));
+            reactor.remove_fd(fds[0]);
+            received.set_value(std::string(buf, n > 0 ? static_cast<size_t>(n) : 0));
+        });
+    });
+    EXPECT_EQ(reactor.watched_fds(), 1u);
+    ASSERT_EQ(write(fds[1], "ping", 4), 4);
+
+    auto result = received.get_future();
+    ASSERT_EQ(result.wait_for(2s), std::future_status::ready);
+    EXPECT_EQ(result.get(), "ping");
+    EXPECT_TRUE(eventually([&] { return reactor.watched_fds() == 0; }));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+TEST(IoReactorTest, TimersFireInOrderAndCanBeCancelled) {
+    diana::IoReactor reactor;
+    std::vector<int> fired;
+    std::promise<void> done;
+    reactor.call([&] {
+        reactor.add_timer(20ms, [&] { fired.push_back(2); });
+        reactor.add_timer(5ms, [&] { fired.push_back(1); });
+        auto cancelled = reactor.add_timer(10ms, [&] { fired.push_back(99); });
+        reactor.cancel_timer(cancelled);
+        reactor.add_timer(30ms, [&] { done.set_value(); });
+    });
+    ASSERT_EQ(done.get_future().wait_for(2s), std::future_status::ready);
+    reactor.call([&] { EXPECT_EQ(fired, (std::vector<int>{1, 2})); });
+}
+
+TEST(IoReactorTest, ReportsChildExitStatus) {
+    diana::IoReactor reactor;
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        usleep(20000);
+        _exit(7);
+    }
+
+    std::promise<int> status;
+    reactor.call([&] {
+        EXPECT_TRUE(reactor.watch_exit(pid, [&](int s) { status.set_value(s); }));
+    });
+    auto result = status.get_future();
+    ASSERT_EQ(result.wait_for(2s), std::future_status::ready);
+    int s = result.get();
+    ASSERT_TRUE(WIFEXITED(s));
+    EXPECT_EQ(WEXITSTATUS(s), 7);
+}
+
+#if defined(__linux__)
+namespace {
+
+std::vector<int> epoll_fds() {
+    std::vector<int> fds;
+    for (const auto& entry : std::filesystem::directory_iterator("/proc/self/fd")) {
+        std::error_code ec;
+        auto target = std::filesystem::read_symlink(entry.path(), ec);
+        if (!ec && target.string() == "anon_inode:[eventpoll]") {
+            fds.push_back(std::stoi(entry.path().filename().string()));
+        }
+    }
+    return fds;
+}
+
+}
+
+TEST(IoReactorTest, FailsCallsOnceWaitingFails) {
+    std::vector<int> before = epoll_fds();
+    diana::IoReactor reactor;
+    int poll_fd = -1;
+    for (int fd : epoll_fds()) {
+        if (std::find(before.begin(), before.end(), fd) == before.end()) {
+            poll_fd = fd;
+        }
+    }
+    ASSERT_GE(poll_fd, 0);
+    ASSERT_TRUE(reactor.call([] {}));
+
+    // The next epoll_wait gets a file that is not an epoll instance.
+    int null_fd = open("/dev/null", O_RDONLY);
+    ASSERT_GE(dup2(null_fd, poll_fd), 0);
+    close(null_fd);
+    reactor.post([] {});
+    ASSERT_TRUE(eventually([&] { return reactor.failed(); }));
+    EXPECT_EQ(reactor.failure_errno(), EINVAL);
+
+    bool ran = false;
+    EXPECT_FALSE(reactor.call([&] { ran = true; }));
+    EXPECT_FALSE(ran);
+
+    diana::ProcessRunner runner(reactor);
+    EXPECT_FALSE(runner.start(shell("true")));
+}
+#endif
+
+TEST(ProcessRunnerTest, ReadsOutputAndReportsExit) {
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::mutex mutex;
+    std::string output;
+    std::atomic<int> exit_code{-100};
+    runner.set_output_callback([&](const std::string& data, bool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output += data;
+    });
+    runner.set_exit_callback([&](int code) { exit_code.store(code); });
+
+    ASSERT_TRUE(runner.start(shell("printf hello; exit 3")));
+    ASSERT_TRUE(eventually([&] { return exit_code.load() != -100; }));
+    EXPECT_EQ(exit_code.load(), 3);
+    EXPECT_FALSE(runner.is_running());
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(output, "hello");
+}
+
+TEST(ProcessRunnerTest, PausesReadingWhileRingIsFull) {
+    diana::IoReactor reactor;
+    auto ring = std::make_shared<diana::ByteRing>(4096);
+    diana::ProcessRunner runner(reactor);
+    runner.set_output_ring(ring);
+    std::atomic<bool> exited{false};
+    runner.set_exit_callback([&](int) { exited.store(true); });
+
+    ASSERT_TRUE(runner.start(shell("head -c 65536 /dev/zero")));
+    ASSERT_TRUE(eventually([&] { return ring->above_high_water(); }));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_FALSE(exited.load());
+
+    size_t total = 0;
+    ASSERT_TRUE(eventually([&] {
+        auto span = ring->read_span();
+        total += span.size;
+        ring->commit_read(span.size);
+        return exited.load() && ring->empty();
+    }, 5000ms));
+    EXPECT_EQ(total, 65536u);
+}
+
+TEST(ProcessRunnerTest, StopEndsChildThatIgnoresSigterm) {
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::atomic<bool> exited{false};
+    runner.set_exit_callback([&](int) { exited.store(true); });
+
+    ASSERT_TRUE(runner.start(shell("trap '' TERM; printf ready; while :; do sleep 1; done")));
+    std::this_thread::sleep_for(100ms);
+    runner.stop();
+    EXPECT_TRUE(eventually([&] { return exited.load(); }, 1000ms));
+    EXPECT_FALSE(runner.is_running());
+}
+
+TEST(ProcessRunnerTest, LargeInputArrivesIntactAndInOrder) {
+    std::string path = ::testing::TempDir() + "diana_runner_input_" + std::to_string(getpid());
+    constexpr size_t SIZE = 3 * 1024 * 1024;
+    std::string payload(SIZE, '\0');
+    unsigned seed = 7;
+    for (char& c : payload) {
+        seed = seed * 1103515245u + 12345u;
+        c = static_cast<char>('a' + (seed >> 16) % 26);
+    }
+
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::atomic<bool> ready{false};
+    std::atomic<int> exit_code{-100};
+    runner.set_output_callback([&](const std::string& data, bool) {
+        if (data.find('R') != std::string::npos) ready.store(true);
+    });
+    runner.set_exit_callback([&](int code) { exit_code.store(code); });
+    ASSERT_TRUE(runner.start(shell("stty raw -echo; printf R; head -c " + std::to_string(SIZE) + " > " + path)));
+    ASSERT_TRUE(eventually([&] { return ready.load(); }));
+
+    // Several writes, so ordering across queued chunks matters.
+    for (size_t pos = 0; pos < SIZE; pos += SIZE / 3) {
+        ASSERT_TRUE(runner.write_stdin(payload.substr(pos, SIZE / 3)));
+    }
+    ASSERT_TRUE(eventually([&] { return exit_code.load() != -100; }, 10000ms));
+    EXPECT_EQ(exit_code.load(), 0);
+    EXPECT_EQ(runner.pending_input(), 0u);
+
+    std::ifstream in(path, std::ios::binary);
+    std::string received((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(received == payload) << "received " << received.size() << " of " << SIZE << " bytes";
+    unlink(path.c_str());
+}
+
+TEST(ProcessRunnerTest, QueuesInputTheChildIsNotReading) {
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::atomic<bool> ready{false};
+    runner.set_output_callback([&](const std::string& data, bool) {
+        if (data.find('R') != std::string::npos) ready.store(true);
+    });
+    ASSERT_TRUE(runner.start(shell("stty raw -echo; printf R; exec sleep 5")));
+    ASSERT_TRUE(eventually([&] { return ready.load(); }));
+
+    EXPECT_TRUE(runner.write_stdin(std::string(1024 * 1024, 'x')));
+    std::this_thread::sleep_for(50ms);
+    EXPECT_GT(runner.pending_input(), 0u);
+    EXPECT_FALSE(runner.write_stdin(std::string(diana::ProcessRunner::MAX_PENDING_INPUT, 'y')));
+
+    runner.kill();
+    ASSERT_TRUE(eventually([&] { return !runner.is_running(); }));
+    EXPECT_EQ(runner.pending_input(), 0u);
+    EXPECT_FALSE(runner.write_stdin("late"));
+}
+
+TEST(ExecPlanTest, BuildsArgvAndEnvironmentInParent) {
+    auto plan = diana::ExecPlan::build("sh", {"-c", "true"});
+    EXPECT_EQ(plan->path().front(), '/');
+    EXPECT_EQ(plan->path().substr(plan->path().size() - 3), "/sh");
+    EXPECT_STREQ(plan->argv()[0], "sh");
+    EXPECT_STREQ(plan->argv()[2], "true");
+    EXPECT_EQ(plan->argv()[3], nullptr);
+
+    ASSERT_NE(plan->env("TERM"), nullptr);
+    EXPECT_STREQ(plan->env("TERM"), "xterm-256color");
+    ASSERT_NE(plan->env("PATH"), nullptr);
+    EXPECT_EQ(std::string(plan->env("PATH")).rfind("/usr/local/bin:", 0), 0u);
+    if (const char* home = std::getenv("HOME")) {
+        EXPECT_STREQ(plan->env("HOME"), home);
+    }
+}
+
+TEST(ProcessRunnerTest, ChildRunsWithPlannedEnvironment) {
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::mutex mutex;
+    std::string output;
+    std::atomic<int> exit_code{-100};
+    runner.set_output_callback([&](const std::string& data, bool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output += data;
+    });
+    runner.set_exit_callback([&](int code) { exit_code.store(code); });
+
+    diana::ProcessConfig config = shell("printf %s \"$TERM\"");
+    config.plan = diana::ExecPlan::build(config.executable, config.args);
+    ASSERT_TRUE(runner.start(config));
+    ASSERT_TRUE(eventually([&] { return exit_code.load() != -100; }));
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(output, "xterm-256color");
+}
+
+TEST(ProcessRunnerTest, ReportsMissingExecutable) {
+    diana::IoReactor reactor;
+    diana::ProcessRunner runner(reactor);
+    std::mutex mutex;
+    std::string output;
+    std::atomic<int> exit_code{-100};
+    runner.set_output_callback([&](const std::string& data, bool) {
+        std::lock_guard<std::mutex> lock(mutex);
+        output += data;
+    });
+    runner.set_exit_callback([&](int code) { exit_code.store(code); });
+
+    diana::ProcessConfig config;
+    config.executable = "diana-no-such-executable";
+    ASSERT_TRUE(runner.start(config));
+    ASSERT_TRUE(eventually([&] { return exit_code.load() != -100; }));
+    EXPECT_EQ(exit_code.load(), 127);
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_NE(output.find("Failed to execute diana-no-such-executable: no such file or directory"), std::string::npos)
+        << output;
+}
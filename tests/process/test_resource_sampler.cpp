@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+#include "process/resource_sampler.h"
+#include <chrono>
+#include <thread>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+// A process group of two busy processes, ended when it goes out of scope.
+class BusyGroup {
+public:
+    BusyGroup() {
+        pid_ = fork();
+        if (pid_ == 0) {
+            setpgid(0, 0);
+            fork();
+            for (volatile unsigned long i = 0;; ++i) {
+            }
+        }
+        setpgid(pid_, pid_);
+    }
+
+    ~BusyGroup() {
+        kill(-pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+    }
+
+    pid_t pgid() const { return pid_; }
+
+private:
+    pid_t pid_ = -1;
+};
+
+// A group whose leader starts a child that burns CPU for a while, reaps it
+// and then sleeps.
+class ReapingGroup {
+public:
+    explicit ReapingGroup(std::chrono::milliseconds burn) {
+        pid_ = fork();
+        if (pid_ == 0) {
+            setpgid(0, 0);
+            pid_t child = fork();
+            if (child == 0) {
+                auto end = std::chrono::steady_clock::now() + burn;
+                while (std::chrono::steady_clock::now() < end) {
+                }
+                _exit(0);
+            }
+            waitpid(child, nullptr, 0);
+            for (;;) {
+                pause();
+            }
+        }
+        setpgid(pid_, pid_);
+    }
+
+    ~ReapingGroup() {
+        kill(-pid_, SIGKILL);
+        waitpid(pid_, nullptr, 0);
+    }
+
+    pid_t pgid() const { return pid_; }
+
+private:
+    pid_t pid_ = -1;
+};
+
+}
+
+TEST(ResourceSamplerTest, SumsCpuAndMemoryOverProcessGroup) {
+    BusyGroup group;
+    diana::ResourceSampler sampler(10s);
+    sampler.track(1, group.pgid());
+    std::this_thread::sleep_for(50ms);
+
+    sampler.sample_now();
+    std::this_thread::sleep_for(300ms);
+    sampler.sample_now();
+
+    auto usage = sampler.latest(1);
+    ASSERT_TRUE(usage);
+    EXPECT_EQ(usage->processes, 2u);
+    EXPECT_GT(usage->cpu_percent, 50.0f);
+    EXPECT_GT(usage->rss_bytes, 0u);
+}
+
+// The child's CPU was counted while it ran; the parent's counters for
+// reaped children must not add it again.
+TEST(ResourceSamplerTest, ReapedChildIsNotCountedTwice) {
+    ReapingGroup group(600ms);
+    diana::ResourceSampler sampler(10s);
+    sampler.track(1, group.pgid());
+    std::this_thread::sleep_for(50ms);
+
+    sampler.sample_now();
+    std::this_thread::sleep_for(100ms);
+    sampler.sample_now();
+    ASSERT_TRUE(sampler.latest(1));
+    EXPECT_EQ(sampler.latest(1)->processes, 2u);
+    EXPECT_GT(sampler.latest(1)->cpu_percent, 50.0f);
+
+    std::this_thread::sleep_for(700ms);
+    sampler.sample_now();
+    auto usage = sampler.latest(1);
+    ASSERT_TRUE(usage);
+    EXPECT_EQ(usage->processes, 1u);
+    EXPECT_LT(usage->cpu_percent, 30.0f);
+
+    std::this_thread::sleep_for(100ms);
+    sampler.sample_now();
+    EXPECT_LT(sampler.latest(1)->cpu_percent, 10.0f);
+}
+
+TEST(ResourceSamplerTest, KeepsBoundedHistory) {
+    diana::ResourceSampler sampler(10s);
+    sampler.track(7, getpgrp());
+    for (size_t i = 0; i < diana::ResourceSampler::HISTORY + 5; ++i) {
+        sampler.sample_now();
+    }
+    EXPECT_EQ(sampler.history(7).size(), diana::ResourceSampler::HISTORY);
+    EXPECT_GE(sampler.latest(7)->processes, 1u);
+
+    sampler.untrack(7);
+    EXPECT_FALSE(sampler.latest(7));
+    EXPECT_TRUE(sampler.history(7).empty());
+}
+
+TEST(ResourceSamplerTest, IdleSamplerDoesNotSample) {
+    diana::ResourceSampler sampler(10ms);
+    std::this_thread::sleep_for(100ms);
+    EXPECT_EQ(sampler.samples(), 0u);
+
+    sampler.track(1, getpgrp());
+    auto deadline = std::chrono::steady_clock::now() + 2s;
+    while (sampler.samples() < 3 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_GE(sampler.samples(), 3u);
+}
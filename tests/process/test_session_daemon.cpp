@@ -0,0 +1,316 @@
+#include <gtest/gtest.h>
+#include "process/io_reactor.h"
+#include "process/session_daemon.h"
+#include "process/session_daemon_client.h"
+#include "process/session_protocol.h"
+#include "test_helpers.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+using diana::test::drain;
+using diana::test::eventually;
+
+namespace {
+
+std::string temp_socket_path() {
+    return ::testing::TempDir() + "diana-sessiond-test-" + std::to_string(getpid()) + ".sock";
+}
+
+}
+
+TEST(SessionProtocolTest, FramesSurviveArbitrarySplits) {
+    std::string stream;
+    diana::append_frame(stream, diana::FrameType::Input, 7, "hello");
+    diana::append_frame(stream, diana::FrameType::Detach, 0xfeedface12345678ull);
+    diana::append_frame(stream, diana::FrameType::Output, 9, std::string(100000, 'x'));
+
+    diana::FrameReader reader;
+    std::vector<diana::Frame> frames;
+    diana::Frame frame;
+    for (size_t i = 0; i < stream.size(); i += 777) {
+        reader.feed(stream.data() + i, std::min<size_t>(777, stream.size() - i));
+        while (reader.next(frame)) {
+            frames.push_back(frame);
+        }
+    }
+    ASSERT_EQ(frames.size(), 3u);
+    EXPECT_EQ(frames[0].type, diana::FrameType::Input);
+    EXPECT_EQ(frames[0].session, 7u);
+    EXPECT_EQ(frames[0].payload, "hello");
+    EXPECT_EQ(frames[1].session, 0xfeedface12345678ull);
+    EXPECT_TRUE(frames[1].payload.empty());
+    EXPECT_EQ(frames[2].payload.size(), 100000u);
+    EXPECT_FALSE(reader.failed());
+
+    diana::SpawnRequest request;
+    request.executable = "/bin/sh";
+    request.args = {"-c", "echo hi", ""};
+    request.working_dir = "/tmp";
+    request.rows = 40;
+    request.cols = 132;
+    diana::SpawnRequest decoded;
+    ASSERT_TRUE(diana::decode_spawn(diana::encode_spawn(request), decoded));
+    EXPECT_EQ(decoded.executable, request.executable);
+    EXPECT_EQ(decoded.args, request.args);
+    EXPECT_EQ(decoded.working_dir, request.working_dir);
+    EXPECT_EQ(decoded.rows, 40);
+    EXPECT_EQ(decoded.cols, 132);
+    EXPECT_FALSE(diana::decode_spawn(diana::encode_spawn(request) + "x", decoded));
+}
+
+TEST(SessionProtocolTest, RejectsOversizedAndUnknownFrames) {
+    std::string header;
+    diana::append_u32(header, static_cast<uint32_t>(diana::MAX_FRAME_PAYLOAD + 1));
+    header.push_back(static_cast<char>(diana::FrameType::Output));
+    diana::append_u64(header, 1);
+    diana::FrameReader reader;
+    diana::Frame frame;
+    reader.feed(header.data(), header.size());
+    EXPECT_FALSE(reader.next(frame));
+    EXPECT_TRUE(reader.failed());
+
+    std::string unknown;
+    diana::append_frame(unknown, diana::FrameType::Input, 1);
+    unknown[4] = static_cast<char>(0xee);
+    diana::FrameReader other;
+    other.feed(unknown.data(), unknown.size());
+    EXPECT_FALSE(other.next(frame));
+    EXPECT_TRUE(other.failed());
+}
+
+TEST(SessionDaemonTest, SessionOutlivesClientAndReplaysOnReattach) {
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    std::string path = temp_socket_path();
+    std::string error;
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+
+    const uint64_t key = 42;
+    std::atomic<pid_t> spawned_pgid{-1};
+    diana::SpawnRequest request;
+    request.executable = "/bin/sh";
+    request.args = {"-c", "stty -echo; printf hello; read x; printf \" $x\"; exit 3"};
+    {
+        diana::SessionDaemonClient client(path);
+        ASSERT_TRUE(client.connect(&error)) << error;
+        EXPECT_FALSE(client.find(key).has_value());
+        auto ring = std::make_shared<diana::ByteRing>();
+        std::string seen;
+        ASSERT_TRUE(client.spawn(key, request));
+        ASSERT_TRUE(client.attach(key, ring, nullptr, [&](pid_t pgid) { spawned_pgid = pgid; }));
+        ASSERT_TRUE(eventually([&] {
+            seen += drain(*ring);
+            return seen.find("hello") != std::string::npos;
+        })) << seen;
+        ASSERT_TRUE(eventually([&] { return spawned_pgid.load() > 0; }));
+        EXPECT_EQ(getpgid(spawned_pgid.load()), spawned_pgid.load());
+    }
+    ASSERT_TRUE(eventually([&] { return daemon.client_count() == 0; }));
+    EXPECT_EQ(daemon.session_count(), 1u);
+
+    diana::SessionDaemonClient client(path);
+    ASSERT_TRUE(client.connect(&error)) << error;
+    auto info = client.find(key);
+    ASSERT_TRUE(info.has_value());
+    EXPECT_TRUE(info->running);
+    EXPECT_EQ(info->pgid, spawned_pgid.load());
+
+    auto ring = std::make_shared<diana::ByteRing>();
+    std::atomic<int> exit_code{-100};
+    pid_t attached_pgid = -1;
+    ASSERT_TRUE(client.attach(key, ring, [&](int code) { exit_code = code; },
+                              [&](pid_t pgid) { attached_pgid = pgid; }));
+    EXPECT_EQ(attached_pgid, spawned_pgid.load());
+    std::string seen;
+    ASSERT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return seen.find("hello") != std::string::npos;
+    })) << seen;
+
+    ASSERT_TRUE(client.write(key, "world\n"));
+    ASSERT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return seen.find(" world") != std::string::npos && exit_code.load() != -100;
+    })) << seen;
+    EXPECT_EQ(exit_code.load(), 3);
+    EXPECT_FALSE(client.find(key)->running);
+
+    ASSERT_TRUE(client.release(key));
+    EXPECT_TRUE(eventually([&] { return daemon.session_count() == 0; }));
+}
+
+TEST(SessionDaemonTest, RefusesSecondDaemonOnLiveSocket) {
+    diana::IoReactor reactor;
+    diana::SessionDaemon first(reactor);
+    std::string path = temp_socket_path() + ".2";
+    ASSERT_TRUE(first.listen(path));
+    diana::SessionDaemon second(reactor);
+    std::string error;
+    EXPECT_FALSE(second.listen(path, &error));
+    EXPECT_NE(error.find("Another"), std::string::npos);
+}
+
+TEST(SessionDaemonTest, SocketIsPrivateToTheUser) {
+    std::string dir = ::testing::TempDir() + "diana-sessiond-dir-" + std::to_string(getpid());
+    std::string path = dir + "/run/sessiond.sock";
+    struct RemoveDir {
+        std::string dir;
+        ~RemoveDir() { std::filesystem::remove_all(dir); }
+    } remove_dir{dir};
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    std::string error;
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+
+    struct stat st;
+    ASSERT_EQ(stat((dir + "/run").c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 0777, 0700u);
+    ASSERT_EQ(stat(path.c_str(), &st), 0);
+    EXPECT_EQ(st.st_mode & 077, 0u);
+
+    diana::SessionDaemonClient client(path);
+    EXPECT_TRUE(client.connect(&error)) << error;
+}
+
+TEST(SessionDaemonTest, FullRingHoldsOnlyItsOwnSession) {
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    std::string path = temp_socket_path() + ".3";
+    std::string error;
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+    diana::SessionDaemonClient client(path);
+    ASSERT_TRUE(client.connect(&error)) << error;
+
+    diana::SpawnRequest flood;
+    flood.executable = "/bin/sh";
+    flood.args = {"-c", "exec yes flood"};
+    auto full = std::make_shared<diana::ByteRing>(4096);
+    ASSERT_TRUE(client.spawn(1, flood));
+    ASSERT_TRUE(client.attach(1, full, nullptr));
+    ASSERT_TRUE(eventually([&] { return full->above_high_water(); }));
+
+    diana::SpawnRequest echo;
+    echo.executable = "/bin/sh";
+    echo.args = {"-c", "stty -echo; while read x; do echo \"got $x\"; done"};
+    auto ring = std::make_shared<diana::ByteRing>();
+    ASSERT_TRUE(client.spawn(2, echo));
+    ASSERT_TRUE(client.attach(2, ring, nullptr));
+    std::string seen;
+    ASSERT_TRUE(client.write(2, "one\n"));
+    ASSERT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return seen.find("got one") != std::string::npos;
+    })) << seen;
+
+    // Releasing the stalled session must not disturb the other one.
+    ASSERT_TRUE(client.release(1));
+    ASSERT_TRUE(client.write(2, "two\n"));
+    EXPECT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return seen.find("got two") != std::string::npos;
+    })) << seen;
+    EXPECT_TRUE(client.connected());
+    EXPECT_EQ(daemon.client_count(), 1u);
+    EXPECT_TRUE(eventually([&] { return daemon.session_count() == 1; }));
+}
+
+TEST(SessionDaemonTest, OutputBeyondTheCreditWindowArrivesWhole) {
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    std::string path = temp_socket_path() + ".6";
+    std::string error;
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+    diana::SessionDaemonClient client(path);
+    ASSERT_TRUE(client.connect(&error)) << error;
+
+    diana::SpawnRequest request;
+    request.executable = "/bin/sh";
+    request.args = {"-c", "stty -onlcr; seq 1 400000"};
+    auto ring = std::make_shared<diana::ByteRing>(64 * 1024);
+    std::atomic<int> exit_code{-100};
+    ASSERT_TRUE(client.spawn(6, request));
+    ASSERT_TRUE(client.attach(6, ring, [&](int code) { exit_code = code; }));
+    std::string seen;
+    ASSERT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return exit_code.load() != -100;
+    }, 20000ms));
+    seen += drain(*ring);
+    std::string expected;
+    for (int i = 1; i <= 400000; ++i) {
+        expected += std::to_string(i) + "\n";
+    }
+    ASSERT_GT(expected.size(), 2 * diana::SESSION_OUTPUT_WINDOW);
+    EXPECT_TRUE(seen == expected) << seen.size() << " of " << expected.size() << " bytes";
+}
+
+TEST(SessionDaemonTest, PasteLargerThanAFrameArrivesWhole) {
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    std::string path = temp_socket_path() + ".4";
+    std::string error;
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+    diana::SessionDaemonClient client(path);
+    ASSERT_TRUE(client.connect(&error)) << error;
+
+    const size_t paste = diana::MAX_FRAME_PAYLOAD + 1024 * 1024;
+    diana::SpawnRequest request;
+    request.executable = "/bin/sh";
+    request.args = {"-c", "stty raw -echo; head -c " + std::to_string(paste) + " | wc -c"};
+    auto ring = std::make_shared<diana::ByteRing>();
+    std::atomic<int> exit_code{-100};
+    ASSERT_TRUE(client.spawn(5, request));
+    ASSERT_TRUE(client.attach(5, ring, [&](int code) { exit_code = code; }));
+
+    EXPECT_FALSE(client.write(5, std::string(diana::SessionDaemonClient::MAX_PENDING_INPUT + 1, 'x')));
+    ASSERT_TRUE(client.write(5, std::string(paste, 'x')));
+    std::string seen;
+    ASSERT_TRUE(eventually([&] {
+        seen += drain(*ring);
+        return exit_code.load() != -100;
+    }, 20000ms)) << seen;
+    seen += drain(*ring);
+    EXPECT_NE(seen.find(std::to_string(paste)), std::string::npos) << seen;
+    EXPECT_EQ(exit_code.load(), 0);
+    EXPECT_TRUE(client.connected());
+}
+
+TEST(SessionDaemonTest, ReconnectsAfterDaemonRestart) {
+    std::string path = temp_socket_path() + ".5";
+    std::string error;
+    diana::SessionDaemonClient client(path);
+    auto ring = std::make_shared<diana::ByteRing>();
+    std::atomic<int> exit_code{-100};
+    {
+        diana::IoReactor reactor;
+        diana::SessionDaemon daemon(reactor);
+        ASSERT_TRUE(daemon.listen(path, &error)) << error;
+        ASSERT_TRUE(client.connect(&error)) << error;
+        diana::SpawnRequest request;
+        request.executable = "/bin/sh";
+        request.args = {"-c", "printf ready; exec sleep 30"};
+        ASSERT_TRUE(client.spawn(9, request));
+        ASSERT_TRUE(client.attach(9, ring, [&](int code) { exit_code = code; }));
+        std::string seen;
+        ASSERT_TRUE(eventually([&] {
+            seen += drain(*ring);
+            return seen.find("ready") != std::string::npos;
+        })) << seen;
+    }
+    ASSERT_TRUE(eventually([&] { return !client.connected(); }));
+
+    // The new daemon does not have the session, so it ends once reattached.
+    diana::IoReactor reactor;
+    diana::SessionDaemon daemon(reactor);
+    ASSERT_TRUE(daemon.listen(path, &error)) << error;
+    EXPECT_TRUE(eventually([&] { return client.connected(); }, 5000ms));
+    EXPECT_TRUE(eventually([&] { return exit_code.load() == -1; }));
+    EXPECT_FALSE(client.find(9).has_value());
+}
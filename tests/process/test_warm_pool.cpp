@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+#include "process/io_reactor.h"
+#include "process/warm_pool.h"
+#include "test_helpers.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+using namespace std::chrono_literals;
+using diana::test::drain;
+using diana::test::eventually;
+
+namespace {
+
+diana::WarmPool::ConfigFactory shell(const std::string& script) {
+    return [script](diana::AppKind, const std::string& working_dir) {
+        diana::ProcessConfig config;
+        config.executable = "/bin/sh";
+        config.args = {"-c", script};
+        config.working_dir = working_dir;
+        config.plan = diana::ExecPlan::build(config.executable, config.args);
+        return config;
+    };
+}
+
+}
+
+TEST(WarmPoolTest, HandsOverIdleAgentAndRefills) {
+    diana::IoReactor reactor;
+    auto factory = shell("printf W; read line; stty size; exec sleep 5");
+    diana::WarmPool pool(factory, {}, reactor);
+    std::string dir = ::testing::TempDir();
+    pool.keep_warm(diana::AppKind::Shell, dir, 1);
+    ASSERT_TRUE(eventually([&] { return pool.idle() == 1; }));
+
+    diana::ProcessConfig config = factory(diana::AppKind::Shell, dir);
+    config.rows = 30;
+    config.cols = 100;
+    auto ring = std::make_shared<diana::ByteRing>();
+    std::atomic<bool> exited{false};
+    auto runner = pool.take(diana::AppKind::Shell, config, ring, [&](int) { exited.store(true); });
+    ASSERT_NE(runner, nullptr);
+    EXPECT_EQ(pool.hits(), 1u);
+
+    // Output from before the hand-over comes first, then the resized PTY.
+    std::string output;
+    ASSERT_TRUE(eventually([&] { output += drain(*ring); return output.find('W') != std::string::npos; }));
+    ASSERT_TRUE(runner->write_stdin("\n"));
+    EXPECT_TRUE(eventually([&] { output += drain(*ring); return output.find("30 100") != std::string::npos; }))
+        << output;
+    EXPECT_EQ(output.find('W'), 0u);
+
+    EXPECT_TRUE(eventually([&] { return pool.idle() == 1; }));
+    EXPECT_EQ(pool.spawned(), 2u);
+
+    runner->kill();
+    EXPECT_TRUE(eventually([&] { return exited.load(); }));
+}
+
+TEST(WarmPoolTest, StaysWithinProcessLimit) {
+    diana::IoReactor reactor;
+    diana::WarmPoolLimits limits;
+    limits.max_processes = 2;
+    diana::WarmPool pool(shell("exec sleep 5"), limits, reactor);
+    pool.keep_warm(diana::AppKind::Shell, "/", 3);
+    ASSERT_TRUE(eventually([&] { return pool.limited() > 0; }));
+    EXPECT_EQ(pool.idle(), 2u);
+
+    pool.keep_warm(diana::AppKind::Shell, "/", 0);
+    EXPECT_EQ(pool.idle(), 0u);
+    auto ring = std::make_shared<diana::ByteRing>();
+    diana::ProcessConfig config;
+    config.working_dir = "/";
+    EXPECT_EQ(pool.take(diana::AppKind::Shell, config, ring, nullptr), nullptr);
+    EXPECT_EQ(pool.misses(), 1u);
+}
+
+TEST(WarmPoolTest, AgentThatExitsAtOnceIsNotRestartedInALoop) {
+    diana::IoReactor reactor;
+    diana::WarmPool pool(shell("exit 1"), {}, reactor);
+    pool.keep_warm(diana::AppKind::Shell, "/", 1);
+    ASSERT_TRUE(eventually([&] { return pool.spawned() >= 1; }));
+    std::this_thread::sleep_for(300ms);
+    EXPECT_EQ(pool.spawned(), 1u);
+    EXPECT_TRUE(eventually([&] { return pool.idle() == 0; }, 2000ms));
+}
@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include "terminal/global_search.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+std::unique_ptr<diana::TerminalSession> make_session(uint32_t id, const std::string& output) {
+    auto session = std::make_unique<diana::TerminalSession>(id);
+    session->resize_terminal(4, 40);
+    session->write_to_terminal(output);
+    EXPECT_TRUE(session->wait_until_parsed(2s));
+    return session;
+}
+
+std::vector<diana::GlobalSearchResult> run(diana::GlobalSearch& search, const diana::GlobalSearchQuery& query,
+                                           const std::vector<diana::TerminalSession*>& sessions) {
+    std::string error;
+    EXPECT_TRUE(search.start(query, sessions, error)) << error;
+
+    std::vector<diana::GlobalSearchResult> results;
+    auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (search.running() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(1ms);
+    }
+    EXPECT_FALSE(search.running());
+    search.drain(results);
+    std::sort(results.begin(), results.end(), [](const auto& a, const auto& b) {
+        return a.session_id != b.session_id ? a.session_id < b.session_id : a.hit.line < b.hit.line;
+    });
+    return results;
+}
+
+std::string numbered_lines(const std::string& prefix, int count) {
+    std::string data;
+    for (int i = 0; i < count; ++i) {
+        data += prefix + " " + std::to_string(i) + "\r\n";
+    }
+    return data;
+}
+
+}
+
+TEST(GlobalSearchTest, LiteralSearchCoversScrollbackAndScreenOfEverySession) {
+    auto first = make_session(1, numbered_lines("Build", 10));
+    auto second = make_session(2, numbered_lines("Test", 10) + "build done");
+
+    diana::ThreadPool pool(4);
+    diana::GlobalSearch search(pool);
+    diana::GlobalSearchQuery query;
+    query.pattern = "BUILD";
+    auto results = run(search, query, {first.get(), second.get()});
+
+    ASSERT_EQ(results.size(), 11u);
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_EQ(results[static_cast<size_t>(i)].session_id, 1u);
+        EXPECT_EQ(results[static_cast<size_t>(i)].hit.line, static_cast<uint64_t>(i));
+        EXPECT_EQ(results[static_cast<size_t>(i)].context, "Build " + std::to_string(i));
+    }
+
+    // The last line of the second session is still on screen.
+    const auto& last = results.back();
+    EXPECT_EQ(last.session_id, 2u);
+    EXPECT_EQ(last.hit.line, 10u);
+    EXPECT_EQ(last.hit.col, 0);
+    EXPECT_EQ(last.hit.end_col, 5);
+    EXPECT_EQ(last.context.substr(last.match_begin, last.match_end - last.match_begin), "build");
+    EXPECT_FALSE(search.truncated());
+}
+
+TEST(GlobalSearchTest, RegexSearchKeepsOriginalCaseInContext) {
+    auto session = make_session(1, "Error: disk full\r\nok\r\nWARNING: low memory\r\nok\r\nok\r\nok\r\n");
+
+    diana::ThreadPool pool(2);
+    diana::GlobalSearch search(pool);
+    diana::GlobalSearchQuery query;
+    query.pattern = "^(error|warning):";
+    query.regex = true;
+    auto results = run(search, query, {session.get()});
+
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_EQ(results[0].hit.line, 0u);
+    EXPECT_EQ(results[0].context, "Error: disk full");
+    EXPECT_EQ(results[0].match_end, 6u);
+    EXPECT_EQ(results[1].hit.line, 2u);
+    EXPECT_EQ(results[1].context, "WARNING: low memory");
+}
+
+TEST(GlobalSearchTest, InvalidRegexReportsError) {
+    auto session = make_session(1, "text\r\n");
+
+    diana::ThreadPool pool(1);
+    diana::GlobalSearch search(pool);
+    diana::GlobalSearchQuery query;
+    query.pattern = "(unclosed";
+    query.regex = true;
+
+    std::string error;
+    EXPECT_FALSE(search.start(query, {session.get()}, error));
+    EXPECT_FALSE(error.empty());
+    EXPECT_FALSE(search.running());
+}
+
+TEST(GlobalSearchTest, StopsAtResultLimit) {
+    auto session = make_session(1, numbered_lines("match", 200));
+
+    diana::ThreadPool pool(2);
+    diana::GlobalSearch search(pool);
+    diana::GlobalSearchQuery query;
+    query.pattern = "match";
+    query.max_results = 50;
+    auto results = run(search, query, {session.get()});
+
+    EXPECT_EQ(results.size(), 50u);
+    EXPECT_TRUE(search.truncated());
+}
+
+TEST(GlobalSearchTest, SearchesWhileSessionKeepsWriting) {
+    auto session = make_session(1, numbered_lines("warmup", 5000));
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+        int i = 0;
+        while (!stop.load()) {
+            session->write_to_terminal("noise " + std::to_string(i++) + "\r\n");
+            std::this_thread::sleep_for(200us);
+        }
+    });
+
+    diana::ThreadPool pool(4);
+    diana::GlobalSearch search(pool);
+    diana::GlobalSearchQuery query;
+    query.pattern = "warmup 4\\d{3}$";
+    query.regex = true;
+    for (int round = 0; round < 5; ++round) {
+        auto results = run(search, query, {session.get()});
+        EXPECT_EQ(results.size(), 1000u);
+    }
+
+    // Restarting cancels the previous search.
+    query.pattern = "warmup";
+    query.regex = false;
+    std::string error;
+    ASSERT_TRUE(search.start(query, {session.get()}, error));
+    search.cancel();
+    EXPECT_FALSE(search.running());
+
+    stop.store(true);
+    writer.join();
+}
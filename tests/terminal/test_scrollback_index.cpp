@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include "terminal/scrollback_index.h"
+#include "terminal/vterminal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<diana::TerminalCell> make_cells(const std::u32string& text) {
+    const int cols = std::max(40, static_cast<int>(text.size()) * 2);
+    std::vector<diana::TerminalCell> cells(static_cast<size_t>(cols));
+    for (auto& cell : cells) {
+        cell.chars[0] = ' ';
+        cell.width = 1;
+    }
+    int col = 0;
+    for (char32_t ch : text) {
+        if (col >= cols) break;
+        bool wide = ch >= 0x1100;
+        cells[static_cast<size_t>(col)].chars[0] = ch;
+        cells[static_cast<size_t>(col)].width = wide ? 2 : 1;
+        if (wide && col + 1 < cols) {
+            cells[static_cast<size_t>(col + 1)].chars[0] = 0xFFFFFFFF;
+            cells[static_cast<size_t>(col + 1)].width = 0;
+        }
+        col += wide ? 2 : 1;
+    }
+    return cells;
+}
+
+std::u32string ascii(const std::string& text) {
+    return std::u32string(text.begin(), text.end());
+}
+
+void push(diana::ScrollbackIndex& index, const std::u32string& text) {
+    auto cells = make_cells(text);
+    diana::LineText line;
+    diana::project_line(cells.data(), static_cast<int>(cells.size()), line);
+    index.push_line(std::move(line));
+}
+
+}
+
+TEST(ScrollbackIndexTest, ProjectsAndTrimsLines) {
+    auto cells = make_cells(ascii("Hello World   "));
+    diana::LineText line;
+    diana::project_line(cells.data(), static_cast<int>(cells.size()), line);
+
+    EXPECT_EQ(line.text, "hello world");
+    EXPECT_TRUE(line.columns.empty());
+}
+
+TEST(ScrollbackIndexTest, FindsCaseInsensitiveMatchesInLineOrder) {
+    diana::ScrollbackIndex index;
+    push(index, ascii("error: missing semicolon"));
+    push(index, ascii("all good"));
+    push(index, ascii("ERROR again, error twice"));
+
+    std::vector<diana::SearchHit> hits;
+    EXPECT_TRUE(index.find("Error", hits));
+
+    ASSERT_EQ(hits.size(), 3u);
+    EXPECT_EQ(hits[0].line, 0u);
+    EXPECT_EQ(hits[0].col, 0);
+    EXPECT_EQ(hits[0].end_col, 5);
+    EXPECT_EQ(hits[1].line, 2u);
+    EXPECT_EQ(hits[2].line, 2u);
+    EXPECT_EQ(hits[2].col, 13);
+}
+
+TEST(ScrollbackIndexTest, ShortNeedlesFallBackToScan) {
+    diana::ScrollbackIndex index;
+    push(index, ascii("ab"));
+    push(index, ascii("xaby"));
+
+    std::vector<diana::SearchHit> hits;
+    index.find("ab", hits);
+    ASSERT_EQ(hits.size(), 2u);
+    EXPECT_EQ(hits[1].col, 1);
+}
+
+TEST(ScrollbackIndexTest, WideGlyphsMapToCellColumns) {
+    diana::ScrollbackIndex index;
+    push(index, U"中文 file.cpp");
+
+    std::vector<diana::SearchHit> hits;
+    index.find("file", hits);
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].col, 5);
+    EXPECT_EQ(hits[0].end_col, 9);
+
+    hits.clear();
+    index.find("\xE6\x96\x87", hits);
+    ASSERT_EQ(hits.size(), 1u);
+    EXPECT_EQ(hits[0].col, 2);
+    EXPECT_EQ(hits[0].end_col, 4);
+}
+
+TEST(ScrollbackIndexTest, PopAndEvictKeepNumbering) {
+    diana::ScrollbackIndex index;
+    for (int i = 0; i < 3000; ++i) {
+        push(index, ascii("line " + std::to_string(i)));
+    }
+    for (int i = 0; i < 2500; ++i) {
+        index.evict_front();
+    }
+    index.pop_line();
+
+    EXPECT_EQ(index.first_line(), 2500u);
+    EXPECT_EQ(index.end_line(), 2999u);
+
+    std::vector<diana::SearchHit> hits;
+    index.find("line 2", hits);
+    ASSERT_FALSE(hits.empty());
+    EXPECT_EQ(hits.front().line, 2500u);
+    EXPECT_EQ(hits.back().line, 2998u);
+
+    hits.clear();
+    index.find("line 2999", hits);
+    EXPECT_TRUE(hits.empty());
+
+    hits.clear();
+    index.find("line 12", hits);
+    EXPECT_TRUE(hits.empty());
+}
+
+TEST(ScrollbackIndexTest, StopsAtMaxHits) {
+    diana::ScrollbackIndex index;
+    for (int i = 0; i < 100; ++i) {
+        push(index, ascii("same text"));
+    }
+    std::vector<diana::SearchHit> hits;
+    EXPECT_FALSE(index.find("text", hits, 10));
+    EXPECT_EQ(hits.size(), 10u);
+}
+
+TEST(ScrollbackIndexTest, FindLastKeepsNewestHits) {
+    diana::ScrollbackIndex index;
+    for (int i = 0; i < 100; ++i) {
+        push(index, ascii("text " + std::to_string(i) + " text"));
+    }
+    std::vector<diana::SearchHit> hits;
+    EXPECT_FALSE(index.find_last("text", 90, hits, 5));
+    ASSERT_EQ(hits.size(), 5u);
+    EXPECT_EQ(hits[0].line, 87u);
+    EXPECT_GT(hits[0].col, 0);
+    EXPECT_EQ(hits[1].line, 88u);
+    EXPECT_EQ(hits[4].line, 89u);
+    EXPECT_GT(hits[4].col, hits[3].col);
+
+    hits.clear();
+    EXPECT_TRUE(index.find_last("text 1", 100, hits, 1000));
+    std::vector<diana::SearchHit> forward;
+    EXPECT_TRUE(index.find("text 1", forward));
+    ASSERT_EQ(hits.size(), forward.size());
+    for (size_t i = 0; i < hits.size(); ++i) {
+        EXPECT_EQ(hits[i].line, forward[i].line);
+        EXPECT_EQ(hits[i].col, forward[i].col);
+    }
+
+    hits.clear();
+    EXPECT_FALSE(index.find_last("t", 100, hits, 3));
+    ASSERT_EQ(hits.size(), 3u);
+    EXPECT_EQ(hits.back().line, 99u);
+}
+
+TEST(ScrollbackIndexTest, VTerminalIndexesScrolledLines) {
+    diana::VTerminal terminal(4, 40);
+    std::string data;
+    for (int i = 0; i < 20; ++i) {
+        data += "output " + std::to_string(i) + "\r\n";
+    }
+    data += "Build FAILED\r\n";
+    terminal.write(data.data(), data.size());
+
+    auto lock = terminal.lock_scrollback();
+    const auto& index = terminal.scrollback_index();
+    EXPECT_EQ(index.size(), terminal.scrollback_size());
+
+    // Lines 0-17 have scrolled off; the last four are still on screen.
+    std::vector<diana::SearchHit> hits;
+    index.find("output 1", hits);
+    EXPECT_EQ(hits.size(), 9u);
+    EXPECT_EQ(hits.back().line, 17u);
+
+    hits.clear();
+    index.find("failed", hits);
+    EXPECT_TRUE(hits.empty());
+}
+
+TEST(ScrollbackIndexTest, QueryLatencyOn100kLines) {
+    diana::ScrollbackIndex index;
+    const char* words[] = {"compiling", "src/terminal/vterminal.cpp", "warning", "Running", "tests",
+                           "cargo", "build", "finished", "release", "target", "agent"};
+    for (int i = 0; i < 100000; ++i) {
+        std::string text;
+        for (int w = 0; w < 8; ++w) {
+            text += words[(i * 7 + w * 3) % 11];
+            text += ' ';
+        }
+        text += std::to_string(i);
+        push(index, ascii(text));
+    }
+
+    auto time_query = [&index](const std::string& needle, size_t max_hits) {
+        std::vector<diana::SearchHit> hits;
+        auto start = std::chrono::steady_clock::now();
+        index.find(needle, hits, max_hits);
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        return std::make_pair(std::chrono::duration<double, std::milli>(elapsed).count(), hits.size());
+    };
+
+    std::string rare_needle = index.line(42424).text;
+    rare_needle = rare_needle.substr(rare_needle.size() - 16);
+    auto rare = time_query(rare_needle, 10000);
+    auto common = time_query("vterminal", 10000);
+    std::printf("[ search   ] 100k lines: rare %.3f ms (%zu hits), common %.3f ms (%zu hits)\n",
+                rare.first, rare.second, common.first, common.second);
+
+    EXPECT_GE(rare.second, 1u);
+    EXPECT_EQ(common.second, 10000u);
+    EXPECT_LT(rare.first, 5.0);
+}
@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include "process/session_recorder.h"
+#include "terminal/session_replayer.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+using namespace std::chrono_literals;
+
+class SessionRecordingTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / "diana_recording_test";
+        fs::create_directories(test_dir_);
+    }
+    
+    void TearDown() override {
+        fs::remove_all(test_dir_);
+    }
+    
+    std::string path(const char* name) const { return (test_dir_ / name).string(); }
+    
+    static std::string row_text(const diana::ScreenSnapshot& snapshot, int row) {
+        std::string text;
+        for (int col = 0; col < snapshot.cols; ++col) {
+            uint32_t ch = snapshot.cell(row, col).chars[0];
+            text.push_back(ch >= 0x20 && ch < 0x7F ? static_cast<char>(ch) : ' ');
+        }
+        while (!text.empty() && text.back() == ' ') {
+            text.pop_back();
+        }
+        return text;
+    }
+    
+    fs::path test_dir_;
+};
+
+TEST_F(SessionRecordingTest, FramesRoundTrip) {
+    {
+        diana::SessionRecorder recorder;
+        ASSERT_TRUE(recorder.open(path("a.dianarec"), 24, 80));
+        recorder.record_output("hello ", 6);
+        std::this_thread::sleep_for(5ms);
+        recorder.record_resize(30, 100);
+        recorder.record_output("world", 5);
+        EXPECT_EQ(recorder.bytes_recorded(), 11u);
+        // Nothing has hit the disk yet.
+        EXPECT_EQ(recorder.writes(), 0u);
+    }
+    
+    auto recording = diana::Recording::load(path("a.dianarec"));
+    ASSERT_TRUE(recording.has_value());
+    EXPECT_EQ(recording->rows, 24);
+    EXPECT_EQ(recording->cols, 80);
+    EXPECT_FALSE(recording->truncated);
+    ASSERT_EQ(recording->frames.size(), 3u);
+    EXPECT_EQ(recording->data(recording->frames[0]), "hello ");
+    EXPECT_EQ(recording->data(recording->frames[2]), "world");
+    EXPECT_GE(recording->frames[1].time_us, 5000u);
+    EXPECT_LE(recording->frames[1].time_us, recording->frames[2].time_us);
+    
+    int rows = 0, cols = 0;
+    ASSERT_TRUE(recording->resize_of(recording->frames[1], rows, cols));
+    EXPECT_EQ(rows, 30);
+    EXPECT_EQ(cols, 100);
+    EXPECT_EQ(recording->output_bytes(), 11u);
+}
+
+TEST_F(SessionRecordingTest, BuffersWritesUntilFull) {
+    diana::SessionRecorder recorder;
+    ASSERT_TRUE(recorder.open(path("big.dianarec"), 24, 80));
+    std::string chunk(1000, 'x');
+    for (int i = 0; i < 2000; ++i) {
+        recorder.record_output(chunk.data(), chunk.size());
+    }
+    recorder.close();
+    
+    // ~2 MB in 256 KB writes rather than one per frame.
+    EXPECT_LE(recorder.writes(), 10u);
+    auto recording = diana::Recording::load(path("big.dianarec"));
+    ASSERT_TRUE(recording.has_value());
+    EXPECT_EQ(recording->frames.size(), 2000u);
+    EXPECT_EQ(recording->output_bytes(), 2000u * 1000u);
+}
+
+TEST_F(SessionRecordingTest, TruncatedTailIsDropped) {
+    {
+        diana::SessionRecorder recorder;
+        ASSERT_TRUE(recorder.open(path("cut.dianarec"), 24, 80));
+        recorder.record_output("first", 5);
+        recorder.record_output("second", 6);
+    }
+    fs::resize_file(path("cut.dianarec"), fs::file_size(path("cut.dianarec")) - 2);
+    
+    auto recording = diana::Recording::load(path("cut.dianarec"));
+    ASSERT_TRUE(recording.has_value());
+    EXPECT_TRUE(recording->truncated);
+    ASSERT_EQ(recording->frames.size(), 1u);
+    EXPECT_EQ(recording->data(recording->frames[0]), "first");
+    
+    std::ofstream(path("junk.dianarec")) << "not a recording";
+    std::string error;
+    EXPECT_FALSE(diana::Recording::load(path("junk.dianarec"), &error).has_value());
+    EXPECT_FALSE(error.empty());
+}
+
+TEST_F(SessionRecordingTest, ExportsAsciicastWithWholeCharacters) {
+    {
+        diana::SessionRecorder recorder;
+        ASSERT_TRUE(recorder.open(path("utf8.dianarec"), 10, 40));
+        // U+4E2D split across two reads.
+        recorder.record_output("a\xE4\xB8", 3);
+        recorder.record_output("\xAD\x1b[0m\r\n", 7);
+        recorder.record_resize(12, 50);
+    }
+    auto recording = diana::Recording::load(path("utf8.dianarec"));
+    ASSERT_TRUE(recording.has_value());
+    ASSERT_TRUE(recording->export_asciicast(path("out.cast")));
+    
+    std::ifstream in(path("out.cast"));
+    std::vector<std::string> lines;
+    for (std::string line; std::getline(in, line);) {
+        lines.push_back(line);
+    }
+    ASSERT_EQ(lines.size(), 4u);
+    EXPECT_NE(lines[0].find("\"version\":2"), std::string::npos);
+    EXPECT_NE(lines[0].find("\"width\":40"), std::string::npos);
+    EXPECT_NE(lines[0].find("\"height\":10"), std::string::npos);
+    EXPECT_NE(lines[1].find("\"o\",\"a\"]"), std::string::npos);
+    EXPECT_NE(lines[2].find("\"o\",\"\xE4\xB8\xAD\\u001b[0m\\r\\n\"]"), std::string::npos);
+    EXPECT_NE(lines[3].find("\"r\",\"50x12\"]"), std::string::npos);
+}
+
+TEST_F(SessionRecordingTest, ReplaysIntoSessionAtMaxSpeed) {
+    {
+        diana::SessionRecorder recorder;
+        ASSERT_TRUE(recorder.open(path("replay.dianarec"), 4, 20));
+        for (int i = 0; i < 10; ++i) {
+            std::string line = "line " + std::to_string(i) + "\r\n";
+            recorder.record_output(line.data(), line.size());
+        }
+    }
+    auto recording = diana::Recording::load(path("replay.dianarec"));
+    ASSERT_TRUE(recording.has_value());
+    
+    diana::TerminalSession session(1);
+    session.resize_terminal(4, 20);
+    diana::SessionReplayer replayer;
+    diana::ReplayOptions options;
+    options.speed = diana::ReplayOptions::MAX_SPEED;
+    replayer.start(session, std::make_shared<diana::Recording>(std::move(*recording)), options);
+    replayer.wait();
+    
+    EXPECT_FALSE(replayer.running());
+    EXPECT_EQ(replayer.progress(), 1.0);
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+    EXPECT_EQ(row_text(session.snapshot(), 0), "line 7");
+    EXPECT_EQ(row_text(session.snapshot(), 2), "line 9");
+    EXPECT_EQ(session.snapshot().scrollback_size, 7u);
+}
+
+TEST_F(SessionRecordingTest, ReplayKeepsRecordedTiming) {
+    {
+        diana::SessionRecorder recorder;
+        ASSERT_TRUE(recorder.open(path("timed.dianarec"), 24, 80));
+        recorder.record_output("a", 1);
+        std::this_thread::sleep_for(200ms);
+        recorder.record_output("b", 1);
+    }
+    auto loaded = diana::Recording::load(path("timed.dianarec"));
+    ASSERT_TRUE(loaded.has_value());
+    auto recording = std::make_shared<diana::Recording>(std::move(*loaded));
+    
+    diana::TerminalSession session(1);
+    diana::SessionReplayer replayer;
+    diana::ReplayOptions options;
+    
+    auto start = std::chrono::steady_clock::now();
+    options.speed = 4.0;
+    replayer.start(session, recording, options);
+    replayer.wait();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_GE(elapsed, 45ms);
+    EXPECT_LT(elapsed, 190ms);
+    
+    // Stopping interrupts a pending wait.
+    options.speed = 0.01;
+    start = std::chrono::steady_clock::now();
+    replayer.start(session, recording, options);
+    std::this_thread::sleep_for(20ms);
+    replayer.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+    EXPECT_FALSE(replayer.running());
+    EXPECT_LT(replayer.progress(), 1.0);
+}
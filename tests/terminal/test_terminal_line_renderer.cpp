@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+#include "terminal/terminal_line_renderer.h"
+#include <imgui.h>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using diana::TerminalCell;
+
+namespace {
+
+constexpr int SCREEN_ROWS = 60;
+constexpr int SCREEN_COLS = 200;
+constexpr uint32_t DEFAULT_FG = 0xFFD4D4D4;
+constexpr uint32_t DEFAULT_BG = 0xFF211D1A;
+
+struct DrawCounts {
+    int vertices = 0;
+    int indices = 0;
+};
+
+class TerminalLineRendererTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ImGui::CreateContext();
+        ImGuiIO& io = ImGui::GetIO();
+        io.DisplaySize = ImVec2(1920.0f, 1080.0f);
+        io.DeltaTime = 1.0f / 60.0f;
+        io.IniFilename = nullptr;
+#if IMGUI_VERSION_NUM >= 19200
+        io.BackendFlags |= ImGuiBackendFlags_RendererHasTextures;
+#else
+        unsigned char* pixels = nullptr;
+        int width = 0;
+        int height = 0;
+        io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+#endif
+        ImGui::NewFrame();
+        ImGui::SetNextWindowPos(ImVec2(0, 0));
+        ImGui::SetNextWindowSize(io.DisplaySize);
+        ImGui::Begin("RendererTest");
+        draw_list_ = ImGui::GetWindowDrawList();
+        char_w_ = ImGui::CalcTextSize("W").x;
+        line_height_ = ImGui::GetTextLineHeight();
+    }
+
+    void TearDown() override {
+        ImGui::End();
+        ImGui::EndFrame();
+        ImGui::DestroyContext();
+    }
+
+    static TerminalCell make_cell(uint32_t ch, uint32_t fg = DEFAULT_FG, uint32_t bg = DEFAULT_BG) {
+        TerminalCell cell{};
+        cell.chars[0] = ch;
+        cell.width = 1;
+        cell.fg = fg;
+        cell.bg = bg;
+        return cell;
+    }
+
+    // Agent-like output: prose, a coloured status word, a highlighted diff line.
+    static std::vector<TerminalCell> make_row(int row) {
+        std::vector<TerminalCell> cells(SCREEN_COLS, make_cell(' '));
+        const char* text = "src/terminal/terminal_panel.cpp:1004 render_terminal_line issues one AddText per cell";
+        size_t len = std::strlen(text);
+        for (int c = 0; c < SCREEN_COLS; ++c) {
+            cells[c] = make_cell(static_cast<unsigned char>(text[(c + row) % len]));
+        }
+        for (int c = 10; c < 18; ++c) {
+            cells[c].fg = 0xFF00FF00;
+        }
+        if (row % 3 == 0) {
+            for (int c = 40; c < 160; ++c) {
+                cells[c].bg = 0xFF204020;
+            }
+        }
+        return cells;
+    }
+
+    DrawCounts measure(const std::function<void(const TerminalCell*, int, ImVec2)>& draw_row) {
+        int vtx_before = draw_list_->VtxBuffer.Size;
+        int idx_before = draw_list_->IdxBuffer.Size;
+        for (int row = 0; row < SCREEN_ROWS; ++row) {
+            auto cells = make_row(row);
+            draw_row(cells.data(), SCREEN_COLS, ImVec2(0.0f, row * line_height_));
+        }
+        return {draw_list_->VtxBuffer.Size - vtx_before, draw_list_->IdxBuffer.Size - idx_before};
+    }
+
+    // Mirrors the previous renderer: one rect and one AddText per cell.
+    void draw_per_cell(const TerminalCell* cells, int count, ImVec2 origin) {
+        for (int i = 0; i < count; ++i) {
+            if (cells[i].width == 0) continue;
+            if (diana::terminal_bg_is_custom(cells[i].bg, DEFAULT_BG)) {
+                draw_list_->AddRectFilled(ImVec2(origin.x + i * char_w_, origin.y),
+                                          ImVec2(origin.x + (i + 1) * char_w_, origin.y + line_height_), cells[i].bg);
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            uint32_t ch = cells[i].chars[0];
+            if (cells[i].width == 0 || ch == 0 || ch == ' ') continue;
+            char buf[2] = {static_cast<char>(ch), '\0'};
+            draw_list_->AddText(ImVec2(origin.x + i * char_w_, origin.y), cells[i].fg, buf);
+        }
+    }
+
+    ImDrawList* draw_list_ = nullptr;
+    float char_w_ = 0.0f;
+    float line_height_ = 0.0f;
+};
+
+}
+
+TEST_F(TerminalLineRendererTest, MergesRunsOfEqualColour) {
+    std::vector<TerminalCell> cells(12, make_cell(' '));
+    const char* word = "hello world";
+    for (int i = 0; i < 11; ++i) {
+        cells[i] = make_cell(static_cast<unsigned char>(word[i]), DEFAULT_FG, 0xFF204020);
+    }
+
+    diana::TerminalLineRenderer renderer;
+    diana::TerminalLineStyle style;
+    style.default_bg = DEFAULT_BG;
+    auto stats = renderer.draw(draw_list_, ImVec2(0, 0), char_w_, line_height_,
+                               cells.data(), static_cast<int>(cells.size()), -1, -1, style);
+
+    EXPECT_EQ(stats.text_runs, 1);
+    EXPECT_EQ(stats.background_rects, 1);
+}
+
+TEST_F(TerminalLineRendererTest, SplitsRunsOnColourChange) {
+    std::vector<TerminalCell> cells;
+    cells.push_back(make_cell('a'));
+    cells.push_back(make_cell('b', 0xFF0000FF));
+    cells.push_back(make_cell(' '));
+    cells.push_back(make_cell('c', 0xFF0000FF));
+
+    diana::TerminalLineRenderer renderer;
+    diana::TerminalLineStyle style;
+    style.default_bg = DEFAULT_BG;
+    auto stats = renderer.draw(draw_list_, ImVec2(0, 0), char_w_, line_height_,
+                               cells.data(), static_cast<int>(cells.size()), 0, 4, style);
+
+    EXPECT_EQ(stats.text_runs, 2);
+    EXPECT_EQ(stats.background_rects, 1);
+}
+
+TEST_F(TerminalLineRendererTest, WideGlyphsAreDrawnPerCell) {
+    std::vector<TerminalCell> cells;
+    cells.push_back(make_cell('a'));
+    TerminalCell wide = make_cell(0x4E2D);
+    wide.width = 2;
+    cells.push_back(wide);
+    TerminalCell continuation = make_cell(0xFFFFFFFF);
+    cells.push_back(continuation);
+    cells.push_back(make_cell('b'));
+
+    diana::TerminalLineRenderer renderer;
+    diana::TerminalLineStyle style;
+    style.default_bg = DEFAULT_BG;
+    auto stats = renderer.draw(draw_list_, ImVec2(0, 0), char_w_, line_height_,
+                               cells.data(), static_cast<int>(cells.size()), -1, -1, style);
+
+    EXPECT_EQ(stats.text_runs, 3);
+}
+
+TEST_F(TerminalLineRendererTest, FullScreenDrawListSize) {
+    DrawCounts before = measure([this](const TerminalCell* cells, int count, ImVec2 origin) {
+        draw_per_cell(cells, count, origin);
+    });
+
+    diana::TerminalLineRenderer renderer;
+    diana::TerminalLineStyle style;
+    style.default_bg = DEFAULT_BG;
+    DrawCounts after = measure([&](const TerminalCell* cells, int count, ImVec2 origin) {
+        renderer.draw(draw_list_, origin, char_w_, line_height_, cells, count, -1, -1, style);
+    });
+
+    std::printf("[ render   ] %dx%d frame per-cell: %d vertices, %d indices\n",
+                SCREEN_COLS, SCREEN_ROWS, before.vertices, before.indices);
+    std::printf("[ render   ] %dx%d frame batched:  %d vertices, %d indices\n",
+                SCREEN_COLS, SCREEN_ROWS, after.vertices, after.indices);
+    RecordProperty("per_cell_vertices", before.vertices);
+    RecordProperty("batched_vertices", after.vertices);
+
+    EXPECT_LT(after.vertices, before.vertices);
+    EXPECT_LT(after.indices, before.indices);
+}
@@ -0,0 +1,316 @@
+#include <gtest/gtest.h>
+#include "terminal/terminal_session.h"
+#include "test_helpers.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+using diana::test::eventually;
+
+namespace {
+
+std::string row_text(const diana::ScreenSnapshot& snapshot, int row) {
+    std::string text;
+    for (int col = 0; col < snapshot.cols; ++col) {
+        uint32_t ch = snapshot.cell(row, col).chars[0];
+        text.push_back(ch >= 0x20 && ch < 0x7F ? static_cast<char>(ch) : ' ');
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+}
+
+TEST(TerminalSessionTest, InitialSnapshotIsBlank) {
+    diana::TerminalSession session(1);
+    const auto& snapshot = session.snapshot();
+
+    EXPECT_EQ(snapshot.rows, 24);
+    EXPECT_EQ(snapshot.cols, 80);
+    EXPECT_EQ(snapshot.cells.size(), 24u * 80u);
+    EXPECT_EQ(row_text(snapshot, 0), "");
+}
+
+TEST(TerminalSessionTest, OutputIsParsedOffThread) {
+    diana::TerminalSession session(1);
+    session.write_to_terminal(std::string("hello\r\nworld"));
+
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    EXPECT_TRUE(session.refresh_snapshot());
+
+    const auto& snapshot = session.snapshot();
+    EXPECT_EQ(row_text(snapshot, 0), "hello");
+    EXPECT_EQ(row_text(snapshot, 1), "world");
+    EXPECT_EQ(snapshot.cursor.row, 1);
+    EXPECT_EQ(snapshot.cursor.col, 5);
+
+    EXPECT_FALSE(session.refresh_snapshot());
+}
+
+TEST(TerminalSessionTest, SnapshotTracksScrollback) {
+    diana::TerminalSession session(1);
+    session.resize_terminal(4, 20);
+
+    std::string data;
+    for (int i = 0; i < 10; ++i) {
+        data += "line " + std::to_string(i) + "\r\n";
+    }
+    session.write_to_terminal(data);
+
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+
+    const auto& snapshot = session.snapshot();
+    EXPECT_EQ(snapshot.rows, 4);
+    EXPECT_EQ(snapshot.cols, 20);
+    EXPECT_EQ(snapshot.scrollback_size, 7u);
+    EXPECT_EQ(row_text(snapshot, 0), "line 7");
+
+    auto lock = session.terminal().lock_scrollback();
+    EXPECT_EQ(session.terminal().scrollback_size(), snapshot.scrollback_size);
+}
+
+TEST(TerminalSessionTest, CursorPositionRequestIsAnsweredInStreamOrder) {
+    diana::TerminalSession session(1);
+
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    session.set_reply_callback([&](const std::string& reply) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.push_back(reply);
+    });
+
+    // The request is split across two writes and followed by more output.
+    session.write_to_terminal(std::string("abc\x1b["));
+    session.write_to_terminal(std::string("6nxyz"));
+
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(replies.size(), 1u);
+    EXPECT_EQ(replies[0], "\x1b[1;4R");
+    EXPECT_EQ(row_text(session.snapshot(), 0), "abcxyz");
+}
+
+TEST(TerminalSessionTest, KeyboardEncodingUnderLock) {
+    diana::TerminalSession session(1);
+    session.write_to_terminal(std::string("\x1b[?2004h"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+
+    auto lock = session.lock_terminal();
+    session.terminal().keyboard_start_paste();
+    session.terminal().keyboard_unichar('x');
+    session.terminal().keyboard_end_paste();
+    EXPECT_EQ(session.terminal().get_output(), "\x1b[200~x\x1b[201~");
+}
+
+TEST(TerminalSessionTest, RingOutputKeepsOrderWithStatusMessages) {
+    diana::TerminalSession session(1);
+    auto ring = session.output_ring();
+
+    auto push = [&ring](const std::string& text) {
+        auto span = ring->write_span();
+        ASSERT_GE(span.size, text.size());
+        std::memcpy(span.data, text.data(), text.size());
+        ring->commit_write(text.size());
+    };
+
+    session.write_to_terminal(std::string("[start] "));
+    push("output ");
+    session.write_to_terminal(std::string("[exit]"));
+
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+
+    EXPECT_EQ(row_text(session.snapshot(), 0), "[start] output [exit]");
+    EXPECT_TRUE(ring->empty());
+}
+
+TEST(TerminalSessionTest, LargeOutputIsParsedInSlices) {
+    diana::TerminalSession session(1);
+    diana::IngestBudget budget;
+    budget.foreground_slice_us = 1;
+    budget.chunk_bytes = 256;
+    session.set_ingest_budget(budget);
+    session.set_foreground(true);
+
+    std::string data;
+    for (int i = 0; i < 2000; ++i) {
+        data += "line " + std::to_string(i) + "\r\n";
+    }
+    session.write_to_terminal(std::string("begin\r\n"));
+    auto ring = session.output_ring();
+    size_t offset = 0;
+    while (offset < data.size()) {
+        auto span = ring->write_span();
+        size_t n = std::min(span.size, data.size() - offset);
+        std::memcpy(span.data, data.data() + offset, n);
+        ring->commit_write(n);
+        offset += n;
+    }
+
+    ASSERT_TRUE(session.wait_until_parsed(5s));
+    session.refresh_snapshot();
+
+    auto stats = session.ingest_stats();
+    EXPECT_EQ(stats.pending_bytes, 0u);
+    EXPECT_EQ(stats.parse_lag_ms, 0.0);
+    EXPECT_EQ(stats.bytes_parsed, data.size() + 7);
+    EXPECT_GT(stats.slices, 10u);
+    EXPECT_EQ(row_text(session.snapshot(), 22), "line 1999");
+}
+
+TEST(TerminalSessionTest, SynchronizedUpdateKeepsLastCompleteFrame) {
+    diana::TerminalSession session(1);
+    session.write_to_terminal(std::string("frame 1"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+
+    session.write_to_terminal(std::string("\x1b[?2026h\r\x1b[2Kframe"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+    EXPECT_EQ(row_text(session.snapshot(), 0), "frame 1");
+    {
+        auto lock = session.lock_terminal();
+        EXPECT_TRUE(session.terminal().update_in_progress());
+    }
+
+    session.write_to_terminal(std::string(" 2\x1b[?2026l"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    EXPECT_TRUE(session.refresh_snapshot());
+    EXPECT_EQ(row_text(session.snapshot(), 0), "frame 2");
+    EXPECT_GT(session.ingest_stats().held_snapshots, 0u);
+}
+
+TEST(TerminalSessionTest, SynchronizedUpdateStartPublishesPrecedingOutput) {
+    diana::TerminalSession session(1);
+    // One buffer: a complete frame, then a batch that is still open.
+    session.write_to_terminal(std::string("ready\x1b[?2026h\r\x1b[2Kpartial"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+    EXPECT_EQ(row_text(session.snapshot(), 0), "ready");
+}
+
+TEST(TerminalSessionTest, UnfinishedSynchronizedUpdateTimesOut) {
+    diana::TerminalSession session(1);
+    diana::IngestBudget budget;
+    budget.sync_update_timeout_ms = 20;
+    session.set_ingest_budget(budget);
+
+    session.write_to_terminal(std::string("\x1b[?2026hstuck"));
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+
+    auto give_up = std::chrono::steady_clock::now() + 2s;
+    std::string text;
+    while (std::chrono::steady_clock::now() < give_up) {
+        session.refresh_snapshot();
+        text = row_text(session.snapshot(), 0);
+        if (text == "stuck") break;
+        std::this_thread::sleep_for(5ms);
+    }
+    EXPECT_EQ(text, "stuck");
+}
+
+namespace {
+
+void push_output(diana::ByteRing& ring, const std::string& text) {
+    auto span = ring.write_span();
+    ASSERT_GE(span.size, text.size());
+    std::memcpy(span.data, text.data(), text.size());
+    ring.commit_write(text.size());
+}
+
+diana::IngestBudget long_deferral() {
+    diana::IngestBudget budget;
+    budget.background_defer_ms = 60000;
+    budget.background_batch_bytes = 4096;
+    return budget;
+}
+
+}
+
+TEST(TerminalSessionTest, BackgroundOutputIsParsedInBatches) {
+    diana::TerminalSession session(1);
+    session.set_ingest_budget(long_deferral());
+    auto ring = session.output_ring();
+
+    push_output(*ring, "small");
+    std::this_thread::sleep_for(30ms);
+    EXPECT_EQ(session.ingest_stats().bytes_parsed, 0u);
+
+    push_output(*ring, std::string(4096, 'x'));
+    EXPECT_TRUE(eventually([&] { return session.ingest_stats().bytes_parsed == 4101u; }));
+    EXPECT_TRUE(session.refresh_snapshot());
+    EXPECT_EQ(session.snapshot().cursor.col, 4101 % 80);
+}
+
+TEST(TerminalSessionTest, BackgroundCursorRequestIsAnsweredPromptly) {
+    diana::TerminalSession session(1);
+    session.set_ingest_budget(long_deferral());
+    auto ring = session.output_ring();
+
+    std::mutex mutex;
+    std::vector<std::string> replies;
+    session.set_reply_callback([&](const std::string& reply) {
+        std::lock_guard<std::mutex> lock(mutex);
+        replies.push_back(reply);
+    });
+
+    push_output(*ring, "ab\x1b[");
+    std::this_thread::sleep_for(10ms);
+    push_output(*ring, "6n");
+    EXPECT_TRUE(eventually([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        return !replies.empty();
+    }));
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(replies.size(), 1u);
+    EXPECT_EQ(replies[0], "\x1b[1;3R");
+}
+
+TEST(TerminalSessionTest, SynchronizedUpdateStartSplitAcrossReads) {
+    diana::TerminalSession session(1);
+    diana::IngestBudget budget;
+    budget.chunk_bytes = 8;
+    session.set_ingest_budget(budget);
+    session.set_foreground(true);
+
+    // Read in chunks of 8, the update start straddles the first two.
+    push_output(*session.output_ring(), "ready\x1b[?2026h\r\x1b[2Kpartial");
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    session.refresh_snapshot();
+    EXPECT_EQ(row_text(session.snapshot(), 0), "ready");
+}
+
+TEST(TerminalSessionTest, BecomingForegroundFinishesDeferredBatch) {
+    diana::TerminalSession session(1);
+    session.set_ingest_budget(long_deferral());
+    push_output(*session.output_ring(), "hidden");
+    std::this_thread::sleep_for(10ms);
+    EXPECT_EQ(session.ingest_stats().bytes_parsed, 0u);
+
+    session.set_foreground(true);
+    EXPECT_TRUE(eventually([&] { return session.ingest_stats().bytes_parsed == 6u; }));
+    EXPECT_TRUE(eventually([&] { return session.refresh_snapshot(); }));
+    EXPECT_EQ(row_text(session.snapshot(), 0), "hidden");
+}
+
+TEST(TerminalSessionTest, WaitUntilParsedDoesNotWaitForBatch) {
+    diana::TerminalSession session(1);
+    session.set_ingest_budget(long_deferral());
+    push_output(*session.output_ring(), "flushed");
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(session.wait_until_parsed(2s));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 1s);
+    session.refresh_snapshot();
+    EXPECT_EQ(row_text(session.snapshot(), 0), "flushed");
+}
@@ -0,0 +1,163 @@
+#include <gtest/gtest.h>
+#include "terminal/terminal_snapshot_file.h"
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+class TerminalSnapshotFileTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        test_dir_ = fs::temp_directory_path() / "diana_snapshot_test";
+        fs::create_directories(test_dir_);
+    }
+
+    void TearDown() override {
+        fs::remove_all(test_dir_);
+    }
+
+    std::string path(const char* name) const { return (test_dir_ / name).string(); }
+
+    static void write(diana::VTerminal& term, const std::string& data) {
+        term.write(data.data(), data.size());
+    }
+
+    static void expect_same_cells(const diana::TerminalCell* a, const diana::TerminalCell* b, int count) {
+        for (int col = 0; col < count; ++col) {
+            SCOPED_TRACE(col);
+            EXPECT_EQ(a[col].chars[0] == ' ' ? 0u : a[col].chars[0], b[col].chars[0] == ' ' ? 0u : b[col].chars[0]);
+            EXPECT_EQ(a[col].chars[1], b[col].chars[1]);
+            EXPECT_EQ(a[col].fg, b[col].fg);
+            EXPECT_EQ(a[col].bg, b[col].bg);
+            EXPECT_EQ(a[col].bold, b[col].bold);
+            EXPECT_EQ(a[col].reverse, b[col].reverse);
+        }
+    }
+
+    fs::path test_dir_;
+};
+
+namespace {
+
+const char* SAMPLE =
+    "plain line\r\n"
+    "\x1b[1;31mred bold\x1b[0m and \x1b[7mreverse\x1b[0m\r\n"
+    "wide \xE4\xB8\xAD\xE6\x96\x87 e\xCC\x81\r\n"
+    "\x1b[44m   \x1b[0m blue cells\r\n"
+    "last line\r\n"
+    "screen \x1b[32mgreen";
+
+}
+
+TEST_F(TerminalSnapshotFileTest, RoundTripsScrollbackAndScreen) {
+    diana::VTerminal term(3, 20);
+    write(term, SAMPLE);
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+    ASSERT_EQ(term.scrollback_size(), 3u);
+
+    {
+        auto lock = term.lock_scrollback();
+        std::string error;
+        ASSERT_TRUE(diana::save_terminal(path("a.dsnap"), term, snapshot, &error)) << error;
+    }
+    std::string error;
+    auto saved = diana::SavedTerminal::load(path("a.dsnap"), &error);
+    ASSERT_TRUE(saved) << error;
+
+    ASSERT_EQ(saved->scrollback.size(), 3u);
+    for (size_t i = 0; i < saved->scrollback.size(); ++i) {
+        SCOPED_TRACE(i);
+        ASSERT_EQ(saved->scrollback[i].size(), term.scrollback()[i].size());
+        expect_same_cells(saved->scrollback[i].data(), term.scrollback()[i].data(), 20);
+    }
+    ASSERT_EQ(saved->screen.rows, 3);
+    ASSERT_EQ(saved->screen.cols, 20);
+    for (int row = 0; row < 3; ++row) {
+        SCOPED_TRACE(row);
+        expect_same_cells(saved->screen.row(row), snapshot.row(row), 20);
+    }
+    EXPECT_EQ(saved->screen.cursor.row, snapshot.cursor.row);
+    EXPECT_EQ(saved->screen.cursor.col, snapshot.cursor.col);
+}
+
+TEST_F(TerminalSnapshotFileTest, EncodeInChunksMatchesSave) {
+    diana::VTerminal term(3, 20);
+    for (int i = 0; i < 2000; ++i) {
+        write(term, "line " + std::to_string(i) + "\r\n");
+    }
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+    {
+        auto lock = term.lock_scrollback();
+        ASSERT_TRUE(diana::save_terminal(path("whole.dsnap"), term, snapshot));
+    }
+    std::string data = diana::encode_terminal(term, snapshot);
+    std::string error;
+    ASSERT_TRUE(diana::write_terminal_file(path("chunked.dsnap"), data, &error)) << error;
+
+    std::ifstream whole(path("whole.dsnap"), std::ios::binary);
+    std::string expected((std::istreambuf_iterator<char>(whole)), std::istreambuf_iterator<char>());
+    EXPECT_TRUE(data == expected);
+    auto saved = diana::SavedTerminal::load(path("chunked.dsnap"));
+    ASSERT_TRUE(saved);
+    EXPECT_EQ(saved->scrollback.size(), term.scrollback_size());
+}
+
+TEST_F(TerminalSnapshotFileTest, RestoreRebuildsTerminal) {
+    diana::VTerminal term(3, 20);
+    write(term, SAMPLE);
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+    {
+        auto lock = term.lock_scrollback();
+        ASSERT_TRUE(diana::save_terminal(path("b.dsnap"), term, snapshot));
+    }
+    auto saved = diana::SavedTerminal::load(path("b.dsnap"));
+    ASSERT_TRUE(saved);
+
+    diana::VTerminal restored(24, 80);
+    restored.restore(std::move(saved->scrollback), saved->screen);
+    diana::ScreenSnapshot after;
+    restored.snapshot_screen(after);
+
+    EXPECT_EQ(after.rows, 3);
+    EXPECT_EQ(after.cols, 20);
+    EXPECT_EQ(restored.scrollback_size(), 3u);
+    EXPECT_EQ(restored.scrollback_index().size(), 3u);
+    for (int row = 0; row < 3; ++row) {
+        SCOPED_TRACE(row);
+        expect_same_cells(after.row(row), snapshot.row(row), 20);
+    }
+    EXPECT_EQ(after.cursor.row, snapshot.cursor.row);
+    EXPECT_EQ(after.cursor.col, snapshot.cursor.col);
+
+    // Output after the restore carries on where the saved session stopped.
+    write(restored, "!");
+    EXPECT_EQ(restored.get_cell(2, 12).chars[0], static_cast<uint32_t>('!'));
+}
+
+TEST_F(TerminalSnapshotFileTest, RejectsDamagedFiles) {
+    diana::VTerminal term(3, 20);
+    write(term, SAMPLE);
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+    {
+        auto lock = term.lock_scrollback();
+        ASSERT_TRUE(diana::save_terminal(path("c.dsnap"), term, snapshot));
+    }
+
+    std::string error;
+    EXPECT_FALSE(diana::SavedTerminal::load(path("missing.dsnap"), &error));
+    EXPECT_FALSE(error.empty());
+
+    auto size = fs::file_size(path("c.dsnap"));
+    fs::resize_file(path("c.dsnap"), size - 3);
+    error.clear();
+    EXPECT_FALSE(diana::SavedTerminal::load(path("c.dsnap"), &error));
+    EXPECT_NE(error.find("corrupt"), std::string::npos);
+
+    std::ofstream(path("d.dsnap"), std::ios::binary) << "not a snapshot at all, just text";
+    EXPECT_FALSE(diana::SavedTerminal::load(path("d.dsnap"), &error));
+}
@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include "terminal/vterminal.h"
+#include <string>
+
+namespace {
+
+std::string row_text(const diana::VTerminal& term, int row) {
+    std::string text;
+    for (int col = 0; col < term.cols(); ++col) {
+        uint32_t ch = term.get_cell(row, col).chars[0];
+        text.push_back(ch >= 0x20 && ch < 0x7F ? static_cast<char>(ch) : ch == 0 ? ' ' : '?');
+    }
+    while (!text.empty() && text.back() == ' ') {
+        text.pop_back();
+    }
+    return text;
+}
+
+void write(diana::VTerminal& term, const std::string& data) {
+    term.write(data.data(), data.size());
+}
+
+}
+
+TEST(VTerminalTest, TextRunWrapsAtRightMargin) {
+    diana::VTerminal term(3, 10);
+    write(term, "0123456789abcdefghijKLM");
+
+    EXPECT_EQ(row_text(term, 0), "0123456789");
+    EXPECT_EQ(row_text(term, 1), "abcdefghij");
+    EXPECT_EQ(row_text(term, 2), "KLM");
+    EXPECT_EQ(term.get_cursor().row, 2);
+    EXPECT_EQ(term.get_cursor().col, 3);
+}
+
+TEST(VTerminalTest, TextRunStopsAtLastColumnWithoutAutowrap) {
+    diana::VTerminal term(3, 10);
+    write(term, "\x1b[?7l" "0123456789abcdef");
+
+    EXPECT_EQ(row_text(term, 0), "012345678f");
+    EXPECT_EQ(row_text(term, 1), "");
+    EXPECT_EQ(term.get_cursor().col, 9);
+}
+
+TEST(VTerminalTest, TextRunInInsertModeShiftsTheRow) {
+    diana::VTerminal term(3, 10);
+    write(term, "abcdefgh\r\x1b[2C\x1b[4h" "XYZ");
+
+    EXPECT_EQ(row_text(term, 0), "abXYZcdefg");
+    EXPECT_EQ(term.get_cursor().col, 5);
+}
+
+TEST(VTerminalTest, TextRunUsesCurrentPen) {
+    diana::VTerminal term(3, 10);
+    write(term, "a\x1b[1;7m" "bcd\x1b[0m" "e");
+
+    EXPECT_FALSE(term.get_cell(0, 0).bold);
+    for (int col = 1; col <= 3; ++col) {
+        EXPECT_TRUE(term.get_cell(0, col).bold);
+        EXPECT_TRUE(term.get_cell(0, col).reverse);
+    }
+    EXPECT_FALSE(term.get_cell(0, 4).bold);
+}
+
+TEST(VTerminalTest, CombiningMarkJoinsPrecedingAsciiGlyph) {
+    diana::VTerminal term(3, 10);
+    write(term, "abe\xCC\x81x");
+    write(term, "y");
+    write(term, "\xCC\x88");
+
+    EXPECT_EQ(row_text(term, 0), "abexy");
+    EXPECT_EQ(term.get_cell(0, 2).chars[1], 0x301u);
+    EXPECT_EQ(term.get_cell(0, 4).chars[1], 0x308u);
+}
+
+TEST(VTerminalTest, LineDrawingCharsetIsStillTranslated) {
+    diana::VTerminal term(3, 10);
+    write(term, "\x1b(0qqx\x1b(Bqq");
+
+    EXPECT_EQ(term.get_cell(0, 0).chars[0], 0x2500u);
+    EXPECT_EQ(term.get_cell(0, 2).chars[0], 0x2502u);
+    EXPECT_EQ(term.get_cell(0, 3).chars[0], static_cast<uint32_t>('q'));
+}
+
+TEST(VTerminalTest, SplitWritesMatchOneWrite) {
+    std::string data;
+    for (int i = 0; i < 40; ++i) {
+        data += "line " + std::to_string(i) + " \x1b[3" + std::to_string(i % 8) + "m" +
+                std::string(static_cast<size_t>(i % 23), 'a' + i % 26) + "\x1b[0m\r\n";
+        if (i % 7 == 0) data += "\x1b[4h>>\x1b[4l";
+    }
+
+    diana::VTerminal whole(5, 17);
+    write(whole, data);
+    diana::VTerminal bytes(5, 17);
+    for (char c : data) {
+        bytes.write(&c, 1);
+    }
+
+    for (int row = 0; row < 5; ++row) {
+        EXPECT_EQ(row_text(bytes, row), row_text(whole, row));
+        for (int col = 0; col < 17; ++col) {
+            EXPECT_EQ(bytes.get_cell(row, col).fg, whole.get_cell(row, col).fg);
+        }
+    }
+    EXPECT_EQ(bytes.get_cursor().row, whole.get_cursor().row);
+    EXPECT_EQ(bytes.get_cursor().col, whole.get_cursor().col);
+    EXPECT_EQ(bytes.scrollback_size(), whole.scrollback_size());
+}
+
+TEST(VTerminalTest, SynchronizedUpdateModeIsTracked) {
+    diana::VTerminal term(3, 10);
+    EXPECT_FALSE(term.update_in_progress());
+
+    write(term, "\x1b[?2026h");
+    EXPECT_TRUE(term.update_in_progress());
+    write(term, "\x1b[?2026$p");
+    EXPECT_EQ(term.get_output(), "\x1b[?2026;1$y");
+
+    write(term, "\x1b[?2026l");
+    EXPECT_FALSE(term.update_in_progress());
+
+    write(term, "\x1b[?2026h\x1b" "c");
+    EXPECT_FALSE(term.update_in_progress());
+}
+
+TEST(VTerminalTest, ExtractTextSpansScrollbackAndScreen) {
+    diana::VTerminal term(3, 10);
+    write(term, "one\r\ntwo\r\nthree\r\nfour\r\nfive");
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+    ASSERT_EQ(term.scrollback_size(), 2u);
+
+    std::string out = "prefix:";
+    auto lock = term.lock_scrollback();
+    size_t lines = term.extract_text({0, 1}, {3, 2}, snapshot, out);
+    EXPECT_EQ(lines, 4u);
+    EXPECT_EQ(out, "prefix:ne\ntwo\nthree\nfou");
+
+    out.clear();
+    term.extract_text({4, 0}, {4, 100}, snapshot, out);
+    EXPECT_EQ(out, "five");
+}
+
+TEST(VTerminalTest, ExtractTextSkipsWideCharContinuation) {
+    diana::VTerminal term(3, 10);
+    write(term, "a\xE4\xB8\xADz e\xCC\x81");
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+
+    std::string out;
+    auto lock = term.lock_scrollback();
+    term.extract_text({0, 0}, {0, 9}, snapshot, out);
+    EXPECT_EQ(out, "a\xE4\xB8\xADz e\xCC\x81");
+}
+
+TEST(VTerminalTest, ExtractTextWithSgr) {
+    diana::VTerminal term(3, 10);
+    term.set_default_colors(0xFFFFFFFF, 0xFF000000);
+    write(term, "a\x1b[1;38;2;255;0;0mbc\x1b[0md");
+    diana::ScreenSnapshot snapshot;
+    term.snapshot_screen(snapshot);
+
+    std::string out;
+    diana::TextExtractOptions options;
+    options.sgr = true;
+    auto lock = term.lock_scrollback();
+    term.extract_text({0, 0}, {0, 9}, snapshot, out, options);
+    EXPECT_EQ(out, "a\x1b[0;1;38;2;255;0;0mbc\x1b[0md");
+}
+
+TEST(VTerminalTest, PasteDropsControlCharacters) {
+    diana::VTerminal term(3, 20);
+    std::string out;
+    term.keyboard_paste("a\x1b[31mb\tc\r\n\x07\x7f\xC2\x9B" "1~ \xC3\xA9\xFF!", out);
+    EXPECT_EQ(out, "a[31mb\tc\r\n1~ \xC3\xA9\xEF\xBF\xBD!");
+}
+
+TEST(VTerminalTest, PasteIsBracketedWhenEnabled) {
+    diana::VTerminal term(3, 20);
+    write(term, "\x1b[?2004h");
+    std::string out;
+    term.keyboard_paste("x\x1b[201~y", out);
+    EXPECT_EQ(out, "\x1b[200~x[201~y\x1b[201~");
+
+    write(term, "\x1b[?2004l");
+    out.clear();
+    term.keyboard_paste("x", out);
+    EXPECT_EQ(out, "x");
+}
+
+TEST(VTerminalTest, PasteMatchesPerCodepointEncoding) {
+    const std::string text = "fn main() {\n\t\xE4\xB8\xAD\xE6\x96\x87 \xF0\x9F\x98\x80 caf\xC3\xA9\r\n}";
+    diana::VTerminal bulk(3, 20);
+    diana::VTerminal single(3, 20);
+    write(bulk, "\x1b[?2004h");
+    write(single, "\x1b[?2004h");
+
+    std::string out;
+    bulk.keyboard_paste(text, out);
+
+    single.keyboard_start_paste();
+    const uint32_t codepoints[] = {'f', 'n', ' ', 'm', 'a', 'i', 'n', '(', ')', ' ', '{', '\n', '\t',
+                                   0x4E2D, 0x6587, ' ', 0x1F600, ' ', 'c', 'a', 'f', 0xE9, '\r', '\n', '}'};
+    for (uint32_t c : codepoints) {
+        single.keyboard_unichar(c);
+    }
+    single.keyboard_end_paste();
+    EXPECT_EQ(out, single.get_output());
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "core/byte_ring.h"
+#include <chrono>
+#include <string>
+#include <thread>
+
+namespace diana::test {
+
+// Polls pred until it holds or timeout passes.
+template <typename Pred>
+bool eventually(Pred pred, std::chrono::milliseconds timeout = std::chrono::milliseconds(2000)) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Reads everything the ring holds.
+inline std::string drain(ByteRing& ring) {
+    std::string out;
+    while (true) {
+        auto span = ring.read_span();
+        if (span.size == 0) break;
+        out.append(span.data, span.size);
+        ring.commit_read(span.size);
+    }
+    return out;
+}
+
+}
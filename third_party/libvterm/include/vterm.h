@@ -260,6 +260,7 @@ typedef enum {
   VTERM_PROP_CURSORSHAPE,       // number
   VTERM_PROP_MOUSE,             // number
   VTERM_PROP_FOCUSREPORT,       // bool
+  VTERM_PROP_SYNCUPDATE,        // bool
 
   VTERM_N_PROPS
 } VTermProp;
@@ -437,6 +438,11 @@ typedef struct {
   int (*resize)(int rows, int cols, VTermStateFields *fields, void *user);
   int (*setlineinfo)(int row, const VTermLineInfo *newinfo, const VTermLineInfo *oldinfo, void *user);
   int (*sb_clear)(void *user);
+  /* Optional bulk form of putglyph for a run of single-width printable ASCII
+   * on one row. info describes every glyph in the run; its chars is NULL.
+   * Returning 0 makes the state fall back to one putglyph per byte.
+   */
+  int (*putascii)(const char bytes[], int count, VTermGlyphInfo *info, VTermPos pos, void *user);
 } VTermStateCallbacks;
 
 typedef struct {
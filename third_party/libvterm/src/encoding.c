@@ -220,6 +220,18 @@ encodings[] = {
   { 0 },
 };
 
+/* True if printable ASCII bytes decode to themselves in this instance right
+ * now: US-ASCII, or UTF-8 with no multibyte sequence in progress.
+ */
+INTERNAL int vterm_encoding_is_ascii_identity(const VTermEncodingInstance *inst)
+{
+  if(inst->enc == &encoding_usascii)
+    return 1;
+  if(inst->enc == &encoding_utf8)
+    return ((const struct UTF8DecoderData *)inst->data)->bytes_remaining == 0;
+  return 0;
+}
+
 /* This ought to be INTERNAL but isn't because it's used by unit testing */
 VTermEncoding *vterm_lookup_encoding(VTermEncodingType type, char designation)
 {
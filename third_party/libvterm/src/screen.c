@@ -205,6 +205,37 @@ static int putglyph(VTermGlyphInfo *info, VTermPos pos, void *user)
   return 1;
 }
 
+static int putascii(const char bytes[], int count, VTermGlyphInfo *info, VTermPos pos, void *user)
+{
+  VTermScreen *screen = user;
+  ScreenCell *cell = getcell(screen, pos.row, pos.col);
+
+  if(!cell || pos.col + count > screen->cols)
+    return 0;
+
+  ScreenPen pen = screen->pen;
+  pen.protected_cell = info->protected_cell;
+  pen.dwl            = info->dwl;
+  pen.dhl            = info->dhl;
+
+  for(int i = 0; i < count; i++, cell++) {
+    cell->chars[0] = (unsigned char)bytes[i];
+    cell->chars[1] = 0;
+    cell->pen = pen;
+  }
+
+  VTermRect rect = {
+    .start_row = pos.row,
+    .end_row   = pos.row+1,
+    .start_col = pos.col,
+    .end_col   = pos.col+count,
+  };
+
+  damagerect(screen, rect);
+
+  return 1;
+}
+
 static void sb_pushline_from_row(VTermScreen *screen, int row)
 {
   VTermPos pos = { .row = row };
@@ -848,6 +879,7 @@ static VTermStateCallbacks state_cbs = {
   .resize      = &resize,
   .setlineinfo = &setlineinfo,
   .sb_clear    = &sb_clear,
+  .putascii    = &putascii,
 };
 
 static VTermScreen *screen_new(VTerm *vt)
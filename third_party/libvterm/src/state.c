@@ -28,6 +28,27 @@ static void putglyph(VTermState *state, const uint32_t chars[], int width, VTerm
   DEBUG_LOG("libvterm: Unhandled putglyph U+%04x at (%d,%d)\n", chars[0], pos.col, pos.row);
 }
 
+static void putascii(VTermState *state, const char bytes[], int count, VTermPos pos)
+{
+  VTermGlyphInfo info = {
+    .chars = NULL,
+    .width = 1,
+    .protected_cell = state->protected_cell,
+    .dwl = state->lineinfo[pos.row].doublewidth,
+    .dhl = state->lineinfo[pos.row].doubleheight,
+  };
+
+  if(state->callbacks && state->callbacks->putascii)
+    if((*state->callbacks->putascii)(bytes, count, &info, pos, state->cbdata))
+      return;
+
+  uint32_t chars[2] = { 0, 0 };
+  for(int i = 0; i < count; i++, pos.col++) {
+    chars[0] = (unsigned char)bytes[i];
+    putglyph(state, chars, 1, pos);
+  }
+}
+
 static void updatecursor(VTermState *state, VTermPos *oldpos, int cancel_phantom)
 {
   if(state->pos.col == oldpos->col && state->pos.row == oldpos->row)
@@ -269,10 +290,124 @@ static void set_lineinfo(VTermState *state, int row, int force, int dwl, int dhl
     state->lineinfo[row] = info;
 }
 
+/* Length of the leading run of printable ASCII (0x20 to 0x7e) in bytes */
+static size_t printable_ascii_run(const char bytes[], size_t len)
+{
+  const uint64_t ones  = 0x0101010101010101ULL;
+  const uint64_t highs = 0x8080808080808080ULL;
+
+  size_t n = 0;
+  /* Eight bytes at a time. The usual "has a byte less than" test flags any
+   * byte below 0x20; the same test on w ^ 0x7f flags DEL. Either may also
+   * flag a word that is fine, which only costs a trip through the loop below.
+   */
+  for(; n + 8 <= len; n += 8) {
+    uint64_t w;
+    memcpy(&w, bytes + n, 8);
+    uint64_t del = w ^ (ones * 0x7f);
+    if((w | ((w - ones * 0x20) & ~w) | ((del - ones) & ~del)) & highs)
+      break;
+  }
+  for(; n < len; n++) {
+    unsigned char c = bytes[n];
+    if(c < 0x20 || c >= 0x7f)
+      break;
+  }
+  return n;
+}
+
+/* Fast path for plain text: a run of printable ASCII that the G-set in use
+ * maps to itself is written a row segment at a time instead of being decoded
+ * and placed one glyph at a time. Wrapping, insert mode, the pen and the
+ * combining-character bookkeeping come out exactly as the general path in
+ * on_text() leaves them. Returns 0 if the run has to take the general path.
+ */
+static size_t on_text_ascii(VTermState *state, const char bytes[], size_t len)
+{
+  if(state->gsingle_set ||
+     !vterm_encoding_is_ascii_identity(&state->encoding[state->gl_set]))
+    return 0;
+
+  size_t n = printable_ascii_run(bytes, len);
+  /* A combining character may follow; leave the last glyph to the general
+   * path so the two are joined in the same call as they would be anyway */
+  if(n > 0 && n < len && (bytes[n] & 0x80))
+    n--;
+  if(n == 0)
+    return 0;
+
+  VTermPos oldpos = state->pos;
+  VTermPos lastpos = state->pos;
+
+  size_t done = 0;
+  while(done < n) {
+    if(state->at_phantom || state->pos.col + 1 > THISROWWIDTH(state)) {
+      linefeed(state);
+      state->pos.col = 0;
+      state->at_phantom = 0;
+      state->lineinfo[state->pos.row].continuation = 1;
+    }
+
+    int rowwidth = THISROWWIDTH(state);
+    size_t room = rowwidth - state->pos.col;
+    size_t count = n - done < room ? n - done : room;
+    const char *segment = bytes + done;
+
+    /* Without autowrap every glyph past the margin lands in the last cell;
+     * only the final one survives */
+    if(!state->mode.autowrap && state->pos.col == rowwidth - 1) {
+      segment = bytes + n - 1;
+      count = 1;
+      done = n - 1;
+    }
+
+    if(state->mode.insert) {
+      /* Shifting once by the whole segment leaves the same row as one ICH
+       * per glyph */
+      VTermRect rect = {
+        .start_row = state->pos.row,
+        .end_row   = state->pos.row + 1,
+        .start_col = state->pos.col,
+        .end_col   = rowwidth,
+      };
+      scroll(state, rect, 0, -(int)count);
+    }
+
+    putascii(state, segment, (int)count, state->pos);
+    done += count;
+
+    lastpos = state->pos;
+    lastpos.col += (int)count - 1;
+
+    if(state->pos.col + (int)count >= rowwidth) {
+      state->pos.col = rowwidth - 1;
+      if(state->mode.autowrap)
+        state->at_phantom = 1;
+    }
+    else {
+      state->pos.col += (int)count;
+    }
+  }
+
+  /* Save the last glyph in case the next write starts with combining chars */
+  state->combine_chars[0] = (unsigned char)bytes[n - 1];
+  state->combine_chars[1] = 0;
+  state->combine_width = 1;
+  state->combine_pos = lastpos;
+
+  updatecursor(state, &oldpos, 0);
+
+  return n;
+}
+
 static int on_text(const char bytes[], size_t len, void *user)
 {
   VTermState *state = user;
 
+  size_t fast = on_text_ascii(state, bytes, len);
+  if(fast)
+    return fast;
+
   VTermPos oldpos = state->pos;
 
   uint32_t *codepoints = (uint32_t *)(state->vt->tmpbuffer);
@@ -834,6 +969,10 @@ static void set_dec_mode(VTermState *state, int num, int val)
     state->mode.bracketpaste = val;
     break;
 
+  case 2026: // synchronized update; the embedder decides what to hold back
+    settermprop_bool(state, VTERM_PROP_SYNCUPDATE, val);
+    break;
+
   default:
     DEBUG_LOG("libvterm: Unknown DEC mode %d\n", num);
     return;
@@ -909,6 +1048,10 @@ static void request_dec_mode(VTermState *state, int num)
       reply = state->mode.bracketpaste;
       break;
 
+    case 2026:
+      reply = state->mode.sync_update;
+      break;
+
     default:
       vterm_push_output_sprintf_ctrl(state->vt, C1_CSI, "?%d;%d$y", num, 0);
       return;
@@ -2087,6 +2230,9 @@ void vterm_state_reset(VTermState *state, int hard)
   state->mode.bracketpaste    = 0;
   state->mode.report_focus    = 0;
 
+  if(state->mode.sync_update)
+    settermprop_bool(state, VTERM_PROP_SYNCUPDATE, 0);
+
   state->mouse_flags = 0;
 
   state->vt->mode.ctrl8bit   = 0;
@@ -2228,6 +2374,9 @@ int vterm_state_set_termprop(VTermState *state, VTermProp prop, VTermValue *val)
   case VTERM_PROP_FOCUSREPORT:
     state->mode.report_focus = val->boolean;
     return 1;
+  case VTERM_PROP_SYNCUPDATE:
+    state->mode.sync_update = val->boolean;
+    return 1;
 
   case VTERM_N_PROPS:
     return 0;
@@ -120,6 +120,7 @@ struct VTermState
     unsigned int leftrightmargin:1;
     unsigned int bracketpaste:1;
     unsigned int report_focus:1;
+    unsigned int sync_update:1;
   } mode;
 
   VTermEncodingInstance encoding[4], encoding_utf8;
@@ -290,6 +291,7 @@ void vterm_state_push_output_sprintf_CSI(VTermState *vts, const char *format, ..
 void vterm_screen_free(VTermScreen *screen);
 
 VTermEncoding *vterm_lookup_encoding(VTermEncodingType type, char designation);
+int vterm_encoding_is_ascii_identity(const VTermEncodingInstance *inst);
 
 int vterm_unicode_width(uint32_t codepoint);
 int vterm_unicode_is_combining(uint32_t codepoint);